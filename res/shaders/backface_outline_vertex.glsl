@@ -0,0 +1,17 @@
+#define VERTEX
+#include "common_inputs.glsl"
+#include "star_rail_outline_inputs.glsl"
+
+void main() {
+    // TODO: depth dependent, fov dependent, screen apsect dependent, sub mesh depedent width
+    CameraTransform camera = view_camera();
+    PretransformedVertex vertex = PRETRANSFORMED_VERTEX;
+    vec4 position_vs = trans_point_ws2vs(camera.view, vertex.position_ws);
+    vec3 normal_vs = trans_dir_ws2vs_norm(camera.view, vertex.normal_ws.xyz);
+    normal_vs = normalize(vec3(normal_vs.xy, 0.0f)); // 拍扁，无深度区别
+    float outline_width_adjust = OUTLINE_WIDTH;
+    if (!k_is_face)
+        position_vs += vec4(normal_vs, 0.0f) * outline_width_adjust;
+    gl_Position = trans_point_vs2cs(camera.proj, position_vs);
+    vs_out.tex_coord = in_tex_coord;
+}
@@ -0,0 +1,28 @@
+#ifndef BINDLESS
+#define BINDLESS
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// BindlessTextureTable：所有纹理一个数组，每个材质一条记录存它用到的纹理序号
+const uint k_max_material_textures = 4u; // 和 BindlessTextureTable::max_material_textures 一致
+
+layout(set = set_bindless, binding = 0) uniform sampler2D bindless_textures[];
+
+layout(std430, set = set_bindless, binding = 1) readonly buffer BindlessMaterials
+{
+    uvec4 material_textures[];
+};
+
+#if defined(VERTEX) || defined(FRAGMENT)
+// 材质 ID 在 common_inputs.glsl 的 ObjectPushConstants 里
+#define MATERIAL_ID object_pc.material_id
+#define BINDLESS_INDEX(index) (index)
+#else
+// compute 里每个像素的材质可能不同，调用方在 include 之前定义 MATERIAL_ID
+#define BINDLESS_INDEX(index) nonuniformEXT(index)
+#endif
+
+// 当前材质的第 slot 张纹理
+#define MATERIAL_TEXTURE(slot) bindless_textures[BINDLESS_INDEX(material_textures[MATERIAL_ID][slot])]
+
+#endif
@@ -4,6 +4,7 @@
 const int set_frame = 0;
 const int set_scene = 0;
 const int set_object = 1;
-const int set_material = 2;
+const int set_bindless = 2;
+const int set_material = 3;
 
 #endif
\ No newline at end of file
@@ -1,3 +1,8 @@
+// SINGLE_VIEW: GPU 不支持 multiViewport / shaderOutputViewportIndex 时的变体 (*_single_view.vert)，不写 gl_ViewportIndex，只有一个视口
+#if defined(VERTEX) && !defined(SINGLE_VIEW)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
 #include "glsl/core/lighting.glsl"
 #include "space_transform.glsl"
 #include "common_data.glsl"
@@ -6,19 +11,44 @@
 // {
 // };
 
-#if defined(VERTEX) || defined(FRAGMENT)
+const uint k_max_views = 4u; // 和 concrete_uniform_buffers.h 的 max_render_views 一致
+
+#if defined(VERTEX) || defined(FRAGMENT) || defined(COMPUTE)
 layout(set = set_scene, binding = 0) uniform UniformPerScene
 {
     Light main_light;
-    CameraTransform camera_trans;
+    CameraTransform cameras[k_max_views];
 } render_set;
 #endif
 
+#if defined(VERTEX) || defined(FRAGMENT)
+// 每个 draw 的数据，和 concrete_uniform_buffers.h 的 ObjectPushConstants 一致
+layout(push_constant) uniform ObjectPushConstants
+{
+    uint vertex_base;
+    uint material_id;
+} object_pc;
+#endif
+
 #ifdef VERTEX
-layout(set = set_object, binding = 0) uniform UniformPerObject
+// 所有 model 预变换好的顶点，这个 model 的从 vertex_base 开始
+layout(std430, set = set_object, binding = 0) readonly buffer PretransformedVertices
+{
+    PretransformedVertex pretransformed_vertices[];
+};
+
+#define PRETRANSFORMED_VERTEX pretransformed_vertices[object_pc.vertex_base + gl_VertexIndex]
+
+// 多个视口共用一次 draw：第 i 个 instance 画到第 i 个视口，用第 i 个相机
+CameraTransform view_camera()
 {
-    ModelTransform model_trans;
-} obj;
+#ifdef SINGLE_VIEW
+    return render_set.cameras[0];
+#else
+    gl_ViewportIndex = gl_InstanceIndex;
+    return render_set.cameras[gl_InstanceIndex];
+#endif
+}
 #endif
 
 // struct UniformPerMaterial
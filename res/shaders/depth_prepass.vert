@@ -0,0 +1,3 @@
+#version 450
+
+#include "depth_prepass_vertex.glsl"
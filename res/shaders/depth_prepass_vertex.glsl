@@ -0,0 +1,11 @@
+#define VERTEX
+#include "common_inputs.glsl"
+
+// 只要位置，深度要和主pass的顶点着色器逐位一致，eEqual 才不会闪
+invariant gl_Position;
+
+void main() {
+    CameraTransform camera = view_camera();
+    vec4 position_ws = PRETRANSFORMED_VERTEX.position_ws;
+    gl_Position = trans_point_ws2cs(camera.view_proj, position_ws);
+}
@@ -0,0 +1,8 @@
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(push_constant) uniform HiZPushConstants
+{
+    ivec2 src_extent;
+    ivec2 dst_extent;
+    int sample_count;
+} pc;
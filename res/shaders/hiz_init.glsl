@@ -0,0 +1,23 @@
+#include "hiz_common.glsl"
+
+#ifdef MULTISAMPLE
+layout(set = 0, binding = 0) uniform sampler2DMS depth_tex;
+#else
+layout(set = 0, binding = 0) uniform sampler2D depth_tex;
+#endif
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D hiz_mip0;
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(coord, pc.dst_extent)))
+        return;
+#ifdef MULTISAMPLE
+    // 取所有sample里最远的深度，保守
+    float depth = 0.0;
+    for (int i = 0; i < pc.sample_count; ++i)
+        depth = max(depth, texelFetch(depth_tex, coord, i).r);
+#else
+    float depth = texelFetch(depth_tex, coord, 0).r;
+#endif
+    imageStore(hiz_mip0, coord, vec4(depth));
+}
@@ -0,0 +1,15 @@
+#version 450
+
+// 在主 render pass 里把屏幕空间描边按 alpha 混合上去
+layout(set = 0, binding = 0) uniform sampler2D outline_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    vec4 color = texelFetch(outline_color, ivec2(gl_FragCoord.xy), 0);
+    if (color.a == 0.0f)
+    {
+        discard;
+    }
+    out_color = color;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout(push_constant) uniform OutlineGBufferPushConstants
+{
+    layout(offset = 4) uint outline_id; // 0 表示这个表面不描边。ObjectPushConstants 的第二个 uint，前面是顶点着色器的 vertex_base
+} pc;
+
+layout(location = 0) in vec3 in_normal_ws;
+
+layout(location = 0) out uint out_outline_id;
+layout(location = 1) out vec4 out_normal_ws;
+
+void main() {
+    out_outline_id = pc.outline_id;
+    out_normal_ws = vec4(normalize(in_normal_ws), 0.0f);
+}
@@ -0,0 +1,3 @@
+#version 450
+
+#include "outline_gbuffer_vertex.glsl"
@@ -0,0 +1,4 @@
+#version 450
+
+#define SINGLE_VIEW
+#include "outline_gbuffer_vertex.glsl"
@@ -0,0 +1,12 @@
+#define VERTEX
+#include "common_inputs.glsl"
+
+// 屏幕空间描边的 G-buffer，只要位置和法线
+layout(location = 0) out vec3 out_normal_ws;
+
+void main() {
+    CameraTransform camera = view_camera();
+    PretransformedVertex vertex = PRETRANSFORMED_VERTEX;
+    gl_Position = trans_point_ws2cs(camera.view_proj, vertex.position_ws);
+    out_normal_ws = vertex.normal_ws.xyz;
+}
@@ -21,6 +21,13 @@ struct ModelTransform
     mat4 model_view_proj;
 };
 
+// vertex_pretransform.comp 每帧写一次，w 没用
+struct PretransformedVertex
+{
+    vec4 position_ws;
+    vec4 normal_ws;
+};
+
 vec4 homo_dir(vec3 dir)
 {
     return vec4(dir, 0.0);
@@ -1,8 +1,6 @@
-#extension GL_EXT_scalar_block_layout : enable
+#extension GL_EXT_scalar_block_layout : require
 
 const int k_material_region_count = 8;
-const int k_debug_bind_index = 0;
-const int k_custom_bind_index = k_debug_bind_index + 1;
 
 struct Outline
 {
@@ -11,20 +9,60 @@ struct Outline
     float width;
 };
 
-// https://docs.vulkan.org/guide/latest/shader_memory_layout.html
-// 让specular_shininess和specular_roughness的一个变量是4字节，而不是16字节
+#include "bindless.glsl"
+#include "virtual_texture.glsl"
 
-#define DEBUG_UNIFORM_DEFINITION layout(set = set_material, binding = k_debug_bind_index) uniform Debug { \
-    vec4 debug_control; \
-    bool show_material_region; \
-} debug;
+// MaterialParameterTable 的一条记录，和 C++ 的 StarRailMaterialParameters 一致，scalar 布局按 C++ 的方式紧排，
+// 补齐到 256 字节。按材质 ID 取，换材质不用换 set
+struct StarRailParameters
+{
+    Outline outline;
+    vec4 specular_colors[k_material_region_count];
+    float specular_shininess[k_material_region_count];
+    float specular_roughness[k_material_region_count];
+    vec4 debug_control;
+    uint show_material_region;
+    uint padding[6];
+};
+
+layout(scalar, set = set_bindless, binding = 2) readonly buffer MaterialParameters
+{
+    StarRailParameters material_params[];
+};
+
+#define props material_params[MATERIAL_ID]
+#define debug material_params[MATERIAL_ID]
+
+// 冻结的材质把静态参数烘焙成特化常量 (StarRailConstantId)，k_params_frozen 也是常量，没冻结的分支会被驱动删掉
+layout(constant_id = 1) const bool k_params_frozen = false;
+layout(constant_id = 2) const float k_specular_shininess_0 = 10.0f;
+layout(constant_id = 3) const float k_specular_shininess_1 = 10.0f;
+layout(constant_id = 4) const float k_specular_shininess_2 = 10.0f;
+layout(constant_id = 5) const float k_specular_shininess_3 = 10.0f;
+layout(constant_id = 6) const float k_specular_shininess_4 = 10.0f;
+layout(constant_id = 7) const float k_specular_shininess_5 = 10.0f;
+layout(constant_id = 8) const float k_specular_shininess_6 = 10.0f;
+layout(constant_id = 9) const float k_specular_shininess_7 = 10.0f;
+layout(constant_id = 10) const float k_specular_roughness_0 = 0.04f;
+layout(constant_id = 11) const float k_specular_roughness_1 = 0.04f;
+layout(constant_id = 12) const float k_specular_roughness_2 = 0.04f;
+layout(constant_id = 13) const float k_specular_roughness_3 = 0.04f;
+layout(constant_id = 14) const float k_specular_roughness_4 = 0.04f;
+layout(constant_id = 15) const float k_specular_roughness_5 = 0.04f;
+layout(constant_id = 16) const float k_specular_roughness_6 = 0.04f;
+layout(constant_id = 17) const float k_specular_roughness_7 = 0.04f;
+layout(constant_id = 18) const float k_outline_width = 0.02f;
+
+const float k_specular_shininess[k_material_region_count] = float[](
+    k_specular_shininess_0, k_specular_shininess_1, k_specular_shininess_2, k_specular_shininess_3,
+    k_specular_shininess_4, k_specular_shininess_5, k_specular_shininess_6, k_specular_shininess_7);
+const float k_specular_roughness[k_material_region_count] = float[](
+    k_specular_roughness_0, k_specular_roughness_1, k_specular_roughness_2, k_specular_roughness_3,
+    k_specular_roughness_4, k_specular_roughness_5, k_specular_roughness_6, k_specular_roughness_7);
 
-#define CUSTOM_PROPERTIES_UNIFORM_DEFINITION layout(std430, set = set_material, binding = k_custom_bind_index) uniform Properties { \
-    Outline outline; \
-    vec4 specular_colors[k_material_region_count]; \
-    float specular_shininess[k_material_region_count]; \
-    float specular_roughness[k_material_region_count]; \
-} props;
+#define SPECULAR_SHININESS(region) (k_params_frozen ? k_specular_shininess[region] : props.specular_shininess[region])
+#define SPECULAR_ROUGHNESS(region) (k_params_frozen ? k_specular_roughness[region] : props.specular_roughness[region])
+#define OUTLINE_WIDTH (k_params_frozen ? k_outline_width : props.outline.width)
 
 
 
@@ -0,0 +1,9 @@
+#define FRAGMENT
+#include "common_inputs.glsl"
+#include "star_rail_inputs.glsl"
+#include "star_rail_shading.glsl"
+
+
+void main() {
+    out_color = shade_star_rail(vs_out.tex_coord, vs_out.normal_ws, vs_out.view_dir_ws);
+}
@@ -21,20 +21,23 @@ layout(location = 0) out VetextShaderOutput vs_out;
 
 
 
-#ifdef FRAGMENT  // Fragment Shader
+#if defined(FRAGMENT) || defined(COMPUTE)  // Fragment Shader 或可见性缓冲的着色 Compute Shader
 
 MODEL_PART_SPECIAL_CONSTANT_DEFINITION
 
-layout(location = 0) in VetextShaderOutput vs_out;
+// 纹理槽位和 StarRailMaterialInstanceBuilder 注册的顺序一致
+#define main_tex_slot 0u  // diffuse texture
+#define light_map_slot 1u
+#define cool_ramp_slot 2u
+#define warm_ramp_slot 3u
+
+#endif
 
-DEBUG_UNIFORM_DEFINITION
 
-CUSTOM_PROPERTIES_UNIFORM_DEFINITION
 
-layout(set = set_material, binding = k_custom_bind_index + 1) uniform sampler2D main_tex_sampler;  // diffuse texture
-layout(set = set_material, binding = k_custom_bind_index + 2) uniform sampler2D light_map_sampler;
-layout(set = set_material, binding = k_custom_bind_index + 3) uniform sampler2D cool_ramp_sampler;
-layout(set = set_material, binding = k_custom_bind_index + 4) uniform sampler2D warm_ramp_sampler;
+#ifdef FRAGMENT  // Fragment Shader
+
+layout(location = 0) in VetextShaderOutput vs_out;
 
 layout(location = 0) out vec4 out_color;
 
@@ -0,0 +1,4 @@
+#version 450
+
+#define NO_VIRTUAL_TEXTURE_FEEDBACK
+#include "star_rail_fragment.glsl"
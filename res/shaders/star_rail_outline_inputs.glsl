@@ -18,16 +18,12 @@ layout(location = 2) in vec2 in_tex_coord;
 
 layout(location = 0) out VetextShaderOutput vs_out;
 
-CUSTOM_PROPERTIES_UNIFORM_DEFINITION
-
 #endif
 
 #ifdef FRAGMENT
 layout(location = 0) in VetextShaderOutput vs_out;
 
-CUSTOM_PROPERTIES_UNIFORM_DEFINITION
-
-layout(set = set_material, binding = k_custom_bind_index + 1) uniform sampler2D main_tex_sampler;  // diffuse texture
+#define main_tex_slot 0u  // diffuse texture
 
 layout(location = 0) out vec4 out_color;
 
@@ -0,0 +1,4 @@
+#version 450
+
+#define SINGLE_VIEW
+#include "star_rail_vertex.glsl"
@@ -0,0 +1,16 @@
+#define VERTEX
+#include "common_inputs.glsl"
+#include "star_rail_inputs.glsl"
+
+invariant gl_Position; // 和 depth_prepass_vertex.glsl 保持一致
+
+void main() {
+    CameraTransform camera = view_camera();
+    PretransformedVertex vertex = PRETRANSFORMED_VERTEX;
+    vec4 position_ws = vertex.position_ws;
+    gl_Position = trans_point_ws2cs(camera.view_proj, position_ws);
+    vs_out.tex_coord = in_tex_coord;
+    vs_out.normal_ws = vertex.normal_ws.xyz;
+    vec4 camera_pos_ws = get_camera_pos_ws(camera.view);
+    vs_out.view_dir_ws = normalize((camera_pos_ws - position_ws).xyz);
+}
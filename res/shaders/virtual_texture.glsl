@@ -0,0 +1,127 @@
+#ifndef VIRTUAL_TEXTURE
+#define VIRTUAL_TEXTURE
+
+#include "bindless.glsl"
+
+// VirtualTextureSystem：虚拟纹理是稀疏 image，没驻留的 tile 不能采样。
+// 每个纹理一条 tile 信息，普通纹理是 0：
+// x 第一个 tile 在位图里的序号，y 宽 | 高 << 16，z tile 宽 | tile 高 << 16，w mip 级数 | mip tail 的第一级 << 8。
+// tile 按级从大到小、级内按行编号，和 VirtualTextureFile 一致
+#if defined(FRAGMENT) || defined(COMPUTE)  // 顶点阶段不能有可写的 storage buffer
+
+layout(std430, set = set_bindless, binding = 3) readonly buffer VirtualTextures
+{
+    uvec4 virtual_textures[];
+};
+
+// 这一帧要采样的 tile，录制下一帧之前拷走清零。
+// NO_VIRTUAL_TEXTURE_FEEDBACK：没有虚拟纹理时的片元着色器变体 (*_no_feedback.frag)，不要求 fragmentStoresAndAtomics，不写反馈
+#ifndef NO_VIRTUAL_TEXTURE_FEEDBACK
+layout(std430, set = set_bindless, binding = 4) buffer VirtualTextureFeedback
+{
+    uint virtual_texture_feedback[];
+};
+#endif
+
+// CPU 写，已经拷好可以采样的 tile
+layout(std430, set = set_bindless, binding = 5) readonly buffer VirtualTextureResidency
+{
+    uint virtual_texture_residency[];
+};
+
+#ifdef FRAGMENT
+#define VIRTUAL_TEXTURE_PIXEL uvec2(gl_FragCoord.xy)
+#else
+#define VIRTUAL_TEXTURE_PIXEL gl_LocalInvocationID.xy
+#endif
+
+// level 要在 mip tail 之前。texel 是这一级的像素坐标，按 repeat 绕回 (clamp 的纹理在边上多查一个 tile，只会更保守)
+uint virtual_tile_bit(uvec4 info, uint level, ivec2 texel)
+{
+    uvec2 size = uvec2(info.y & 0xffffu, info.y >> 16);
+    uvec2 tile_size = uvec2(info.z & 0xffffu, info.z >> 16);
+    uint bit = info.x;
+    for (uint i = 0u; i < level; ++i)
+    {
+        uvec2 tiles = (max(size >> i, uvec2(1u)) + tile_size - 1u) / tile_size;
+        bit += tiles.x * tiles.y;
+    }
+    ivec2 level_size = ivec2(max(size >> level, uvec2(1u)));
+    uvec2 tiles = (uvec2(level_size) + tile_size - 1u) / tile_size;
+    uvec2 tile = uvec2(texel - level_size * ivec2(floor(vec2(texel) / vec2(level_size)))) / tile_size;  // 负数不能用 %
+    return bit + tile.y * tiles.x + tile.x;
+}
+
+ivec2 virtual_level_size(uvec4 info, uint level)
+{
+    return ivec2(max(uvec2(info.y & 0xffffu, info.y >> 16) >> level, uvec2(1u)));
+}
+
+bool virtual_bit_resident(uint bit)
+{
+    return (virtual_texture_residency[bit >> 5] & (1u << (bit & 31u))) != 0u;
+}
+
+// level 上双线性过滤 uv 要读的 2x2 个像素，所在的 tile 都驻留了。在 tile 边上会跨到相邻的 tile
+bool virtual_footprint_resident(uvec4 info, uint level, vec2 uv)
+{
+    if (level >= (info.w >> 8))
+    {
+        return true;  // mip tail 一直驻留
+    }
+    ivec2 texel = ivec2(floor(uv * vec2(virtual_level_size(info, level)) - 0.5f));
+    uint bit = virtual_tile_bit(info, level, texel);
+    uint bit_x = virtual_tile_bit(info, level, texel + ivec2(1, 0));
+    uint bit_y = virtual_tile_bit(info, level, texel + ivec2(0, 1));
+    uint bit_xy = virtual_tile_bit(info, level, texel + ivec2(1, 1));
+    return virtual_bit_resident(bit) && virtual_bit_resident(bit_x) && virtual_bit_resident(bit_y) && virtual_bit_resident(bit_xy);
+}
+
+// 普通纹理直接 textureGrad。虚拟纹理记下想要的 tile，再用 textureLod 采样最清楚的、过滤要读的 tile 都已经驻留的一级
+vec4 sample_virtual_texture(uint texture_index, vec2 uv, vec2 uv_ddx, vec2 uv_ddy)
+{
+    uvec4 info = virtual_textures[texture_index];
+    if (info.w == 0u)
+    {
+        return textureGrad(bindless_textures[BINDLESS_INDEX(texture_index)], uv, uv_ddx, uv_ddy);
+    }
+    uint mip_levels = info.w & 0xffu;
+    uint mip_tail_start = info.w >> 8;
+    vec2 size = vec2(info.y & 0xffffu, info.y >> 16);
+    // 和采样器一样按长轴选级，检查的和采样的是同一级
+    float lod = clamp(log2(max(max(length(uv_ddx * size), length(uv_ddy * size)), 1e-6f)), 0.0f, float(mip_levels - 1u));
+    uint level = uint(lod);
+
+#ifndef NO_VIRTUAL_TEXTURE_FEEDBACK
+    // 只有 1/16 的像素写反馈，已经有人写过的不再做原子操作
+    uvec2 pixel = VIRTUAL_TEXTURE_PIXEL;
+    if (level < mip_tail_start && (pixel.x & 3u) == 0u && (pixel.y & 3u) == 0u)
+    {
+        uint bit = virtual_tile_bit(info, level, ivec2(floor(uv * vec2(virtual_level_size(info, level)))));
+        uint mask = 1u << (bit & 31u);
+        if ((virtual_texture_feedback[bit >> 5] & mask) == 0u)
+        {
+            atomicOr(virtual_texture_feedback[bit >> 5], mask);
+        }
+    }
+#endif
+
+    uint resident_level = level;
+    while (resident_level + 1u < mip_levels && !virtual_footprint_resident(info, resident_level, uv))
+    {
+        ++resident_level;
+    }
+    // 要的那一级和下一级都在就在两级之间过滤，否则钳在驻留的这一级
+    if (resident_level == level && (level + 1u >= mip_levels || virtual_footprint_resident(info, level + 1u, uv)))
+    {
+        return textureLod(bindless_textures[BINDLESS_INDEX(texture_index)], uv, lod);
+    }
+    return textureLod(bindless_textures[BINDLESS_INDEX(texture_index)], uv, float(resident_level));
+}
+
+// 当前材质的第 slot 张纹理，普通的和虚拟的都能用
+#define SAMPLE_MATERIAL_TEXTURE(slot, uv, uv_ddx, uv_ddy) sample_virtual_texture(material_textures[MATERIAL_ID][slot], uv, uv_ddx, uv_ddy)
+
+#endif
+
+#endif
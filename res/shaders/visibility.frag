@@ -0,0 +1,15 @@
+#version 450
+
+#include "visibility_common.glsl"
+
+// 顶点着色器复用 depth_prepass.vert (或 _single_view 变体)，这里只写 ID，不跑任何材质
+layout(push_constant) uniform VisibilityDrawConstants
+{
+    layout(offset = 4) uint draw_id; // ObjectPushConstants 的第二个 uint，前面是顶点着色器的 vertex_base
+} draw;
+
+layout(location = 0) out uvec2 out_ids;
+
+void main() {
+    out_ids = uvec2(gl_PrimitiveID, draw.draw_id);
+}
@@ -0,0 +1,115 @@
+#ifndef VISIBILITY_COMMON
+#define VISIBILITY_COMMON
+
+// 可见性缓冲每个像素 64 位：x = 三角形在这次 draw 里的序号(gl_PrimitiveID)，y = draw 序号
+const uint k_vis_invalid_id = 0xffffffffu;
+const uint k_vis_tile_size = 8u;
+const uint k_vis_max_bins = 64u; // 和 VisibilityBufferDrawer::max_bins 一致
+const int set_visibility = 1;    // 着色时 set 1 (原来的 set_object) 换成可见性缓冲的公共资源
+const int set_geometry = 3;    // 材质参数都在 set_bindless 里，原来的 set_material 给网格数据用
+
+struct VisibilityDrawRecord
+{
+    mat4 model;
+    uint bin;  // (材质管线, 网格) 组合的序号，着色按它分批
+    uint vertex_offset;
+    uint index_offset;
+    uint material_id;
+};
+
+#ifdef COMPUTE
+
+layout(push_constant) uniform VisibilityPushConstants
+{
+    uvec2 extent;
+    uint tile_count_x;
+    uint tile_capacity;  // 每个 bin 的 tile 列表长度，等于屏幕上的 tile 数
+    uint bin;
+    uint vertex_stride;  // 以下以 float 为单位
+    uint position_offset;
+    uint normal_offset;
+    uint tex_coord_offset;
+} pc;
+
+layout(set = set_visibility, binding = 0, rg32ui) uniform readonly uimage2D vis_ids;
+
+layout(std430, set = set_visibility, binding = 1) readonly buffer VisibilityDraws
+{
+    VisibilityDrawRecord draws[];
+};
+
+struct DispatchIndirectCommand
+{
+    uint x;
+    uint y;
+    uint z;
+};
+
+layout(std430, set = set_visibility, binding = 2) buffer VisibilityBinArgs
+{
+    DispatchIndirectCommand bin_args[];
+};
+
+layout(std430, set = set_visibility, binding = 3) buffer VisibilityBinTiles
+{
+    uint bin_tiles[];  // bin * tile_capacity + i
+};
+
+layout(set = set_visibility, binding = 4, rgba16f) uniform writeonly image2D shaded_color;
+
+#endif
+
+// 透视校正的重心坐标和它对屏幕 x/y 方向一个像素的偏导，给纹理采样算 LOD
+// ref: "Deferred Attribute Interpolation Shading"(Schied, Dachsbacher) / The Forge 的 visibility buffer
+struct BarycentricDeriv
+{
+    vec3 lambda;
+    vec3 ddx;
+    vec3 ddy;
+};
+
+BarycentricDeriv calc_barycentric_deriv(vec4 pt0, vec4 pt1, vec4 pt2, vec2 pixel_ndc, vec2 extent)
+{
+    BarycentricDeriv ret;
+    vec3 inv_w = 1.0f / vec3(pt0.w, pt1.w, pt2.w);
+    vec2 ndc0 = pt0.xy * inv_w.x;
+    vec2 ndc1 = pt1.xy * inv_w.y;
+    vec2 ndc2 = pt2.xy * inv_w.z;
+
+    float inv_det = 1.0f / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * inv_det * inv_w;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * inv_det * inv_w;
+    float ddx_sum = dot(ddx, vec3(1.0f));
+    float ddy_sum = dot(ddy, vec3(1.0f));
+
+    vec2 delta = pixel_ndc - ndc0;
+    float interp_inv_w = inv_w.x + delta.x * ddx_sum + delta.y * ddy_sum;
+    float interp_w = 1.0f / interp_inv_w;
+    ret.lambda = interp_w * vec3(inv_w.x + delta.x * ddx.x + delta.y * ddy.x,
+                                 delta.x * ddx.y + delta.y * ddy.y,
+                                 delta.x * ddx.z + delta.y * ddy.z);
+
+    // NDC 一个像素是 2 / extent，vulkan 的 NDC y 和像素 y 同向
+    vec2 pixel_step = 2.0f / extent;
+    ddx *= pixel_step.x;
+    ddy *= pixel_step.y;
+    ddx_sum *= pixel_step.x;
+    ddy_sum *= pixel_step.y;
+    float interp_w_ddx = 1.0f / (interp_inv_w + ddx_sum);
+    float interp_w_ddy = 1.0f / (interp_inv_w + ddy_sum);
+    ret.ddx = interp_w_ddx * (ret.lambda * interp_inv_w + ddx) - ret.lambda;
+    ret.ddy = interp_w_ddy * (ret.lambda * interp_inv_w + ddy) - ret.lambda;
+    return ret;
+}
+
+vec2 interpolate(BarycentricDeriv deriv, vec2 a0, vec2 a1, vec2 a2)
+{
+    return deriv.lambda.x * a0 + deriv.lambda.y * a1 + deriv.lambda.z * a2;
+}
+
+vec3 interpolate(BarycentricDeriv deriv, vec3 a0, vec3 a1, vec3 a2)
+{
+    return deriv.lambda.x * a0 + deriv.lambda.y * a1 + deriv.lambda.z * a2;
+}
+
+#endif
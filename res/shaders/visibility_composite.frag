@@ -0,0 +1,20 @@
+#version 450
+
+#include "visibility_common.glsl"
+
+// 在主 render pass 里把可见性缓冲的着色结果铺上去，深度也写回去，后面前向画的描边还能做深度测试
+layout(set = 0, binding = 0) uniform usampler2D vis_ids;
+layout(set = 0, binding = 1) uniform sampler2D shaded_color;
+layout(set = 0, binding = 2) uniform sampler2D vis_depth;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (texelFetch(vis_ids, pixel, 0).y == k_vis_invalid_id)
+    {
+        discard;
+    }
+    out_color = texelFetch(shaded_color, pixel, 0);
+    gl_FragDepth = texelFetch(vis_depth, pixel, 0).r;
+}
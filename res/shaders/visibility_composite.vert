@@ -0,0 +1,7 @@
+#version 450
+
+// 一个盖住整个屏幕的三角形
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0f - 1.0f, 0.0f, 1.0f);
+}
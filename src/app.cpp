@@ -15,12 +15,9 @@ App::App(HINSTANCE hinst, HINSTANCE hprev, LPSTR cmdline, int show)
     jre::Graphics &graphics = renderer.graphics();
     jre::SceneDrawer &scene_drawer = renderer.scene_drawer();
     jre::Scene &scene = scene_drawer.scene;
-    jre::Model &model = scene.models.emplace_back(load_lingsha(scene_drawer,
-                                                               graphics.cpu_frames().size(),
-                                                               graphics.logical_device(),
-                                                               graphics.physical_device(),
-                                                               graphics.transfer_queue(),
-                                                               vk::shared::allocate_one_command_buffer(graphics.transfer_command_pool())));
+    // 不等加载完，先画出第一帧，灵砂在之后几帧里出现
+    jre::AsyncModelHandle lingsha = load_lingsha_async(renderer.model_loader(), scene_drawer, graphics.cpu_frames().size());
+    jre::Model &model = scene.models[lingsha.model_index];
     model.transform.set_model(glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
 
     auto camera_controller = std::make_shared<jre::CameraController>(renderer.input_manager);
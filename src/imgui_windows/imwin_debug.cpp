@@ -29,6 +29,10 @@ void ImWinDebug::tick()
     frame_info();
     present_mode();
     msaa();
+    occlusion_culling();
+    depth_prepass();
+    visibility_buffer();
+    multi_view();
     camera_info();
     control_info();
     shader_properties();
@@ -42,6 +46,46 @@ void ImWinDebug::frame_info()
 
     auto &frame_fps = frame_counter_graph.frame_fps();
     ImGui::PlotLines("Frame Times", &frame_fps[0], 50, 0, "", 0.0f, frame_counter_graph.max_fps(), ImVec2(0, 80));
+    ImGui::Text("pretransformed vertices: %u", m_renderer.vertex_pretransformer().vertex_count);
+    const jre::BindlessTextureTable &bindless_textures = m_renderer.scene_drawer().bindless_textures;
+    ImGui::Text("bindless textures: %u, materials: %u", bindless_textures.texture_count(), bindless_textures.material_count());
+    ImGui::Text("material parameter uploads: %u", m_renderer.scene_drawer().material_parameters->uploaded_count);
+    const jre::TextureStreamer &texture_streamer = m_renderer.texture_streamer();
+    ImGui::Text("streamed textures: %u, resident: %.1f / %.1f MB, streaming: %u",
+                texture_streamer.texture_count(),
+                texture_streamer.resident_bytes() / (1024.0f * 1024.0f),
+                texture_streamer.budget_bytes / (1024.0f * 1024.0f),
+                texture_streamer.transition_count());
+    if (const jre::VirtualTextureSystem *virtual_textures = m_renderer.virtual_textures())
+    {
+        ImGui::Text("virtual textures: %u, resident tiles: %u, loading: %u, pages: %u / %u",
+                    virtual_textures->texture_count(),
+                    virtual_textures->resident_tile_count(),
+                    virtual_textures->loading_tile_count(),
+                    virtual_textures->page_count(),
+                    virtual_textures->max_pages);
+    }
+    jre::Graphics &graphics = m_renderer.graphics();
+    ImGui::Text("descriptor pools: %u, sets: %u, layouts: %u",
+                graphics.descriptor_allocator().pool_count(),
+                graphics.descriptor_allocator().allocated_count(),
+                graphics.descriptor_set_layouts().size());
+    ImGui::Text("samplers: %u", graphics.sampler_cache().size());
+    const jre::ResourceStats shader_stats = graphics.shader_modules().stats();
+    ImGui::Text("shader modules: %zu, %.1f KB, hit rate: %.2f, evictions: %llu",
+                shader_stats.count,
+                shader_stats.bytes / 1024.0f,
+                shader_stats.hit_rate(),
+                static_cast<unsigned long long>(shader_stats.evictions));
+    const jre::ResourceStats mesh_stats = m_renderer.scene_drawer().mesh_cache->stats();
+    ImGui::Text("meshes: %zu, %.1f MB, hit rate: %.2f, evictions: %llu",
+                mesh_stats.count,
+                mesh_stats.bytes / (1024.0f * 1024.0f),
+                mesh_stats.hit_rate(),
+                static_cast<unsigned long long>(mesh_stats.evictions));
+    ImGui::Text("transient descriptor pools: %u, sets: %u",
+                graphics.transient_descriptor_allocator().pool_count(),
+                graphics.transient_descriptor_allocator().allocated_count());
 }
 
 void ImWinDebug::present_mode()
@@ -93,6 +137,88 @@ void ImWinDebug::msaa()
     }
 }
 
+void ImWinDebug::occlusion_culling()
+{
+    static std::vector<std::string> mode_names = {"None", "Hi-Z", "Software"};
+    int mode_current = static_cast<int>(m_renderer.occlusion_culling_mode());
+    if (ImGui::Combo("occlusion culling", &mode_current, combo_vector_getter, mode_names.data(), mode_names.size()))
+    {
+        m_renderer.set_occlusion_culling(static_cast<jre::OcclusionCullingMode>(mode_current));
+    }
+    ImGui::Text("culled sub meshes: %u", m_renderer.scene_drawer().culled_sub_mesh_count);
+}
+
+void ImWinDebug::depth_prepass()
+{
+    jre::SceneDrawer &scene_drawer = m_renderer.scene_drawer();
+    ImGui::Checkbox("depth prepass", &scene_drawer.depth_prepass);
+    static std::array<vk::CompareOp, 2> compare_ops = {vk::CompareOp::eLessOrEqual, vk::CompareOp::eEqual};
+    static std::vector<std::string> compare_op_names = compare_ops | std::views::transform([](vk::CompareOp op)
+                                                                                           { return vk::to_string(op); }) |
+                                                       std::ranges::to<std::vector>();
+    static int compare_op_current = 0;
+    if (ImGui::Combo("prepass depth compare", &compare_op_current, combo_vector_getter, compare_op_names.data(), compare_op_names.size()))
+    {
+        scene_drawer.set_depth_prepass_compare_op(m_renderer.graphics(), compare_ops[compare_op_current]);
+    }
+}
+
+void ImWinDebug::visibility_buffer()
+{
+    jre::VisibilityBufferDrawer *drawer = m_renderer.visibility_buffer_drawer();
+    if (!drawer)
+    {
+        ImGui::Text("visibility buffer: not supported (no geometryShader)");
+        return;
+    }
+    bool enabled = m_renderer.visibility_buffer_enabled();
+    if (ImGui::Checkbox("visibility buffer", &enabled))
+    {
+        m_renderer.set_visibility_buffer(enabled);
+    }
+    if (enabled)
+    {
+        ImGui::Text("visibility draws: %u, material bins: %u", drawer->draw_count, drawer->bin_count);
+    }
+}
+
+void ImWinDebug::multi_view()
+{
+    jre::SceneDrawer &scene_drawer = m_renderer.scene_drawer();
+    std::vector<jre::RenderViewport> &render_viewports = scene_drawer.scene.render_viewports;
+    if (scene_drawer.render_view_limit < 2)
+    {
+        ImGui::Text("split screen: not supported (no multiViewport)");
+        return;
+    }
+    bool split = render_viewports.size() > 1;
+    if (ImGui::Checkbox("split screen (right view frozen)", &split))
+    {
+        // 左右各一半，宽高比减半，投影的 x 缩放翻倍
+        if (split)
+        {
+            render_viewports[0].projection[0][0] *= 2.0f;
+            render_viewports.push_back(render_viewports[0]);
+        }
+        else
+        {
+            render_viewports.resize(1);
+            render_viewports[0].projection[0][0] *= 0.5f;
+            vk::Extent2D extent = m_renderer.graphics().swapchain_extent();
+            render_viewports[0].viewport = vk::Viewport{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+        }
+    }
+    if (split)
+    {
+        // resize 会把主视口改回全屏，每帧重新切
+        vk::Extent2D extent = m_renderer.graphics().swapchain_extent();
+        float half_width = extent.width * 0.5f;
+        render_viewports[0].viewport = vk::Viewport{0.0f, 0.0f, half_width, static_cast<float>(extent.height), 0.0f, 1.0f};
+        render_viewports[1].viewport = vk::Viewport{half_width, 0.0f, half_width, static_cast<float>(extent.height), 0.0f, 1.0f};
+    }
+    ImGui::Text("views: %zu, shared draws: %u", render_viewports.size(), scene_drawer.draw_count);
+}
+
 void ImWinDebug::camera_info()
 {
     if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen))
@@ -143,6 +269,36 @@ void ImWinDebug::shader_properties()
             m_renderer.scene_drawer().scene.main_light.set_direction(dir);
         }
 
+        // 冻结静态参数：高光 shininess、roughness 和描边宽度烘焙进特化的 pipeline，解冻才能再调
+        bool frozen = (!base_materials.empty() && base_materials.begin()->get()->frozen()) ||
+                      (!outline_materials.empty() && outline_materials.begin()->get()->frozen());
+        if (ImGui::Checkbox("freeze static parameters", &frozen))
+        {
+            jre::RenderPipelineResources &render_pipelines = m_renderer.scene_drawer().render_pipelines;
+            for (std::shared_ptr<jre::StarRailMaterialInstance> material_instance : base_materials)
+            {
+                if (frozen)
+                {
+                    material_instance->freeze(render_pipelines);
+                }
+                else
+                {
+                    material_instance->unfreeze();
+                }
+            }
+            for (std::shared_ptr<jre::StarRailOutlineMaterialInstance> material_instance : outline_materials)
+            {
+                if (frozen)
+                {
+                    material_instance->freeze(render_pipelines);
+                }
+                else
+                {
+                    material_instance->unfreeze();
+                }
+            }
+        }
+
         auto changed = false;
         if (!base_materials.empty())
         {
@@ -156,6 +312,7 @@ void ImWinDebug::shader_properties()
                 for (std::shared_ptr<jre::StarRailMaterialInstance> material_instance : base_materials)
                 {
                     material_instance->buffer_data_debug = ubo_debug;
+                    material_instance->mark_dirty();
                 }
             }
 
@@ -166,14 +323,17 @@ void ImWinDebug::shader_properties()
                 for (int i = 0; i < jre::MATERIAL_REGION_COUNT; ++i)
                 {
                     changed |= ImGui::ColorEdit4(fmt::format("specular color {}", i).c_str(), glm::value_ptr(ubo_props.specular_colors[i]));
+                    ImGui::BeginDisabled(frozen);
                     changed |= ImGui::DragFloat(fmt::format("specular shinness {}", i).c_str(), &ubo_props.specular_shininess[i], 0.01f, 0.0f, 1.0f);
                     changed |= ImGui::DragFloat(fmt::format("specular roughness {}", i).c_str(), &ubo_props.specular_roughness[i], 0.01f, 0.0f, 1.0f);
+                    ImGui::EndDisabled();
                 }
                 if (changed)
                 {
                     for (std::shared_ptr<jre::StarRailMaterialInstance> material_instance : base_materials)
                     {
                         material_instance->buffer_data_props = ubo_props;
+                        material_instance->mark_dirty();
                     }
                 }
             }
@@ -183,7 +343,9 @@ void ImWinDebug::shader_properties()
         {
             static jre::UniformPropertiesStarRail ubo_props = outline_materials.begin()->get()->buffer_data_props;
             changed = false;
+            ImGui::BeginDisabled(frozen);
             changed |= ImGui::DragFloat("outline width", &ubo_props.outline.width, 0.01f, 0.0f, 1.0f);
+            ImGui::EndDisabled();
             changed |= ImGui::DragFloat("outline factor_of_color", &ubo_props.outline.factor_of_color, 0.01f, 0.0f, 1.0f);
             changed |= ImGui::ColorEdit3("outline color", glm::value_ptr(ubo_props.outline.color));
             if (changed)
@@ -191,8 +353,25 @@ void ImWinDebug::shader_properties()
                 for (std::shared_ptr<jre::StarRailOutlineMaterialInstance> material_instance : outline_materials)
                 {
                     material_instance->buffer_data_props = ubo_props;
+                    material_instance->mark_dirty();
+                }
+            }
+
+            bool screen_space = outline_materials.begin()->get()->outline_mode == jre::OutlineMode::ScreenSpace;
+            if (ImGui::Checkbox("screen space outline", &screen_space))
+            {
+                for (std::shared_ptr<jre::StarRailOutlineMaterialInstance> material_instance : outline_materials)
+                {
+                    material_instance->outline_mode = screen_space ? jre::OutlineMode::ScreenSpace : jre::OutlineMode::InvertedHull;
                 }
             }
+            if (screen_space)
+            {
+                jre::ScreenSpaceOutlineDrawer &drawer = m_renderer.screen_space_outline_drawer();
+                ImGui::DragFloat("outline depth threshold", &drawer.depth_threshold, 0.005f, 0.0f, 1.0f);
+                ImGui::DragFloat("outline normal threshold", &drawer.normal_threshold, 0.01f, -1.0f, 1.0f);
+                ImGui::Text("outline materials: %u, g-buffer draws: %u", drawer.outline_material_count, drawer.draw_count);
+            }
         }
     }
 }
@@ -18,5 +18,9 @@ public:
     void frame_info();
     void present_mode();
     void msaa();
+    void occlusion_culling();
+    void depth_prepass();
+    void visibility_buffer();
+    void multi_view();
     void shader_properties();
 };
@@ -0,0 +1,67 @@
+// PMX 读取的独立 benchmark：PmxFile (ifstream + pmx::PmxModel)、内存映射的 PmxReader、烘焙好的 .jmesh 比，各自读文件、转换顶点、算 sub mesh 分开计时。
+// 顶点转换写进一块预先分配好的内存，代替 staging buffer。.jmesh 先烘焙一份写到 get_cooked_mesh_path
+// usage: PmxLoadBenchmark [pmx_path] [iterations]
+#include "jrenderer/asset/pmx_file.h"
+#include "jrenderer/asset/mesh_cooker.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <string>
+
+namespace
+{
+    template <typename Func>
+    double measure_ms(uint32_t iterations, Func &&func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            func();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "res/model/HonkaiStarRail/lingsha/lingsha.pmx";
+    uint32_t iterations = argc > 2 ? std::stoul(argv[2]) : 20;
+
+    using Builder = jre::PmxMeshBuilder<jre::Vertex, uint32_t>;
+    jre::PmxFile pmx_file(path);
+    const jre::PmxReader reader(path);
+    std::vector<jre::Vertex> staging(reader.vertex_count());
+
+    // PmxFile 的顶点转换和 sub mesh 在 build_mesh_data 里一起做，sub mesh 单独再量一次，相减得到顶点
+    double file_parse_ms = measure_ms(iterations, [&]
+                                      { jre::PmxFile file(path); });
+    double file_build_ms = measure_ms(iterations, [&]
+                                      { auto mesh_data = Builder::build_mesh_data(pmx_file.model()); });
+    double reader_parse_ms = measure_ms(iterations, [&]
+                                        { jre::PmxReader parsed(path); });
+    double reader_convert_ms = measure_ms(iterations, [&]
+                                          { reader.write_vertices(staging.data()); });
+    double sub_mesh_ms = measure_ms(iterations, [&]
+                                    { auto sub_meshes = Builder::build_sub_meshes(reader); });
+    double file_convert_ms = std::max(file_build_ms - sub_mesh_ms, 0.0);
+
+    const std::filesystem::path cooked_path = jre::get_cooked_mesh_path(path);
+    jre::JMeshFile::save(jre::JMeshFile::encode(jre::cook_mesh(path), false), cooked_path);
+    const jre::JMeshFile cooked(cooked_path);
+    double cooked_open_ms = measure_ms(iterations, [&]
+                                       { jre::JMeshFile opened(cooked_path); });
+    double cooked_copy_ms = measure_ms(iterations, [&]
+                                       { cooked.write_vertices(staging.data()); });
+    double cooked_sub_mesh_ms = measure_ms(iterations, [&]
+                                           { auto sub_meshes = cooked.sub_meshes(); });
+
+    fmt::print("{}: {} vertices, {} indices, {} materials, {} iterations\n",
+               path, reader.vertex_count(), reader.index_count(), reader.materials.size(), iterations);
+    fmt::print("{:>10} {:>12} {:>12} {:>14} {:>12}\n", "", "parse ms", "vertex ms", "sub mesh ms", "total ms");
+    fmt::print("{:>10} {:>12.3f} {:>12.3f} {:>14.3f} {:>12.3f}\n",
+               "PmxFile", file_parse_ms, file_convert_ms, sub_mesh_ms, file_parse_ms + file_build_ms);
+    fmt::print("{:>10} {:>12.3f} {:>12.3f} {:>14.3f} {:>12.3f}\n",
+               "PmxReader", reader_parse_ms, reader_convert_ms, sub_mesh_ms, reader_parse_ms + reader_convert_ms + sub_mesh_ms);
+    fmt::print("{:>10} {:>12.3f} {:>12.3f} {:>14.3f} {:>12.3f}\n",
+               "JMeshFile", cooked_open_ms, cooked_copy_ms, cooked_sub_mesh_ms, cooked_open_ms + cooked_copy_ms + cooked_sub_mesh_ms);
+    return 0;
+}
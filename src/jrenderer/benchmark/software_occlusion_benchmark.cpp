@@ -0,0 +1,69 @@
+// 软件遮挡光栅化的独立 benchmark：随机三角形汤，按线程数统计每线程每毫秒光栅化的三角形数
+// usage: SoftwareOcclusionBenchmark [triangle_count] [iterations] [width] [height]
+#include "jrenderer/culling/software_occlusion_culler.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <random>
+#include <string>
+
+namespace
+{
+    jre::OccluderMesh make_triangle_soup(uint32_t triangle_count, float triangle_size)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> depth(0.1f, 0.9f);
+        jre::OccluderMesh soup;
+        soup.positions.reserve(triangle_count * 3);
+        soup.indices.reserve(triangle_count * 3);
+        for (uint32_t i = 0; i < triangle_count; ++i)
+        {
+            glm::vec2 center(position(rng), position(rng));
+            float z = depth(rng);
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                soup.positions.push_back(glm::vec3(center + glm::vec2(position(rng), position(rng)) * triangle_size, z));
+                soup.indices.push_back(i * 3 + k);
+            }
+        }
+        return soup;
+    }
+
+    template <typename Func>
+    double measure_ms(uint32_t iterations, Func &&func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            func();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t triangle_count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    uint32_t iterations = argc > 2 ? std::stoul(argv[2]) : 100;
+    uint32_t width = argc > 3 ? std::stoul(argv[3]) : 256;
+    uint32_t height = argc > 4 ? std::stoul(argv[4]) : 128;
+
+    // 裁剪空间里直接摆三角形，model_view_proj 用单位矩阵
+    const glm::mat4 identity(1.0f);
+    const jre::OccluderMesh soup = make_triangle_soup(triangle_count, 0.05f);
+
+    fmt::print("{} triangles, {}x{} depth buffer, {} iterations\n", triangle_count, width, height, iterations);
+    fmt::print("{:>8} {:>12} {:>12} {:>12} {:>16}\n", "threads", "setup ms", "raster ms", "tris/ms", "tris/ms/thread");
+    for (uint32_t thread_count = 1; thread_count <= std::max(1u, std::thread::hardware_concurrency()); thread_count *= 2)
+    {
+        jre::SoftwareOcclusionCuller culler(width, height, thread_count);
+        double setup_ms = measure_ms(iterations, [&]
+                                     { culler.clear(); culler.add_occluder(soup, identity); });
+        double raster_ms = measure_ms(iterations, [&]
+                                      { culler.rasterize(); });
+        double triangles_per_ms = culler.triangle_count() / raster_ms;
+        fmt::print("{:>8} {:>12.3f} {:>12.3f} {:>12.0f} {:>16.0f}\n",
+                   thread_count, setup_ms, raster_ms, triangles_per_ms, triangles_per_ms / thread_count);
+    }
+    return 0;
+}
@@ -6,6 +6,14 @@
 #include "jrenderer/ticker/scene_ticker.h"
 #include "jrenderer/drawer/imgui_drawer.h"
 #include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/texture_streamer.h"
+#include "jrenderer/virtual_texture.h"
+#include "jrenderer/async_model_loader.h"
+#include "jrenderer/drawer/visibility_buffer_drawer.h"
+#include "jrenderer/drawer/vertex_pretransformer.h"
+#include "jrenderer/drawer/screen_space_outline_drawer.h"
+#include "jrenderer/culling/hiz_occlusion_culler.h"
+#include "jrenderer/culling/software_occlusion_culler.h"
 
 namespace jre
 {
@@ -23,12 +31,29 @@ namespace jre
         inline Graphics &graphics() { return m_graphics; }
 
         void set_msaa(const vk::SampleCountFlagBits &msaa);
+        void set_occlusion_culling(OcclusionCullingMode mode);
+        OcclusionCullingMode occlusion_culling_mode() const { return m_occlusion_culling_mode; }
+        // GPU 不支持 geometryShader 时没有可见性缓冲，开不了，全部前向画
+        void set_visibility_buffer(bool enable)
+        {
+            if (m_visibility_buffer)
+            {
+                m_visibility_buffer->visible = enable;
+            }
+        }
+        bool visibility_buffer_enabled() const { return m_visibility_buffer && m_visibility_buffer->visible; }
 
         std::unique_ptr<imgui::ScopedFrame> new_imgui_frame() { return std::make_unique<imgui::ScopedFrame>(); }
         void new_frame(TickContext context);
 
         imgui::ImguiDrawer &imgui_drawer() { return *m_imgui_drawer; }
         SceneDrawer &scene_drawer() { return *m_scene_drawer; }
+        TextureStreamer &texture_streamer() { return *m_texture_streamer; }
+        VirtualTextureSystem *virtual_textures() { return m_virtual_textures.get(); } // GPU 不支持稀疏 image 时是空的
+        AsyncModelLoader &model_loader() { return *m_model_loader; }
+        VisibilityBufferDrawer *visibility_buffer_drawer() { return m_visibility_buffer.get(); } // GPU 不支持 geometryShader 时是空的
+        VertexPretransformer &vertex_pretransformer() { return *m_vertex_pretransformer; }
+        ScreenSpaceOutlineDrawer &screen_space_outline_drawer() { return *m_screen_space_outline; }
         SceneTicker &scene_ticker() { return m_scene_ticker; }
 
     private:
@@ -36,6 +61,15 @@ namespace jre
         Graphics m_graphics;
         std::shared_ptr<imgui::ImguiDrawer> m_imgui_drawer;
         std::shared_ptr<SceneDrawer> m_scene_drawer;
+        std::shared_ptr<TextureStreamer> m_texture_streamer;
+        std::shared_ptr<VirtualTextureSystem> m_virtual_textures;
+        std::shared_ptr<AsyncModelLoader> m_model_loader;
+        std::shared_ptr<VertexPretransformer> m_vertex_pretransformer;
+        std::shared_ptr<VisibilityBufferDrawer> m_visibility_buffer;
+        std::shared_ptr<ScreenSpaceOutlineDrawer> m_screen_space_outline;
+        std::shared_ptr<HiZOcclusionCuller> m_hiz_culler;
+        std::shared_ptr<SoftwareOcclusionCuller> m_software_culler;
+        OcclusionCullingMode m_occlusion_culling_mode = OcclusionCullingMode::None;
         SceneTicker m_scene_ticker;
 
         void on_tick(TickContext context) override;
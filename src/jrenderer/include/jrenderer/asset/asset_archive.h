@@ -0,0 +1,90 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "jrenderer/utils/mapped_file.h"
+
+namespace jre
+{
+    // 一段资源数据。打包文件里没压缩的直接指向映射的内存，压缩的解到自己的缓冲里，散文件是单独映射的；
+    // 拿着它，底下的映射就不会被解除
+    class AssetBlob
+    {
+    public:
+        AssetBlob() = default;
+        AssetBlob(std::vector<std::byte> bytes);
+        AssetBlob(std::shared_ptr<const void> owner, std::span<const std::byte> bytes) : m_owner(std::move(owner)), m_data(bytes) {}
+
+        std::span<const std::byte> data() const { return m_data; }
+        size_t size() const { return m_data.size(); }
+
+    private:
+        std::shared_ptr<const void> m_owner;
+        std::span<const std::byte> m_data;
+    };
+
+    // 资源打包文件 (.jpak)：所有条目的数据按 alignment 对齐紧挨着放，最后是按名字哈希排好序的索引和名字。
+    // 打开时只映射、检查索引，找的时候二分哈希再比名字；可以对单个条目做 LZ4 (块格式)，省不了多少的不压。
+    // 名字是相对工作目录的路径，分隔符统一成 /，和代码里写的 "res/..." 一样
+    class AssetArchive
+    {
+    public:
+        static constexpr uint32_t default_alignment = 64; // spv 要 4 字节对齐，.jmesh 的段是 64 字节对齐的
+
+        class Builder
+        {
+        public:
+            uint32_t alignment = default_alignment;
+            bool compress = false;
+
+            void add(const std::filesystem::path &name, std::vector<std::byte> data);
+            // 保存的时候才读
+            void add_file(const std::filesystem::path &name, const std::filesystem::path &source);
+            // 先写临时文件再改名
+            void save(const std::filesystem::path &path) const;
+
+        private:
+            struct PendingEntry
+            {
+                std::string name;
+                std::filesystem::path source; // 空的话用 data
+                std::vector<std::byte> data;
+            };
+            std::vector<PendingEntry> m_entries;
+        };
+
+        AssetArchive(const std::filesystem::path &path);
+
+        AssetArchive(const AssetArchive &) = delete;
+        AssetArchive &operator=(const AssetArchive &) = delete;
+
+        static std::string normalize_name(const std::filesystem::path &name);
+
+        uint32_t entry_count() const { return static_cast<uint32_t>(m_index.size()); }
+        bool contains(const std::filesystem::path &name) const;
+        // 可以在任意线程上调用
+        std::optional<AssetBlob> find(const std::filesystem::path &name) const;
+
+    private:
+        struct IndexEntry;
+
+        std::shared_ptr<const MappedFile> m_file;
+        std::span<const IndexEntry> m_index;
+        std::span<const char> m_names;
+
+        const IndexEntry *find_entry(const std::filesystem::path &name) const;
+    };
+
+    // 挂载的打包文件，后挂的先找。一般在启动时、开始加载之前挂
+    void mount_asset_archive(std::shared_ptr<const AssetArchive> archive);
+    void unmount_asset_archives();
+    // 只在挂载的打包文件里找
+    std::optional<AssetBlob> find_archived_asset(const std::filesystem::path &path);
+    bool contains_archived_asset(const std::filesystem::path &path);
+    // 先在挂载的打包文件里找，没有再映射散文件，都没有抛异常。加载资源的地方都经过这里
+    AssetBlob read_asset(const std::filesystem::path &path);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "jrenderer/asset/asset_archive.h"
+
+namespace jre
+{
+    // 源文件内容的哈希 (XXH64)，经过 read_asset。路径、大小、修改时间都没变的文件只算一次，可以在任意线程上调用
+    uint64_t hash_asset_content(const std::filesystem::path &path);
+
+    // 派生数据的键：烘焙器的名字和版本、设置、源文件内容的哈希依次混进去。
+    // 只看内容不看路径，源文件改名、挪目录不用重新烘焙，内容一样的两个文件得到同一个键。
+    // 烘焙的算法或者输出格式变了就加版本号
+    class DerivedDataKey
+    {
+    public:
+        DerivedDataKey(std::string_view cooker, uint32_t version);
+
+        DerivedDataKey &add(std::span<const std::byte> bytes);
+        DerivedDataKey &add(std::string_view text) { return add(std::as_bytes(std::span(text))); }
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        DerivedDataKey &add_value(const T &value)
+        {
+            return add(std::as_bytes(std::span(&value, 1)));
+        }
+        DerivedDataKey &add_source(const std::filesystem::path &path) { return add_value(hash_asset_content(path)); }
+
+        uint64_t value() const { return m_hash; }
+
+    private:
+        uint64_t m_hash;
+    };
+
+    // 本地磁盘上按内容寻址的烘焙结果缓存 (derived data cache)：一个键一个文件，directory/<前两位>/<16 位十六进制>.bin。
+    // 键相同输入就相同，所以文件写一次之后不会再改；写的时候先写临时文件再改名，几个线程或者进程同时烘焙同一个也没事。
+    // 读是映射文件，不用拷贝。不会自己清理，删掉整个目录就行
+    class DerivedDataCache
+    {
+    public:
+        DerivedDataCache(std::filesystem::path directory);
+
+        const std::filesystem::path &directory() const { return m_directory; }
+        std::filesystem::path get_entry_path(uint64_t key) const;
+
+        std::optional<AssetBlob> find(uint64_t key) const;
+        // 写不了 (只读目录、磁盘满) 抛异常
+        void put(uint64_t key, std::span<const std::byte> data) const;
+        // 有就直接返回，没有就 cook 一遍存进去；存不了不算错，这次的结果照样返回
+        AssetBlob find_or_cook(uint64_t key, const std::function<std::vector<std::byte>()> &cook) const;
+
+    private:
+        std::filesystem::path m_directory;
+    };
+
+    // 工作目录下的 cache/ddc，load_cooked_texture、load_cooked_mesh 用的都是它
+    const DerivedDataCache &default_derived_data_cache();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "jrenderer/mesh.h"
+#include "jrenderer/asset/asset_archive.h"
+
+namespace jre
+{
+    // 材质绑定：sub mesh 用的材质名和漫反射纹理，UTF-8，纹理路径相对模型文件所在的目录，没有就是空的
+    struct MeshMaterialBinding
+    {
+        std::string name;
+        std::string diffuse_texture;
+    };
+
+    // 烘焙前整理好的网格，和 PmxMeshBuilder::build_mesh_data 的结果一样再加上材质绑定
+    struct CookedMeshData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<SubMesh> sub_meshes;
+        std::vector<MeshMaterialBinding> materials; // 和 sub_meshes 一一对应
+    };
+
+    // 烘焙好的网格 (.jmesh)：顶点已经是 Vertex 的布局，索引是 32 位，后面是 sub mesh 表 (包围盒、遮挡体、材质绑定)。
+    // 每段按 64 字节对齐，映射之后顶点、索引不用解析，直接拷进 staging。
+    // 可以量化成 16 字节一个顶点 (位置按整个网格的包围盒 16 位、法线八面体编码、UV 半精度)，文件小一半，读的时候解码
+    class JMeshFile
+    {
+    public:
+        BoundingBox bounds;
+        bool quantized = false;
+        std::vector<MeshMaterialBinding> materials; // 和 sub_meshes() 一一对应，打开时读出来
+
+        static std::vector<std::byte> encode(const CookedMeshData &data, bool quantize);
+        // encode 的结果写进文件，先写临时文件再改名
+        static void save(std::span<const std::byte> encoded, const std::filesystem::path &path);
+
+        // 经过 read_asset 映射文件 (或者打包文件里的条目)，只检查头和各段的范围，顶点和索引用的时候才从映射的内存里读
+        JMeshFile(const std::filesystem::path &path);
+        // encode 的结果可以直接传进来，不经过文件
+        JMeshFile(AssetBlob blob);
+
+        JMeshFile(const JMeshFile &) = delete;
+        JMeshFile &operator=(const JMeshFile &) = delete;
+
+        uint32_t vertex_count() const { return m_vertex_count; }
+        uint32_t index_count() const { return static_cast<uint32_t>(m_indices.size()); }
+        std::span<const uint32_t> indices() const { return m_indices; }
+        // 每次都新建，遮挡体也从文件里拷出来
+        std::vector<SubMesh> sub_meshes() const;
+
+        // destination 要有 vertex_count() 个的空间，没量化的直接拷
+        void write_vertices(Vertex *destination) const;
+
+        template <typename IndexType>
+        void write_indices(IndexType *destination) const
+        {
+            if constexpr (std::is_same_v<IndexType, uint32_t>)
+            {
+                std::memcpy(destination, m_indices.data(), m_indices.size_bytes());
+            }
+            else
+            {
+                std::ranges::transform(m_indices, destination, [](uint32_t index)
+                                       { return static_cast<IndexType>(index); });
+            }
+        }
+
+    private:
+        AssetBlob m_blob;
+        uint32_t m_vertex_count = 0;
+        std::span<const std::byte> m_vertices;
+        std::span<const uint32_t> m_indices;
+        std::span<const std::byte> m_sub_meshes;
+        std::span<const float> m_occluder_positions; // 紧凑的 xyz
+        std::span<const uint32_t> m_occluder_indices;
+        std::span<const char> m_strings;
+
+        void parse();
+    };
+
+    // 在 mesh.h 里声明，用的时候要包含这个头文件
+    template <typename VertexType, typename IndexType>
+    DeviceMeshBuilder<VertexType, IndexType>::DeviceMeshBuilder(vk::SharedDevice device,
+                                                               vk::PhysicalDevice physical_device,
+                                                               vk::CommandBuffer command_buffer,
+                                                               vk::Queue transfer_queue,
+                                                               std::shared_ptr<const JMeshFile> file)
+        : DeviceMeshBuilder(device,
+                            physical_device,
+                            command_buffer,
+                            transfer_queue,
+                            file->vertex_count(),
+                            [file](VertexType *destination)
+                            { file->write_vertices(destination); },
+                            file->index_count(),
+                            [file](IndexType *destination)
+                            { file->write_indices(destination); })
+    {
+    }
+}
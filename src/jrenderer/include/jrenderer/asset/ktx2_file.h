@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include "jrenderer/texture.h"
+
+namespace jre
+{
+    // KTX2 容器 (https://registry.khronos.org/KTX/specs/2.0/ktxspec.html)
+    // 只支持单层 2D、不做 supercompression，格式就是 vkFormat，DFD 只用来读 transfer function
+    class Ktx2File
+    {
+    public:
+        vk::Format format = vk::Format::eUndefined;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mip_levels = 0;
+        bool srgb = false;               // 内容是 sRGB 编码的颜色。格式还是 Unorm，shader 里的读法不变
+        std::vector<unsigned char> data; // 按 level 从大到小紧挨着放，和 TextureData 一致。文件里是从小到大、按块对齐的
+
+        Ktx2File() = default;
+        // 经过 read_asset，打包文件里有就从包里读
+        Ktx2File(const std::filesystem::path &path);
+        Ktx2File(std::span<const std::byte> bytes);
+
+        // 整个文件的内容，save 写的就是它
+        std::vector<std::byte> encode() const;
+        void save(const std::filesystem::path &path) const;
+
+        uint32_t level_size(uint32_t level) const;
+        // data 不拷贝，用的时候 Ktx2File 要活着
+        TextureData texture_data() const
+        {
+            return TextureData{width, height, 4, data.data(), format, mip_levels};
+        }
+
+    private:
+        void parse(std::span<const std::byte> bytes, const std::string &name);
+    };
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include "jrenderer/asset/jmesh_file.h"
+
+namespace jre
+{
+    // 离线烘焙 (MeshCooker) 的输出：源模型 a/b.pmx、a/b.obj 烘焙到 a/b.jmesh。运行时只在打包文件里按这个名字找
+    std::filesystem::path get_cooked_mesh_path(const std::filesystem::path &source);
+
+    // 按扩展名读 PMX 或 OBJ，整理成 Vertex/32 位索引，每个材质一个 sub mesh，顺便算包围盒和遮挡体
+    CookedMeshData cook_mesh(const std::filesystem::path &source);
+
+    // 和 load_cooked_texture 一样第一次用的时候烘焙：挂载的打包文件里有烘好的就直接用，否则按源文件的内容、
+    // quantize 和 Vertex 布局到 default_derived_data_cache 里找，映射之后直接用，没有再烘焙一遍存进去。
+    // 写不了缓存不算错，这次的结果照样返回
+    std::shared_ptr<const JMeshFile> load_cooked_mesh(const std::filesystem::path &source, bool quantize = false);
+}
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan_shared.hpp>
 #include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/async_model_loader.h"
 
 namespace jre
 {
@@ -12,4 +13,7 @@ namespace jre
                        vk::SharedQueue transfer_queue,
                        vk::SharedCommandBuffer command_buffer);
 
+    // 马上返回，先往场景里放一个占位的 model，解析、上传、纹理都在后面几帧里陆续完成，见 AsyncModelLoader
+    AsyncModelHandle load_lingsha_async(AsyncModelLoader &loader, SceneDrawer &scene_drawer, uint32_t frame_count);
+
 }
\ No newline at end of file
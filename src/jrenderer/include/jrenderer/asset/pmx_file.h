@@ -1,9 +1,13 @@
 #pragma once
 
 #include <string>
+#include <span>
 #include "Pmx.h"
 #include "jrenderer/asset/convert.hpp"
+#include "jrenderer/asset/pmx_reader.h"
+#include "jrenderer/asset/jmesh_file.h"
 #include "jrenderer/mesh.h"
+#include "jrenderer/culling/software_occlusion_culler.h"
 
 namespace jre
 {
@@ -88,6 +92,55 @@ namespace jre
         {
         }
 
+        // 顶点不经过 vertices，build/record 的时候从 reader 的 SoA 数组直接转换写进 staging。
+        // reader 要活到 build/record 之后，这里拿着它
+        PmxMeshBuilder(
+            vk::SharedDevice device,
+            vk::PhysicalDevice physical_device,
+            vk::CommandBuffer command_buffer,
+            vk::Queue transfer_queue,
+            std::shared_ptr<const PmxReader> reader,
+            std::vector<SubMesh> sub_meshes)
+            requires std::is_same_v<VertexType, Vertex>
+            : sub_meshes(std::move(sub_meshes)),
+              mesh_builder(device,
+                           physical_device,
+                           command_buffer,
+                           transfer_queue,
+                           reader->vertex_count(),
+                           [reader](VertexType *destination)
+                           { reader->write_vertices(destination); },
+                           reader->index_count(),
+                           [reader](IndexType *destination)
+                           { std::ranges::copy(reader->indices, destination); })
+        {
+        }
+
+        // 从烘焙好的 .jmesh 建 (见 load_cooked_mesh)，sub mesh 也从文件里来，不用再算遮挡体
+        PmxMeshBuilder(
+            vk::SharedDevice device,
+            vk::PhysicalDevice physical_device,
+            vk::CommandBuffer command_buffer,
+            vk::Queue transfer_queue,
+            std::shared_ptr<const JMeshFile> file,
+            std::vector<SubMesh> sub_meshes)
+            requires std::is_same_v<VertexType, Vertex>
+            : sub_meshes(std::move(sub_meshes)),
+              mesh_builder(device, physical_device, command_buffer, transfer_queue, std::move(file))
+        {
+        }
+
+        PmxMeshBuilder(
+            vk::SharedDevice device,
+            vk::PhysicalDevice physical_device,
+            vk::CommandBuffer command_buffer,
+            vk::Queue transfer_queue,
+            std::shared_ptr<const JMeshFile> file)
+            requires std::is_same_v<VertexType, Vertex>
+            : PmxMeshBuilder(device, physical_device, command_buffer, transfer_queue, file, file->sub_meshes())
+        {
+        }
+
         Mesh build()
         {
             Mesh mesh = mesh_builder.build();
@@ -100,6 +153,14 @@ namespace jre
             return std::make_shared<Mesh>(std::move(build()));
         }
 
+        // 见 DeviceMeshBuilder::record
+        Mesh record(vk::CommandBuffer recording_command_buffer, std::vector<DynamicBuffer> &staging_buffers)
+        {
+            Mesh mesh = mesh_builder.record(recording_command_buffer, staging_buffers);
+            mesh.sub_meshes = std::move(sub_meshes);
+            return mesh;
+        }
+
         static std::tuple<std::vector<VertexType>, std::vector<IndexType>, std::vector<SubMesh>> build_mesh_data(const pmx::PmxModel &model)
         {
             std::vector<VertexType> vertices;
@@ -118,17 +179,59 @@ namespace jre
             indices.assign(model.indices.get(), model.indices.get() + model.index_count);
 
             // sub mesh
+            std::vector<glm::vec3> positions = std::span(model.vertices.get(), model.vertex_count) |
+                                               std::views::transform([](const pmx::PmxVertex &vertex)
+                                                                     { return glm::vec3(vertex.positon[0], vertex.positon[1], vertex.positon[2]); }) |
+                                               std::ranges::to<std::vector>();
             sub_meshes.reserve(model.material_count);
             uint32_t index_offset = 0;
             for (size_t i = 0; i < model.material_count; ++i)
             {
                 const pmx::PmxMaterial &material = model.materials[i];
-                sub_meshes.push_back(SubMesh(0, index_offset, material.index_count));
+                std::vector<uint32_t> sub_mesh_indices(model.indices.get() + index_offset, model.indices.get() + index_offset + material.index_count);
+                BoundingBox bounds;
+                glm::vec2 uv_min(std::numeric_limits<float>::max());
+                glm::vec2 uv_max(std::numeric_limits<float>::lowest());
+                for (uint32_t index : sub_mesh_indices)
+                {
+                    bounds.expand(positions[index]);
+                    const glm::vec2 uv(model.vertices[index].uv[0], model.vertices[index].uv[1]);
+                    uv_min = glm::min(uv_min, uv);
+                    uv_max = glm::max(uv_max, uv);
+                }
+                const float uv_extent = sub_mesh_indices.empty() ? 1.0f : std::max(uv_max.x - uv_min.x, uv_max.y - uv_min.y);
+                // 导入时顺便生成简化的遮挡体，给软件遮挡剔除用
+                sub_meshes.push_back(SubMesh(0, index_offset, material.index_count, bounds, simplify_occluder(positions, sub_mesh_indices, bounds), uv_extent));
                 index_offset += material.index_count;
             }
             return {std::move(vertices), std::move(indices), std::move(sub_meshes)};
         }
 
+        // 和 build_mesh_data 里的 sub mesh 一样，位置和 UV 直接用 reader 的数组
+        static std::vector<SubMesh> build_sub_meshes(const PmxReader &reader)
+        {
+            std::vector<SubMesh> sub_meshes;
+            sub_meshes.reserve(reader.materials.size());
+            uint32_t index_offset = 0;
+            for (const PmxReader::Material &material : reader.materials)
+            {
+                std::span<const uint32_t> sub_mesh_indices(reader.indices.data() + index_offset, material.index_count);
+                BoundingBox bounds;
+                glm::vec2 uv_min(std::numeric_limits<float>::max());
+                glm::vec2 uv_max(std::numeric_limits<float>::lowest());
+                for (uint32_t index : sub_mesh_indices)
+                {
+                    bounds.expand(reader.positions[index]);
+                    uv_min = glm::min(uv_min, reader.uvs[index]);
+                    uv_max = glm::max(uv_max, reader.uvs[index]);
+                }
+                const float uv_extent = sub_mesh_indices.empty() ? 1.0f : std::max(uv_max.x - uv_min.x, uv_max.y - uv_min.y);
+                sub_meshes.push_back(SubMesh(0, index_offset, material.index_count, bounds, simplify_occluder(reader.positions, sub_mesh_indices, bounds), uv_extent));
+                index_offset += material.index_count;
+            }
+            return sub_meshes;
+        }
+
     private:
     };
 
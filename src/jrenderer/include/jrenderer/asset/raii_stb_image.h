@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stb/stb_image.h>
+#include <span>
 #include <string>
 
 namespace jre
@@ -14,7 +15,9 @@ namespace jre
         stbi_uc *m_data;
 
     public:
+        // 经过 read_asset，打包文件里有就从包里解码
         STBImage(const std::string &file_name);
+        STBImage(std::span<const std::byte> bytes);
         STBImage(const STBImage &);
         STBImage &operator=(const STBImage &);
         STBImage(STBImage &&other) noexcept;
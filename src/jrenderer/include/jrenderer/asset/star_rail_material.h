@@ -4,6 +4,8 @@
 #include "vulkan/vulkan_shared.hpp"
 #include "jrenderer/material.h"
 #include "jrenderer/pipeline.h"
+#include "jrenderer/material_parameter_table.h"
+#include "jrenderer/texture_loader.h"
 
 namespace jre
 {
@@ -55,39 +57,72 @@ namespace jre
         }
     };
 
+    // 特化常量 ID，和 star_rail_common_inputs.glsl 一致
+    enum class StarRailConstantId : uint32_t
+    {
+        ModelPart = 0,
+        ParametersFrozen = 1,
+        SpecularShininess = 2, // 每个区域一个
+        SpecularRoughness = SpecularShininess + MATERIAL_REGION_COUNT,
+        OutlineWidth = SpecularRoughness + MATERIAL_REGION_COUNT,
+    };
+
+    // 冻结：把调好之后不再变的参数 (各区域的高光 shininess、roughness，描边宽度) 烘焙成特化常量，
+    // 编一个特化的 pipeline 变体，驱动可以把光照计算里的这些量常量折叠掉。解冻就换回原来的 pipeline，继续从参数表读，可以实时调
+    SpecializationConstants make_frozen_constants(const UniformPropertiesStarRail &props);
+
+    // MaterialParameterTable 里的一条记录，和 star_rail_common_inputs.glsl 的 StarRailParameters 一致 (scalar 布局)
+    struct StarRailMaterialParameters
+    {
+        UniformPropertiesStarRail props;
+        glm::vec4 debug_control;
+        uint32_t show_material_region;
+        uint32_t padding[6]; // 补到 MaterialParameterTable::record_size
+    };
+
     class StarRailMaterialInstance : public IMaterialInstance
     {
     public:
         Material material;
-        std::vector<vk::SharedDescriptorSet> descriptor_sets;
         UniformStarRailDebug buffer_data_debug;
         UniformPropertiesStarRail buffer_data_props;
-        HostArrayBuffer<UniformStarRailDebug, true> uniform_buffer_debug;
-        HostArrayBuffer<UniformPropertiesStarRail, true> uniform_buffer_props;
         Texture diffuse;
         Texture light_map;
         Texture cool_ramp;
         Texture warm_ramp;
+        uint32_t material_id = 0;
+        MaterialParameterTable *material_parameters = nullptr;
+        BindlessTextureTable *bindless_textures = nullptr; // replace_texture 时更新材质的纹理序号
 
         StarRailMaterialInstance(MaterialInstance &&inst) : material(std::move(inst.material)),
-                                                            descriptor_sets(std::move(inst.descriptor_sets)),
                                                             buffer_data_debug(),
                                                             buffer_data_props(),
-                                                            uniform_buffer_debug(),
-                                                            uniform_buffer_props(),
                                                             diffuse(),
                                                             light_map(),
                                                             cool_ramp(),
                                                             warm_ramp() {}
-        void update_descriptor_set();
-        void update_descriptor_set_data(uint32_t cur_frame) override;
+        // 改了 buffer_data_debug 或 buffer_data_props 之后调用，内容变了才会上传
+        void mark_dirty();
+        // 冻结之后再改静态参数不起作用，要先解冻
+        void freeze(RenderPipelineResources &render_pipeline_resources);
+        void unfreeze() { frozen_pipeline.reset(); }
+        bool frozen() const { return static_cast<bool>(frozen_pipeline); }
+        void replace_texture(const Texture &placeholder, const Texture &texture) override;
+        std::vector<Texture> get_textures() override { return {diffuse, light_map, cool_ramp, warm_ramp}; }
         RenderMaterialData get_render_data(uint32_t cur_frame) override
         {
+            RenderPipeline *render_pipeline = frozen() ? frozen_pipeline.get() : material.render_pipeline.get();
             return {
-                material.render_pipeline->pipeline.get(),
-                material.render_pipeline->pipeline_layout.get(),
-                descriptor_sets[cur_frame].get()};
+                render_pipeline->pipeline.get(),
+                render_pipeline->pipeline_layout.get(),
+                vk::DescriptorSet{},
+                render_pipeline->prepassed_pipeline.get(),
+                render_pipeline,
+                material_id};
         }
+
+    private:
+        SharedRenderPipeline frozen_pipeline;
     };
 
     class StarRailMaterialBuilder
@@ -120,7 +155,17 @@ namespace jre
         std::string filename_light_map;
         std::string filename_cool_ramp;
         std::string filename_warm_ramp;
+        BindlessTextureTable *bindless_textures = nullptr;
+        MaterialParameterTable *material_parameters = nullptr;
+        SamplerCache *sampler_cache = nullptr;
+        TextureUploadBatch *upload_batch = nullptr; // 非空时纹理只录进去，调用方统一 submit；空的话每张纹理自己提交
+        bool compressed_textures = false;           // 按用途烘焙成块压缩的 KTX2 (第一次用的时候烘焙，之后读缓存)，不再解码 png
+        TextureLoader *texture_loader = nullptr;    // 非空时纹理交给它在后台解码，上传录进它的 batch，不看上面两项
 
+        // 现在这几个文件名要加载的纹理，顺序和 star_rail_inputs.glsl 的纹理槽位一致
+        std::vector<TextureRequest> texture_requests() const;
+        // 把 texture_requests 先交给 texture_loader 解码，build 的时候就不用等
+        void prefetch_textures();
         StarRailMaterialInstance build();
         std::shared_ptr<StarRailMaterialInstance> build_shared();
     };
@@ -129,29 +174,43 @@ namespace jre
     {
     public:
         Material material;
-        std::vector<vk::SharedDescriptorSet> descriptor_sets;
         UniformStarRailDebug buffer_data_debug;
         UniformPropertiesStarRail buffer_data_props;
-        HostArrayBuffer<UniformStarRailDebug, true> uniform_buffer_debug;
-        HostArrayBuffer<UniformPropertiesStarRail, true> uniform_buffer_props;
         Texture diffuse;
+        uint32_t material_id = 0;
+        MaterialParameterTable *material_parameters = nullptr;
+        BindlessTextureTable *bindless_textures = nullptr;
+        OutlineMode outline_mode = OutlineMode::InvertedHull;
 
         StarRailOutlineMaterialInstance(MaterialInstance &&inst) : material(std::move(inst.material)),
-                                                                   descriptor_sets(std::move(inst.descriptor_sets)),
                                                                    buffer_data_debug(),
                                                                    buffer_data_props(),
-                                                                   uniform_buffer_debug(),
-                                                                   uniform_buffer_props(),
                                                                    diffuse() {}
-        void update_descriptor_set();
-        void update_descriptor_set_data(uint32_t cur_frame) override;
+        // 改了 buffer_data_debug 或 buffer_data_props 之后调用，内容变了才会上传
+        void mark_dirty();
+        // 冻结之后再改静态参数不起作用，要先解冻
+        void freeze(RenderPipelineResources &render_pipeline_resources);
+        void unfreeze() { frozen_pipeline.reset(); }
+        bool frozen() const { return static_cast<bool>(frozen_pipeline); }
+        void replace_texture(const Texture &placeholder, const Texture &texture) override;
+        std::vector<Texture> get_textures() override { return {diffuse}; }
         RenderMaterialData get_render_data(uint32_t cur_frame) override
         {
+            RenderPipeline *render_pipeline = frozen() ? frozen_pipeline.get() : material.render_pipeline.get();
             return {
-                material.render_pipeline->pipeline.get(),
-                material.render_pipeline->pipeline_layout.get(),
-                descriptor_sets[cur_frame].get()};
+                render_pipeline->pipeline.get(),
+                render_pipeline->pipeline_layout.get(),
+                vk::DescriptorSet{},
+                render_pipeline->prepassed_pipeline.get(),
+                render_pipeline,
+                material_id,
+                RenderOutlineData{outline_mode,
+                                  glm::vec4(buffer_data_props.outline.color, buffer_data_props.outline.factor_of_color),
+                                  buffer_data_props.outline.width}};
         }
+
+    private:
+        SharedRenderPipeline frozen_pipeline;
     };
 
     class StarRailOutlineMaterialBuilder
@@ -181,7 +240,15 @@ namespace jre
         Material material;
         std::unordered_map<std::string, Texture> *texture_cache;
         std::string filename_diffuse;
+        BindlessTextureTable *bindless_textures = nullptr;
+        MaterialParameterTable *material_parameters = nullptr;
+        SamplerCache *sampler_cache = nullptr;
+        TextureUploadBatch *upload_batch = nullptr; // 非空时纹理只录进去，调用方统一 submit；空的话每张纹理自己提交
+        bool compressed_textures = false;           // 按用途烘焙成块压缩的 KTX2 (第一次用的时候烘焙，之后读缓存)，不再解码 png
+        TextureLoader *texture_loader = nullptr;    // 非空时纹理交给它在后台解码，上传录进它的 batch，不看上面两项
 
+        std::vector<TextureRequest> texture_requests() const;
+        void prefetch_textures();
         StarRailOutlineMaterialInstance build();
         std::shared_ptr<StarRailOutlineMaterialInstance> build_shared()
         {
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include "jrenderer/asset/ktx2_file.h"
+#include "jrenderer/utils/worker_pool.hpp"
+
+namespace jre
+{
+    // 纹理的用途，决定烘焙成哪种块压缩格式
+    enum class TextureRole
+    {
+        Color,        // sRGB 编码的颜色 (漫反射、ramp)，BC7，mip 在线性空间平均
+        Data,         // 四个通道都是数据 (光照贴图)，BC7，alpha 优先保精度，mip 直接平均
+        TwoChannel,   // 只用 rg (切线空间法线之类)，BC5
+        SingleChannel // 只用 r (遮罩、AO 之类)，BC4
+    };
+
+    vk::Format get_cooked_format(TextureRole role);
+
+    // 离线烘焙 (TextureCooker) 的输出：源图片 a/b.png 烘焙到 a/b.<role>.ktx2，同一张图按不同用途烘焙不会冲突。
+    // 运行时只在打包文件里按这个名字找
+    std::filesystem::path get_cooked_texture_path(const std::filesystem::path &source, TextureRole role);
+
+    // 解码源图片，CPU 上生成整条 mip 链，每级编码成块。workers 非空时按块行分给它
+    Ktx2File cook_texture(const std::string &source, TextureRole role, WorkerPool *workers = nullptr);
+
+    // 不压缩，CPU 上生成整条 eR8G8B8A8Unorm 的 mip 链 (和 cook_texture 一样的下采样)，给纹理流送用
+    Ktx2File build_mip_chain(const std::string &source, TextureRole role);
+
+    // 第一次用的时候烘焙：挂载的打包文件里有烘好的就直接用，否则按源图片的内容和用途到 default_derived_data_cache 里找，
+    // 没有再烘焙一遍存进去。写不了缓存 (只读目录之类) 不算错，这次的结果照样返回
+    Ktx2File load_cooked_texture(const std::string &source, TextureRole role, WorkerPool *workers = nullptr);
+
+    // build_mip_chain 的结果，和 load_cooked_texture 一样按内容缓存
+    Ktx2File load_mip_chain(const std::string &source, TextureRole role);
+}
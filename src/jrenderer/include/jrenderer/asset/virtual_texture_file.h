@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "jrenderer/asset/ktx2_file.h"
+
+namespace jre
+{
+    // 虚拟纹理切好的 tile 文件 (.jvt)：mip tail 之前的每一级切成 tile_extent 大的块，每块的数据紧挨着放，可以直接拷进稀疏 image 的一个 tile；
+    // mip tail 的几级放在最后，和 Ktx2File 一样从大到小紧挨着。
+    // tile 的编号按级从大到小、级内按行，和着色器里反馈/驻留位图的顺序一致
+    class VirtualTextureFile
+    {
+    public:
+        vk::Format format = vk::Format::eUndefined;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mip_levels = 0;
+        vk::Extent2D tile_extent;
+        uint32_t mip_tail_start = 0; // 从这一级起都在 mip tail 里，一直驻留
+        bool srgb = false;
+        std::vector<unsigned char> mip_tail; // 打开时读进来
+
+        // chain 要带整条 mip 链
+        static void save(const Ktx2File &chain, vk::Extent2D tile_extent, uint32_t mip_tail_start, const std::filesystem::path &path);
+
+        VirtualTextureFile(const std::filesystem::path &path);
+
+        uint32_t tile_count() const { return static_cast<uint32_t>(m_tile_offsets.size() - 1); }
+        vk::Extent2D level_extent(uint32_t level) const { return {std::max(width >> level, 1u), std::max(height >> level, 1u)}; }
+        vk::Extent2D level_tiles(uint32_t level) const; // 这一级横竖各几块
+        uint32_t level_first_tile(uint32_t level) const;
+        // 在任意线程上调用，读文件的时候加锁
+        std::vector<unsigned char> read_tile(uint32_t tile) const;
+
+    private:
+        std::vector<uint64_t> m_tile_offsets; // 多一个，最后一个是 mip tail 的位置
+        mutable std::ifstream m_stream;
+        mutable std::mutex m_mutex;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <future>
+#include <ranges>
 
 namespace jre
 {
@@ -9,4 +10,28 @@ namespace jre
     {
         return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
     }
-}
\ No newline at end of file
+
+    template <typename R>
+    bool is_ready(std::shared_future<R> const &f)
+    {
+        return f.valid() && f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // 一组 future 里已经就绪的个数，不等待
+    template <std::ranges::range Futures>
+    size_t count_ready(Futures const &futures)
+    {
+        size_t count = 0;
+        for (auto const &f : futures)
+        {
+            count += is_ready(f) ? 1 : 0;
+        }
+        return count;
+    }
+
+    template <std::ranges::range Futures>
+    bool all_ready(Futures const &futures)
+    {
+        return count_ready(futures) == static_cast<size_t>(std::ranges::distance(futures));
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/texture_loader.h"
+#include "jrenderer/texture_streamer.h"
+#include "jrenderer/utils/blocking_queue.hpp"
+
+namespace jre
+{
+    class Graphics;
+
+    // IAsyncModelSource::create 用的
+    struct AsyncModelContext
+    {
+        vk::SharedDevice device;
+        vk::PhysicalDevice physical_device;
+        vk::CommandBuffer command_buffer;            // 这一帧正在录的，录进去的拷贝在这一帧的渲染之前执行
+        std::vector<DynamicBuffer> &staging_buffers; // 录拷贝用的 staging 放这里，留到这一帧执行完
+        // 马上返回占位纹理 (1x1，按用途的默认值，同一个文件同一个)。真的纹理在后台加载，好了之后换进这个 model 的材质
+        std::function<Texture(const TextureRequest &)> request_texture;
+    };
+
+    struct AsyncModelParts
+    {
+        std::shared_ptr<IMesh> mesh;
+        std::vector<std::shared_ptr<IMaterialInstance>> materials;
+    };
+
+    // 一个要异步加载的 model
+    class IAsyncModelSource
+    {
+    public:
+        virtual ~IAsyncModelSource() = default;
+        // 工作线程上：读文件、解析、整理顶点。不录命令、不碰渲染线程的东西，可以先编好材质的 pipeline
+        virtual void prepare() = 0;
+        // 渲染线程上，这一帧录制之前：建网格和材质，上传录进 context.command_buffer，纹理用 context.request_texture 拿
+        virtual AsyncModelParts create(AsyncModelContext &context) = 0;
+    };
+
+    struct AsyncModelHandle
+    {
+        uint32_t model_index;                    // 在 scene.models 里，加载好之前是个空网格的占位 model，什么都不画
+        std::shared_future<void> mesh_ready;     // 网格和材质换进去了，纹理可能还是占位的
+        std::shared_future<void> textures_ready; // 纹理都换成真的了。失败的话两个 future 都带着异常，model 留着占位的
+    };
+
+    // 异步加载 model：load 马上往场景里放一个占位的 model，解析交给工作线程。
+    // 渲染线程每帧录制之前 (注册在 pre_render_pass_recorders 最前面) 不等待地取做好的，最多 models_per_frame 个，
+    // 建 GPU 资源、上传录进这一帧的 command buffer，在帧边界把 model 的网格和材质换成真的，材质先用占位纹理。
+    // 纹理在 TextureLoader 的线程上解码，每帧最多录 textures_per_frame 张，录它的那一帧执行完 (这个 cpu frame 的 fence 下次被等过) 才换进材质。
+    // 录命令都在渲染线程上，不额外提交，不等 GPU；材质的 pipeline 由 source 在 prepare 里编好，create 里只是拿来用。
+    // 给了 texture_streamer 的话纹理交给它流送，换进材质的是它现在的那张
+    class AsyncModelLoader : public CommandBufferRecordable
+    {
+    public:
+        uint32_t models_per_frame = 1;
+        uint32_t textures_per_frame = 4;
+
+        AsyncModelLoader(Graphics &graphics, SceneDrawer &scene_drawer, TextureStreamer *texture_streamer = nullptr, VirtualTextureSystem *virtual_textures = nullptr, uint32_t thread_count = 1);
+        ~AsyncModelLoader();
+
+        AsyncModelLoader(const AsyncModelLoader &) = delete;
+        AsyncModelLoader &operator=(const AsyncModelLoader &) = delete;
+
+        // 在渲染线程上调用
+        AsyncModelHandle load(std::shared_ptr<IAsyncModelSource> source);
+        uint32_t loading_count() const { return m_loading_count; } // 还没全部就绪的 model 数
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+
+    private:
+        struct Job
+        {
+            std::shared_ptr<IAsyncModelSource> source;
+            uint32_t model_index;
+            std::promise<void> mesh_ready;
+            std::promise<void> textures_ready;
+            std::exception_ptr error;
+            std::vector<std::string> waiting_textures; // 还是占位的纹理
+        };
+
+        struct PendingTexture
+        {
+            Texture placeholder; // 真的换进材质之后交给 FrameUploads::retired，失败的话一直留着
+            std::shared_future<Texture> future;
+            std::optional<Texture> texture; // 录它的那一帧执行完了才有，失败的话一直没有
+            bool complete = false;
+        };
+
+        struct FrameUploads
+        {
+            std::vector<DynamicBuffer> staging_buffers;
+            std::vector<std::string> textures;
+            std::vector<Texture> retired; // 换下来的占位纹理，等到这个 cpu frame 下次录制时没有帧在用了，放掉无绑定表的位置和 image view
+        };
+
+        vk::SharedDevice m_device;
+        vk::PhysicalDevice m_physical_device;
+        SceneDrawer &m_scene_drawer;
+        TextureStreamer *m_texture_streamer;
+        std::shared_ptr<Mesh> m_placeholder_mesh;
+        std::array<Texture, 4> m_default_textures; // 按 TextureRole
+        TextureUploadBatch m_texture_batch;
+        TextureLoader m_texture_loader;
+        std::unordered_map<std::string, PendingTexture> m_textures;
+        std::vector<std::string> m_unrecorded_textures;
+        std::vector<FrameUploads> m_frames; // 按 cpu frame
+        std::vector<std::shared_ptr<Job>> m_waiting_jobs;
+        uint32_t m_loading_count = 0;
+        BlockingQueue<std::shared_ptr<Job>> m_jobs;
+        BlockingQueue<std::shared_ptr<Job>> m_prepared;
+        std::vector<std::jthread> m_threads; // 最后一个成员，先于队列析构
+
+        void prepare_loop();
+        bool create_model(vk::CommandBuffer command_buffer, FrameUploads &frame, std::shared_ptr<Job> job); // 返回有没有录网格上传
+        Texture request_texture(Job &job, const TextureRequest &request);
+        Texture create_placeholder(const TextureRequest &request);
+        Texture resolve(const Texture &texture) const;
+        void replace_completed_textures();
+    };
+}
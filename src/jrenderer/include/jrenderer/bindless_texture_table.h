@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <map>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "jrenderer/image.h"
+#include "jrenderer/buffer.h"
+
+namespace jre
+{
+    // 全局的无绑定纹理表 (descriptor indexing，Vulkan 1.2 核心)，整张表是 set_bindless 一个 set。
+    // 纹理由 TextureBuilder 注册一次，拿到在 bindless_textures[] 里的序号；材质实例注册它用到的纹理序号，拿到材质 ID。
+    // 着色器用 push constant 里的材质 ID 查 material_textures 再采样，换材质不用换 set。
+    // binding 2 是 MaterialParameterTable 的 buffer，同一个材质 ID 取参数。
+    // binding 3 每个纹理一个 uvec4，虚拟纹理的 tile 信息，普通纹理是 0；binding 4、5 是 VirtualTextureSystem 的反馈和驻留位图，没有的话不绑。
+    class BindlessTextureTable
+    {
+    public:
+        static constexpr uint32_t max_textures = 4096;
+        static constexpr uint32_t max_materials = 1024;
+        static constexpr uint32_t max_material_textures = 4; // 和 bindless.glsl 的 material_textures 一致
+        static constexpr uint32_t invalid_index = ~0u;
+
+        BindlessTextureTable(vk::SharedDevice device, vk::PhysicalDevice physical_device, vk::Buffer material_parameter_buffer);
+
+        // 同一个 image view 只占一个位置，优先用 release_texture 空出来的
+        uint32_t register_texture(const DeviceImage &texture);
+        // 空出位置给后面注册的纹理。调用方保证已经没有材质指着它，用它的帧也都执行完了
+        void release_texture(uint32_t texture_index);
+        // 最多 max_material_textures 个纹理序号，返回材质 ID
+        uint32_t register_material(std::span<const uint32_t> texture_indices);
+        // 改已有材质的纹理序号 (占位纹理换成加载好的)。表是各帧共用的，还在飞的帧可能读到旧的或新的，所以新旧纹理都要还能用
+        void update_material(uint32_t material_id, std::span<const uint32_t> texture_indices);
+        // 注册之后写，格式见 virtual_texture.glsl
+        void set_virtual_texture(uint32_t texture_index, const glm::uvec4 &info) { m_virtual_texture_buffer[texture_index] = info; }
+        // 第一帧之前调用
+        void set_virtual_texture_buffers(vk::Buffer feedback_buffer, vk::Buffer residency_buffer);
+
+        vk::DescriptorSetLayout descriptor_set_layout() const { return m_descriptor_set_layout.get(); }
+        vk::DescriptorSet descriptor_set() const { return m_descriptor_set.get(); }
+        uint32_t texture_count() const { return static_cast<uint32_t>(m_texture_indices.size()); }
+        uint32_t material_count() const { return m_material_count; }
+
+    private:
+        vk::SharedDevice m_device;
+        vk::SharedDescriptorPool m_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_descriptor_set_layout;
+        vk::SharedDescriptorSet m_descriptor_set;
+        HostArrayBuffer<glm::uvec4> m_material_buffer;        // 每个材质一个，存纹理序号
+        HostArrayBuffer<glm::uvec4> m_virtual_texture_buffer; // 每个纹理一个
+        std::map<vk::ImageView, uint32_t> m_texture_indices;
+        std::vector<uint32_t> m_free_texture_indices;
+        uint32_t m_texture_slot_count = 0;
+        uint32_t m_material_count = 0;
+    };
+}
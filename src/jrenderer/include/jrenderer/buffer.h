@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.hpp>
 #include <vulkan_utils/utils.hpp>
 #include <gsl/pointers>
+#include <functional>
 #include <ranges>
 #include "jrenderer/utils/vk_utils.h"
 #include "jrenderer/utils/vk_shared_utils.h"
@@ -267,7 +268,14 @@ namespace jre
 
         Buffer<void> build(const void *const data, size_t size)
         {
-            Buffer<void> staging_buffer = HostVisibleBufferBuilder<void>(this->device, this->physical_device, info.size).set_usage(vk::BufferUsageFlagBits::eTransferSrc).build(data, size);
+            return build([data, size](void *staging_memory)
+                         { std::memcpy(staging_memory, data, size); });
+        }
+
+        // write 直接往 staging 的映射内存里写 (比如边转换边写)，省掉先攒一份再拷的那次
+        Buffer<void> build(const std::function<void(void *)> &write)
+        {
+            Buffer<void> staging_buffer = build_staging_buffer(write);
             this->info.usage = this->info.usage | vk::BufferUsageFlagBits::eTransferDst;
             vk::Buffer buffer = this->device->createBuffer(this->info);
             vk::DeviceMemory memory = vk::su::allocateDeviceMemory(this->device.get(), this->physical_device.getMemoryProperties(), this->device->getBufferMemoryRequirements(buffer), this->properties);
@@ -275,6 +283,36 @@ namespace jre
             copy_buffer_to_buffer(command_buffer, transfer_queue, staging_buffer.buffer().get(), buffer, info.size);
             return {vk::SharedBuffer(buffer, this->device), vk::SharedDeviceMemory(memory, this->device), info.size};
         }
+
+        // 不提交，拷贝录进调用方正在录的 command buffer。staging 放进 staging_buffers 由调用方留到执行完，之后的 barrier 也由调用方加
+        Buffer<void> record(const void *const data, size_t size, vk::CommandBuffer recording_command_buffer, std::vector<Buffer<void>> &staging_buffers)
+        {
+            return record([data, size](void *staging_memory)
+                          { std::memcpy(staging_memory, data, size); },
+                          recording_command_buffer,
+                          staging_buffers);
+        }
+
+        Buffer<void> record(const std::function<void(void *)> &write, vk::CommandBuffer recording_command_buffer, std::vector<Buffer<void>> &staging_buffers)
+        {
+            Buffer<void> staging_buffer = build_staging_buffer(write);
+            this->info.usage = this->info.usage | vk::BufferUsageFlagBits::eTransferDst;
+            vk::Buffer buffer = this->device->createBuffer(this->info);
+            vk::DeviceMemory memory = vk::su::allocateDeviceMemory(this->device.get(), this->physical_device.getMemoryProperties(), this->device->getBufferMemoryRequirements(buffer), this->properties);
+            this->device->bindBufferMemory(buffer, memory, 0);
+            recording_command_buffer.copyBuffer(staging_buffer.buffer().get(), buffer, vk::BufferCopy(0, 0, info.size));
+            staging_buffers.push_back(std::move(staging_buffer));
+            return {vk::SharedBuffer(buffer, this->device), vk::SharedDeviceMemory(memory, this->device), info.size};
+        }
+
+    private:
+        Buffer<void> build_staging_buffer(const std::function<void(void *)> &write)
+        {
+            Buffer<void> staging_buffer = HostVisibleBufferBuilder<void>(this->device, this->physical_device, info.size).set_usage(vk::BufferUsageFlagBits::eTransferSrc).build();
+            write(staging_buffer.mapped_memory());
+            staging_buffer.unmap_memory();
+            return staging_buffer;
+        }
     };
 
     using DeviceLocalDynamicBufferBuilder = DeviceLocalBufferBuilder<void>;
@@ -405,12 +443,20 @@ namespace jre
         {
         public:
             vk::ArrayProxy<ElementType> data;
+            std::function<void(ElementType *)> write; // 有的话不用 data，见 DeviceLocalDynamicBufferBuilder::build(write)
             Builder(vk::SharedDevice device, vk::PhysicalDevice physical_device, vk::CommandBuffer command_buffer, vk::Queue transfer_queue, vk::ArrayProxy<ElementType> data)
                 : DeviceLocalDynamicBufferBuilder(device, physical_device, command_buffer, transfer_queue, data.size() * sizeof(ElementType)),
                   data(data)
             {
             }
 
+            // 建的时候由 write 往 staging 里写 count 个元素
+            Builder(vk::SharedDevice device, vk::PhysicalDevice physical_device, vk::CommandBuffer command_buffer, vk::Queue transfer_queue, uint32_t count, std::function<void(ElementType *)> write)
+                : DeviceLocalDynamicBufferBuilder(device, physical_device, command_buffer, transfer_queue, count * sizeof(ElementType)),
+                  write(std::move(write))
+            {
+            }
+
             Builder &set_usage(vk::BufferUsageFlags usage)
             {
                 DeviceLocalDynamicBufferBuilder::set_usage(usage);
@@ -419,8 +465,25 @@ namespace jre
 
             DeviceArrayBuffer build()
             {
+                if (write)
+                {
+                    return DeviceArrayBuffer(DeviceLocalDynamicBufferBuilder::build([this](void *staging_memory)
+                                                                                    { write(static_cast<ElementType *>(staging_memory)); }));
+                }
                 return DeviceArrayBuffer(DeviceLocalDynamicBufferBuilder::build(data.data(), data.size() * sizeof(ElementType)));
             }
+
+            DeviceArrayBuffer record(vk::CommandBuffer recording_command_buffer, std::vector<DynamicBuffer> &staging_buffers)
+            {
+                if (write)
+                {
+                    return DeviceArrayBuffer(DeviceLocalDynamicBufferBuilder::record([this](void *staging_memory)
+                                                                                     { write(static_cast<ElementType *>(staging_memory)); },
+                                                                                     recording_command_buffer,
+                                                                                     staging_buffers));
+                }
+                return DeviceArrayBuffer(DeviceLocalDynamicBufferBuilder::record(data.data(), data.size() * sizeof(ElementType), recording_command_buffer, staging_buffers));
+            }
         };
     };
 
@@ -6,13 +6,6 @@
 
 namespace jre
 {
-    struct UniformModelTransform
-    {
-        glm::mat4 model = glm::identity<glm::mat4>();
-        glm::mat4 model_view;
-        glm::mat4 model_view_proj;
-    };
-
     struct UniformCamera
     {
         glm::mat4 view;
@@ -27,22 +20,29 @@ namespace jre
         UniformCamera camera_trans;
     };
 
+    static constexpr uint32_t max_render_views = 4; // 和 common_inputs.glsl 的 k_max_views 一致
+
     struct UniformScene
     {
         UniformLight main_light;
-        UniformCamera camera_trans;
+        UniformCamera cameras[max_render_views]; // 每个 render viewport 一个，draw 的 instance 序号就是视口序号
     };
 
-    struct UniformPerObject
+    // 每个 draw 的数据用 push constant 传，所有光栅化 pipeline 的 [0, 8) 字节，顶点和片元都能读。
+    // 和 common_inputs.glsl 的 ObjectPushConstants 一致
+    struct ObjectPushConstants
     {
-        UniformModelTransform mvp;
+        uint32_t vertex_base; // 这个 model 在预变换顶点 buffer 里的起始顶点
+        uint32_t material_id; // 材质 ID；可见性缓冲的 ID pass 里是 draw 序号，屏幕空间描边的 G-buffer 里是描边 ID
     };
+    static_assert(sizeof(ObjectPushConstants) <= 128); // maxPushConstantsSize 保证的最小值
 
     enum class UniformBufferSetIndex
     {
         // PerFrame,
         PerRenderSet,
-        PerObject,
+        PerObject, // 所有 model 共用的预变换顶点，每个 cpu frame 一个
+        Bindless, // BindlessTextureTable
         PerMaterial
     };
 }
\ No newline at end of file
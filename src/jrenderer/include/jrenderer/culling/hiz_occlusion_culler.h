@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include "jrenderer/culling/occlusion_culler.h"
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/image.h"
+#include "jrenderer/buffer.h"
+
+namespace jre
+{
+    class Scene;
+
+    // 在主 render pass 之后用 compute 从深度附件生成 Hi-Z mip 链（每个texel存覆盖区域的最远深度），
+    // 再把一级较小的 mip 拷到 host 可见的 buffer。
+    // 每个 cpu frame 一份回读，等到这个 cpu frame 的 fence 等过之后才读，所以 CPU 测试用的是几帧之前的深度，
+    // 测试时用的也是那一帧的 view_proj，保证深度和投影一致。代价是物体刚露出来时可能晚几帧出现。
+    class HiZOcclusionCuller : public CommandBufferRecordable, public IOcclusionCuller
+    {
+    public:
+        uint32_t readback_max_size = 64; // 回读的 mip 的最大边长
+
+        HiZOcclusionCuller(Graphics &graphics, Scene &scene);
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+        void on_resize(Graphics &graphics) { create_resources(graphics); }
+        void reset();
+
+        bool is_visible(const BoundingBox &bounds, const glm::mat4 &model) const override;
+
+    private:
+        struct FrameReadback
+        {
+            DynamicBuffer buffer;
+            glm::mat4 view_proj;
+            vk::Viewport viewport;
+            bool valid = false;
+        };
+
+        struct PushConstants
+        {
+            glm::ivec2 src_extent;
+            glm::ivec2 dst_extent;
+            int sample_count;
+        };
+
+        Scene &m_scene;
+        vk::SharedShaderModule m_init_shader;
+        vk::SharedShaderModule m_init_ms_shader;
+        vk::SharedShaderModule m_downsample_shader;
+        vk::SharedSampler m_depth_sampler;
+
+        vk::SharedDescriptorPool m_init_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_init_descriptor_set_layout;
+        vk::SharedDescriptorPool m_downsample_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_downsample_descriptor_set_layout;
+        vk::SharedPipelineLayout m_init_pipeline_layout;
+        vk::SharedPipelineLayout m_downsample_pipeline_layout;
+        vk::SharedPipeline m_init_pipeline;
+        vk::SharedPipeline m_downsample_pipeline;
+
+        DeviceImage m_hiz_image;
+        std::vector<vk::SharedImageView> m_mip_views;
+        std::vector<vk::SharedDescriptorSet> m_init_descriptor_sets;       // 每个深度附件一个
+        std::vector<vk::SharedDescriptorSet> m_downsample_descriptor_sets; // 每级 mip 一个 (1 .. mip_levels - 1)
+        vk::Extent2D m_extent;
+        vk::SampleCountFlagBits m_sample_count = vk::SampleCountFlagBits::e1;
+        uint32_t m_mip_levels = 1;
+        uint32_t m_readback_level = 0;
+        vk::Extent2D m_readback_extent;
+        std::vector<FrameReadback> m_readbacks;
+
+        // 最近一次完成的回读
+        std::vector<float> m_depth;
+        glm::mat4 m_view_proj;
+        vk::Viewport m_viewport;
+        bool m_valid = false;
+
+        void create_resources(Graphics &graphics);
+    };
+}
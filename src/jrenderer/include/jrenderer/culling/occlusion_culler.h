@@ -0,0 +1,59 @@
+#pragma once
+
+#include <optional>
+#include <limits>
+#include <glm/glm.hpp>
+#include "jrenderer/mesh.h"
+
+namespace jre
+{
+    enum class OcclusionCullingMode
+    {
+        None,
+        HiZ,      // GPU 生成 Hi-Z，回读到 CPU 测试（晚若干帧）
+        Software, // CPU 光栅化遮挡体，当帧测试
+    };
+
+    class Scene;
+
+    class IOcclusionCuller
+    {
+    public:
+        virtual ~IOcclusionCuller() = default;
+        // 每帧录制 draw 之前调用一次，frame 是本帧用的 cpu frame
+        virtual void prepare(Scene &scene, uint32_t frame) {}
+        // bounds 是模型空间的包围盒，返回false表示被完全挡住，可以不画
+        virtual bool is_visible(const BoundingBox &bounds, const glm::mat4 &model) const = 0;
+    };
+
+    struct ScreenRect
+    {
+        glm::vec2 min; // [0, 1] 视口uv，y向下
+        glm::vec2 max;
+        float nearest_depth;
+
+        bool overlaps_viewport() const { return max.x >= 0.0f && max.y >= 0.0f && min.x <= 1.0f && min.y <= 1.0f; }
+    };
+
+    // 包围盒跨过相机平面时拿不到可靠的屏幕矩形，返回空，调用方当作可见
+    inline std::optional<ScreenRect> project_bounds(const BoundingBox &bounds, const glm::mat4 &model_view_proj)
+    {
+        ScreenRect rect{glm::vec2(std::numeric_limits<float>::max()),
+                        glm::vec2(std::numeric_limits<float>::lowest()),
+                        std::numeric_limits<float>::max()};
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            glm::vec4 clip = model_view_proj * glm::vec4(bounds.corner(i), 1.0f);
+            if (clip.w <= std::numeric_limits<float>::epsilon())
+            {
+                return std::nullopt;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 uv = glm::vec2(ndc) * 0.5f + 0.5f;
+            rect.min = glm::min(rect.min, uv);
+            rect.max = glm::max(rect.max, uv);
+            rect.nearest_depth = std::min(rect.nearest_depth, ndc.z);
+        }
+        return rect;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <span>
+#include "jrenderer/culling/occlusion_culler.h"
+#include "jrenderer/utils/worker_pool.hpp"
+
+namespace jre
+{
+    // 从原网格里挑面积最大的 max_triangles 个三角形当遮挡体，顶点位置不动，退化、重复的三角形丢掉。
+    // 遮挡体是原表面的一部分，盖住的地方原网格一定也盖住，所以是保守的；挑剩下的小三角形只是少挡一点。
+    // 不用顶点聚类：合并成平均位置会鼓出原表面，把其实看得见的东西剔掉
+    std::shared_ptr<OccluderMesh> simplify_occluder(std::span<const glm::vec3> positions,
+                                                    std::span<const uint32_t> indices,
+                                                    const BoundingBox &bounds,
+                                                    uint32_t max_triangles = 256);
+
+    // 把遮挡体光栅化到低分辨率深度图，再拿包围盒去测。
+    // 三角形按 tile 分桶，tile 分给 worker 线程，每个 tile 内一行一行用 SIMD（AVX2 8 宽 / SSE 4 宽）算覆盖 mask 和深度。
+    // 覆盖按像素中心算，深度取像素范围内最远的值，测试时包围盒矩形外扩一个像素，所以遮挡测试是保守的
+    class SoftwareOcclusionCuller : public IOcclusionCuller
+    {
+    public:
+        static constexpr uint32_t tile_width = 32;
+        static constexpr uint32_t tile_height = 16;
+
+        SoftwareOcclusionCuller(uint32_t width = 256, uint32_t height = 128, uint32_t thread_count = std::thread::hardware_concurrency());
+
+        // 会向上取整到 tile 的整数倍
+        void set_resolution(uint32_t width, uint32_t height);
+        uint32_t width() const { return m_width; }
+        uint32_t height() const { return m_height; }
+        uint32_t thread_count() const { return m_workers.thread_count(); }
+        uint32_t triangle_count() const { return static_cast<uint32_t>(m_triangles.size()); }
+        const std::vector<float> &depth() const { return m_depth; }
+
+        void clear();
+        void add_occluder(const OccluderMesh &occluder, const glm::mat4 &model_view_proj);
+        void rasterize();
+
+        void prepare(Scene &scene, uint32_t frame) override;
+        bool is_visible(const BoundingBox &bounds, const glm::mat4 &model) const override;
+
+    private:
+        // 边函数 E = a * x + b * y + c >= 0 在三角形内，深度 z = za * x + zb * y + zc，都以像素整数坐标求值，
+        // 像素中心的 0.5 偏移和深度的保守偏移已经折进 c / zc 里了
+        struct TriangleSetup
+        {
+            float edge_a[3];
+            float edge_b[3];
+            float edge_c[3];
+            float z_a, z_b, z_c;
+            float z_max;
+            int min_x, min_y, max_x, max_y;
+        };
+
+        WorkerPool m_workers;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        uint32_t m_tiles_x = 0;
+        uint32_t m_tiles_y = 0;
+        std::vector<float> m_depth;
+        std::vector<TriangleSetup> m_triangles;
+        std::vector<std::vector<uint32_t>> m_tile_bins;
+        glm::mat4 m_view_proj{1.0f};
+        bool m_valid = false;
+
+        void rasterize_tile(uint32_t tile_index);
+    };
+}
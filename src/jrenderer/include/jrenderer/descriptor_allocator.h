@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace jre
+{
+    // 按 binding 签名缓存 set layout，binding 一样的 layout 只建一次，用它们的 pipeline layout 也就兼容
+    class DescriptorSetLayoutCache
+    {
+    public:
+        DescriptorSetLayoutCache() = default;
+        DescriptorSetLayoutCache(vk::SharedDevice device) : m_device(device) {}
+
+        // 不支持 immutable sampler
+        vk::SharedDescriptorSetLayout get(vk::ArrayProxy<const vk::DescriptorSetLayoutBinding> bindings);
+
+        uint32_t size() const { return static_cast<uint32_t>(m_layouts.size()); }
+
+    private:
+        using BindingKey = std::tuple<uint32_t, vk::DescriptorType, uint32_t, vk::ShaderStageFlags::MaskType>;
+
+        vk::SharedDevice m_device;
+        std::map<std::vector<BindingKey>, vk::SharedDescriptorSetLayout> m_layouts;
+    };
+
+    // 可增长的一组 descriptor pool。当前 pool 分不出来 (eErrorOutOfPoolMemory、eErrorFragmentedPool) 就换下一个，
+    // 都满了再建一个，每次大一倍。pool 里每种类型按 pool_size_ratios 留，不按某一个 layout 算死，不同 layout 的 set 可以混在一个 pool 里。
+    // 两种用法：
+    // 1. 常驻：pool 带 eFreeDescriptorSet，allocate 出来的 set 析构时还回它的 pool。pool 都留在分配器里，
+    //    当前 pool 分不出来时绕回去把前面的 pool 也试一遍 (可能有还回来的空位)，都不行才建新的
+    // 2. 临时：pool 不带 eFreeDescriptorSet，allocate_transient 的 set 不单独还，reset 一起回收。每个 cpu frame 一个，见 CPUFrame
+    class DescriptorAllocator
+    {
+    public:
+        struct PoolSizeRatio
+        {
+            vk::DescriptorType type;
+            float ratio; // 平均每个 set 几个
+        };
+
+        static constexpr uint32_t max_sets_per_pool = 4096;
+
+        static std::vector<PoolSizeRatio> default_pool_size_ratios();
+
+        DescriptorAllocator() = default;
+        DescriptorAllocator(vk::SharedDevice device,
+                            vk::DescriptorPoolCreateFlags flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                            uint32_t initial_sets = 32,
+                            std::vector<PoolSizeRatio> pool_size_ratios = default_pool_size_ratios());
+
+        // 常驻，要 eFreeDescriptorSet
+        vk::SharedDescriptorSet allocate(vk::DescriptorSetLayout layout);
+        std::vector<vk::SharedDescriptorSet> allocate(const std::vector<vk::DescriptorSetLayout> &layouts);
+        // 临时，只在下一次 reset 之前有效
+        vk::DescriptorSet allocate_transient(vk::DescriptorSetLayout layout);
+        // 所有 pool 一起 reset，要确定 GPU 不再用这些 set，也没有常驻的 set 还活着
+        void reset();
+
+        uint32_t pool_count() const { return static_cast<uint32_t>(m_pools.size()); }
+        uint32_t allocated_count() const { return m_allocated_count; } // reset 之后的
+
+    private:
+        vk::SharedDevice m_device;
+        vk::DescriptorPoolCreateFlags m_flags;
+        std::vector<PoolSizeRatio> m_pool_size_ratios;
+        uint32_t m_next_pool_sets = 0;
+        std::vector<vk::SharedDescriptorPool> m_pools;
+        size_t m_current_pool = 0; // 临时用法下它前面的都分满了；常驻用法下是上次分出来的那个
+        uint32_t m_allocated_count = 0;
+
+        std::tuple<vk::DescriptorSet, vk::SharedDescriptorPool> allocate_from_pools(vk::DescriptorSetLayout layout);
+        vk::SharedDescriptorPool create_pool();
+    };
+}
@@ -56,19 +56,45 @@ namespace jre
                                                 binding_index);
         }
 
-        DescripterSetUpdater &write_combined_image_sampler(vk::DescriptorImageInfo info, int binding_index = -1)
+        DescripterSetUpdater &write_combined_image_sampler(vk::DescriptorImageInfo info, int binding_index = -1, uint32_t array_element = 0)
         {
             auto &tmp_info = descriptor_image_infos.emplace_back(info);
             descriptor_writes.emplace_back(
                 vk::DescriptorSet(),
                 binding_index == -1 ? descriptor_writes.size() : binding_index,
-                0,
+                array_element,
                 vk::DescriptorType::eCombinedImageSampler,
                 tmp_info,
                 nullptr);
             return *this;
         }
 
+        DescripterSetUpdater &write_storage_image(vk::ImageView image_view, int binding_index = -1)
+        {
+            auto &tmp_info = descriptor_image_infos.emplace_back(vk::Sampler(), image_view, vk::ImageLayout::eGeneral);
+            descriptor_writes.emplace_back(
+                vk::DescriptorSet(),
+                binding_index == -1 ? descriptor_writes.size() : binding_index,
+                0,
+                vk::DescriptorType::eStorageImage,
+                tmp_info,
+                nullptr);
+            return *this;
+        }
+
+        DescripterSetUpdater &write_storage_buffer(vk::DescriptorBufferInfo info, int binding_index = -1)
+        {
+            auto &tmp_info = descriptor_buffer_infos.emplace_back(info);
+            descriptor_writes.emplace_back(
+                vk::DescriptorSet(),
+                binding_index == -1 ? descriptor_writes.size() : binding_index,
+                0,
+                vk::DescriptorType::eStorageBuffer,
+                nullptr,
+                tmp_info);
+            return *this;
+        }
+
         DescripterSetUpdater &clear()
         {
             descriptor_writes.clear();
@@ -88,4 +114,41 @@ namespace jre
         }
     };
 
+    // 同一个 layout 的 set 要反复更新时用：VkDescriptorUpdateTemplate 每个 layout 建一次，
+    // 之后直接从打包好的 Data 里读 DescriptorBufferInfo / DescriptorImageInfo，不用每次拼 WriteDescriptorSet，也没有堆分配。
+    // Data 里每个 binding 一个成员，用 entry 说明它对应哪个 binding、什么类型、在 Data 里的偏移
+    template <typename Data>
+    class DescriptorUpdateTemplate
+    {
+    public:
+        static vk::DescriptorUpdateTemplateEntry entry(uint32_t binding, vk::DescriptorType type, size_t offset, uint32_t count = 1, size_t stride = 0)
+        {
+            return vk::DescriptorUpdateTemplateEntry(binding, 0, count, type, offset, stride);
+        }
+
+        DescriptorUpdateTemplate() = default;
+        DescriptorUpdateTemplate(vk::SharedDevice device,
+                                 vk::DescriptorSetLayout descriptor_set_layout,
+                                 vk::ArrayProxy<const vk::DescriptorUpdateTemplateEntry> entries)
+            : m_device(device)
+        {
+            m_template = vk::SharedDescriptorUpdateTemplate(
+                device->createDescriptorUpdateTemplate(vk::DescriptorUpdateTemplateCreateInfo(
+                    {},
+                    entries,
+                    vk::DescriptorUpdateTemplateType::eDescriptorSet,
+                    descriptor_set_layout)),
+                device);
+        }
+
+        void update(vk::DescriptorSet descriptor_set, const Data &data) const
+        {
+            m_device->updateDescriptorSetWithTemplate(descriptor_set, m_template.get(), &data);
+        }
+
+    private:
+        vk::SharedDevice m_device;
+        vk::SharedDescriptorUpdateTemplate m_template;
+    };
+
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "jrenderer/descriptor_transform.h"
+#include "jrenderer/descriptor_update.hpp"
 #include "jrenderer/drawer/command_buffer_recordable.h"
 #include "jrenderer/pipeline.h"
 #include "jrenderer/concrete_uniform_buffers.h"
@@ -9,10 +10,18 @@
 #include "jrenderer/camera/render_viewport.h"
 #include "jrenderer/drawer/render_pass_drawer.h"
 #include "jrenderer/ticker/scene_ticker.h"
+#include "jrenderer/culling/occlusion_culler.h"
+#include "jrenderer/mesh_drawer.h"
+#include "jrenderer/bindless_texture_table.h"
+#include "jrenderer/material_parameter_table.h"
+#include "jrenderer/mesh_cache.h"
+#include "jrenderer/texture_cache.h"
 
 namespace jre
 {
     class IMesh;
+    class VisibilityBufferDrawer;
+    class ScreenSpaceOutlineDrawer;
 
     class Model
     {
@@ -20,14 +29,15 @@ namespace jre
         ModelTransform transform;
         std::shared_ptr<IMesh> mesh;
         std::vector<std::shared_ptr<IMaterialInstance>> materials;
+        std::vector<std::shared_ptr<Texture>> textures; // 从 SceneDrawer::texture_cache 拿的，拿着缓存就不会换出去
     };
 
     class ModelFactory
     {
     public:
         ModelTransformFactory transform_factory;
-        ModelFactory(vk::SharedDevice device, vk::PhysicalDevice physical_device, uint32_t frame_count = 1, uint32_t max_sets = 100) : transform_factory(device, physical_device, frame_count, max_sets) {}
-        Model create() { return {transform_factory.create_transform(), nullptr, {}}; }
+        ModelFactory(uint32_t frame_count = 1) : transform_factory(frame_count) {}
+        Model create() { return {transform_factory.create_transform(), nullptr, {}, {}}; }
     };
 
     class Scene
@@ -39,6 +49,10 @@ namespace jre
         HostArrayBuffer<UniformScene> scene_buffers;
         vk::SharedDescriptorSetLayout descriptor_set_layout;
         std::vector<vk::SharedDescriptorSet> descriptor_sets;
+        // set_object：VertexPretransformer 的输出，所有 model 共用一块，按 push constant 里的 vertex_base 取
+        vk::SharedDescriptorSetLayout object_descriptor_set_layout;
+        std::vector<vk::SharedDescriptorSet> object_descriptor_sets;
+        std::vector<uint32_t> vertex_bases; // 每个 model 一个，VertexPretransformer 每帧写
 
         Scene(vk::SharedDevice device, vk::PhysicalDevice physical_device, uint32_t frame_count = 1)
             : models(), render_viewports(), descriptor_sets(frame_count)
@@ -49,7 +63,7 @@ namespace jre
             auto [descriptor_pool, descriptor_set_layout_] = vk::shared::make_descriptor_pool_with_layout(
                 device,
                 frame_count,
-                {{{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment}}});
+                {{{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute}}});
             descriptor_set_layout = descriptor_set_layout_;
             for (uint32_t i = 0; i < frame_count; ++i)
             {
@@ -60,20 +74,39 @@ namespace jre
                     .write_uniform_buffer(vk::DescriptorBufferInfo{scene_buffers.vk_buffer(), sizeof(UniformScene) * i, sizeof(UniformScene)})
                     .update();
             }
+
+            auto [object_descriptor_pool, object_descriptor_set_layout_] = vk::shared::make_descriptor_pool_with_layout(
+                device,
+                frame_count,
+                {{{0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute}}});
+            object_descriptor_set_layout = object_descriptor_set_layout_;
+            object_descriptor_sets = vk::shared::allocate_descriptor_sets(object_descriptor_pool,
+                                                                          std::vector<vk::DescriptorSetLayout>(frame_count, object_descriptor_set_layout.get()));
         }
     };
 
+    // 所有光栅化 pipeline layout 都带这一段，见 ObjectPushConstants
+    inline vk::PushConstantRange object_push_constant_range()
+    {
+        return vk::PushConstantRange{vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(ObjectPushConstants)};
+    }
+
     class DiffSceneMaterialBinder
     {
     public:
         DiffTrigger<std::tuple<vk::PipelineLayout, vk::DescriptorSet>> scene_descriptor_set_diff{};
-        DiffTrigger<std::tuple<vk::PipelineLayout, vk::DescriptorSet>> model_descriptor_set_diff{};
+        DiffTrigger<std::tuple<vk::PipelineLayout, vk::DescriptorSet>> object_descriptor_set_diff{};
+        DiffTrigger<std::tuple<vk::PipelineLayout, vk::DescriptorSet>> bindless_descriptor_set_diff{};
         DiffTrigger<std::tuple<vk::PipelineLayout, vk::DescriptorSet>> material_descriptor_set_diff{};
+        DiffTrigger<std::tuple<vk::PipelineLayout, uint32_t, uint32_t>> push_constants_diff{};
         DiffTrigger<vk::Pipeline> pipeline_diff{};
 
+        // 前几个 set 每帧都一样，实际上只在换 pipeline layout 时重绑；换 model 或材质只推 push constant
         void bind(const RenderMaterialData &render_material_data,
                   vk::DescriptorSet scene_descriptor_set,
-                  vk::DescriptorSet model_descriptor_set,
+                  vk::DescriptorSet object_descriptor_set,
+                  vk::DescriptorSet bindless_descriptor_set,
+                  uint32_t vertex_base,
                   vk::CommandBuffer command_buffer);
     };
 
@@ -83,11 +116,57 @@ namespace jre
         ModelFactory factory;
         Scene scene;
         RenderPipelineResources render_pipelines;
+        std::shared_ptr<MaterialParameterTable> material_parameters; // 所有材质的参数，要放进 pre_render_pass_recorders 上传
+        BindlessTextureTable bindless_textures;                       // 所有材质的纹理和参数，材质 pipeline layout 的 set_bindless
+        SamplerCache *sampler_cache = nullptr;                        // Graphics 的，材质纹理共用 sampler
+        ShaderModuleCache *shader_modules = nullptr;                  // Graphics 的，材质共用 shader module
+        std::shared_ptr<MipGenerator> mip_generator;                  // 材质纹理用 compute 生成 mip，GPU 不支持时为空，退回逐级 blit
+        std::unique_ptr<MeshCache> mesh_cache;                        // 模型的 mesh 按源文件共用，超出预算换出没有 Model 拿着的
+        std::shared_ptr<RetiredMeshes> retired_meshes;                // mesh_cache 换出去的，按缓冲句柄缓存了东西的在上面加 release listener
+        std::unique_ptr<TextureCache> texture_cache;                  // 同步加载的模型的纹理按文件、用途和 sampler 共用，超出预算换出没有 Model 拿着的
+        bool compressed_textures = false;                             // GPU 支持 BC 格式，材质纹理烘焙成块压缩的 KTX2 再上传
+        uint32_t render_view_limit = max_render_views;                // GPU 不支持 multiViewport 时是 1，多出来的 render_viewports 不画
+        bool virtual_texture_feedback = false;                        // 有 VirtualTextureSystem，材质的片元着色器要写反馈
         PipelineLayoutBuilder pipeline_layout_builder;
         PipelineBuilder pipeline_builder;
         SceneUBOTicker scene_ubo_ticker;
+        std::shared_ptr<IOcclusionCuller> occlusion_culler; // 只对 render_viewports[0] 生效，空表示不剔除
+        uint32_t culled_sub_mesh_count = 0;                 // 上一次 on_draw 剔除掉的 sub mesh 数
+        uint32_t draw_count = 0;                            // 上一次 on_draw 所有视口共用的 draw 数
+        bool depth_prepass = false;                         // 先只画深度，主pass里重的片元着色每个像素只跑一次
+        vk::SharedShaderModule depth_prepass_shader;
+        vk::SharedPipelineLayout depth_prepass_pipeline_layout;
+        vk::SharedPipeline depth_prepass_pipeline;
+        std::shared_ptr<VisibilityBufferDrawer> visibility_buffer; // 非空且 visible 时 render_viewports[0] 里它支持的 draw 走可见性缓冲
+        std::shared_ptr<ScreenSpaceOutlineDrawer> screen_space_outline; // 非空时选了屏幕空间描边的材质不画几何，最后铺上它的结果
         SceneDrawer(Graphics &graphics);
         void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
         void on_set_msaa(Graphics &graphics) override;
+        // eEqual 或 eLessOrEqual，要重建参与预pass的pipeline
+        void set_depth_prepass_compare_op(Graphics &graphics, vk::CompareOp compare_op);
+        // 按视口选 camera 的顶点着色器，只有一个视口时换成不写 gl_ViewportIndex 的 _single_view 变体。name 不带后缀，如 "res/shaders/star_rail"
+        std::string view_vertex_shader_path(std::string_view name) const;
+        // 采样材质纹理的片元着色器，没有虚拟纹理时换成不写反馈的 _no_feedback 变体
+        std::string material_fragment_shader_path(std::string_view name) const;
+
+    private:
+        // 所有视口共用一份剔除结果，[first_view, first_view + view_count) 的视口用 instance 一次画完
+        struct SceneDraw
+        {
+            uint32_t model_index;
+            uint32_t sub_mesh_index;
+            RenderMaterialData material_data;
+            uint32_t first_view;
+            uint32_t view_count;
+        };
+
+        std::vector<RenderMeshData> m_draw_meshes; // 每个 model 一个
+        std::shared_ptr<RetiredTextures> m_retired_textures; // texture_cache 换出去的
+        std::vector<SceneDraw> m_draws;
+
+        void create_depth_prepass_pipeline(Graphics &graphics);
+        void build_draw_list(uint32_t frame, bool visibility_mode);
+        void set_viewports(vk::CommandBuffer command_buffer);
+        void draw_depth_prepass(Graphics &graphics, vk::CommandBuffer command_buffer, DiffMeshBinder &mesh_binder);
     };
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <set>
+#include <vulkan/vulkan_shared.hpp>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/material.h"
+#include "jrenderer/image.h"
+#include "jrenderer/buffer.h"
+
+namespace jre
+{
+    class SceneDrawer;
+
+    // 屏幕空间描边，代替背面外扩的第二遍几何。主 render pass 之前：
+    // 1. 把 render_viewports[0] 的表面画一遍，只写深度、法线和描边材质 ID (0 表示不描边)
+    // 2. compute 每个像素固定采样一圈邻居，有轮廓、材质交界或者法线折痕就填上描边材质的颜色
+    // 主 render pass 里再用 draw_composite 按描边材质的混合比例铺上去。
+    // 只处理 RenderOutlineData::mode 是 ScreenSpace 的描边材质，只在单视口时生效，多视口时退回背面外扩；
+    // 一帧超过 max_outline_materials 的描边材质也退回背面外扩。
+    class ScreenSpaceOutlineDrawer : public CommandBufferRecordable
+    {
+    public:
+        static constexpr uint32_t max_outline_materials = 64; // 包括 0 号的不描边
+        static constexpr uint32_t group_size = 8;
+        float depth_threshold = 0.05f; // 邻居的线性深度远出这个比例算轮廓
+        float normal_threshold = 0.5f; // 法线夹角余弦小于它算折痕
+
+        // 上一次 on_draw 的统计
+        uint32_t outline_material_count = 0;
+        uint32_t draw_count = 0;
+
+        ScreenSpaceOutlineDrawer(Graphics &graphics, SceneDrawer &scene_drawer);
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+        void on_resize(Graphics &graphics) { create_resources(graphics); }
+        void on_set_msaa(Graphics &graphics) { create_composite_pipeline(graphics); }
+
+        // 在主 render pass 的 render_viewports[0] 里调用，这一帧没有屏幕空间描边时什么都不画
+        void draw_composite(vk::CommandBuffer command_buffer);
+        // 这一帧分到了描边材质 ID，SceneDrawer 不用再画它的背面外扩。要在这一帧的 on_draw 之后调用
+        bool handles(uint32_t model_index, uint32_t material_index, const RenderMaterialData &material_data) const;
+        // 材质选了屏幕空间描边，而且是单视口
+        bool supports(const RenderMaterialData &material_data) const;
+
+    private:
+        struct OutlineParams
+        {
+            glm::vec4 color;
+            glm::vec4 width; // x 有用
+        };
+
+        struct PushConstants
+        {
+            glm::uvec2 extent;
+            float depth_threshold;
+            float normal_threshold;
+        };
+
+        SceneDrawer &m_scene_drawer;
+        vk::SharedDevice m_device;
+        vk::SharedShaderModule m_gbuffer_vertex_shader;
+        vk::SharedShaderModule m_gbuffer_fragment_shader;
+        vk::SharedShaderModule m_edge_shader;
+        vk::SharedShaderModule m_composite_vertex_shader;
+        vk::SharedShaderModule m_composite_fragment_shader;
+        vk::SharedSampler m_sampler;
+
+        vk::SharedRenderPass m_render_pass;
+        vk::SharedPipelineLayout m_gbuffer_pipeline_layout;
+        vk::SharedPipeline m_gbuffer_pipeline;
+
+        vk::SharedDescriptorPool m_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_descriptor_set_layout;
+        std::vector<vk::SharedDescriptorSet> m_descriptor_sets; // 每个 cpu frame 一个
+        vk::SharedPipelineLayout m_edge_pipeline_layout;
+        vk::SharedPipeline m_edge_pipeline;
+
+        vk::SharedDescriptorPool m_composite_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_composite_descriptor_set_layout;
+        vk::SharedDescriptorSet m_composite_descriptor_set;
+        vk::SharedPipelineLayout m_composite_pipeline_layout;
+        vk::SharedPipeline m_composite_pipeline;
+
+        DeviceImage m_id_image;
+        DeviceImage m_normal_image;
+        DeviceImage m_depth_image;
+        DeviceImage m_outline_image;
+        vk::SharedFramebuffer m_framebuffer;
+        std::vector<HostArrayBuffer<OutlineParams>> m_params_buffers;
+        vk::Extent2D m_extent;
+        bool m_has_outline = false;
+        std::set<std::pair<uint32_t, uint32_t>> m_overflowed; // 这一帧分不到 ID 的 (模型, 材质)
+
+        void create_resources(Graphics &graphics);
+        void create_composite_pipeline(Graphics &graphics);
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/mesh.h"
+#include "jrenderer/buffer.h"
+#include "jrenderer/descriptor_update.hpp"
+
+namespace jre
+{
+    class SceneDrawer;
+
+    // 每帧在 render pass 之前用 compute 把每个 model 的顶点变换一次，写进一块临时 buffer，
+    // 基础 pass、描边 pass、深度预pass 的顶点着色器按 vertex_base + gl_VertexIndex 从 object set 读，不再各自变换。
+    // 写的是世界空间的位置和法线：多视口共用一份，观察空间的话每个视口都要一份。以后的蒙皮、morph 也放在这里做。
+    class VertexPretransformer : public CommandBufferRecordable
+    {
+    public:
+        static constexpr uint32_t group_size = 64; // 和 vertex_pretransform.comp 的 local_size_x 一致
+
+        // 上一次 on_draw 的统计
+        uint32_t vertex_count = 0;
+
+        VertexPretransformer(Graphics &graphics, SceneDrawer &scene_drawer);
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+
+    private:
+        struct PretransformedVertex
+        {
+            glm::vec4 position_ws;
+            glm::vec4 normal_ws;
+        };
+
+        struct PushConstants
+        {
+            glm::mat4 model;
+            uint32_t vertex_base; // 在输出 buffer 里的起始顶点
+            uint32_t vertex_count;
+            uint32_t vertex_stride; // 以下以 float 为单位
+            uint32_t position_offset;
+            uint32_t normal_offset;
+        };
+
+        SceneDrawer &m_scene_drawer;
+        vk::SharedDevice m_device;
+        vk::PhysicalDevice m_physical_device;
+        vk::SharedShaderModule m_shader;
+
+        vk::SharedDescriptorSetLayout m_source_descriptor_set_layout;
+        DescriptorUpdateTemplate<vk::DescriptorBufferInfo> m_source_update_template; // 每帧每个 mesh 都要更新一次
+        vk::SharedPipelineLayout m_pipeline_layout;
+        vk::SharedPipeline m_pipeline;
+
+        std::vector<DynamicBuffer> m_vertex_buffers; // 每个 cpu frame 一个，所有 model 按 vertex_base 分，写进 scene 的 object set
+        vk::DeviceSize m_capacity = 0;
+
+        void reserve(Graphics &graphics, vk::DeviceSize size);
+    };
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/material.h"
+#include "jrenderer/mesh.h"
+#include "jrenderer/image.h"
+#include "jrenderer/buffer.h"
+#include "jrenderer/descriptor_allocator.h"
+#include "jrenderer/descriptor_update.hpp"
+
+namespace jre
+{
+    class SceneDrawer;
+
+    // 可见性缓冲渲染。主 render pass 之前：
+    // 1. 把 render_viewports[0] 里支持的 draw 光栅化成每像素 64 位的 ID (三角形序号, draw 序号)，不跑材质
+    // 2. compute 按 8x8 tile 分类，每个 tile 追加到它里面出现过的 bin((材质管线, 网格) 组合)的列表
+    // 3. 每个 bin 一次 indirect dispatch，只在自己的 tile 上重建属性并跑材质着色，每个像素只着色一次
+    // 主 render pass 里再用 draw_composite 把着色结果和深度铺上去。
+    // 只处理 RenderPipeline 带 visibility_shader、索引是 uint32 的 draw，其它的(比如描边)照常前向画。
+    // 着色只有一个采样，MSAA 只对前向画的部分生效。只在单视口时生效，多视口时全部前向画。
+    class VisibilityBufferDrawer : public CommandBufferRecordable
+    {
+    public:
+        static constexpr uint32_t max_bins = 64; // 和 visibility_common.glsl 的 k_vis_max_bins 一致
+        static constexpr uint32_t tile_size = 8;
+        uint32_t max_draws = 4096;
+
+        // 上一次 on_draw 的统计
+        uint32_t draw_count = 0;
+        uint32_t bin_count = 0;
+        uint32_t culled_sub_mesh_count = 0;
+
+        VisibilityBufferDrawer(Graphics &graphics, SceneDrawer &scene_drawer);
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+        void on_resize(Graphics &graphics) { create_resources(graphics); }
+        void on_set_msaa(Graphics &graphics) { create_composite_pipeline(graphics); }
+
+        // 在主 render pass 的 render_viewports[0] 里调用
+        void draw_composite(vk::CommandBuffer command_buffer);
+        // 这一帧的 on_draw 已经画了 (或者剔除了) 它。超出 max_draws、max_bins 的不算，前向照常画
+        bool handles(uint32_t model_index, uint32_t material_index, const RenderMeshData &mesh_data, const RenderMaterialData &material_data) const;
+        // 管线和网格能走可见性缓冲
+        bool supports(const RenderMeshData &mesh_data, const RenderMaterialData &material_data) const;
+
+    private:
+        struct DrawRecord
+        {
+            glm::mat4 model;
+            uint32_t bin;
+            uint32_t vertex_offset;
+            uint32_t index_offset;
+            uint32_t material_id;
+        };
+
+        struct PushConstants
+        {
+            glm::uvec2 extent;
+            uint32_t tile_count_x;
+            uint32_t tile_capacity;
+            uint32_t bin;
+            uint32_t vertex_stride; // 以下以 float 为单位
+            uint32_t position_offset;
+            uint32_t normal_offset;
+            uint32_t tex_coord_offset;
+        };
+
+        struct Bin
+        {
+            RenderPipeline *render_pipeline;
+            vk::DescriptorSet geometry_descriptor_set;
+        };
+
+        // set_geometry 的内容，按 m_geometry_update_template 打包
+        struct GeometryDescriptors
+        {
+            vk::DescriptorBufferInfo vertexes;
+            vk::DescriptorBufferInfo indices;
+        };
+
+        struct ShadingPipeline
+        {
+            vk::SharedPipelineLayout pipeline_layout;
+            vk::SharedPipeline pipeline;
+        };
+
+        SceneDrawer &m_scene_drawer;
+        vk::SharedDevice m_device;
+        vk::SharedShaderModule m_id_vertex_shader;
+        vk::SharedShaderModule m_id_fragment_shader;
+        vk::SharedShaderModule m_classify_shader;
+        vk::SharedShaderModule m_composite_vertex_shader;
+        vk::SharedShaderModule m_composite_fragment_shader;
+        vk::SharedSampler m_sampler;
+
+        vk::SharedRenderPass m_render_pass;
+        vk::SharedPipelineLayout m_id_pipeline_layout;
+        vk::SharedPipeline m_id_pipeline;
+
+        vk::SharedDescriptorPool m_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_descriptor_set_layout;
+        std::vector<vk::SharedDescriptorSet> m_descriptor_sets; // 每个 cpu frame 一个
+        vk::SharedPipelineLayout m_classify_pipeline_layout;
+        vk::SharedPipeline m_classify_pipeline;
+
+        DescriptorAllocator *m_descriptor_allocator = nullptr;
+        vk::SharedDescriptorSetLayout m_geometry_descriptor_set_layout;
+        DescriptorUpdateTemplate<GeometryDescriptors> m_geometry_update_template;
+        std::map<std::tuple<vk::Buffer, vk::Buffer>, vk::SharedDescriptorSet> m_geometry_descriptor_sets;
+        // 着色 pipeline 只取决于 visibility shader 和它的常量，不按 RenderPipeline 的地址：冻结的变体放掉之后地址会被别的变体用上
+        std::map<std::tuple<vk::ShaderModule, std::map<uint32_t, bytes>>, ShadingPipeline> m_shading_pipelines;
+
+        vk::SharedDescriptorPool m_composite_descriptor_pool;
+        vk::SharedDescriptorSetLayout m_composite_descriptor_set_layout;
+        vk::SharedDescriptorSet m_composite_descriptor_set;
+        vk::SharedPipelineLayout m_composite_pipeline_layout;
+        vk::SharedPipeline m_composite_pipeline;
+
+        DeviceImage m_id_image;
+        DeviceImage m_depth_image;
+        DeviceImage m_shaded_image;
+        vk::SharedFramebuffer m_framebuffer;
+        DynamicBuffer m_bin_args;  // 每个 bin 一个 vk::DispatchIndirectCommand
+        DynamicBuffer m_bin_tiles; // 每个 bin 一段 tile 列表
+        std::vector<HostArrayBuffer<DrawRecord>> m_draw_buffers;
+        std::vector<vk::DispatchIndirectCommand> m_bin_args_reset;
+        vk::Extent2D m_extent;
+        uint32_t m_tile_count_x = 0;
+        uint32_t m_tile_count_y = 0;
+
+        std::vector<Bin> m_bins;
+        std::set<std::pair<uint32_t, uint32_t>> m_overflowed; // 这一帧放不下的 (模型, 材质)
+        std::map<std::tuple<RenderPipeline *, vk::Buffer>, uint32_t> m_bin_indices; // 材质参数按 DrawRecord 里的材质 ID 取，同管线同网格的材质合成一个 bin
+
+        void create_resources(Graphics &graphics);
+        void create_composite_pipeline(Graphics &graphics);
+        vk::DescriptorSet get_geometry_descriptor_set(const RenderMeshData &mesh_data);
+        const ShadingPipeline &get_shading_pipeline(RenderPipeline *render_pipeline);
+        uint32_t get_bin(const RenderMeshData &mesh_data, const RenderMaterialData &material_data);
+    };
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <gsl/pointers>
 #include <vulkan/vulkan_shared.hpp>
+#include "jrenderer/descriptor_allocator.h"
 
 namespace jre
 {
@@ -14,6 +15,7 @@ namespace jre
         vk::SharedSemaphore render_finished_semaphore;
         vk::SharedFence in_flight_fence;
         vk::SharedCommandBuffer command_buffer;
+        DescriptorAllocator transient_descriptors; // 这一帧临时分配的 set，等到这一帧的 fence 之后整个 reset
     };
 
 }
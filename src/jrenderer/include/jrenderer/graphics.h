@@ -12,6 +12,9 @@
 #include "jrenderer/texture.h"
 #include "jrenderer/descriptor_transform.h"
 #include "jrenderer/pipeline.h"
+#include "jrenderer/descriptor_allocator.h"
+#include "jrenderer/sampler_cache.h"
+#include "jrenderer/shader_module_cache.h"
 #include <vulkan/vulkan_raii.hpp>
 #include <vulkan/vulkan_shared.hpp>
 #include <any>
@@ -66,6 +69,9 @@ namespace jre
         vk::SharedInstance &instance() noexcept { return m_instance; }
         vk::PhysicalDevice &physical_device() noexcept { return m_physical_device; }
         const PhysicalDeviceInfo &physical_device_info() noexcept { return m_physical_device_info; }
+        bool sparse_residency() const noexcept { return m_sparse_residency; } // 能用 VirtualTextureSystem
+        bool geometry_shader() const noexcept { return m_geometry_shader; }   // 片元着色器能读 gl_PrimitiveID，能用 VisibilityBufferDrawer
+        bool multi_viewport() const noexcept { return m_multi_viewport; }     // 一次 draw 能画到多个视口，否则 SceneDrawer 只画主视口
         vk::SharedDevice &logical_device() noexcept { return m_logical_device; }
         vk::SharedQueue &graphics_queue() noexcept { return m_graphics_queue; }
         vk::SharedQueue &present_queue() noexcept { return m_present_queue; }
@@ -82,7 +88,16 @@ namespace jre
         std::vector<vk::SharedFramebuffer> &framebuffers() noexcept { return m_framebuffers; }
         std::vector<CPUFrame> &cpu_frames() noexcept { return m_cpu_frames; }
         uint32_t current_cpu_frame() noexcept { return static_cast<uint32_t>(std::distance(m_cpu_frames.begin(), m_current_cpu_frame)); }
+        uint32_t recording_cpu_frame() const noexcept { return m_recording_cpu_frame; } // 正在录制的cpu frame，它的fence已经等待过了，它上一次提交的结果可以安全读取
+        uint32_t current_frame_buffer_index() const noexcept { return m_current_frame_buffer_index; }
+        std::list<DeviceImage> &depth_images() noexcept { return m_depth_images; }
+        DeviceImage &depth_image(uint32_t frame_buffer_index) { return *std::next(m_depth_images.begin(), frame_buffer_index); }
         ModelTransformFactory &model_transform_manager() noexcept { return m_model_transform_manager; }
+        DescriptorSetLayoutCache &descriptor_set_layouts() noexcept { return m_descriptor_set_layouts; }
+        DescriptorAllocator &descriptor_allocator() noexcept { return m_descriptor_allocator; }                                                  // 常驻的 set
+        SamplerCache &sampler_cache() noexcept { return m_sampler_cache; }
+        ShaderModuleCache &shader_modules() noexcept { return *m_shader_modules; }
+        DescriptorAllocator &transient_descriptor_allocator() noexcept { return m_cpu_frames[m_recording_cpu_frame].transient_descriptors; } // 只在正在录制的这一帧有效
         const GraphicsSettings &settings() const noexcept { return m_settings; }
         std::vector<std::vector<std::vector<std::shared_ptr<CommandBufferRecordable>>>> &render_pass_renderers() noexcept { return m_render_pass_renderers; }
         RenderPassDrawers &render_pass_drawer() noexcept { return m_render_pass_drawer; }
@@ -118,6 +133,9 @@ namespace jre
         vk::SharedQueue m_graphics_queue;
         vk::SharedQueue m_present_queue;
         vk::SharedQueue m_transfer_queue;
+        bool m_sparse_residency = false;
+        bool m_geometry_shader = false;
+        bool m_multi_viewport = false;
 
         vk::SharedSwapchainKHR m_swapchain;
         vk::Extent2D m_swapchain_extent;
@@ -132,11 +150,16 @@ namespace jre
 
         std::vector<vk::SharedFramebuffer> m_framebuffers;
         uint32_t m_current_frame_buffer_index = 0;
+        uint32_t m_recording_cpu_frame = 0;
         std::vector<vk::ClearValue> m_clear_values;
         std::vector<CPUFrame> m_cpu_frames;
         std::vector<CPUFrame>::iterator m_current_cpu_frame;
 
         ModelTransformFactory m_model_transform_manager;
+        DescriptorSetLayoutCache m_descriptor_set_layouts;
+        DescriptorAllocator m_descriptor_allocator;
+        SamplerCache m_sampler_cache;
+        std::unique_ptr<ShaderModuleCache> m_shader_modules;
 
         RenderPassDrawers m_render_pass_drawer;
         std::vector<std::vector<std::vector<std::shared_ptr<CommandBufferRecordable>>>> m_render_pass_renderers;
@@ -157,5 +180,7 @@ namespace jre
 
     public:
         std::list<ResizeFunc> resize_funcs;
+        std::vector<std::shared_ptr<CommandBufferRecordable>> pre_render_pass_recorders;  // render pass开始前录制，比如可见性缓冲的pass
+        std::vector<std::shared_ptr<CommandBufferRecordable>> post_render_pass_recorders; // render pass结束后录制，比如读取深度的compute pass
     };
 }
\ No newline at end of file
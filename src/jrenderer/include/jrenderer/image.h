@@ -5,6 +5,7 @@
 #include <gsl/pointers>
 #include <optional>
 #include <variant>
+#include "jrenderer/sampler_cache.h"
 
 namespace jre
 {
@@ -44,7 +45,8 @@ namespace jre
         vk::SharedImage image;
         vk::SharedDeviceMemory memory;
         vk::SharedImageView image_view;
-        vk::SharedSampler sampler;
+        vk::SharedSampler sampler; // 从 SamplerCache 拿的话和别的纹理共享
+        uint32_t bindless_index = ~0u; // 在 BindlessTextureTable 里的序号，没注册是 ~0u
 
         operator vk::DescriptorImageInfo()
         {
@@ -62,6 +64,7 @@ namespace jre
         vk::ImageViewCreateInfo image_view_create_info;
         vk::MemoryPropertyFlagBits memory_properties;
         std::optional<vk::SamplerCreateInfo> sampler_create_info;
+        SamplerCache *sampler_cache = nullptr; // 空的话每个 image 自己建一个 sampler
 
         DeviceImageBuilder(vk::SharedDevice device, vk::PhysicalDevice physical_device)
             : image_builder(device), physical_device(physical_device) {}
@@ -90,6 +93,12 @@ namespace jre
             return *this;
         }
 
+        DeviceImageBuilder &set_sampler_cache(SamplerCache *sampler_cache_)
+        {
+            sampler_cache = sampler_cache_;
+            return *this;
+        }
+
         DeviceImageBuilder &set_usage(vk::ImageUsageFlags usage)
         {
             image_builder.image_create_info.usage = usage;
@@ -3,8 +3,11 @@
 #include "jrenderer/texture.h"
 #include "jrenderer/concrete_uniform_buffers.h"
 #include "jrenderer/pipeline.h"
+#include "jrenderer/descriptor_allocator.h"
+#include "jrenderer/shader_module_cache.h"
 #include "jrenderer/utils/diff_trigger.hpp"
 #include <any>
+#include <optional>
 
 namespace jre
 {
@@ -14,16 +17,34 @@ namespace jre
     public:
         SharedRenderPipeline render_pipeline;
         vk::SharedDescriptorSetLayout descriptor_set_layout;
-        vk::SharedDescriptorPool descriptor_pool;
+        DescriptorAllocator *descriptor_allocator = nullptr; // 有材质自己的 set 时，create_instance 从这里分
 
         MaterialInstance create_instance(uint32_t frame_count = 1);
     };
 
+    enum class OutlineMode
+    {
+        InvertedHull, // 背面外扩再画一遍几何
+        ScreenSpace,  // ScreenSpaceOutlineDrawer 按深度、法线、材质 ID 找边，每像素固定开销，不画几何
+    };
+
+    // 描边材质才有，同一个 model 里和它对应同一个 sub mesh 的材质就是被描边的表面
+    struct RenderOutlineData
+    {
+        OutlineMode mode;
+        glm::vec4 color; // rgb 描边颜色，a 是和原色混合的比例
+        float width;     // 观察空间的长度，和背面外扩的一致
+    };
+
     struct RenderMaterialData
     {
         vk::Pipeline pipeline;
         vk::PipelineLayout pipeline_layout;
-        vk::DescriptorSet descriptor_set;
+        vk::DescriptorSet descriptor_set; // 材质自己的 set，空表示数据都在 set_bindless 里
+        vk::Pipeline prepassed_pipeline; // 深度预pass打开时用，空表示这个材质不参与预pass
+        RenderPipeline *render_pipeline = nullptr;
+        uint32_t material_id = 0; // BindlessTextureTable 里的材质 ID，用 push constant 传给着色器
+        std::optional<RenderOutlineData> outline;
     };
 
     class IMaterialInstance
@@ -32,7 +53,10 @@ namespace jre
         virtual ~IMaterialInstance() = default;
         virtual RenderMaterialData get_render_data(uint32_t cur_frame) = 0;
         const RenderMaterialData get_render_data(uint32_t cur_frame) const { return const_cast<IMaterialInstance *>(this)->get_render_data(cur_frame); }
-        virtual void update_descriptor_set_data(uint32_t cur_frame) = 0;
+        // 用到 placeholder 的地方换成 texture (按 image view 比较)，异步加载的纹理好了之后调用。默认没有可换的
+        virtual void replace_texture(const Texture &placeholder, const Texture &texture) {}
+        // 用到的纹理，纹理流送按它们所在的 sub mesh 估计要多清楚
+        virtual std::vector<Texture> get_textures() { return {}; }
     };
 
     class MaterialInstance : public IMaterialInstance
@@ -42,13 +66,14 @@ namespace jre
         std::vector<vk::SharedDescriptorSet> descriptor_sets;
 
         MaterialInstance(Material material, std::vector<vk::SharedDescriptorSet> descriptor_sets) : material(material), descriptor_sets(descriptor_sets) {}
-        void update_descriptor_set_data(uint32_t) override {}
         RenderMaterialData get_render_data(uint32_t cur_frame) override
         {
             return {
                 material.render_pipeline->pipeline.get(),
                 material.render_pipeline->pipeline_layout.get(),
-                descriptor_sets[cur_frame].get()};
+                descriptor_sets.empty() ? vk::DescriptorSet{} : descriptor_sets[cur_frame].get(),
+                material.render_pipeline->prepassed_pipeline.get(),
+                material.render_pipeline.get()};
         }
     };
 
@@ -69,11 +94,14 @@ namespace jre
         vk::PhysicalDevice physical_device;
         vk::CommandBuffer command_buffer;
         vk::Queue transfer_queue;
-        std::vector<vk::DescriptorSetLayoutBinding> bindings;
-        uint32_t descriptor_set_count = 100;
+        std::vector<vk::DescriptorSetLayoutBinding> bindings; // 空表示没有材质自己的 set
+        DescriptorSetLayoutCache *descriptor_set_layouts = nullptr; // bindings 不空时要设置，一般是 Graphics 的
+        DescriptorAllocator *descriptor_allocator = nullptr;
+        bool depth_prepass = false;
         ShaderCreateInfo vertex_shader_info;
         ShaderCreateInfo fragment_shader_info;
-        std::unordered_map<std::string, vk::SharedShaderModule> *shader_cache;
+        ShaderCreateInfo visibility_shader_info; // 可选，可见性缓冲模式下的着色 compute shader
+        ShaderModuleCache *shader_cache = nullptr; // 空的话每次都从文件建
 
         MaterialBuilder(RenderPipelineResources &render_pipeline_resources,
                         PipelineLayoutBuilder pipeline_layout_builder,
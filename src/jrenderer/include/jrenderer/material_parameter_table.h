@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <cstring>
+#include <span>
+#include <vector>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/buffer.h"
+
+namespace jre
+{
+    // 所有材质的参数放在一块 device local 的 SSBO 里，按材质 ID 索引，每条记录固定 record_size 字节。
+    // CPU 上留一份副本，set 时内容变了才标脏；on_draw 在 render pass 之前只把脏的记录用 vkCmdUpdateBuffer 传上去，
+    // 没有改动的帧什么都不录制。着色器那边每种材质声明自己的结构体，补齐到 record_size。
+    class MaterialParameterTable : public CommandBufferRecordable
+    {
+    public:
+        static constexpr uint32_t record_size = 256;
+
+        // 上一次 on_draw 的统计
+        uint32_t uploaded_count = 0;
+
+        MaterialParameterTable(vk::SharedDevice device, vk::PhysicalDevice physical_device, uint32_t max_records);
+
+        void set(uint32_t material_id, std::span<const std::byte> record);
+        template <typename T>
+        void set(uint32_t material_id, const T &record)
+        {
+            static_assert(sizeof(T) == record_size);
+            set(material_id, std::as_bytes(std::span(&record, 1)));
+        }
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+
+        vk::Buffer vk_buffer() const { return m_buffer.vk_buffer(); }
+        uint32_t dirty_count() const { return static_cast<uint32_t>(m_dirty_ids.size()); }
+
+    private:
+        DynamicBuffer m_buffer;
+        std::vector<std::byte> m_records; // 和 m_buffer 一样的布局
+        std::vector<bool> m_dirty;
+        std::vector<bool> m_uploaded; // 没传过的记录即使内容是 0 也要传
+        std::vector<uint32_t> m_dirty_ids;
+    };
+}
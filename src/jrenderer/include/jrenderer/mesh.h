@@ -7,6 +7,7 @@
 #include <glm/gtx/hash.hpp>
 #include <tiny_obj_loader.h>
 #include <ranges>
+#include <limits>
 
 namespace jre
 {
@@ -50,11 +51,36 @@ namespace jre
         };
     }
 
+    // 轴对齐包围盒，模型空间。默认是空盒(min > max)，空盒视为总是可见
+    struct BoundingBox
+    {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+        bool empty() const { return glm::any(glm::greaterThan(min, max)); }
+        void expand(const glm::vec3 &point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+        glm::vec3 corner(uint32_t i) const { return {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z}; }
+    };
+
+    // 遮挡体，模型空间的简化三角形，只给软件光栅化遮挡剔除用
+    struct OccluderMesh
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+    };
+
     struct RenderSubMeshData
     {
         uint32_t vertex_offset;
         uint32_t index_offset;
         uint32_t index_count;
+        BoundingBox bounds;
+        std::shared_ptr<const OccluderMesh> occluder;
+        float uv_extent = 1.0f; // uv 包围盒的长边，纹理流送按它估计这段网格在纹理上占多大
     };
 
     struct RenderMeshData
@@ -63,6 +89,7 @@ namespace jre
         vk::Buffer index_buffer;
         vk::IndexType index_type;
         std::vector<RenderSubMeshData> sub_meshes;
+        uint32_t vertex_count = 0;
     };
 
     class IMesh
@@ -86,10 +113,14 @@ namespace jre
         uint32_t vertex_offset;
         uint32_t index_offset;
         uint32_t index_count;
+        BoundingBox bounds;
+        std::shared_ptr<const OccluderMesh> occluder;
+        float uv_extent;
 
-        SubMesh(uint32_t vertex_offset, uint32_t index_offset, uint32_t index_count) : vertex_offset(vertex_offset), index_offset(index_offset), index_count(index_count) {}
+        SubMesh(uint32_t vertex_offset, uint32_t index_offset, uint32_t index_count, BoundingBox bounds = {}, std::shared_ptr<const OccluderMesh> occluder = nullptr, float uv_extent = 1.0f)
+            : vertex_offset(vertex_offset), index_offset(index_offset), index_count(index_count), bounds(bounds), occluder(occluder), uv_extent(uv_extent) {}
 
-        RenderSubMeshData get_render_data() override { return {vertex_offset, index_offset, index_count}; }
+        RenderSubMeshData get_render_data() override { return {vertex_offset, index_offset, index_count, bounds, occluder, uv_extent}; }
     };
 
     class Mesh : public IMesh
@@ -99,6 +130,7 @@ namespace jre
         DynamicBuffer index_buffer;
         vk::IndexType index_type;
         std::vector<SubMesh> sub_meshes;
+        uint32_t vertex_count = 0;
 
         RenderMeshData get_render_data() override
         {
@@ -106,6 +138,7 @@ namespace jre
             mesh_data.vertexes = {vertex_buffer.buffer().get()};
             mesh_data.index_buffer = index_buffer.buffer().get();
             mesh_data.index_type = index_type;
+            mesh_data.vertex_count = vertex_count;
             mesh_data.sub_meshes = sub_meshes |
                                    std::views::transform([](SubMesh &sub_mesh)
                                                          { return sub_mesh.get_render_data(); }) |
@@ -116,12 +149,21 @@ namespace jre
     private:
     };
 
+    // 给 Resources 算预算用
+    inline size_t resource_bytes(const Mesh &mesh)
+    {
+        return mesh.vertex_buffer.size() + mesh.index_buffer.size();
+    }
+
+    class JMeshFile;
+
     template <typename VertexType, typename IndexType>
     class DeviceMeshBuilder
     {
     public:
         DeviceArrayBufferBuilder<VertexType> vertex_buffer_builder;
         DeviceArrayBufferBuilder<IndexType> index_buffer_builder;
+        uint32_t vertex_count;
         DeviceMeshBuilder(vk::SharedDevice device,
                           vk::PhysicalDevice physical_device,
                           vk::CommandBuffer command_buffer,
@@ -129,18 +171,56 @@ namespace jre
                           vk::ArrayProxyNoTemporaries<VertexType> vertex_data,
                           vk::ArrayProxyNoTemporaries<IndexType> index_data)
             : vertex_buffer_builder(device, physical_device, command_buffer, transfer_queue, vertex_data),
-              index_buffer_builder(device, physical_device, command_buffer, transfer_queue, index_data)
+              index_buffer_builder(device, physical_device, command_buffer, transfer_queue, index_data),
+              vertex_count(vertex_data.size())
         {
-            vertex_buffer_builder.set_usage(vk::BufferUsageFlagBits::eVertexBuffer);
-            index_buffer_builder.set_usage(vk::BufferUsageFlagBits::eIndexBuffer);
+            // 顶点预变换和可见性缓冲的着色 pass 要在 compute 里读顶点
+            vertex_buffer_builder.set_usage(vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+            index_buffer_builder.set_usage(vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
         }
 
+        // 顶点和索引在 build/record 的时候由 write_vertices/write_indices 直接写进 staging，见 DeviceArrayBuffer::Builder
+        DeviceMeshBuilder(vk::SharedDevice device,
+                          vk::PhysicalDevice physical_device,
+                          vk::CommandBuffer command_buffer,
+                          vk::Queue transfer_queue,
+                          uint32_t vertex_count,
+                          std::function<void(VertexType *)> write_vertices,
+                          uint32_t index_count,
+                          std::function<void(IndexType *)> write_indices)
+            : vertex_buffer_builder(device, physical_device, command_buffer, transfer_queue, vertex_count, std::move(write_vertices)),
+              index_buffer_builder(device, physical_device, command_buffer, transfer_queue, index_count, std::move(write_indices)),
+              vertex_count(vertex_count)
+        {
+            vertex_buffer_builder.set_usage(vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+            index_buffer_builder.set_usage(vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+        }
+
+        // 从烘焙好的 .jmesh 建，顶点和索引从映射的文件直接拷进 staging。定义在 jmesh_file.h
+        DeviceMeshBuilder(vk::SharedDevice device,
+                          vk::PhysicalDevice physical_device,
+                          vk::CommandBuffer command_buffer,
+                          vk::Queue transfer_queue,
+                          std::shared_ptr<const JMeshFile> file);
+
         Mesh build()
         {
             Mesh mesh;
             mesh.vertex_buffer = vertex_buffer_builder.build();
             mesh.index_buffer = index_buffer_builder.build();
             mesh.index_type = vk::IndexTypeValue<IndexType>::value;
+            mesh.vertex_count = vertex_count;
+            return mesh;
+        }
+
+        // 见 DeviceLocalDynamicBufferBuilder::record，画之前要有 transfer 到顶点/索引读取的 barrier
+        Mesh record(vk::CommandBuffer recording_command_buffer, std::vector<DynamicBuffer> &staging_buffers)
+        {
+            Mesh mesh;
+            mesh.vertex_buffer = vertex_buffer_builder.record(recording_command_buffer, staging_buffers);
+            mesh.index_buffer = index_buffer_builder.record(recording_command_buffer, staging_buffers);
+            mesh.index_type = vk::IndexTypeValue<IndexType>::value;
+            mesh.vertex_count = vertex_count;
             return mesh;
         }
     };
@@ -159,6 +239,7 @@ namespace jre
             mesh_data.vertexes = {vertex_buffer.vk_buffer()};
             mesh_data.index_buffer = index_buffer.vk_buffer();
             mesh_data.index_type = vk::IndexTypeValue<IndexType>::value;
+            mesh_data.vertex_count = vertex_buffer.count();
             mesh_data.sub_meshes = sub_meshes |
                                    std::views::transform([](SubMesh &sub_mesh)
                                                          { return sub_mesh.get_render_data(); }) |
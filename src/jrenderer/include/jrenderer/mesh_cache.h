@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include "jrenderer/mesh.h"
+#include "jrenderer/resources.hpp"
+#include "jrenderer/retired_resources.hpp"
+
+namespace jre
+{
+    using RetiredMeshes = RetiredResources<std::shared_ptr<Mesh>>;
+
+    struct MeshCreator
+    {
+        std::shared_ptr<RetiredMeshes> retired;
+
+        void retire(const std::shared_ptr<Mesh> &mesh) const;
+    };
+
+    // 场景级的 mesh 缓存，按源文件的路径，多次加载同一个模型共用顶点和索引缓冲。字节数按两个缓冲的大小算。
+    // 建 mesh 要录进调用方的 command buffer，不走 get_or_create：先 find，没有就建好再 insert。
+    // 只换出没有 Model 拿着的，换出去的交给 RetiredMeshes，按缓冲句柄缓存了东西的要在它上面加 release listener
+    using MeshCache = Resources<std::string, std::shared_ptr<Mesh>, MeshCreator, cappuccino::thread_safe::yes>;
+}
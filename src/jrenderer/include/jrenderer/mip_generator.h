@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <array>
+#include <glm/glm.hpp>
+#include "jrenderer/buffer.h"
+#include "jrenderer/descriptor_allocator.h"
+#include "jrenderer/descriptor_update.hpp"
+
+namespace jre
+{
+    class Graphics;
+
+    // 用 compute 一次 dispatch 生成整条 mip 链 (mip_generate.comp)，代替逐级 blit，每张纹理前后各一个 barrier。
+    // record 只录命令，很多纹理可以录进同一个 command buffer 一次提交，见 TextureUploadBatch。
+    // 每张纹理的 mip view、descriptor set、计数器都要留到提交完成，所以每个 cpu frame 一份，另有一份给自己提交、等完的批次 (synchronous)。
+    // 那一帧的 fence 等过、或者同步提交等完之后调 reset(frame) 回收。同一时间一份只给一个 command buffer 用
+    class MipGenerator
+    {
+    public:
+        static constexpr uint32_t max_levels = 13;         // 和 mip_generate.comp 的 k_max_levels 一致，边长最大 4096
+        static constexpr uint32_t max_batch_images = 1024; // 一份两次 reset 之间最多录几张
+        static constexpr uint32_t synchronous = ~0u;        // 不跟着 cpu frame 提交的批次
+
+        MipGenerator(Graphics &graphics);
+
+        // image 的格式是 eR8G8B8A8Unorm，带 eStorage。调用前 mip 0 是 eTransferDstOptimal，之后所有层是 eShaderReadOnlyOptimal。
+        // srgb：内容是 sRGB 编码的颜色，转到线性空间再平均
+        // frame：command_buffer 跟着哪个 cpu frame 提交，或者 synchronous
+        // mip_levels 至少是 2，只有一级的不用生成
+        void record(vk::CommandBuffer command_buffer, uint32_t frame, vk::Image image, vk::Extent2D extent, uint32_t mip_levels, bool srgb);
+        void reset(uint32_t frame);
+
+        uint32_t pending_count(uint32_t frame) const { return m_frames[frame_slot(frame)].pending_count; }
+
+    private:
+        struct PushConstants
+        {
+            glm::ivec2 extent;
+            uint32_t mip_count;
+            uint32_t srgb;
+            uint32_t counter_index;
+            uint32_t workgroup_count;
+        };
+
+        struct Descriptors
+        {
+            std::array<vk::DescriptorImageInfo, max_levels> mips;
+            vk::DescriptorBufferInfo counters;
+        };
+
+        struct FrameState
+        {
+            DescriptorAllocator descriptors; // 临时的，reset 一起回收
+            std::vector<vk::SharedImageView> views;
+            uint32_t pending_count = 0;
+        };
+
+        vk::SharedDevice m_device;
+        vk::SharedShaderModule m_shader;
+        vk::SharedDescriptorSetLayout m_descriptor_set_layout;
+        DescriptorUpdateTemplate<Descriptors> m_update_template;
+        vk::SharedPipelineLayout m_pipeline_layout;
+        vk::SharedPipeline m_pipeline;
+        DynamicBuffer m_counter_buffer; // 每份 max_batch_images 个计数器
+        std::vector<FrameState> m_frames; // 按 cpu frame，最后一份是 synchronous 的
+
+        uint32_t frame_slot(uint32_t frame) const { return frame == synchronous ? static_cast<uint32_t>(m_frames.size() - 1) : frame; }
+    };
+}
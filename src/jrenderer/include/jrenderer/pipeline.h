@@ -5,6 +5,9 @@
 #include <vector>
 #include <variant>
 #include <ranges>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include "jrenderer/mesh.h"
 #include "jrenderer/specilization_constant.hpp"
 
@@ -254,6 +257,38 @@ namespace jre
         vk::SharedPipeline build();
     };
 
+    class ComputePipelineBuilder
+    {
+    public:
+        vk::SharedDevice device;
+        vk::PipelineLayout pipeline_layout;
+        vk::PipelineCache cache;
+        vk::ShaderModule shader;
+        SpecializationConstants specialization;
+        std::string entry = "main";
+
+        ComputePipelineBuilder(vk::SharedDevice device,
+                               vk::PipelineLayout pipeline_layout,
+                               vk::PipelineCache cache = {})
+            : device(device),
+              pipeline_layout(pipeline_layout),
+              cache(cache)
+        {
+        }
+
+        ComputePipelineBuilder &set_shader(vk::ShaderModule module,
+                                           const SpecializationConstants &specialization_ = {},
+                                           const std::string &entry_ = "main")
+        {
+            shader = module;
+            specialization = specialization_;
+            entry = entry_;
+            return *this;
+        }
+
+        vk::SharedPipeline build();
+    };
+
     class RenderPipeline
     {
     public:
@@ -261,10 +296,27 @@ namespace jre
         vk::SharedPipelineLayout pipeline_layout;
         vk::SharedShaderModule vertex_shader;
         vk::SharedShaderModule fragment_shader;
+        SpecializationConstants vertex_constants; // 建 pipeline 时的特化常量，特化变体在它们上面追加
+        SpecializationConstants fragment_constants;
         PipelineBuilder pipeline_builder;
+        bool depth_prepass = false;                                  // 参与深度预pass，会多建一个不写深度的变体
+        vk::CompareOp prepass_compare_op = vk::CompareOp::eLessOrEqual; // 预pass之后主pass用的比较
+        vk::SharedPipeline prepassed_pipeline;
+        vk::SharedShaderModule visibility_shader;               // 可见性缓冲模式下按材质着色的 compute shader，空表示只能前向画
+        SpecializationConstants visibility_constants;
+        vk::SharedDescriptorSetLayout material_descriptor_set_layout; // 可见性缓冲的着色 pipeline 要用同一个材质 set
+        std::unordered_map<size_t, std::shared_ptr<RenderPipeline>> specialized_variants; // 在这个 pipeline 上追加常量编的变体，key 是常量的 hash
         void recreate_pipeline()
         {
             pipeline = pipeline_builder.build();
+            if (depth_prepass)
+            {
+                PipelineBuilder prepassed_builder = pipeline_builder;
+                prepassed_builder.depth_stencil
+                    .setDepthCompareOp(prepass_compare_op)
+                    .setDepthWriteEnable(false);
+                prepassed_pipeline = prepassed_builder.build();
+            }
         }
     };
 
@@ -284,5 +336,19 @@ namespace jre
     public:
         std::hash<PipelineHashInfo> hasher;
         std::unordered_map<size_t, SharedRenderPipeline> pipelines;
+
+        // 在 base 的常量上追加 constants (每个 stage 都加，shader 里没有的 ID 不起作用) 编一个特化变体。
+        // 同一个组合只编一次，变体挂在 base 的 specialized_variants 上，调用方拿着就一直活着
+        SharedRenderPipeline get_or_create_specialized(const SharedRenderPipeline &base, const SpecializationConstants &constants);
+        // 这个 cpu frame 的 fence 等过之后调：放掉它上次摘下的变体，再把没有实例拿着的变体从 base 上摘下来记在它上面
+        void begin_frame(uint32_t frame);
+        // 调用方等过 GPU 空闲之后用：update 改了 builder 返回 true 的 base 连同还在用的变体一起重建，没人用的变体直接扔掉
+        void recreate_pipelines(const std::function<bool(RenderPipeline &)> &update);
+        // recreate_pipelines 一次加一。之前照着旧设置在别处编好、还没放进 pipelines 的就不能用了
+        uint32_t generation() const { return m_generation; }
+
+    private:
+        std::vector<std::vector<SharedRenderPipeline>> m_retired_variants;
+        uint32_t m_generation = 0;
     };
 }
\ No newline at end of file
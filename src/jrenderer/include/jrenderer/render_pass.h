@@ -19,7 +19,7 @@ namespace jre
         RenderPassBuilder(vk::SharedDevice device) : device(device) {}
         vk::AttachmentReference add_attachment(vk::AttachmentDescription attachment, vk::ImageLayout ref_layout);
         vk::AttachmentReference add_color_attachment(vk::Format format, vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1);
-        vk::AttachmentReference add_depth_attachment(vk::Format format, vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1);
+        vk::AttachmentReference add_depth_attachment(vk::Format format, vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1, vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eDontCare);
         vk::AttachmentReference add_resolve_attachment(vk::Format format, vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1);
 
         RenderPassBuilder &add_dependency(vk::SubpassDependency dependency)
@@ -1,52 +1,287 @@
 #pragma once
 
+#include <future>
+#include <limits>
+#include <list>
 #include <memory>
+#include <optional>
+#include <type_traits>
 #include <unordered_map>
 #include <mutex>
 #include <cappuccino/lock.hpp>
 
 namespace jre
 {
-    template <typename Key, typename Value, typename ValueCreator, cappuccino::thread_safe ThreadSafe = cappuccino::thread_safe::no>
+    // 创建函数可以直接返回资源，也可以连同它占的字节数一起返回 (比如只有创建时才知道大小的 shader module)
+    template <typename Value>
+    struct SizedResource
+    {
+        Value value;
+        size_t bytes;
+    };
+
+    template <typename T>
+    size_t resource_bytes(const std::shared_ptr<T> &value)
+    {
+        return value ? resource_bytes(*value) : 0;
+    }
+
+    // 资源占多少字节、除了缓存还有没有别人拿着。
+    // 字节数默认用 resource_bytes 重载 (和资源类型放在一起)；有 use_count 的按引用计数，没有的 (vk::SharedHandle) 当作没人拿着，
+    // 换出去只是缓存不再拿着，别人手里的照样能用
+    template <typename Value>
+    struct ResourceTraits
+    {
+        static size_t bytes(const Value &value) { return resource_bytes(value); }
+        static bool referenced(const Value &value)
+        {
+            if constexpr (requires { value.use_count(); })
+            {
+                return value.use_count() > 1;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    };
+
+    struct ResourceStats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;      // 调用了创建函数
+        uint64_t waits = 0;       // 别的线程正在创建同一个，等它
+        uint64_t evictions = 0;
+        size_t count = 0;
+        size_t bytes = 0;
+        size_t budget_bytes = 0;
+
+        float hit_rate() const { return hits + misses + waits == 0 ? 0.0f : static_cast<float>(hits + waits) / static_cast<float>(hits + misses + waits); }
+    };
+
+    // 按 key 缓存资源，同一个 key 只创建一次。
+    // 加起来超过 budget_bytes 时按最近最少使用换出没被别人拿着的；都被拿着就暂时超出预算。
+    // ThreadSafe 的时候可以多个线程同时 get_or_create：创建函数在锁外面跑，不挡别的 key；
+    // 同一个 key 正在创建时后来的线程等它的结果，不会重复创建。创建函数抛出的异常传给所有等着的线程，这个 key 不留在缓存里。
+    // 创建函数里不能再 get_or_create 同一个 key。
+    // 创建函数有 retire(const Value &) 的话，换出去、erase 掉的值先交给它 (在锁里调用)，比如等在飞的帧用完再释放
+    template <typename Key, typename Value, typename ValueCreator, cappuccino::thread_safe ThreadSafe = cappuccino::thread_safe::no, typename Hash = std::hash<Key>>
     class Resources
     {
     public:
-        Resources(const ValueCreator &value_loader = ValueCreator()) : m_value_loader(value_loader) {}
+        Resources(const ValueCreator &value_loader = ValueCreator(), size_t budget_bytes = std::numeric_limits<size_t>::max())
+            : m_value_loader(value_loader), m_budget_bytes(budget_bytes) {}
+
+        Resources(const Resources &) = delete;
+        Resources &operator=(const Resources &) = delete;
 
         bool contains(const Key &key)
         {
             std::lock_guard lock(m_mutex);
-            return m_resources.contains(key);
+            auto it = m_resources.find(key);
+            return it != m_resources.end() && it->second.ready;
+        }
+
+        // 不创建，不在 (或者还在创建) 返回 nullopt
+        std::optional<Value> find(const Key &key)
+        {
+            std::lock_guard lock(m_mutex);
+            auto it = m_resources.find(key);
+            if (it == m_resources.end() || !it->second.ready)
+            {
+                return std::nullopt;
+            }
+            touch(it->second);
+            ++m_stats.hits;
+            return it->second.future.get();
+        }
+
+        // 返回值是一份拷贝 (句柄)，条目之后被换出去也不影响它
+        Value get_or_create(const Key &key)
+        {
+            std::unique_lock lock(m_mutex);
+            auto [it, inserted] = m_resources.try_emplace(key);
+            Entry &entry = it->second;
+            if (!inserted)
+            {
+                if (entry.ready)
+                {
+                    touch(entry);
+                    ++m_stats.hits;
+                    return entry.future.get();
+                }
+                ++m_stats.waits;
+                std::shared_future<Value> future = entry.future;
+                lock.unlock();
+                return future.get();
+            }
+
+            ++m_stats.misses;
+            std::promise<Value> promise;
+            entry.future = promise.get_future().share();
+            lock.unlock();
+
+            std::optional<SizedResource<Value>> created;
+            try
+            {
+                created = create(key);
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+                lock.lock();
+                m_resources.erase(key);
+                throw;
+            }
+            promise.set_value(created->value);
+
+            lock.lock();
+            Entry &created_entry = m_resources.at(key); // rehash 过的话 entry 的引用失效了
+            created_entry.ready = true;
+            created_entry.bytes = created->bytes;
+            created_entry.lru_position = m_lru.insert(m_lru.begin(), key);
+            m_bytes += created->bytes;
+            evict();
+            return std::move(created->value);
+        }
+
+        // 已经有的话不替换
+        void insert(const Key &key, Value value)
+        {
+            insert(key, SizedResource<Value>{value, ResourceTraits<Value>::bytes(value)});
+        }
+
+        void insert(const Key &key, SizedResource<Value> value)
+        {
+            std::lock_guard lock(m_mutex);
+            auto [it, inserted] = m_resources.try_emplace(key);
+            if (!inserted)
+            {
+                return;
+            }
+            std::promise<Value> promise;
+            promise.set_value(std::move(value.value));
+            it->second.future = promise.get_future().share();
+            it->second.ready = true;
+            it->second.bytes = value.bytes;
+            it->second.lru_position = m_lru.insert(m_lru.begin(), key);
+            m_bytes += value.bytes;
+            evict();
         }
 
-        Value &get_or_create(const Key &key)
+        // 不管有没有被拿着，还在创建的不动
+        void erase(const Key &key)
         {
             std::lock_guard lock(m_mutex);
-            if (!m_resources.contains(key))
+            auto it = m_resources.find(key);
+            if (it != m_resources.end() && it->second.ready)
             {
-                return m_resources.emplace(key, m_value_loader(key));
+                remove(it);
             }
-            return m_resources[key];
         }
 
-        void insert(const Key &key, Value &&value)
+        // 换出所有没被别人拿着的，返回换出了几个
+        size_t purge()
         {
             std::lock_guard lock(m_mutex);
-            m_resources.emplace(key, value);
+            size_t count = 0;
+            for (auto it = m_resources.begin(); it != m_resources.end();)
+            {
+                if (it->second.ready && !ResourceTraits<Value>::referenced(it->second.future.get()))
+                {
+                    it = remove(it);
+                    ++m_stats.evictions;
+                    ++count;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            return count;
+        }
+
+        void set_budget_bytes(size_t budget_bytes)
+        {
+            std::lock_guard lock(m_mutex);
+            m_budget_bytes = budget_bytes;
+            evict();
         }
 
-        // delete all no other referenced resource (use count == 1)
-        void purge()
+        ResourceStats stats()
         {
             std::lock_guard lock(m_mutex);
-            m_resources.erase(std::remove_if(m_resources.begin(), m_resources.end(), [](const auto &pair)
-                                             { return pair.second.use_count() == 1; }));
+            ResourceStats stats = m_stats;
+            stats.count = m_resources.size();
+            stats.bytes = m_bytes;
+            stats.budget_bytes = m_budget_bytes;
+            return stats;
         }
 
     private:
+        struct Entry
+        {
+            std::shared_future<Value> future;
+            bool ready = false;
+            size_t bytes = 0;
+            typename std::list<Key>::iterator lru_position; // ready 之后才有
+        };
+        using EntryMap = std::unordered_map<Key, Entry, Hash>;
+
         ValueCreator m_value_loader;
         cappuccino::mutex<ThreadSafe> m_mutex;
-        std::unordered_map<Key, Value> m_resources;
+        EntryMap m_resources;
+        std::list<Key> m_lru; // 前面是最近用过的
+        size_t m_budget_bytes;
+        size_t m_bytes = 0;
+        ResourceStats m_stats;
+
+        SizedResource<Value> create(const Key &key)
+        {
+            if constexpr (std::is_same_v<std::invoke_result_t<ValueCreator &, const Key &>, SizedResource<Value>>)
+            {
+                return m_value_loader(key);
+            }
+            else
+            {
+                Value value = m_value_loader(key);
+                const size_t bytes = ResourceTraits<Value>::bytes(value);
+                return {std::move(value), bytes};
+            }
+        }
+
+        void touch(Entry &entry)
+        {
+            m_lru.splice(m_lru.begin(), m_lru, entry.lru_position);
+        }
+
+        typename EntryMap::iterator remove(typename EntryMap::iterator it)
+        {
+            m_bytes -= it->second.bytes;
+            m_lru.erase(it->second.lru_position);
+            if constexpr (requires { m_value_loader.retire(it->second.future.get()); })
+            {
+                m_value_loader.retire(it->second.future.get());
+            }
+            return m_resources.erase(it);
+        }
+
+        // 从最久没用的开始换出，被拿着的跳过
+        void evict()
+        {
+            for (auto lru_it = m_lru.end(); m_bytes > m_budget_bytes && lru_it != m_lru.begin();)
+            {
+                --lru_it;
+                auto it = m_resources.find(*lru_it);
+                if (ResourceTraits<Value>::referenced(it->second.future.get()))
+                {
+                    continue;
+                }
+                lru_it = std::next(lru_it); // remove 会删掉 lru_it 指的那个
+                remove(it);
+                ++m_stats.evictions;
+            }
+        }
     };
 
-}
\ No newline at end of file
+}
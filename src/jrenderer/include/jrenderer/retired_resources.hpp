@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace jre
+{
+    // 从缓存里换出去的资源可能还在在飞的帧里用着，先拿着，等记下它的那个 cpu frame 下次录制时再放
+    template <typename T>
+    class RetiredResources
+    {
+    public:
+        RetiredResources(uint32_t frame_count) : m_frames(frame_count) {}
+
+        // 可以在任意线程上调用
+        void retire(T value)
+        {
+            std::lock_guard lock(m_mutex);
+            m_frames[m_frame].push_back(std::move(value));
+        }
+
+        // 放掉之前在 begin_frame 的线程上调用，这时 GPU 已经不用它了。
+        // 按句柄缓存了东西的在这里清掉，句柄之后可能分给新建的资源。要在第一帧之前加
+        void add_release_listener(std::function<void(const T &)> listener)
+        {
+            m_release_listeners.push_back(std::move(listener));
+        }
+
+        // 这个 cpu frame 的 fence 等过之后调：放掉它上次记下的，之后换出去的记在它上面
+        void begin_frame(uint32_t frame)
+        {
+            std::vector<T> released;
+            {
+                std::lock_guard lock(m_mutex);
+                released.swap(m_frames[frame]);
+                m_frame = frame;
+            }
+            // 锁外面通知、析构
+            for (const T &value : released)
+            {
+                for (const std::function<void(const T &)> &listener : m_release_listeners)
+                {
+                    listener(value);
+                }
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::vector<T>> m_frames;
+        uint32_t m_frame = 0;
+        std::vector<std::function<void(const T &)>> m_release_listeners;
+    };
+}
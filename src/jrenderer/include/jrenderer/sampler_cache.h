@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <unordered_map>
+
+namespace jre
+{
+    // 设备级的 sampler 缓存，同样的 SamplerCreateInfo 只建一个 sampler，纹理之间共享。
+    // 纹理数量上去之后不会碰到 maxSamplerAllocationCount。不支持 pNext (比如 YCbCr 转换)
+    class SamplerCache
+    {
+    public:
+        SamplerCache() = default;
+        SamplerCache(vk::SharedDevice device) : m_device(device) {}
+
+        vk::SharedSampler get(const vk::SamplerCreateInfo &create_info);
+
+        uint32_t size() const { return static_cast<uint32_t>(m_samplers.size()); }
+
+    private:
+        struct CreateInfoHash
+        {
+            size_t operator()(const vk::SamplerCreateInfo &create_info) const;
+        };
+
+        vk::SharedDevice m_device;
+        std::unordered_map<vk::SamplerCreateInfo, vk::SharedSampler, CreateInfoHash> m_samplers;
+    };
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan_shared.hpp>
+#include <string>
+#include "jrenderer/resources.hpp"
+
+namespace jre
+{
+    struct ShaderModuleCreator
+    {
+        vk::SharedDevice device;
+
+        SizedResource<vk::SharedShaderModule> operator()(const std::string &path) const;
+    };
+
+    // 设备级的 shader module 缓存，按 spv 的路径，材质之间、多次加载模型之间共享。字节数按 spv 的大小算。
+    // pipeline 建好之后就不需要 module 了，换出去不影响已有的 pipeline；要重建的 PipelineBuilder 自己拿着一份
+    using ShaderModuleCache = Resources<std::string, vk::SharedShaderModule, ShaderModuleCreator, cappuccino::thread_safe::yes>;
+}
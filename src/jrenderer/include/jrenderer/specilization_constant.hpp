@@ -35,6 +35,15 @@ namespace jre
 
         void set_constant(uint32_t constant_id, const bytes &data) { m_constants[constant_id] = data; }
 
+        // other 里的覆盖这里同 ID 的
+        void merge(const SpecializationConstants &other)
+        {
+            for (auto &[constant_id, constant] : other.constants())
+            {
+                m_constants[constant_id] = constant;
+            }
+        }
+
         const std::map<uint32_t, bytes> &constants() const { return m_constants; }
 
     private:
@@ -8,19 +8,64 @@
 #include "jrenderer/command_buffer.h"
 #include "jrenderer/resources.hpp"
 #include "jrenderer/buffer.h"
+#include "jrenderer/bindless_texture_table.h"
+#include "jrenderer/mip_generator.h"
 #include "jrenderer/utils/vk_utils.h"
 
 namespace jre
 {
 
+    // 块压缩格式一个 4x4 块的字节数，不是块压缩格式返回 0
+    inline uint32_t get_block_bytes(vk::Format format)
+    {
+        switch (format)
+        {
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc4UnormBlock:
+            return 8;
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc5UnormBlock:
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    // 块压缩格式一级 mip 的字节数，不足 4x4 的按一个块算
+    inline uint32_t get_compressed_level_size(vk::Format format, uint32_t width, uint32_t height)
+    {
+        return ((width + 3) / 4) * ((height + 3) / 4) * get_block_bytes(format);
+    }
+
     struct TextureData
     {
         uint32_t width;
         uint32_t height;
         uint32_t channels;
         const unsigned char *data;
+        vk::Format format = vk::Format::eR8G8B8A8Unorm;
+        uint32_t mip_levels = 1; // 大于 1 (块压缩的总是) 表示 data 里按 level 从大到小紧挨着放好了 mip 链 (见 Ktx2File)，直接拷贝，不再生成 mip
 
-        uint32_t size() const { return width * height * channels * sizeof(unsigned char); }
+        bool compressed() const { return get_block_bytes(format) != 0; }
+        bool has_mips() const { return compressed() || mip_levels > 1; }
+        uint32_t level_size(uint32_t level) const
+        {
+            const uint32_t level_width = std::max(width >> level, 1u);
+            const uint32_t level_height = std::max(height >> level, 1u);
+            return compressed() ? get_compressed_level_size(format, level_width, level_height) : level_width * level_height * channels * sizeof(unsigned char);
+        }
+        uint32_t size() const
+        {
+            uint32_t total = 0;
+            for (uint32_t level = 0; level < mip_levels; ++level)
+            {
+                total += level_size(level);
+            }
+            return total;
+        }
     };
 
     inline uint32_t get_mipmap_levels(uint32_t width, uint32_t height)
@@ -30,13 +75,49 @@ namespace jre
         return static_cast<uint32_t>(std::floor(std::log2(std::max<uint32_t>(width, height)))) + 1;
     }
 
+    // 把多张纹理的上传 (staging 拷贝、生成 mip) 录进同一个 command buffer，一次提交、等一次 fence，
+    // 代替每张纹理每一步都 submit 再 waitIdle。staging buffer 留到 submit 完成。
+    // 纹理在 submit 之前就注册进了无绑定表，submit 返回之后才能拿去画
+    class TextureUploadBatch
+    {
+    public:
+        TextureUploadBatch(vk::SharedDevice device, vk::CommandBuffer command_buffer, vk::Queue queue, MipGenerator *mip_generator = nullptr);
+
+        vk::CommandBuffer command_buffer(); // 第一次调用时 begin
+        MipGenerator *mip_generator() const { return m_mip_generator; } // 空的话逐级 blit
+        uint32_t mip_frame() const { return m_mip_frame; }               // 录进 MipGenerator 的哪一份
+        void keep_alive(DynamicBuffer &&staging_buffer);
+        void submit(); // 提交并等到完成，之后可以接着录下一批
+        // 不自己 begin/submit，录进外面已经在录的 command buffer (比如渲染线程这一帧的)。
+        // 录完用 take_staging_buffers 拿走 staging，由调用方留到那个 command buffer 执行完。
+        // frame 是它跟着提交的 cpu frame，调用方在这一帧的 fence 等过之后自己 reset MipGenerator 的这一份
+        void record_into(vk::CommandBuffer recording_command_buffer, uint32_t frame);
+        std::vector<DynamicBuffer> take_staging_buffers();
+
+        uint32_t texture_count() const { return m_texture_count; }
+
+    private:
+        vk::SharedDevice m_device;
+        vk::CommandBuffer m_command_buffer;
+        vk::Queue m_queue;
+        MipGenerator *m_mip_generator;
+        uint32_t m_mip_frame = MipGenerator::synchronous;
+        vk::SharedFence m_fence;
+        std::vector<DynamicBuffer> m_staging_buffers;
+        uint32_t m_texture_count = 0;
+        bool m_recording = false;
+        bool m_external = false;
+    };
+
     class TextureBuilder : public DeviceImageBuilder
     {
     public:
         const TextureData &data;
         vk::CommandBuffer command_buffer;
         vk::Queue transfer_queue;
-        bool generate_mipmaps = true;
+        bool generate_mipmaps = true; // 块压缩的数据自带 mip，不看这个
+        bool srgb = false; // 内容是 sRGB 编码的颜色，compute 生成 mip 时在线性空间平均。格式还是 Unorm
+        BindlessTextureTable *bindless_table = nullptr; // 非空时 build 完注册进去
         TextureBuilder(vk::SharedDevice device,
                        vk::PhysicalDevice physical_device,
                        vk::CommandBuffer command_buffer,
@@ -49,12 +130,39 @@ namespace jre
             return *this;
         }
 
+        TextureBuilder &set_srgb(bool srgb_)
+        {
+            srgb = srgb_;
+            return *this;
+        }
+
+        TextureBuilder &set_bindless_table(BindlessTextureTable *bindless_table_)
+        {
+            bindless_table = bindless_table_;
+            return *this;
+        }
+
         TextureBuilder &set_sampler(vk::SamplerCreateInfo sampler_create_info_)
         {
             sampler_create_info = sampler_create_info_;
             return *this;
         }
 
+        TextureBuilder &set_sampler_cache(SamplerCache *sampler_cache_)
+        {
+            sampler_cache = sampler_cache_;
+            return *this;
+        }
+
+        // 自己提交并等完成
         DeviceImage build();
+        // 只录进 batch，batch.submit 之后才能用
+        DeviceImage build(TextureUploadBatch &batch);
     };
+
+    // 给 Resources 算预算用，按 image 的显存需求算
+    inline size_t resource_bytes(const DeviceImage &texture)
+    {
+        return texture.image ? texture.image.getDestructorType()->getImageMemoryRequirements(texture.image.get()).size : 0;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include "jrenderer/image.h"
+#include "jrenderer/resources.hpp"
+#include "jrenderer/retired_resources.hpp"
+#include "jrenderer/texture_loader.h"
+
+namespace jre
+{
+    using RetiredTextures = RetiredResources<std::shared_ptr<Texture>>;
+
+    struct TextureCreator
+    {
+        std::shared_ptr<RetiredTextures> retired;
+
+        void retire(const std::shared_ptr<Texture> &texture) const;
+    };
+
+    // 场景级的纹理缓存，多次同步加载同一个模型共用纹理。字节数按 image 的显存算，insert 时给。
+    // 和 MeshCache 一样不走 get_or_create：先 find，没有就建好再 insert。
+    // 材质里存的是 Texture 的拷贝，缓存看不到，建材质的地方要把 shared_ptr 放进 Model::textures，model 在就不会换出。
+    // 换出去的交给 RetiredTextures，SceneDrawer 等在飞的帧用完再放掉它在无绑定表里的位置
+    using TextureCache = Resources<std::string, std::shared_ptr<Texture>, TextureCreator, cappuccino::thread_safe::yes>;
+
+    // 文件名、用途和 sampler 都一样才是同一张。sampler 是 SamplerCache 里的，一直活着，句柄不会重用
+    std::string texture_cache_key(const TextureRequest &request, vk::Sampler sampler);
+}
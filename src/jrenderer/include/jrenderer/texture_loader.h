@@ -0,0 +1,129 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "jrenderer/texture.h"
+#include "jrenderer/asset/raii_stb_image.h"
+#include "jrenderer/asset/texture_cooker.h"
+#include "jrenderer/utils/blocking_queue.hpp"
+
+namespace jre
+{
+    class TextureStreamer;
+    class VirtualTextureSystem;
+    class VirtualTextureFile;
+
+    // 一张要加载的纹理
+    struct TextureRequest
+    {
+        std::string filename;
+        TextureRole role;
+        vk::SamplerCreateInfo sampler_create_info;
+    };
+
+    // 纹理加载流水线：解码 (png 解码，或者读/烘焙 KTX2) 分给几个工作线程，解码好的放进有界队列，
+    // 调用线程从队列里取出来录进 TextureUploadBatch (staging 拷贝、生成 mip)，攒够 textures_per_submit 张提交一次。
+    // 解码、录制和上一批的 GPU 传输互相重叠；队列有界，上传跟不上时工作线程停下来，解码结果不会一下子全堆在内存里。
+    // Vulkan 的录制和提交都只在调用线程上
+    class TextureLoader
+    {
+    public:
+        SamplerCache *sampler_cache = nullptr;
+        BindlessTextureTable *bindless_table = nullptr;
+        bool compressed_textures = false; // 见 StarRailMaterialInstanceBuilder::compressed_textures
+        uint32_t textures_per_submit = 8; // 0 表示都留给调用方 batch.submit
+        TextureStreamer *streamer = nullptr; // 非空时解码出整条 mip 链交给它，future 给的是 add 返回的纹理
+        VirtualTextureSystem *virtual_textures = nullptr; // 非空时够大的纹理切成 tile 做成虚拟纹理，优先于 streamer
+
+        TextureLoader(vk::SharedDevice device,
+                      vk::PhysicalDevice physical_device,
+                      vk::CommandBuffer command_buffer,
+                      vk::Queue transfer_queue,
+                      TextureUploadBatch &batch,
+                      uint32_t thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1, // 留一个给调用线程录制
+                      uint32_t queue_capacity = 4);
+        ~TextureLoader(); // 没录完的丢掉，它们的 future 得到 broken_promise
+
+        TextureLoader(const TextureLoader &) = delete;
+        TextureLoader &operator=(const TextureLoader &) = delete;
+
+        // 马上返回，同一个文件只解码一次、拿到同一个 future。
+        // 文件名不同、内容、用途和 sampler 都一样的 (PMX 纹理表里常有) 在工作线程上按内容哈希认出来，也只解码、上传一次，共用一张纹理
+        // future 在纹理录进 batch 之后就绪 (bindless_index 已经有了)，batch 提交完成之后才能画
+        std::shared_future<Texture> load(const std::string &filename, TextureRole role, const vk::SamplerCreateInfo &sampler_create_info);
+        std::shared_future<Texture> load(const TextureRequest &request) { return load(request.filename, request.role, request.sampler_create_info); }
+        // 在调用线程上把解码好的依次录进 batch，直到 texture 就绪
+        Texture wait(const std::shared_future<Texture> &texture);
+        // 已经请求的都录完
+        void wait_all();
+        // 不等，把已经解码好的最多 max_count 张录进 batch，返回录了几张。给每帧调一次、不能停下来等的渲染线程用
+        uint32_t upload_ready(uint32_t max_count);
+
+        size_t requested_count() const { return m_requests.size(); }
+        size_t ready_count() const;
+
+    private:
+        struct DecodeJob
+        {
+            uint32_t index;
+            std::string filename;
+            TextureRole role;
+            vk::SamplerCreateInfo sampler_create_info;
+            bool compressed;
+            bool streamed;
+            bool virtual_texture;
+        };
+
+        struct DecodedTexture
+        {
+            uint32_t index;
+            std::optional<STBImage> image;
+            std::optional<Ktx2File> cooked;
+            std::shared_ptr<VirtualTextureFile> virtual_file;
+            std::optional<uint32_t> alias_of; // 内容和它一样，没有解码
+            std::exception_ptr error;
+        };
+
+        struct Request
+        {
+            vk::SamplerCreateInfo sampler_create_info;
+            TextureRole role;
+            std::promise<Texture> promise;
+            std::shared_future<Texture> future;
+            std::vector<uint32_t> aliases; // 先到了、等着它上传的同内容请求
+        };
+
+        vk::SharedDevice m_device;
+        vk::PhysicalDevice m_physical_device;
+        vk::CommandBuffer m_command_buffer;
+        vk::Queue m_transfer_queue;
+        TextureUploadBatch &m_batch;
+        std::unordered_map<std::string, uint32_t> m_request_indices;
+        struct ContentRequest
+        {
+            vk::SamplerCreateInfo sampler_create_info;
+            uint32_t index;
+        };
+
+        std::mutex m_content_mutex;
+        // 内容哈希和用途到每种 sampler 的第一个请求，工作线程上访问。sampler 不一样的各自上传，纹理要带着自己的 sampler 注册进无绑定表
+        std::map<std::pair<uint64_t, TextureRole>, std::vector<ContentRequest>> m_content_indices;
+        std::vector<Request> m_requests; // 只在调用线程上访问
+        uint32_t m_uploaded_count = 0;
+        BlockingQueue<DecodeJob> m_jobs;
+        BlockingQueue<DecodedTexture> m_decoded;
+        std::vector<std::jthread> m_threads; // 最后一个成员，先于队列析构
+
+        void decode_loop();
+        void decode(const DecodeJob &job, DecodedTexture &decoded) const;
+        void upload_one(); // 阻塞到有一张解码好
+        void upload(DecodedTexture &decoded);
+        void upload_texture(Request &request, DecodedTexture &decoded);
+    };
+}
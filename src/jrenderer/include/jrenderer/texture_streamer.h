@@ -0,0 +1,85 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/asset/ktx2_file.h"
+
+namespace jre
+{
+    class Graphics;
+
+    // 纹理流送：加进来的纹理在内存里留着整条 mip 链，显存里一开始只放长边不超过 initial_resident_size 的几级。
+    // 每帧录制之前 (pre_render_pass_recorders 里，AsyncModelLoader 之后) 按视口 0 里用它的 sub mesh 投影到屏幕上的大小
+    // 和 sub mesh 的 uv 范围估计要哪一级，在 budget_bytes 以内流入更清楚的，超了先降占得最多的。
+    // 换级数是重建一张只有常驻这几级的 image，view 从它的 mip 0 开始就是把 min lod 钳在常驻的最高一级；
+    // 上传录进这一帧，那一帧执行完才换进材质，旧的再等一轮才释放，着色器不会采样到还没写好的级。
+    // 换的时候新旧两张同时在显存里，会短暂超出预算
+    class TextureStreamer : public CommandBufferRecordable
+    {
+    public:
+        vk::DeviceSize budget_bytes = 256ull << 20;
+        vk::DeviceSize upload_bytes_per_frame = 16ull << 20; // 至少换一张
+        uint32_t initial_resident_size = 256;                // 这以下的级一直常驻，不算进预算的取舍
+        float mip_bias = 0.0f;                               // 正的偏糊，省显存
+
+        TextureStreamer(Graphics &graphics, SceneDrawer &scene_drawer);
+
+        // source 要带整条 mip 链。常驻的几级录进 batch，返回的纹理已经注册进 scene_drawer 的无绑定表
+        Texture add(Ktx2File &&source, const vk::SamplerCreateInfo &sampler_create_info, TextureUploadBatch &batch);
+        // texture 是 add 返回的或者现在材质里用的，返回现在材质里用的那张；不是流送的原样返回
+        Texture resolve(const Texture &texture) const;
+
+        uint32_t texture_count() const { return static_cast<uint32_t>(m_textures.size()); }
+        uint32_t transition_count() const { return m_transition_count; } // 上传了还没换进材质的
+        vk::DeviceSize resident_bytes() const { return m_resident_bytes; }
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+
+    private:
+        struct StreamedTexture
+        {
+            Ktx2File source;
+            vk::SamplerCreateInfo sampler_create_info;
+            Texture issued;  // add 返回的那张，只有常驻的几级。一直留着，view 不会被别的纹理复用，降回去也不用再上传
+            Texture texture; // 现在材质里用的
+            uint32_t resident_level; // texture 的 mip 0 是 source 的第几级
+            uint32_t base_level;     // 长边不超过 initial_resident_size 的第一级
+            uint32_t wanted_level = 0;
+            uint32_t target_level = 0;
+            bool transitioning = false;
+        };
+
+        struct Transition
+        {
+            uint32_t index;
+            Texture texture;
+            uint32_t level;
+        };
+
+        struct FrameUploads
+        {
+            std::vector<DynamicBuffer> staging_buffers;
+            std::vector<Transition> transitions;
+            std::vector<Texture> retired; // 已经换下来的，等到这个 cpu frame 下次录制时没有帧在用了
+        };
+
+        vk::SharedDevice m_device;
+        vk::PhysicalDevice m_physical_device;
+        SceneDrawer &m_scene_drawer;
+        TextureUploadBatch m_batch;
+        std::vector<StreamedTexture> m_textures;
+        std::map<vk::ImageView, uint32_t> m_texture_indices; // issued 和 texture 的 view
+        std::vector<FrameUploads> m_frames;                  // 按 cpu frame
+        vk::DeviceSize m_resident_bytes = 0;
+        uint32_t m_transition_count = 0;
+
+        vk::DeviceSize get_resident_size(const StreamedTexture &texture, uint32_t level) const;
+        Texture build_texture(const StreamedTexture &texture, uint32_t level, TextureUploadBatch &batch);
+        void complete_transition(const Transition &transition, FrameUploads &frame);
+        void estimate_levels(Graphics &graphics);
+        void fit_budget();
+        void record_transitions(vk::CommandBuffer command_buffer, FrameUploads &frame);
+    };
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace jre
+{
+    // 多生产者多消费者的阻塞队列。capacity 为 0 不限长度，否则满了 push 就等，用来给流水线的上一级限速
+    // close 之后 push 都失败，pop 取完剩下的再返回 nullopt
+    template <typename T>
+    class BlockingQueue
+    {
+    public:
+        explicit BlockingQueue(size_t capacity = 0) : m_capacity(capacity) {}
+
+        BlockingQueue(const BlockingQueue &) = delete;
+        BlockingQueue &operator=(const BlockingQueue &) = delete;
+
+        bool push(T value)
+        {
+            std::unique_lock lock(m_mutex);
+            m_not_full.wait(lock, [this]
+                            { return m_closed || m_capacity == 0 || m_items.size() < m_capacity; });
+            if (m_closed)
+            {
+                return false;
+            }
+            m_items.push_back(std::move(value));
+            lock.unlock();
+            m_not_empty.notify_one();
+            return true;
+        }
+
+        std::optional<T> pop()
+        {
+            std::unique_lock lock(m_mutex);
+            m_not_empty.wait(lock, [this]
+                             { return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+            {
+                return std::nullopt;
+            }
+            T value = std::move(m_items.front());
+            m_items.pop_front();
+            lock.unlock();
+            m_not_full.notify_one();
+            return value;
+        }
+
+        // 不等，空的就返回 nullopt。给不能停下来的线程 (比如渲染线程) 用
+        std::optional<T> try_pop()
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_items.empty())
+            {
+                return std::nullopt;
+            }
+            T value = std::move(m_items.front());
+            m_items.pop_front();
+            lock.unlock();
+            m_not_full.notify_one();
+            return value;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_closed = true;
+            }
+            m_not_full.notify_all();
+            m_not_empty.notify_all();
+        }
+
+        size_t size() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_items.size();
+        }
+
+    private:
+        mutable std::mutex m_mutex;
+        std::condition_variable m_not_full;
+        std::condition_variable m_not_empty;
+        std::deque<T> m_items;
+        size_t m_capacity;
+        bool m_closed = false;
+    };
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace jre
+{
+    // LZ4 的块格式 (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)，不带帧头，原始大小由调用方另外记。
+    // 压缩是贪心的单个哈希表，比官方的默认档稍差一点；解压检查越界，数据坏了抛异常
+    std::vector<std::byte> lz4_compress(std::span<const std::byte> source);
+    // destination 的大小就是原始大小，解出来的不多不少才算对
+    void lz4_decompress(std::span<const std::byte> source, std::span<std::byte> destination);
+}
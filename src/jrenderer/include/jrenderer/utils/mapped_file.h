@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace jre
+{
+    // 只读地映射整个文件，数据按需从页缓存里来，不经过 ifstream 的缓冲和拷贝。
+    // 空文件 data() 是空的。只能移动，析构时解除映射
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::filesystem::path &path);
+        ~MappedFile();
+
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        std::span<const std::byte> data() const { return {m_data, m_size}; }
+        size_t size() const { return m_size; }
+
+    private:
+        const std::byte *m_data = nullptr;
+        size_t m_size = 0;
+
+        void close();
+    };
+}
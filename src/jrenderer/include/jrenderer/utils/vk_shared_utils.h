@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <vulkan/vulkan_shared.hpp>
 
@@ -65,6 +66,9 @@ namespace vk
         std::vector<char> load_spv_shader_file(const std::string &file_path);
         vk::SharedShaderModule create_shader_from_spv(vk::SharedDevice device,
                                                       const std::vector<char> &content);
+        vk::SharedShaderModule create_shader_from_spv(vk::SharedDevice device,
+                                                      std::span<const std::byte> content);
+        // 经过 jre::read_asset，挂了打包文件就先从包里读
         vk::SharedShaderModule create_shader_from_spv_file(vk::SharedDevice device,
                                                            const std::string &file_path);
         vk::SharedPipelineLayout create_pipeline_layout(vk::SharedDevice device,
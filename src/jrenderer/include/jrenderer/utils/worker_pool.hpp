@@ -0,0 +1,119 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stop_token>
+
+namespace jre
+{
+    // 常驻线程的 parallel for，每帧都要分发的小任务用它，省掉每帧起线程的开销。
+    // run 会阻塞到所有 job 做完，调用线程自己也参与干活。不能嵌套调用。
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(uint32_t thread_count = std::thread::hardware_concurrency())
+        {
+            thread_count = std::max(1u, thread_count);
+            for (uint32_t i = 1; i < thread_count; ++i)
+            {
+                m_threads.emplace_back([this, i](std::stop_token stop_token)
+                                       { worker_loop(stop_token, i); });
+            }
+        }
+
+        ~WorkerPool()
+        {
+            for (auto &thread : m_threads)
+            {
+                thread.request_stop();
+            }
+            m_wake.notify_all();
+            m_threads.clear(); // 先 join，再析构 mutex 和条件变量
+        }
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        uint32_t thread_count() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+
+        // job(job_index, thread_index)
+        void run(uint32_t job_count, const std::function<void(uint32_t, uint32_t)> &job)
+        {
+            if (job_count == 0)
+            {
+                return;
+            }
+            {
+                std::lock_guard lock(m_mutex);
+                m_job = &job;
+                m_job_count = job_count;
+                m_next_job = 0;
+                m_finished_jobs = 0;
+                ++m_generation;
+            }
+            m_wake.notify_all();
+            work(0);
+            std::unique_lock lock(m_mutex);
+            // 等所有 worker 都退出 work()，下一次 run 重置计数时才不会和它们抢
+            m_done.wait(lock, [this]
+                        { return m_finished_jobs == m_job_count && m_active_workers == 0; });
+            m_job = nullptr;
+        }
+
+    private:
+        std::vector<std::jthread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable_any m_wake;
+        std::condition_variable m_done;
+        const std::function<void(uint32_t, uint32_t)> *m_job = nullptr;
+        uint32_t m_job_count = 0;
+        std::atomic<uint32_t> m_next_job = 0;
+        uint32_t m_finished_jobs = 0;
+        uint32_t m_active_workers = 0;
+        uint64_t m_generation = 0;
+
+        void work(uint32_t thread_index)
+        {
+            uint32_t finished = 0;
+            for (uint32_t i = m_next_job++; i < m_job_count; i = m_next_job++)
+            {
+                (*m_job)(i, thread_index);
+                ++finished;
+            }
+            if (finished > 0)
+            {
+                std::lock_guard lock(m_mutex);
+                m_finished_jobs += finished;
+            }
+            m_done.notify_one();
+        }
+
+        void worker_loop(std::stop_token stop_token, uint32_t thread_index)
+        {
+            uint64_t seen_generation = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock lock(m_mutex);
+                    if (!m_wake.wait(lock, stop_token, [&]
+                                     { return m_generation != seen_generation && m_job != nullptr; }))
+                    {
+                        return;
+                    }
+                    seen_generation = m_generation;
+                    ++m_active_workers;
+                }
+                work(thread_index);
+                {
+                    std::lock_guard lock(m_mutex);
+                    --m_active_workers;
+                }
+                m_done.notify_one();
+            }
+        }
+    };
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "jrenderer/drawer/command_buffer_recordable.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/asset/texture_cooker.h"
+#include "jrenderer/asset/virtual_texture_file.h"
+#include "jrenderer/utils/blocking_queue.hpp"
+
+namespace jre
+{
+    class Graphics;
+
+    // 虚拟纹理：很大的纹理 (环境之类，加起来放不进显存) 建成稀疏 image (sparseResidencyImage2D)，mip tail 一直驻留，
+    // 其余的级按 tile 从切好的 .jvt 文件里按需读进来，绑到从页池里分的显存上。
+    // 着色器 (virtual_texture.glsl) 采样时把想要的 tile 记进反馈位图，再从驻留位图里找最清楚的、过滤要读的 tile 都已经驻留的一级采样。
+    // 每帧录制之前 (pre_render_pass_recorders) 读回几帧前的反馈，缺的 tile 交给读文件的线程；
+    // 读好的 tile 先 bindSparse，这个 cpu frame 下次录制时录拷贝，再下次才置驻留位，着色器不会读到没写好的 tile。
+    // 页池满了换出最久没被采样的 tile，清驻留位之后等一轮才解绑。
+    // 只在 Graphics::sparse_residency() 的 GPU 上用；要在第一帧之前建好，它往无绑定表的 set 里写反馈和驻留位图
+    class VirtualTextureSystem : public CommandBufferRecordable
+    {
+    public:
+        static constexpr uint32_t max_tiles = 1u << 20; // 所有虚拟纹理加起来的 tile 数，反馈和驻留位图的位数
+
+        uint32_t min_texture_size = 4096; // 长边不小于这个的纹理才做成虚拟的，小的走整级的 mip 流送
+        uint32_t max_pages = 2048;        // 物理页的上限，一页一个 tile (标准块形状是 64KB)
+        uint32_t tiles_per_frame = 16;    // 每帧最多绑定、上传几个 tile
+        uint32_t keep_frames = 8;         // 这么多帧内被采样过的 tile 不换出去
+
+        VirtualTextureSystem(Graphics &graphics, SceneDrawer &scene_drawer);
+        ~VirtualTextureSystem();
+
+        VirtualTextureSystem(const VirtualTextureSystem &) = delete;
+        VirtualTextureSystem &operator=(const VirtualTextureSystem &) = delete;
+
+        // 工作线程上调用。已经切好、比源文件新、布局和这个 GPU 一致的 tile 文件才打开，否则返回空
+        std::shared_ptr<VirtualTextureFile> open(const std::string &filename, TextureRole role, vk::Format format) const;
+        // 工作线程上调用。chain 要带整条 mip 链；够大、格式支持稀疏的话切成 tile 文件存好再打开，否则返回空
+        std::shared_ptr<VirtualTextureFile> cook(const std::string &filename, TextureRole role, const Ktx2File &chain) const;
+        // 渲染线程上调用。建稀疏 image，绑定 mip tail (同步等绑定完成)，mip tail 的上传录进 batch，注册进无绑定表
+        Texture add(std::shared_ptr<VirtualTextureFile> file, const vk::SamplerCreateInfo &sampler_create_info, TextureUploadBatch &batch);
+
+        uint32_t texture_count() const { return static_cast<uint32_t>(m_textures.size()); }
+        uint32_t resident_tile_count() const { return static_cast<uint32_t>(m_resident_tiles.size()); }
+        uint32_t loading_tile_count() const { return m_loading_count; }
+        uint32_t page_count() const { return m_page_count; }
+
+        void on_draw(Graphics &graphics, vk::CommandBuffer command_buffer) override;
+
+    private:
+        struct TileLayout
+        {
+            vk::Extent2D tile_extent;
+            uint32_t mip_tail_start;
+        };
+
+        struct VirtualTexture
+        {
+            std::shared_ptr<VirtualTextureFile> file;
+            Texture texture;
+            uint32_t first_tile; // 在位图里的起点
+        };
+
+        enum class TileState : uint8_t
+        {
+            NonResident,
+            Loading,
+            Uploading, // 绑定了，拷贝在路上
+            Resident,
+        };
+
+        struct Tile
+        {
+            uint32_t texture;
+            uint32_t level;
+            uint32_t x;
+            uint32_t y;
+            TileState state = TileState::NonResident;
+            uint32_t page = ~0u;
+            uint64_t last_used_frame = 0;
+        };
+
+        struct TileRequest
+        {
+            std::shared_ptr<VirtualTextureFile> file;
+            uint32_t file_tile; // 在文件里的编号
+            uint32_t tile;
+        };
+
+        struct LoadedTile
+        {
+            uint32_t tile;
+            std::vector<unsigned char> data;
+            std::exception_ptr error;
+        };
+
+        struct UploadingTile
+        {
+            uint32_t tile;
+            DynamicBuffer staging_buffer;
+        };
+
+        struct FrameWork
+        {
+            DynamicBuffer feedback_readback;
+            uint32_t feedback_words = 0; // 拷了几个字，0 表示没有可读的
+            vk::SharedFence bind_fence;
+            bool bind_pending = false;
+            std::vector<UploadingTile> bound;                     // 这次录制时绑定的，下次录拷贝
+            std::vector<UploadingTile> copied;                    // 拷贝录在这个 cpu frame 上一次的 command buffer 里
+            std::vector<std::pair<uint32_t, uint32_t>> evicted;   // 驻留位已经清掉的 tile 和它的页，下次录制时解绑、还回页池
+        };
+
+        vk::SharedDevice m_device;
+        vk::PhysicalDevice m_physical_device;
+        vk::Queue m_sparse_queue;
+        SceneDrawer &m_scene_drawer;
+        DynamicBuffer m_feedback_buffer;  // 着色器写，每帧录制前拷走再清零
+        DynamicBuffer m_residency_buffer; // CPU 写
+        bool m_feedback_cleared = false;
+        std::vector<VirtualTexture> m_textures;
+        std::vector<Tile> m_tiles;
+        std::vector<uint32_t> m_resident_tiles;
+        std::vector<FrameWork> m_frames; // 按 cpu frame
+        uint64_t m_frame_number = 0;
+        uint32_t m_loading_count = 0;
+
+        // 物理页：一块 DeviceMemory 分 pages_per_block 页
+        static constexpr uint32_t pages_per_block = 64;
+        vk::DeviceSize m_page_size = 0;
+        uint32_t m_page_memory_type_bits = 0;
+        std::vector<vk::SharedDeviceMemory> m_page_blocks;
+        std::vector<uint32_t> m_free_pages;
+        uint32_t m_page_count = 0;
+
+        BlockingQueue<TileRequest> m_tile_requests;
+        BlockingQueue<LoadedTile> m_loaded_tiles;
+        std::vector<std::jthread> m_threads; // 最后一个成员，先于队列析构
+
+        std::optional<TileLayout> get_tile_layout(vk::Format format, uint32_t width, uint32_t height, uint32_t mip_levels) const;
+        void load_loop();
+        void read_feedback(FrameWork &frame);
+        void record_feedback_copy(vk::CommandBuffer command_buffer, FrameWork &frame);
+        void record_tile_copies(vk::CommandBuffer command_buffer, FrameWork &frame);
+        void bind_loaded_tiles(FrameWork &frame);
+        std::optional<uint32_t> allocate_page(FrameWork &frame);
+        vk::SparseImageMemoryBind get_tile_bind(const Tile &tile, vk::DeviceMemory memory, vk::DeviceSize memory_offset) const;
+        void set_resident(uint32_t tile, bool resident);
+    };
+}
@@ -0,0 +1,326 @@
+#include "jrenderer/asset/asset_archive.h"
+#include "jrenderer/utils/lz4.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr uint32_t archive_magic = 0x4B41504A; // "JPAK"
+        constexpr uint32_t archive_version = 1;
+
+        enum class Compression : uint32_t
+        {
+            none = 0,
+            lz4 = 1,
+        };
+
+        struct ArchiveHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t entry_count;
+            uint32_t alignment;
+            uint64_t index_offset;
+            uint64_t names_offset;
+            uint64_t names_size;
+        };
+        static_assert(sizeof(ArchiveHeader) == 40);
+
+        uint64_t hash_name(std::string_view name)
+        {
+            // FNV-1a
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (char c : name)
+            {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        uint64_t align_up(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        std::vector<std::byte> read_file(const std::filesystem::path &path)
+        {
+            const MappedFile file(path);
+            return std::vector<std::byte>(file.data().begin(), file.data().end());
+        }
+
+        struct MountedArchives
+        {
+            std::shared_mutex mutex;
+            std::vector<std::shared_ptr<const AssetArchive>> archives;
+        };
+
+        MountedArchives &mounted_archives()
+        {
+            static MountedArchives mounted;
+            return mounted;
+        }
+    }
+
+    struct AssetArchive::IndexEntry
+    {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t stored_size; // 压缩了的话是压缩后的大小
+        uint64_t size;
+        uint32_t name_offset;
+        uint32_t name_size;
+        Compression compression;
+        uint32_t reserved;
+    };
+
+    AssetBlob::AssetBlob(std::vector<std::byte> bytes)
+    {
+        auto owned = std::make_shared<const std::vector<std::byte>>(std::move(bytes));
+        m_data = *owned;
+        m_owner = std::move(owned);
+    }
+
+    std::string AssetArchive::normalize_name(const std::filesystem::path &name)
+    {
+        std::string normalized = name.lexically_normal().generic_string();
+        while (normalized.starts_with("./"))
+        {
+            normalized.erase(0, 2);
+        }
+        return normalized;
+    }
+
+    void AssetArchive::Builder::add(const std::filesystem::path &name, std::vector<std::byte> data)
+    {
+        m_entries.push_back({normalize_name(name), {}, std::move(data)});
+    }
+
+    void AssetArchive::Builder::add_file(const std::filesystem::path &name, const std::filesystem::path &source)
+    {
+        m_entries.push_back({normalize_name(name), source, {}});
+    }
+
+    void AssetArchive::Builder::save(const std::filesystem::path &path) const
+    {
+        ZoneScoped;
+        // spv 直接当 uint32_t 数组用，至少 4 字节
+        if (alignment < 4 || (alignment & (alignment - 1)) != 0)
+        {
+            throw std::runtime_error("AssetArchive: alignment must be a power of two and at least 4");
+        }
+
+        std::vector<IndexEntry> index;
+        std::string names;
+        std::unordered_set<std::string> added_names;
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+            if (!stream)
+            {
+                throw std::runtime_error("AssetArchive: failed to write " + temp_path.string());
+            }
+            ArchiveHeader header{};
+            stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            uint64_t offset = sizeof(header);
+            const char padding[256] = {};
+            auto pad_to = [&](uint64_t target)
+            {
+                while (offset < target)
+                {
+                    const uint64_t count = std::min<uint64_t>(target - offset, sizeof(padding));
+                    stream.write(padding, count);
+                    offset += count;
+                }
+            };
+
+            for (const PendingEntry &pending : m_entries)
+            {
+                if (!added_names.insert(pending.name).second)
+                {
+                    throw std::runtime_error("AssetArchive: duplicated entry " + pending.name);
+                }
+
+                std::vector<std::byte> loaded = pending.source.empty() ? std::vector<std::byte>() : read_file(pending.source);
+                const std::vector<std::byte> &data = pending.source.empty() ? pending.data : loaded;
+                std::vector<std::byte> compressed;
+                Compression compression = Compression::none;
+                if (compress && !data.empty())
+                {
+                    compressed = lz4_compress(data);
+                    // 至少省 1/8 才值得解压的开销
+                    if (compressed.size() <= data.size() - data.size() / 8)
+                    {
+                        compression = Compression::lz4;
+                    }
+                }
+                const std::vector<std::byte> &stored = compression == Compression::lz4 ? compressed : data;
+
+                pad_to(align_up(offset, alignment));
+                IndexEntry entry{};
+                entry.hash = hash_name(pending.name);
+                entry.offset = offset;
+                entry.stored_size = stored.size();
+                entry.size = data.size();
+                entry.name_offset = static_cast<uint32_t>(names.size());
+                entry.name_size = static_cast<uint32_t>(pending.name.size());
+                entry.compression = compression;
+                index.push_back(entry);
+                names += pending.name;
+
+                stream.write(reinterpret_cast<const char *>(stored.data()), stored.size());
+                offset += stored.size();
+            }
+
+            std::ranges::sort(index, {}, &IndexEntry::hash);
+            pad_to(align_up(offset, alignof(IndexEntry)));
+            header.magic = archive_magic;
+            header.version = archive_version;
+            header.entry_count = static_cast<uint32_t>(index.size());
+            header.alignment = alignment;
+            header.index_offset = offset;
+            header.names_offset = offset + index.size() * sizeof(IndexEntry);
+            header.names_size = names.size();
+            stream.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(IndexEntry));
+            stream.write(names.data(), names.size());
+            stream.seekp(0);
+            stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            if (!stream)
+            {
+                throw std::runtime_error("AssetArchive: failed to write " + temp_path.string());
+            }
+        }
+        std::filesystem::rename(temp_path, path);
+    }
+
+    AssetArchive::AssetArchive(const std::filesystem::path &path)
+        : m_file(std::make_shared<const MappedFile>(path))
+    {
+        static_assert(sizeof(IndexEntry) == 48);
+        const std::span<const std::byte> data = m_file->data();
+        ArchiveHeader header;
+        if (data.size() < sizeof(header))
+        {
+            throw std::runtime_error("AssetArchive: file too small " + path.string());
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != archive_magic || header.version != archive_version)
+        {
+            throw std::runtime_error("AssetArchive: unsupported file " + path.string());
+        }
+        const uint64_t index_size = static_cast<uint64_t>(header.entry_count) * sizeof(IndexEntry);
+        if (header.index_offset % alignof(IndexEntry) != 0 ||
+            header.index_offset > data.size() || index_size > data.size() - header.index_offset ||
+            header.names_offset > data.size() || header.names_size > data.size() - header.names_offset)
+        {
+            throw std::runtime_error("AssetArchive: index out of range " + path.string());
+        }
+        m_index = {reinterpret_cast<const IndexEntry *>(data.data() + header.index_offset), header.entry_count};
+        m_names = {reinterpret_cast<const char *>(data.data() + header.names_offset), header.names_size};
+        for (const IndexEntry &entry : m_index)
+        {
+            if (entry.offset > header.index_offset || entry.stored_size > header.index_offset - entry.offset ||
+                static_cast<uint64_t>(entry.name_offset) + entry.name_size > m_names.size() ||
+                (entry.compression != Compression::none && entry.compression != Compression::lz4) ||
+                (entry.compression == Compression::none && entry.stored_size != entry.size))
+            {
+                throw std::runtime_error("AssetArchive: corrupted entry in " + path.string());
+            }
+        }
+    }
+
+    const AssetArchive::IndexEntry *AssetArchive::find_entry(const std::filesystem::path &name) const
+    {
+        const std::string normalized = normalize_name(name);
+        const uint64_t hash = hash_name(normalized);
+        for (auto it = std::ranges::lower_bound(m_index, hash, {}, &IndexEntry::hash); it != m_index.end() && it->hash == hash; ++it)
+        {
+            if (std::string_view(m_names.data() + it->name_offset, it->name_size) == normalized)
+            {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    bool AssetArchive::contains(const std::filesystem::path &name) const
+    {
+        return find_entry(name) != nullptr;
+    }
+
+    std::optional<AssetBlob> AssetArchive::find(const std::filesystem::path &name) const
+    {
+        const IndexEntry *entry = find_entry(name);
+        if (entry == nullptr)
+        {
+            return std::nullopt;
+        }
+        const std::span<const std::byte> stored = m_file->data().subspan(entry->offset, entry->stored_size);
+        if (entry->compression == Compression::none)
+        {
+            return AssetBlob(m_file, stored);
+        }
+        ZoneScopedN("AssetArchive::decompress");
+        std::vector<std::byte> data(entry->size);
+        lz4_decompress(stored, data);
+        return AssetBlob(std::move(data));
+    }
+
+    void mount_asset_archive(std::shared_ptr<const AssetArchive> archive)
+    {
+        MountedArchives &mounted = mounted_archives();
+        std::unique_lock lock(mounted.mutex);
+        mounted.archives.push_back(std::move(archive));
+    }
+
+    void unmount_asset_archives()
+    {
+        MountedArchives &mounted = mounted_archives();
+        std::unique_lock lock(mounted.mutex);
+        mounted.archives.clear();
+    }
+
+    std::optional<AssetBlob> find_archived_asset(const std::filesystem::path &path)
+    {
+        MountedArchives &mounted = mounted_archives();
+        std::shared_lock lock(mounted.mutex);
+        for (auto it = mounted.archives.rbegin(); it != mounted.archives.rend(); ++it)
+        {
+            if (std::optional<AssetBlob> blob = (*it)->find(path))
+            {
+                return blob;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool contains_archived_asset(const std::filesystem::path &path)
+    {
+        MountedArchives &mounted = mounted_archives();
+        std::shared_lock lock(mounted.mutex);
+        return std::ranges::any_of(mounted.archives, [&](const std::shared_ptr<const AssetArchive> &archive)
+                                   { return archive->contains(path); });
+    }
+
+    AssetBlob read_asset(const std::filesystem::path &path)
+    {
+        ZoneScoped;
+        if (std::optional<AssetBlob> blob = find_archived_asset(path))
+        {
+            return std::move(*blob);
+        }
+        auto file = std::make_shared<const MappedFile>(path);
+        const std::span<const std::byte> data = file->data();
+        return AssetBlob(std::move(file), data);
+    }
+}
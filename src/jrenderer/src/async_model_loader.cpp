@@ -0,0 +1,290 @@
+#include "jrenderer/async_model_loader.h"
+#include "jrenderer/async_helper.hpp"
+#include "jrenderer/graphics.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace jre
+{
+    // 占位纹理的像素，和着色器里不用这张纹理时的默认值一致
+    static std::array<unsigned char, 4> get_placeholder_texel(TextureRole role)
+    {
+        switch (role)
+        {
+        case TextureRole::Data:
+            return {255, 255, 255, 0}; // 和 star_rail_shading.glsl 不用光照图时一样
+        case TextureRole::TwoChannel:
+            return {128, 128, 0, 0}; // 切线空间法线朝外
+        default:
+            return {255, 255, 255, 255};
+        }
+    }
+
+    AsyncModelLoader::AsyncModelLoader(Graphics &graphics, SceneDrawer &scene_drawer, TextureStreamer *texture_streamer, VirtualTextureSystem *virtual_textures, uint32_t thread_count)
+        : m_device(graphics.logical_device()),
+          m_physical_device(graphics.physical_device()),
+          m_scene_drawer(scene_drawer),
+          m_texture_streamer(texture_streamer),
+          m_texture_batch(graphics.logical_device(), {}, {}, scene_drawer.mip_generator.get()),
+          m_texture_loader(graphics.logical_device(), graphics.physical_device(), {}, {}, m_texture_batch),
+          m_frames(graphics.cpu_frames().size())
+    {
+        m_texture_loader.sampler_cache = scene_drawer.sampler_cache;
+        m_texture_loader.bindless_table = &scene_drawer.bindless_textures;
+        m_texture_loader.compressed_textures = scene_drawer.compressed_textures;
+        m_texture_loader.textures_per_submit = 0; // 录进每一帧的 command buffer，跟着帧提交
+        m_texture_loader.streamer = texture_streamer;
+        m_texture_loader.virtual_textures = virtual_textures;
+
+        // 占位的网格和纹理都很小，启动时同步建好
+        vk::SharedCommandBuffer command_buffer = vk::shared::allocate_one_command_buffer(graphics.transfer_command_pool());
+        std::array<Vertex, 1> vertices{};
+        std::array<uint32_t, 1> indices{};
+        m_placeholder_mesh = std::make_shared<Mesh>(DeviceMeshBuilder<Vertex, uint32_t>(m_device, m_physical_device, command_buffer.get(), graphics.transfer_queue().get(), vertices, indices).build());
+        m_placeholder_mesh->vertex_count = 0; // 没有 sub mesh，顶点预变换也跳过
+        for (TextureRole role : {TextureRole::Color, TextureRole::Data, TextureRole::TwoChannel, TextureRole::SingleChannel})
+        {
+            std::array<unsigned char, 4> texel = get_placeholder_texel(role);
+            TextureBuilder texture_builder(m_device, m_physical_device, command_buffer.get(), graphics.transfer_queue().get(), TextureData{1, 1, 4, texel.data()});
+            m_default_textures[static_cast<size_t>(role)] = texture_builder.set_generate_mipmaps(false).build();
+        }
+
+        for (uint32_t i = 0; i < std::max(1u, thread_count); ++i)
+        {
+            m_threads.emplace_back([this]
+                                   { prepare_loop(); });
+        }
+    }
+
+    AsyncModelLoader::~AsyncModelLoader()
+    {
+        m_jobs.close();
+        m_prepared.close();
+    }
+
+    AsyncModelHandle AsyncModelLoader::load(std::shared_ptr<IAsyncModelSource> source)
+    {
+        auto job = std::make_shared<Job>();
+        job->source = std::move(source);
+        job->model_index = static_cast<uint32_t>(m_scene_drawer.scene.models.size());
+        Model &model = m_scene_drawer.scene.models.emplace_back(m_scene_drawer.factory.create());
+        model.mesh = m_placeholder_mesh;
+        AsyncModelHandle handle{job->model_index, job->mesh_ready.get_future().share(), job->textures_ready.get_future().share()};
+        ++m_loading_count;
+        m_jobs.push(std::move(job));
+        return handle;
+    }
+
+    void AsyncModelLoader::prepare_loop()
+    {
+        while (std::optional<std::shared_ptr<Job>> job = m_jobs.pop())
+        {
+            ZoneScopedN("AsyncModelLoader::prepare");
+            try
+            {
+                (*job)->source->prepare();
+            }
+            catch (...)
+            {
+                (*job)->error = std::current_exception();
+            }
+            if (!m_prepared.push(std::move(*job)))
+            {
+                return;
+            }
+        }
+    }
+
+    void AsyncModelLoader::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        // 这个 cpu frame 的 fence 刚等过，上次用它录的拷贝都执行完了
+        FrameUploads &frame = m_frames[graphics.recording_cpu_frame()];
+        frame.staging_buffers.clear();
+        for (const Texture &placeholder : frame.retired)
+        {
+            m_scene_drawer.bindless_textures.release_texture(placeholder.bindless_index);
+        }
+        frame.retired.clear();
+        if (MipGenerator *mip_generator = m_texture_batch.mip_generator())
+        {
+            mip_generator->reset(graphics.recording_cpu_frame());
+        }
+        for (const std::string &filename : frame.textures)
+        {
+            PendingTexture &pending = m_textures.at(filename);
+            pending.complete = true;
+            try
+            {
+                pending.texture = pending.future.get();
+            }
+            catch (...)
+            {
+                // 加载失败就一直用占位的
+            }
+        }
+        replace_completed_textures();
+        // 等着它们的材质都换过了，之后来的 model 直接拿真的
+        for (const std::string &filename : frame.textures)
+        {
+            PendingTexture &pending = m_textures.at(filename);
+            if (pending.texture)
+            {
+                frame.retired.push_back(std::exchange(pending.placeholder, Texture{}));
+            }
+        }
+        frame.textures.clear();
+
+        m_texture_batch.record_into(command_buffer, graphics.recording_cpu_frame());
+        bool mesh_recorded = false;
+        for (uint32_t i = 0; i < models_per_frame; ++i)
+        {
+            std::optional<std::shared_ptr<Job>> job = m_prepared.try_pop();
+            if (!job)
+            {
+                break;
+            }
+            mesh_recorded |= create_model(command_buffer, frame, std::move(*job));
+        }
+
+        m_texture_loader.upload_ready(textures_per_frame);
+        std::erase_if(m_unrecorded_textures, [this, &frame](const std::string &filename)
+                      {
+                          PendingTexture &pending = m_textures.at(filename);
+                          if (!is_ready(pending.future))
+                          {
+                              return false;
+                          }
+                          frame.textures.push_back(filename);
+                          return true; });
+        std::ranges::move(m_texture_batch.take_staging_buffers(), std::back_inserter(frame.staging_buffers));
+
+        if (mesh_recorded)
+        {
+            // 顶点预变换在 compute 里读顶点，画的时候读索引
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                           vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader,
+                                           {},
+                                           vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+                                                             vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead),
+                                           nullptr, nullptr);
+        }
+    }
+
+    bool AsyncModelLoader::create_model(vk::CommandBuffer command_buffer, FrameUploads &frame, std::shared_ptr<Job> job_ptr)
+    {
+        ZoneScoped;
+        Job &job = *job_ptr;
+        if (!job.error)
+        {
+            AsyncModelContext context{m_device,
+                                      m_physical_device,
+                                      command_buffer,
+                                      frame.staging_buffers,
+                                      [this, &job](const TextureRequest &request)
+                                      { return request_texture(job, request); }};
+            try
+            {
+                AsyncModelParts parts = job.source->create(context);
+                Model &model = m_scene_drawer.scene.models[job.model_index];
+                model.mesh = std::move(parts.mesh);
+                model.materials = std::move(parts.materials);
+            }
+            catch (...)
+            {
+                job.error = std::current_exception();
+            }
+        }
+        if (job.error)
+        {
+            job.mesh_ready.set_exception(job.error);
+            job.textures_ready.set_exception(job.error);
+            --m_loading_count;
+            return false;
+        }
+        job.source.reset(); // 解析出来的数据用完了
+        job.mesh_ready.set_value();
+        if (job.waiting_textures.empty())
+        {
+            job.textures_ready.set_value();
+            --m_loading_count;
+        }
+        else
+        {
+            m_waiting_jobs.push_back(std::move(job_ptr));
+        }
+        return true;
+    }
+
+    Texture AsyncModelLoader::request_texture(Job &job, const TextureRequest &request)
+    {
+        auto [it, inserted] = m_textures.try_emplace(request.filename);
+        PendingTexture &pending = it->second;
+        if (inserted)
+        {
+            pending.placeholder = create_placeholder(request);
+            pending.future = m_texture_loader.load(request);
+            m_unrecorded_textures.push_back(request.filename);
+        }
+        if (pending.texture)
+        {
+            return resolve(*pending.texture); // 别的 model 已经加载好了
+        }
+        if (!pending.complete && !std::ranges::contains(job.waiting_textures, request.filename))
+        {
+            job.waiting_textures.push_back(request.filename);
+        }
+        return pending.placeholder;
+    }
+
+    Texture AsyncModelLoader::create_placeholder(const TextureRequest &request)
+    {
+        // 每个文件一个 image view，在无绑定表里各占一个位置，换的时候才分得清是哪个材质的哪张纹理
+        Texture placeholder = m_default_textures[static_cast<size_t>(request.role)];
+        placeholder.image_view = vk::SharedImageView(m_device->createImageView(vk::ImageViewCreateInfo({},
+                                                                                                       placeholder.image.get(),
+                                                                                                       vk::ImageViewType::e2D,
+                                                                                                       vk::Format::eR8G8B8A8Unorm,
+                                                                                                       {},
+                                                                                                       {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1})),
+                                                     m_device);
+        placeholder.sampler = m_scene_drawer.sampler_cache->get(request.sampler_create_info);
+        placeholder.bindless_index = m_scene_drawer.bindless_textures.register_texture(placeholder);
+        return placeholder;
+    }
+
+    Texture AsyncModelLoader::resolve(const Texture &texture) const
+    {
+        return m_texture_streamer ? m_texture_streamer->resolve(texture) : texture;
+    }
+
+    void AsyncModelLoader::replace_completed_textures()
+    {
+        std::erase_if(m_waiting_jobs, [this](const std::shared_ptr<Job> &job)
+                      {
+                          Model &model = m_scene_drawer.scene.models[job->model_index];
+                          std::erase_if(job->waiting_textures, [this, &model](const std::string &filename)
+                                        {
+                                            const PendingTexture &pending = m_textures.at(filename);
+                                            if (!pending.complete)
+                                            {
+                                                return false;
+                                            }
+                                            if (pending.texture)
+                                            {
+                                                for (const std::shared_ptr<IMaterialInstance> &material : model.materials)
+                                                {
+                                                    material->replace_texture(pending.placeholder, resolve(*pending.texture));
+                                                }
+                                            }
+                                            return true; });
+                          if (!job->waiting_textures.empty())
+                          {
+                              return false;
+                          }
+                          job->textures_ready.set_value();
+                          --m_loading_count;
+                          return true; });
+    }
+}
@@ -0,0 +1,117 @@
+#include "jrenderer/bindless_texture_table.h"
+#include "jrenderer/descriptor_update.hpp"
+#include <algorithm>
+
+namespace jre
+{
+    BindlessTextureTable::BindlessTextureTable(vk::SharedDevice device, vk::PhysicalDevice physical_device, vk::Buffer material_parameter_buffer)
+        : m_device(device)
+    {
+        vk::ShaderStageFlags all_stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+        std::array bindings = {vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eCombinedImageSampler, max_textures, all_stages},
+                               vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1, all_stages},
+                               vk::DescriptorSetLayoutBinding{2, vk::DescriptorType::eStorageBuffer, 1, all_stages},
+                               vk::DescriptorSetLayoutBinding{3, vk::DescriptorType::eStorageBuffer, 1, all_stages},
+                               vk::DescriptorSetLayoutBinding{4, vk::DescriptorType::eStorageBuffer, 1, all_stages},
+                               vk::DescriptorSetLayoutBinding{5, vk::DescriptorType::eStorageBuffer, 1, all_stages}};
+        // 纹理可以在 set 已经绑定、还在飞的时候往没在用的位置写 (追加或者复用释放的)，没注册的位置不会被访问
+        // 反馈和驻留位图只在有虚拟纹理系统时写，着色器只在虚拟纹理上访问
+        std::array<vk::DescriptorBindingFlags, 6> binding_flags = {vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending,
+                                                                   vk::DescriptorBindingFlags{},
+                                                                   vk::DescriptorBindingFlags{},
+                                                                   vk::DescriptorBindingFlags{},
+                                                                   vk::DescriptorBindingFlagBits::ePartiallyBound,
+                                                                   vk::DescriptorBindingFlagBits::ePartiallyBound};
+        vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo> layout_create_info{
+            vk::DescriptorSetLayoutCreateInfo{vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, bindings},
+            vk::DescriptorSetLayoutBindingFlagsCreateInfo{binding_flags}};
+        m_descriptor_set_layout = vk::SharedDescriptorSetLayout(m_device->createDescriptorSetLayout(layout_create_info.get<vk::DescriptorSetLayoutCreateInfo>()), m_device);
+
+        std::array pool_sizes = {vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, max_textures},
+                                 vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 5}};
+        m_descriptor_pool = vk::SharedDescriptorPool(m_device->createDescriptorPool(vk::DescriptorPoolCreateInfo{vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+                                                                                                                 1,
+                                                                                                                 pool_sizes}),
+                                                     m_device);
+        m_descriptor_set = vk::shared::allocate_one_descriptor_set(m_descriptor_pool, m_descriptor_set_layout.get());
+
+        m_material_buffer = HostArrayBufferBuilder<glm::uvec4>(m_device, physical_device, sizeof(glm::uvec4) * max_materials)
+                                .set_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+                                .build();
+        m_virtual_texture_buffer = HostArrayBufferBuilder<glm::uvec4>(m_device, physical_device, sizeof(glm::uvec4) * max_textures)
+                                       .set_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+                                       .build();
+        DescripterSetUpdater(m_descriptor_set)
+            .write_storage_buffer(vk::DescriptorBufferInfo{m_material_buffer.vk_buffer(), 0, VK_WHOLE_SIZE}, 1)
+            .write_storage_buffer(vk::DescriptorBufferInfo{material_parameter_buffer, 0, VK_WHOLE_SIZE}, 2)
+            .write_storage_buffer(vk::DescriptorBufferInfo{m_virtual_texture_buffer.vk_buffer(), 0, VK_WHOLE_SIZE}, 3)
+            .update();
+    }
+
+    void BindlessTextureTable::set_virtual_texture_buffers(vk::Buffer feedback_buffer, vk::Buffer residency_buffer)
+    {
+        DescripterSetUpdater(m_descriptor_set)
+            .write_storage_buffer(vk::DescriptorBufferInfo{feedback_buffer, 0, VK_WHOLE_SIZE}, 4)
+            .write_storage_buffer(vk::DescriptorBufferInfo{residency_buffer, 0, VK_WHOLE_SIZE}, 5)
+            .update();
+    }
+
+    uint32_t BindlessTextureTable::register_texture(const DeviceImage &texture)
+    {
+        auto it = m_texture_indices.find(texture.image_view.get());
+        if (it != m_texture_indices.end())
+        {
+            return it->second;
+        }
+        uint32_t texture_index;
+        if (!m_free_texture_indices.empty())
+        {
+            texture_index = m_free_texture_indices.back();
+            m_free_texture_indices.pop_back();
+        }
+        else if (m_texture_slot_count < max_textures)
+        {
+            texture_index = m_texture_slot_count++;
+        }
+        else
+        {
+            throw std::runtime_error("bindless texture table is full");
+        }
+        m_texture_indices.emplace(texture.image_view.get(), texture_index);
+        m_virtual_texture_buffer[texture_index] = glm::uvec4(0); // 复用的位置可能是虚拟纹理留下的
+        DescripterSetUpdater(m_descriptor_set)
+            .write_combined_image_sampler(vk::DescriptorImageInfo{texture.sampler.get(), texture.image_view.get(), vk::ImageLayout::eShaderReadOnlyOptimal}, 0, texture_index)
+            .update();
+        return texture_index;
+    }
+
+    void BindlessTextureTable::release_texture(uint32_t texture_index)
+    {
+        auto it = std::ranges::find_if(m_texture_indices, [texture_index](const auto &entry)
+                                       { return entry.second == texture_index; });
+        assert(it != m_texture_indices.end());
+        m_texture_indices.erase(it); // image view 之后可能被销毁，句柄再被别的纹理用上
+        m_free_texture_indices.push_back(texture_index);
+    }
+
+    uint32_t BindlessTextureTable::register_material(std::span<const uint32_t> texture_indices)
+    {
+        assert(texture_indices.size() <= max_material_textures);
+        if (m_material_count >= max_materials)
+        {
+            throw std::runtime_error("bindless material table is full");
+        }
+        glm::uvec4 record(invalid_index);
+        std::ranges::copy(texture_indices, &record.x);
+        m_material_buffer[m_material_count] = record;
+        return m_material_count++;
+    }
+
+    void BindlessTextureTable::update_material(uint32_t material_id, std::span<const uint32_t> texture_indices)
+    {
+        assert(material_id < m_material_count && texture_indices.size() <= max_material_textures);
+        glm::uvec4 record(invalid_index);
+        std::ranges::copy(texture_indices, &record.x);
+        m_material_buffer[material_id] = record;
+    }
+}
@@ -0,0 +1,152 @@
+#include "jrenderer/asset/derived_data_cache.h"
+#include "jrenderer/utils/hash.h"
+#include "tracy/Tracy.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace jre
+{
+    namespace
+    {
+        struct ContentHashEntry
+        {
+            uintmax_t size;
+            std::filesystem::file_time_type write_time;
+            uint64_t hash;
+        };
+
+        struct ContentHashMemo
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string, ContentHashEntry> entries;
+        };
+
+        ContentHashMemo &content_hash_memo()
+        {
+            static ContentHashMemo memo;
+            return memo;
+        }
+    }
+
+    uint64_t hash_asset_content(const std::filesystem::path &path)
+    {
+        // 打包文件里的不会变，大小和时间都记 0
+        const std::string name = AssetArchive::normalize_name(path);
+        ContentHashEntry stamp{};
+        if (!contains_archived_asset(path))
+        {
+            stamp.size = std::filesystem::file_size(path);
+            stamp.write_time = std::filesystem::last_write_time(path);
+        }
+        ContentHashMemo &memo = content_hash_memo();
+        {
+            std::lock_guard lock(memo.mutex);
+            auto it = memo.entries.find(name);
+            if (it != memo.entries.end() && it->second.size == stamp.size && it->second.write_time == stamp.write_time)
+            {
+                return it->second.hash;
+            }
+        }
+        ZoneScoped;
+        stamp.hash = xxhash64(read_asset(path).data());
+        std::lock_guard lock(memo.mutex);
+        memo.entries[name] = stamp;
+        return stamp.hash;
+    }
+
+    DerivedDataKey::DerivedDataKey(std::string_view cooker, uint32_t version)
+        : m_hash(0)
+    {
+        add(cooker);
+        add_value(version);
+    }
+
+    DerivedDataKey &DerivedDataKey::add(std::span<const std::byte> bytes)
+    {
+        // 带上长度，"ab" + "c" 和 "a" + "bc" 不一样
+        const uint64_t size = bytes.size();
+        m_hash = xxhash64(std::as_bytes(std::span(&size, 1)), m_hash);
+        m_hash = xxhash64(bytes, m_hash);
+        return *this;
+    }
+
+    DerivedDataCache::DerivedDataCache(std::filesystem::path directory)
+        : m_directory(std::move(directory))
+    {
+    }
+
+    std::filesystem::path DerivedDataCache::get_entry_path(uint64_t key) const
+    {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        // 分一层子目录，免得一个目录里文件太多
+        return m_directory / std::string_view(name, 2) / (std::string(name) + ".bin");
+    }
+
+    std::optional<AssetBlob> DerivedDataCache::find(uint64_t key) const
+    {
+        const std::filesystem::path path = get_entry_path(key);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error))
+        {
+            return std::nullopt;
+        }
+        auto file = std::make_shared<const MappedFile>(path);
+        const std::span<const std::byte> data = file->data();
+        return AssetBlob(std::move(file), data);
+    }
+
+    void DerivedDataCache::put(uint64_t key, std::span<const std::byte> data) const
+    {
+        ZoneScoped;
+        const std::filesystem::path path = get_entry_path(key);
+        std::filesystem::create_directories(path.parent_path());
+        // 每次写换一个临时文件名，几个线程同时烘焙同一个键不会写进同一个临时文件
+        static std::atomic<uint32_t> temp_counter = 0;
+        std::filesystem::path temp_path = path;
+        temp_path += "." + std::to_string(temp_counter++) + ".tmp";
+        {
+            std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char *>(data.data()), data.size());
+            if (!stream)
+            {
+                throw std::runtime_error("DerivedDataCache: failed to write " + temp_path.string());
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+        if (error)
+        {
+            // Windows 上目标正被别人映射着的时候改名会失败，那边写的是一样的内容
+            std::filesystem::remove(temp_path, error);
+        }
+    }
+
+    AssetBlob DerivedDataCache::find_or_cook(uint64_t key, const std::function<std::vector<std::byte>()> &cook) const
+    {
+        if (std::optional<AssetBlob> blob = find(key))
+        {
+            return std::move(*blob);
+        }
+        std::vector<std::byte> data = cook();
+        try
+        {
+            put(key, data);
+        }
+        catch (const std::exception &)
+        {
+            // 只是下次还要再烘焙
+        }
+        return AssetBlob(std::move(data));
+    }
+
+    const DerivedDataCache &default_derived_data_cache()
+    {
+        static const DerivedDataCache cache("cache/ddc");
+        return cache;
+    }
+}
@@ -0,0 +1,129 @@
+#include "jrenderer/descriptor_allocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace jre
+{
+    vk::SharedDescriptorSetLayout DescriptorSetLayoutCache::get(vk::ArrayProxy<const vk::DescriptorSetLayoutBinding> bindings)
+    {
+        std::vector<BindingKey> key;
+        for (const vk::DescriptorSetLayoutBinding &binding : bindings)
+        {
+            assert(!binding.pImmutableSamplers);
+            key.emplace_back(binding.binding, binding.descriptorType, binding.descriptorCount, static_cast<vk::ShaderStageFlags::MaskType>(binding.stageFlags));
+        }
+        std::ranges::sort(key); // 和 binding 的书写顺序无关
+
+        auto [it, inserted] = m_layouts.try_emplace(std::move(key));
+        if (inserted)
+        {
+            it->second = vk::SharedDescriptorSetLayout(m_device->createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, bindings)), m_device);
+        }
+        return it->second;
+    }
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> DescriptorAllocator::default_pool_size_ratios()
+    {
+        return {{vk::DescriptorType::eUniformBuffer, 2.0f},
+                {vk::DescriptorType::eStorageBuffer, 2.0f},
+                {vk::DescriptorType::eCombinedImageSampler, 4.0f},
+                {vk::DescriptorType::eStorageImage, 1.0f}};
+    }
+
+    DescriptorAllocator::DescriptorAllocator(vk::SharedDevice device,
+                                             vk::DescriptorPoolCreateFlags flags,
+                                             uint32_t initial_sets,
+                                             std::vector<PoolSizeRatio> pool_size_ratios)
+        : m_device(device),
+          m_flags(flags),
+          m_pool_size_ratios(std::move(pool_size_ratios)),
+          m_next_pool_sets(initial_sets)
+    {
+    }
+
+    vk::SharedDescriptorSet DescriptorAllocator::allocate(vk::DescriptorSetLayout layout)
+    {
+        assert(m_flags & vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+        auto [descriptor_set, pool] = allocate_from_pools(layout);
+        return vk::SharedDescriptorSet(descriptor_set, m_device, pool);
+    }
+
+    std::vector<vk::SharedDescriptorSet> DescriptorAllocator::allocate(const std::vector<vk::DescriptorSetLayout> &layouts)
+    {
+        std::vector<vk::SharedDescriptorSet> descriptor_sets;
+        descriptor_sets.reserve(layouts.size());
+        for (vk::DescriptorSetLayout layout : layouts)
+        {
+            descriptor_sets.push_back(allocate(layout));
+        }
+        return descriptor_sets;
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocate_transient(vk::DescriptorSetLayout layout)
+    {
+        return std::get<vk::DescriptorSet>(allocate_from_pools(layout));
+    }
+
+    void DescriptorAllocator::reset()
+    {
+        for (vk::SharedDescriptorPool &pool : m_pools)
+        {
+            m_device->resetDescriptorPool(pool.get());
+        }
+        m_current_pool = 0;
+        m_allocated_count = 0;
+    }
+
+    std::tuple<vk::DescriptorSet, vk::SharedDescriptorPool> DescriptorAllocator::allocate_from_pools(vk::DescriptorSetLayout layout)
+    {
+        // 常驻的 set 会还回各自的 pool，从当前的开始绕一圈；临时的只往后找
+        size_t tried = (m_flags & vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet) ? 0 : m_current_pool;
+        while (true)
+        {
+            bool fresh_pool = false;
+            if (tried == m_pools.size())
+            {
+                m_current_pool = m_pools.size();
+                m_pools.push_back(create_pool());
+                fresh_pool = true;
+            }
+            else if (m_current_pool == m_pools.size())
+            {
+                m_current_pool = 0;
+            }
+            vk::DescriptorSetAllocateInfo allocate_info(m_pools[m_current_pool].get(), layout);
+            vk::DescriptorSet descriptor_set;
+            vk::Result result = m_device->allocateDescriptorSets(&allocate_info, &descriptor_set);
+            if (result == vk::Result::eSuccess)
+            {
+                ++m_allocated_count;
+                return {descriptor_set, m_pools[m_current_pool]};
+            }
+            if (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool)
+            {
+                vk::detail::resultCheck(result, "DescriptorAllocator::allocate");
+            }
+            if (fresh_pool && m_next_pool_sets >= max_sets_per_pool)
+            {
+                // 最大的空 pool 都放不下，layout 里有 pool_size_ratios 没留的类型，或者一个 set 要的太多
+                throw std::runtime_error("descriptor set layout does not fit in an empty descriptor pool");
+            }
+            ++tried;
+            ++m_current_pool;
+        }
+    }
+
+    vk::SharedDescriptorPool DescriptorAllocator::create_pool()
+    {
+        const uint32_t set_count = m_next_pool_sets;
+        m_next_pool_sets = std::min(m_next_pool_sets * 2, max_sets_per_pool);
+        std::vector<vk::DescriptorPoolSize> pool_sizes;
+        for (const PoolSizeRatio &ratio : m_pool_size_ratios)
+        {
+            pool_sizes.emplace_back(ratio.type, static_cast<uint32_t>(std::ceil(ratio.ratio * set_count)));
+        }
+        return vk::SharedDescriptorPool(m_device->createDescriptorPool(vk::DescriptorPoolCreateInfo(m_flags, set_count, pool_sizes)), m_device);
+    }
+}
@@ -22,7 +22,11 @@ namespace jre
         create_render_pass();
         create_framebuffers();
         create_cpu_frames();
-        m_model_transform_manager = ModelTransformFactory(m_logical_device, m_physical_device);
+        m_descriptor_set_layouts = DescriptorSetLayoutCache(m_logical_device);
+        m_descriptor_allocator = DescriptorAllocator(m_logical_device);
+        m_sampler_cache = SamplerCache(m_logical_device);
+        m_shader_modules = std::make_unique<ShaderModuleCache>(ShaderModuleCreator{m_logical_device}, 8ull << 20);
+        m_model_transform_manager = ModelTransformFactory(static_cast<uint32_t>(m_cpu_frames.size()));
     };
 
     void Graphics::create_instance()
@@ -168,13 +172,48 @@ namespace jre
         // Create logic device from physical device
         std::array<const char *, 1> wanted_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME}; // swap chain 需要定义extension，否则会段错误，它应该是dll来的
 
+        // 多视口用 instance 一次画完，顶点着色器要写 gl_ViewportIndex；不支持的话只画一个视口，用 _single_view 的顶点着色器
+        const auto supported_features = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        m_multi_viewport = m_physical_device_info.features.multiViewport && supported_features.get<vk::PhysicalDeviceVulkan12Features>().shaderOutputViewportIndex;
+        // 无绑定纹理表：运行时长度的纹理数组，没注册的位置不填，绑定后还能追加；可见性缓冲的 compute 里按像素的材质取纹理
+        const vk::PhysicalDeviceVulkan12Features &supported_features12 = supported_features.get<vk::PhysicalDeviceVulkan12Features>();
+        if (!supported_features12.runtimeDescriptorArray ||
+            !supported_features12.descriptorBindingPartiallyBound ||
+            !supported_features12.descriptorBindingSampledImageUpdateAfterBind ||
+            !supported_features12.descriptorBindingUpdateUnusedWhilePending ||
+            !supported_features12.shaderSampledImageArrayNonUniformIndexing)
+        {
+            throw std::runtime_error("GPU do not support descriptor indexing for bindless textures");
+        }
+        // 虚拟纹理用稀疏 image，绑定放在图形队列上；反馈位图在片元着色器里 atomicOr，要 fragmentStoresAndAtomics。
+        // 不支持的话大纹理走整级的 mip 流送，材质用不写反馈的片元着色器
+        m_sparse_residency = m_physical_device_info.features.fragmentStoresAndAtomics &&
+                             m_physical_device_info.features.sparseBinding &&
+                             m_physical_device_info.features.sparseResidencyImage2D &&
+                             (properties[m_graphics_queue_family_index].queueFlags & vk::QueueFlagBits::eSparseBinding);
+
         vk::PhysicalDeviceVulkan12Features features;
         features.setScalarBlockLayout(true); // shader中使用的layout有std430，#extension GL_EXT_scalar_block_layout : enable。需要在这里设置，否则validation layer会报错
+        features.setShaderOutputViewportIndex(m_multi_viewport);
+        features.setRuntimeDescriptorArray(true)
+            .setDescriptorBindingPartiallyBound(true)
+            .setDescriptorBindingSampledImageUpdateAfterBind(true)
+            .setDescriptorBindingUpdateUnusedWhilePending(true)
+            .setShaderSampledImageArrayNonUniformIndexing(true);
+        vk::PhysicalDeviceFeatures enabled_features;
+        m_geometry_shader = m_physical_device_info.features.geometryShader;
+        enabled_features.setGeometryShader(m_geometry_shader); // 可见性缓冲的片元着色器要读 gl_PrimitiveID，不支持就不建可见性缓冲
+        enabled_features.setMultiViewport(m_multi_viewport);
+        enabled_features.setShaderStorageImageArrayDynamicIndexing(m_physical_device_info.features.shaderStorageImageArrayDynamicIndexing); // MipGenerator 按级下标取 storage image
+        enabled_features.setTextureCompressionBC(m_physical_device_info.features.textureCompressionBC); // 烘焙好的 BC4/BC5/BC7 纹理
+        enabled_features.setFragmentStoresAndAtomics(m_sparse_residency);
+        enabled_features.setSparseBinding(m_sparse_residency).setSparseResidencyImage2D(m_sparse_residency);
 
         create_info.setQueueCreateInfos(queue_create_infos)
             .setQueueCreateInfoCount(static_cast<uint32_t>(queue_create_infos.size()))
             .setEnabledExtensionCount(static_cast<uint32_t>(wanted_extensions.size()))
             .setPpEnabledExtensionNames(wanted_extensions.data())
+            .setPEnabledFeatures(&enabled_features)
             .setPNext(&features);
         m_logical_device = vk::SharedDevice{m_physical_device.createDevice(create_info)}; // 没有引用住SharedInstance，会报错。graphics以外的对象(windows的回调)引用住vulkan资源就会有问题
 
@@ -303,13 +342,16 @@ namespace jre
         {
             resolve_attachment = builder.add_resolve_attachment(m_surface_format.format);
             depth_attachment = builder.add_depth_attachment(vk::su::pickDepthFormat(m_physical_device),
-                                                            m_settings.msaa);
+                                                            m_settings.msaa,
+                                                            vk::AttachmentStoreOp::eStore); // 保留深度给Hi-Z等后续pass读取
             color_attachment = builder.add_color_attachment(m_surface_format.format, m_settings.msaa);
         }
         else
         {
             color_attachment = builder.add_color_attachment(m_surface_format.format);
-            depth_attachment = builder.add_depth_attachment(vk::su::pickDepthFormat(m_physical_device));
+            depth_attachment = builder.add_depth_attachment(vk::su::pickDepthFormat(m_physical_device),
+                                                            vk::SampleCountFlagBits::e1,
+                                                            vk::AttachmentStoreOp::eStore);
         }
 
         builder.add_subpass(
@@ -351,7 +393,8 @@ namespace jre
         bool msaa_enabled = m_settings.msaa > vk::SampleCountFlagBits::e1;
         auto depth_builder = DepthStencilAttachment2DBuilder(m_logical_device, m_physical_device)
                                  .set_extent(m_swapchain_extent)
-                                 .set_sample_count(m_settings.msaa);
+                                 .set_sample_count(m_settings.msaa)
+                                 .set_usage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled);
         m_depth_images.clear();
         for (auto _ : std::views::iota(0u, m_swapchain_image_views.size()))
         {
@@ -415,7 +458,8 @@ namespace jre
                                                    vk::SharedSemaphore(m_logical_device->createSemaphore({}), m_logical_device),
                                                    vk::SharedSemaphore(m_logical_device->createSemaphore({}), m_logical_device),
                                                    vk::SharedFence(m_logical_device->createFence({vk::FenceCreateFlagBits::eSignaled}), m_logical_device),
-                                                   command_buffers[index]}; }) |
+                                                   command_buffers[index],
+                                                   DescriptorAllocator(m_logical_device, {})}; }) |
                        std::ranges::to<std::vector>();
         m_current_cpu_frame = m_cpu_frames.begin();
     }
@@ -432,6 +476,8 @@ namespace jre
             CPUFrame &cpu_frame = *m_current_cpu_frame;
             check(m_logical_device->waitForFences({cpu_frame.in_flight_fence.get()}, false, std::numeric_limits<uint64_t>::max()));
             m_logical_device->resetFences({cpu_frame.in_flight_fence.get()});
+            m_recording_cpu_frame = current_cpu_frame();
+            cpu_frame.transient_descriptors.reset(); // 上一次用它们的提交已经结束
 
             auto cyclic_next = [](auto &it, auto &container) mutable
             { return std::next(it) == container.end() ? it = container.begin() : ++it; };
@@ -443,12 +489,20 @@ namespace jre
             vk::SharedCommandBuffer command_buffer = cpu_frame.command_buffer;
             command_buffer->reset();
             command_buffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+            for (auto &recorder : pre_render_pass_recorders)
+            {
+                recorder->draw(*this, cpu_frame.command_buffer.get());
+            }
             m_render_pass_drawer.draw(
                 *this,
                 cpu_frame.command_buffer.get(),
                 m_framebuffers[m_current_frame_buffer_index],
                 m_clear_values,
                 {{0, 0}, m_swapchain_extent});
+            for (auto &recorder : post_render_pass_recorders)
+            {
+                recorder->draw(*this, cpu_frame.command_buffer.get());
+            }
             cpu_frame.command_buffer->end();
             submit(m_graphics_queue.get(),
                    {command_buffer.get()},
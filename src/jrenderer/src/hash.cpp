@@ -0,0 +1,100 @@
+#include "jrenderer/utils/hash.h"
+#include <bit>
+#include <cstring>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+        // 小端机器上直接读
+        uint64_t read64(const std::byte *p)
+        {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t read32(const std::byte *p)
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint64_t round(uint64_t accumulator, uint64_t input)
+        {
+            accumulator += input * prime2;
+            accumulator = std::rotl(accumulator, 31);
+            return accumulator * prime1;
+        }
+
+        uint64_t merge_round(uint64_t accumulator, uint64_t value)
+        {
+            accumulator ^= round(0, value);
+            return accumulator * prime1 + prime4;
+        }
+    }
+
+    uint64_t xxhash64(std::span<const std::byte> data, uint64_t seed)
+    {
+        const std::byte *p = data.data();
+        const std::byte *end = p + data.size();
+        uint64_t hash;
+        if (data.size() >= 32)
+        {
+            uint64_t v1 = seed + prime1 + prime2;
+            uint64_t v2 = seed + prime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - prime1;
+            const std::byte *limit = end - 32;
+            do
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+            hash = merge_round(hash, v1);
+            hash = merge_round(hash, v2);
+            hash = merge_round(hash, v3);
+            hash = merge_round(hash, v4);
+        }
+        else
+        {
+            hash = seed + prime5;
+        }
+        hash += data.size();
+
+        for (; p + 8 <= end; p += 8)
+        {
+            hash ^= round(0, read64(p));
+            hash = std::rotl(hash, 27) * prime1 + prime4;
+        }
+        if (p + 4 <= end)
+        {
+            hash ^= read32(p) * prime1;
+            hash = std::rotl(hash, 23) * prime2 + prime3;
+            p += 4;
+        }
+        for (; p < end; ++p)
+        {
+            hash ^= static_cast<uint8_t>(*p) * prime5;
+            hash = std::rotl(hash, 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
@@ -0,0 +1,261 @@
+#include "jrenderer/culling/hiz_occlusion_culler.h"
+#include "jrenderer/graphics.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/texture.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/descriptor_update.hpp"
+#include "tracy/Tracy.hpp"
+#include <ranges>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr uint32_t group_size = 8;
+
+        uint32_t group_count(uint32_t size) { return (size + group_size - 1) / group_size; }
+
+        vk::Extent2D mip_extent(vk::Extent2D extent, uint32_t level)
+        {
+            return {std::max(1u, extent.width >> level), std::max(1u, extent.height >> level)};
+        }
+
+        vk::ImageMemoryBarrier hiz_barrier(vk::Image image,
+                                           uint32_t base_level,
+                                           uint32_t level_count,
+                                           vk::AccessFlags src_access,
+                                           vk::AccessFlags dst_access,
+                                           vk::ImageLayout old_layout = vk::ImageLayout::eGeneral)
+        {
+            return vk::ImageMemoryBarrier(src_access, dst_access,
+                                          old_layout, vk::ImageLayout::eGeneral,
+                                          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                          image,
+                                          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, base_level, level_count, 0, 1));
+        }
+    }
+
+    HiZOcclusionCuller::HiZOcclusionCuller(Graphics &graphics, Scene &scene) : m_scene(scene)
+    {
+        vk::SharedDevice device = graphics.logical_device();
+        m_init_shader = vk::shared::create_shader_from_spv_file(device, "res/shaders/hiz_init.comp.spv");
+        m_init_ms_shader = vk::shared::create_shader_from_spv_file(device, "res/shaders/hiz_init_ms.comp.spv");
+        m_downsample_shader = vk::shared::create_shader_from_spv_file(device, "res/shaders/hiz_downsample.comp.spv");
+        m_depth_sampler = graphics.sampler_cache().get(vk::SamplerCreateInfo{}
+                                                           .setMagFilter(vk::Filter::eNearest)
+                                                           .setMinFilter(vk::Filter::eNearest)
+                                                           .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+                                                           .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+                                                           .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+                                                           .setAddressModeW(vk::SamplerAddressMode::eClampToEdge));
+        create_resources(graphics);
+    }
+
+    void HiZOcclusionCuller::create_resources(Graphics &graphics)
+    {
+        vk::SharedDevice device = graphics.logical_device();
+        m_extent = graphics.swapchain_extent();
+        m_sample_count = graphics.settings().msaa;
+        m_mip_levels = get_mipmap_levels(m_extent.width, m_extent.height);
+        m_readback_level = 0;
+        while (m_readback_level + 1 < m_mip_levels &&
+               std::max(mip_extent(m_extent, m_readback_level).width, mip_extent(m_extent, m_readback_level).height) > readback_max_size)
+        {
+            ++m_readback_level;
+        }
+        m_readback_extent = mip_extent(m_extent, m_readback_level);
+
+        DeviceImageBuilder image_builder(device, graphics.physical_device());
+        image_builder.set_image_create_info(vk::ImageCreateInfo{
+            {},
+            vk::ImageType::e2D,
+            vk::Format::eR32Sfloat,
+            vk::Extent3D{m_extent.width, m_extent.height, 1},
+            m_mip_levels,
+            1,
+            vk::SampleCountFlagBits::e1,
+            vk::ImageTiling::eOptimal,
+            vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc,
+            vk::SharingMode::eExclusive});
+        image_builder.image_view_create_info.setViewType(vk::ImageViewType::e2D)
+            .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, m_mip_levels, 0, 1));
+        image_builder.memory_properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        m_hiz_image = image_builder.build();
+
+        m_mip_views.clear();
+        for (uint32_t level : std::views::iota(0u, m_mip_levels))
+        {
+            SharedImageViewBuilder view_builder(device, m_hiz_image.image.get());
+            view_builder.image_view_create_info.setViewType(vk::ImageViewType::e2D)
+                .setFormat(vk::Format::eR32Sfloat)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+            m_mip_views.push_back(view_builder.build());
+        }
+
+        std::list<DeviceImage> &depth_images = graphics.depth_images();
+        std::tie(m_init_descriptor_pool, m_init_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            device,
+            static_cast<uint32_t>(depth_images.size()),
+            {{{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute},
+              {1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}}});
+        m_init_descriptor_sets.clear();
+        for (DeviceImage &depth_image : depth_images)
+        {
+            vk::SharedDescriptorSet descriptor_set = vk::shared::allocate_one_descriptor_set(m_init_descriptor_pool, m_init_descriptor_set_layout.get());
+            DescripterSetUpdater(descriptor_set)
+                .write_combined_image_sampler(vk::DescriptorImageInfo{m_depth_sampler.get(), depth_image.image_view.get(), vk::ImageLayout::eShaderReadOnlyOptimal})
+                .write_storage_image(m_mip_views[0].get())
+                .update();
+            m_init_descriptor_sets.push_back(descriptor_set);
+        }
+
+        std::tie(m_downsample_descriptor_pool, m_downsample_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            device,
+            std::max(1u, m_mip_levels - 1),
+            {{{0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute},
+              {1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}}});
+        m_downsample_descriptor_sets.clear();
+        for (uint32_t level : std::views::iota(1u, m_mip_levels))
+        {
+            vk::SharedDescriptorSet descriptor_set = vk::shared::allocate_one_descriptor_set(m_downsample_descriptor_pool, m_downsample_descriptor_set_layout.get());
+            DescripterSetUpdater(descriptor_set)
+                .write_storage_image(m_mip_views[level - 1].get())
+                .write_storage_image(m_mip_views[level].get())
+                .update();
+            m_downsample_descriptor_sets.push_back(descriptor_set);
+        }
+
+        vk::PushConstantRange push_constant_range{vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants)};
+        m_init_pipeline_layout = vk::shared::create_pipeline_layout(device, m_init_descriptor_set_layout.get(), push_constant_range);
+        m_downsample_pipeline_layout = vk::shared::create_pipeline_layout(device, m_downsample_descriptor_set_layout.get(), push_constant_range);
+        m_init_pipeline = ComputePipelineBuilder(device, m_init_pipeline_layout.get())
+                              .set_shader(m_sample_count > vk::SampleCountFlagBits::e1 ? m_init_ms_shader.get() : m_init_shader.get())
+                              .build();
+        m_downsample_pipeline = ComputePipelineBuilder(device, m_downsample_pipeline_layout.get())
+                                    .set_shader(m_downsample_shader.get())
+                                    .build();
+
+        m_readbacks.clear();
+        for (auto _ : std::views::iota(0u, graphics.cpu_frames().size()))
+        {
+            m_readbacks.push_back({HostVisibleDynamicBufferBuilder(device,
+                                                                   graphics.physical_device(),
+                                                                   sizeof(float) * m_readback_extent.width * m_readback_extent.height)
+                                       .set_usage(vk::BufferUsageFlagBits::eTransferDst)
+                                       .build()});
+        }
+        reset();
+    }
+
+    void HiZOcclusionCuller::reset()
+    {
+        for (FrameReadback &readback : m_readbacks)
+        {
+            readback.valid = false;
+        }
+        m_valid = false;
+    }
+
+    void HiZOcclusionCuller::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        // 这个cpu frame的fence已经等过了，上一次在这里录制的回读已经完成
+        FrameReadback &readback = m_readbacks[graphics.recording_cpu_frame()];
+        if (readback.valid)
+        {
+            const float *data = static_cast<const float *>(readback.buffer.mapped_memory());
+            m_depth.assign(data, data + m_readback_extent.width * m_readback_extent.height);
+            m_view_proj = readback.view_proj;
+            m_viewport = readback.viewport;
+            m_valid = true;
+        }
+
+        DeviceImage &depth_image = graphics.depth_image(graphics.current_frame_buffer_index());
+        vk::Image hiz_image = m_hiz_image.image.get();
+
+        vk::ImageMemoryBarrier depth_barrier(vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eShaderRead,
+                                             vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                             VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                             depth_image.image.get(),
+                                             vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
+        // m_hiz_image 所有 cpu frame 共用：还要等上一帧的下采样写完 (WAW)、回读拷完 (WAR) 再覆盖
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests |
+                                           vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                                       vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr, nullptr,
+                                       {depth_barrier,
+                                        hiz_barrier(hiz_image, 0, m_mip_levels, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined)});
+
+        PushConstants push_constants{{m_extent.width, m_extent.height}, {m_extent.width, m_extent.height}, static_cast<int>(m_sample_count)};
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_init_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_init_pipeline_layout.get(), 0, m_init_descriptor_sets[graphics.current_frame_buffer_index()].get(), nullptr);
+        command_buffer.pushConstants<PushConstants>(m_init_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+        command_buffer.dispatch(group_count(m_extent.width), group_count(m_extent.height), 1);
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_downsample_pipeline.get());
+        for (uint32_t level : std::views::iota(1u, m_mip_levels))
+        {
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                           {}, nullptr, nullptr,
+                                           hiz_barrier(hiz_image, level - 1, 1, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+            vk::Extent2D src_extent = mip_extent(m_extent, level - 1);
+            vk::Extent2D dst_extent = mip_extent(m_extent, level);
+            push_constants.src_extent = {src_extent.width, src_extent.height};
+            push_constants.dst_extent = {dst_extent.width, dst_extent.height};
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_downsample_pipeline_layout.get(), 0, m_downsample_descriptor_sets[level - 1].get(), nullptr);
+            command_buffer.pushConstants<PushConstants>(m_downsample_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+            command_buffer.dispatch(group_count(dst_extent.width), group_count(dst_extent.height), 1);
+        }
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                                       {}, nullptr, nullptr,
+                                       hiz_barrier(hiz_image, m_readback_level, 1, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead));
+        command_buffer.copyImageToBuffer(hiz_image, vk::ImageLayout::eGeneral, readback.buffer.vk_buffer(),
+                                         vk::BufferImageCopy(0, 0, 0,
+                                                             vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, m_readback_level, 0, 1),
+                                                             {0, 0, 0},
+                                                             {m_readback_extent.width, m_readback_extent.height, 1}));
+        vk::BufferMemoryBarrier readback_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+                                                 VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                 readback.buffer.vk_buffer(), 0, VK_WHOLE_SIZE);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                                       {}, nullptr, readback_barrier, nullptr);
+
+        // 下一个 render pass 以 eUndefined 开始，这里不用把深度转回去
+        readback.view_proj = m_scene.scene_buffers[graphics.current_cpu_frame()].cameras[0].view_proj;
+        readback.viewport = m_scene.render_viewports[0].viewport;
+        readback.valid = true;
+    }
+
+    bool HiZOcclusionCuller::is_visible(const BoundingBox &bounds, const glm::mat4 &model) const
+    {
+        if (!m_valid || bounds.empty())
+        {
+            return true;
+        }
+        std::optional<ScreenRect> rect = project_bounds(bounds, m_view_proj * model);
+        if (!rect || !rect->overlaps_viewport())
+        {
+            return true;
+        }
+
+        // 视口uv -> framebuffer 像素 -> 回读 mip 的 texel，向外多扩一个 texel 保证保守
+        glm::vec2 readback_extent(m_readback_extent.width, m_readback_extent.height);
+        glm::vec2 texel_scale = readback_extent / glm::vec2(m_extent.width, m_extent.height);
+        auto to_texel = [&](glm::vec2 uv)
+        { return (glm::vec2(m_viewport.x, m_viewport.y) + uv * glm::vec2(m_viewport.width, m_viewport.height)) * texel_scale; };
+        glm::ivec2 max_texel = glm::ivec2(readback_extent) - 1;
+        glm::ivec2 min_corner = glm::clamp(glm::ivec2(glm::floor(to_texel(rect->min))) - 1, glm::ivec2(0), max_texel);
+        glm::ivec2 max_corner = glm::clamp(glm::ivec2(glm::floor(to_texel(rect->max))) + 1, glm::ivec2(0), max_texel);
+
+        float farthest = 0.0f;
+        for (int y = min_corner.y; y <= max_corner.y; ++y)
+        {
+            for (int x = min_corner.x; x <= max_corner.x; ++x)
+            {
+                farthest = std::max(farthest, m_depth[y * m_readback_extent.width + x]);
+            }
+        }
+        return rect->nearest_depth <= farthest;
+    }
+}
@@ -17,14 +17,20 @@ namespace jre
                                                                memory_properties);
 
         device->bindImageMemory(*image, memory, 0);
+        vk::SharedSampler sampler;
+        if (sampler_create_info && sampler_cache)
+        {
+            sampler = sampler_cache->get(sampler_create_info.value());
+        }
+        else if (sampler_create_info)
+        {
+            sampler = vk::SharedSampler(device->createSampler(sampler_create_info.value()), device);
+        }
         return {
             image,
             vk::SharedDeviceMemory(memory, device),
             image_view_builder.build(),
-            sampler_create_info ? vk::SharedSampler(
-                                      device->createSampler(sampler_create_info.value()),
-                                      device)
-                                : vk::SharedSampler()};
+            sampler};
     }
 
     DepthStencilAttachment2DBuilder::DepthStencilAttachment2DBuilder(vk::SharedDevice device, vk::PhysicalDevice physical_device)
@@ -79,6 +79,7 @@ namespace jre
                                                 fontData})
                                  .set_generate_mipmaps(false)
                                  .set_sampler(make_sampler_create_info())
+                                 .set_sampler_cache(&graphics.sampler_cache())
                                  .build();
             // update descriptor set
             DescripterSetUpdater{
@@ -0,0 +1,381 @@
+#include "jrenderer/asset/jmesh_file.h"
+#include "tracy/Tracy.hpp"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr std::array<char, 4> jmesh_magic = {'J', 'M', 'S', 'H'};
+        constexpr uint32_t jmesh_version = 1;
+        constexpr size_t section_alignment = 64;
+
+        enum class JMeshVertexFormat : uint32_t
+        {
+            Vertex = 0,    // 和这次编译的 Vertex 一样，stride 要一致
+            Quantized = 1, // QuantizedVertex
+        };
+
+        struct JMeshHeader
+        {
+            std::array<char, 4> magic;
+            uint32_t version;
+            uint32_t vertex_format;
+            uint32_t vertex_stride;
+            uint32_t vertex_count;
+            uint32_t index_count;
+            uint32_t sub_mesh_count;
+            uint32_t occluder_vertex_count;
+            uint32_t occluder_index_count;
+            uint32_t string_bytes;
+            float bounds_min[3];
+            float bounds_max[3];
+            uint64_t vertex_offset;
+            uint64_t index_offset;
+            uint64_t sub_mesh_offset;
+            uint64_t occluder_vertex_offset;
+            uint64_t occluder_index_offset;
+            uint64_t string_offset;
+        };
+        static_assert(sizeof(JMeshHeader) == 112);
+
+        struct JMeshSubMesh
+        {
+            uint32_t vertex_offset;
+            uint32_t index_offset;
+            uint32_t index_count;
+            float bounds_min[3];
+            float bounds_max[3];
+            float uv_extent;
+            uint32_t first_occluder_vertex;
+            uint32_t occluder_vertex_count; // 0 表示没有遮挡体
+            uint32_t first_occluder_index;
+            uint32_t occluder_index_count;
+            uint32_t name_offset; // 在字符串段里
+            uint32_t name_size;
+            uint32_t diffuse_texture_offset;
+            uint32_t diffuse_texture_size;
+        };
+        static_assert(sizeof(JMeshSubMesh) == 72);
+
+        struct QuantizedVertex
+        {
+            uint16_t position[3]; // 整个网格的包围盒里的位置
+            uint16_t padding;
+            int16_t normal[2];  // 八面体编码
+            uint32_t tex_coord; // 两个半精度
+        };
+        static_assert(sizeof(QuantizedVertex) == 16);
+
+        glm::vec2 encode_octahedron(glm::vec3 normal)
+        {
+            const float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+            if (sum == 0.0f)
+            {
+                return glm::vec2(0.0f);
+            }
+            normal /= sum;
+            glm::vec2 encoded(normal.x, normal.y);
+            if (normal.z < 0.0f)
+            {
+                encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+            }
+            return encoded;
+        }
+
+        glm::vec3 decode_octahedron(glm::vec2 encoded)
+        {
+            glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+            const float t = std::max(-normal.z, 0.0f);
+            normal.x += normal.x >= 0.0f ? -t : t;
+            normal.y += normal.y >= 0.0f ? -t : t;
+            return glm::normalize(normal);
+        }
+
+        class ByteWriter
+        {
+        public:
+            std::vector<std::byte> bytes;
+
+            void append(const void *data, size_t size)
+            {
+                const std::byte *begin = static_cast<const std::byte *>(data);
+                bytes.insert(bytes.end(), begin, begin + size);
+            }
+
+            uint64_t align()
+            {
+                bytes.resize((bytes.size() + section_alignment - 1) / section_alignment * section_alignment);
+                return bytes.size();
+            }
+        };
+
+        template <typename T>
+        std::span<const T> get_section(std::span<const std::byte> data, uint64_t offset, uint64_t count)
+        {
+            if (offset % alignof(T) != 0 || offset > data.size() || count > (data.size() - offset) / sizeof(T))
+            {
+                throw std::runtime_error("JMeshFile: section out of range");
+            }
+            return {reinterpret_cast<const T *>(data.data() + offset), static_cast<size_t>(count)};
+        }
+    }
+
+    std::vector<std::byte> JMeshFile::encode(const CookedMeshData &data, bool quantize)
+    {
+        ZoneScoped;
+        if (data.materials.size() != data.sub_meshes.size())
+        {
+            throw std::runtime_error("JMeshFile: every sub mesh needs a material binding");
+        }
+        BoundingBox bounds;
+        for (const Vertex &vertex : data.vertices)
+        {
+            bounds.expand(vertex.pos);
+        }
+        if (data.vertices.empty())
+        {
+            bounds = BoundingBox{glm::vec3(0.0f), glm::vec3(0.0f)};
+        }
+
+        JMeshHeader header{};
+        header.magic = jmesh_magic;
+        header.version = jmesh_version;
+        header.vertex_format = static_cast<uint32_t>(quantize ? JMeshVertexFormat::Quantized : JMeshVertexFormat::Vertex);
+        header.vertex_stride = quantize ? sizeof(QuantizedVertex) : sizeof(Vertex);
+        header.vertex_count = static_cast<uint32_t>(data.vertices.size());
+        header.index_count = static_cast<uint32_t>(data.indices.size());
+        header.sub_mesh_count = static_cast<uint32_t>(data.sub_meshes.size());
+        std::memcpy(header.bounds_min, &bounds.min.x, sizeof(header.bounds_min));
+        std::memcpy(header.bounds_max, &bounds.max.x, sizeof(header.bounds_max));
+
+        ByteWriter writer;
+        writer.append(&header, sizeof(header));
+
+        header.vertex_offset = writer.align();
+        if (quantize)
+        {
+            const glm::vec3 extent = bounds.max - bounds.min;
+            const glm::vec3 scale = glm::vec3(65535.0f) / glm::max(extent, glm::vec3(std::numeric_limits<float>::min()));
+            std::vector<QuantizedVertex> quantized(data.vertices.size());
+            for (size_t i = 0; i < data.vertices.size(); ++i)
+            {
+                const Vertex &vertex = data.vertices[i];
+                const glm::vec3 position = glm::round(glm::clamp((vertex.pos - bounds.min) * scale, 0.0f, 65535.0f));
+                const glm::vec2 normal = glm::round(glm::clamp(encode_octahedron(vertex.normal), -1.0f, 1.0f) * 32767.0f);
+                quantized[i] = QuantizedVertex{{static_cast<uint16_t>(position.x), static_cast<uint16_t>(position.y), static_cast<uint16_t>(position.z)},
+                                               0,
+                                               {static_cast<int16_t>(normal.x), static_cast<int16_t>(normal.y)},
+                                               glm::packHalf2x16(vertex.tex_coord)};
+            }
+            writer.append(quantized.data(), quantized.size() * sizeof(QuantizedVertex));
+        }
+        else
+        {
+            writer.append(data.vertices.data(), data.vertices.size() * sizeof(Vertex));
+        }
+
+        header.index_offset = writer.align();
+        writer.append(data.indices.data(), data.indices.size() * sizeof(uint32_t));
+
+        std::vector<JMeshSubMesh> sub_meshes;
+        std::vector<float> occluder_positions;
+        std::vector<uint32_t> occluder_indices;
+        std::string strings;
+        for (size_t i = 0; i < data.sub_meshes.size(); ++i)
+        {
+            const SubMesh &sub_mesh = data.sub_meshes[i];
+            JMeshSubMesh &record = sub_meshes.emplace_back();
+            record.vertex_offset = sub_mesh.vertex_offset;
+            record.index_offset = sub_mesh.index_offset;
+            record.index_count = sub_mesh.index_count;
+            std::memcpy(record.bounds_min, &sub_mesh.bounds.min.x, sizeof(record.bounds_min));
+            std::memcpy(record.bounds_max, &sub_mesh.bounds.max.x, sizeof(record.bounds_max));
+            record.uv_extent = sub_mesh.uv_extent;
+            record.first_occluder_vertex = static_cast<uint32_t>(occluder_positions.size() / 3);
+            record.first_occluder_index = static_cast<uint32_t>(occluder_indices.size());
+            if (sub_mesh.occluder)
+            {
+                for (const glm::vec3 &position : sub_mesh.occluder->positions)
+                {
+                    occluder_positions.insert(occluder_positions.end(), {position.x, position.y, position.z});
+                }
+                occluder_indices.insert(occluder_indices.end(), sub_mesh.occluder->indices.begin(), sub_mesh.occluder->indices.end());
+                record.occluder_vertex_count = static_cast<uint32_t>(sub_mesh.occluder->positions.size());
+                record.occluder_index_count = static_cast<uint32_t>(sub_mesh.occluder->indices.size());
+            }
+            record.name_offset = static_cast<uint32_t>(strings.size());
+            record.name_size = static_cast<uint32_t>(data.materials[i].name.size());
+            strings += data.materials[i].name;
+            record.diffuse_texture_offset = static_cast<uint32_t>(strings.size());
+            record.diffuse_texture_size = static_cast<uint32_t>(data.materials[i].diffuse_texture.size());
+            strings += data.materials[i].diffuse_texture;
+        }
+        header.sub_mesh_offset = writer.align();
+        writer.append(sub_meshes.data(), sub_meshes.size() * sizeof(JMeshSubMesh));
+        header.occluder_vertex_count = static_cast<uint32_t>(occluder_positions.size() / 3);
+        header.occluder_vertex_offset = writer.align();
+        writer.append(occluder_positions.data(), occluder_positions.size() * sizeof(float));
+        header.occluder_index_count = static_cast<uint32_t>(occluder_indices.size());
+        header.occluder_index_offset = writer.align();
+        writer.append(occluder_indices.data(), occluder_indices.size() * sizeof(uint32_t));
+        header.string_bytes = static_cast<uint32_t>(strings.size());
+        header.string_offset = writer.align();
+        writer.append(strings.data(), strings.size());
+
+        std::memcpy(writer.bytes.data(), &header, sizeof(header));
+        return std::move(writer.bytes);
+    }
+
+    void JMeshFile::save(std::span<const std::byte> encoded, const std::filesystem::path &path)
+    {
+        // 和 Ktx2File::save 一样先写临时文件再改名
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+            if (!stream)
+            {
+                throw std::runtime_error("JMeshFile: failed to write " + temp_path.string());
+            }
+        }
+        std::filesystem::rename(temp_path, path);
+    }
+
+    JMeshFile::JMeshFile(const std::filesystem::path &path)
+        : JMeshFile(read_asset(path))
+    {
+    }
+
+    JMeshFile::JMeshFile(AssetBlob blob)
+        : m_blob(std::move(blob))
+    {
+        parse();
+    }
+
+    void JMeshFile::parse()
+    {
+        const std::span<const std::byte> data = m_blob.data();
+        JMeshHeader header;
+        if (data.size() < sizeof(header))
+        {
+            throw std::runtime_error("JMeshFile: not a jmesh file");
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != jmesh_magic || header.version != jmesh_version)
+        {
+            throw std::runtime_error("JMeshFile: not a jmesh file or an old version");
+        }
+        const JMeshVertexFormat vertex_format = static_cast<JMeshVertexFormat>(header.vertex_format);
+        if (vertex_format == JMeshVertexFormat::Vertex && header.vertex_stride != sizeof(Vertex))
+        {
+            throw std::runtime_error("JMeshFile: vertex layout differs from this build");
+        }
+        if (vertex_format == JMeshVertexFormat::Quantized && header.vertex_stride != sizeof(QuantizedVertex))
+        {
+            throw std::runtime_error("JMeshFile: invalid quantized vertex stride");
+        }
+        if (vertex_format != JMeshVertexFormat::Vertex && vertex_format != JMeshVertexFormat::Quantized)
+        {
+            throw std::runtime_error("JMeshFile: unknown vertex format");
+        }
+        quantized = vertex_format == JMeshVertexFormat::Quantized;
+        std::memcpy(&bounds.min.x, header.bounds_min, sizeof(header.bounds_min));
+        std::memcpy(&bounds.max.x, header.bounds_max, sizeof(header.bounds_max));
+
+        m_vertex_count = header.vertex_count;
+        m_vertices = get_section<std::byte>(data, header.vertex_offset, static_cast<uint64_t>(header.vertex_count) * header.vertex_stride);
+        m_indices = get_section<uint32_t>(data, header.index_offset, header.index_count);
+        m_sub_meshes = get_section<std::byte>(data, header.sub_mesh_offset, static_cast<uint64_t>(header.sub_mesh_count) * sizeof(JMeshSubMesh));
+        m_occluder_positions = get_section<float>(data, header.occluder_vertex_offset, static_cast<uint64_t>(header.occluder_vertex_count) * 3);
+        m_occluder_indices = get_section<uint32_t>(data, header.occluder_index_offset, header.occluder_index_count);
+        m_strings = get_section<char>(data, header.string_offset, header.string_bytes);
+
+        // 缓存里的文件可能是坏的，索引也要扫一遍：越界的索引会让 GPU 读到缓冲外面。抛出去 load_cooked_mesh 会重新烘焙
+        materials.reserve(header.sub_mesh_count);
+        for (uint32_t i = 0; i < header.sub_mesh_count; ++i)
+        {
+            JMeshSubMesh record;
+            std::memcpy(&record, m_sub_meshes.data() + i * sizeof(JMeshSubMesh), sizeof(record));
+            if (static_cast<uint64_t>(record.index_offset) + record.index_count > header.index_count ||
+                static_cast<uint64_t>(record.first_occluder_vertex) + record.occluder_vertex_count > header.occluder_vertex_count ||
+                static_cast<uint64_t>(record.first_occluder_index) + record.occluder_index_count > header.occluder_index_count ||
+                static_cast<uint64_t>(record.name_offset) + record.name_size > header.string_bytes ||
+                static_cast<uint64_t>(record.diffuse_texture_offset) + record.diffuse_texture_size > header.string_bytes)
+            {
+                throw std::runtime_error("JMeshFile: sub mesh out of range");
+            }
+            if (record.index_count > 0 && record.vertex_offset >= header.vertex_count)
+            {
+                throw std::runtime_error("JMeshFile: sub mesh vertex offset out of range");
+            }
+            const uint32_t sub_mesh_vertex_count = header.vertex_count - std::min(record.vertex_offset, header.vertex_count);
+            if (std::ranges::any_of(m_indices.subspan(record.index_offset, record.index_count), [sub_mesh_vertex_count](uint32_t index)
+                                    { return index >= sub_mesh_vertex_count; }))
+            {
+                throw std::runtime_error("JMeshFile: index out of range");
+            }
+            if (std::ranges::any_of(m_occluder_indices.subspan(record.first_occluder_index, record.occluder_index_count), [&record](uint32_t index)
+                                    { return index >= record.occluder_vertex_count; }))
+            {
+                throw std::runtime_error("JMeshFile: occluder index out of range");
+            }
+            materials.push_back({std::string(m_strings.data() + record.name_offset, record.name_size),
+                                 std::string(m_strings.data() + record.diffuse_texture_offset, record.diffuse_texture_size)});
+        }
+    }
+
+    std::vector<SubMesh> JMeshFile::sub_meshes() const
+    {
+        std::vector<SubMesh> sub_meshes;
+        sub_meshes.reserve(materials.size());
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            JMeshSubMesh record;
+            std::memcpy(&record, m_sub_meshes.data() + i * sizeof(JMeshSubMesh), sizeof(record));
+            BoundingBox sub_mesh_bounds;
+            std::memcpy(&sub_mesh_bounds.min.x, record.bounds_min, sizeof(record.bounds_min));
+            std::memcpy(&sub_mesh_bounds.max.x, record.bounds_max, sizeof(record.bounds_max));
+            std::shared_ptr<OccluderMesh> occluder;
+            if (record.occluder_vertex_count > 0)
+            {
+                occluder = std::make_shared<OccluderMesh>();
+                occluder->positions.resize(record.occluder_vertex_count);
+                for (uint32_t k = 0; k < record.occluder_vertex_count; ++k)
+                {
+                    const float *position = m_occluder_positions.data() + (record.first_occluder_vertex + k) * 3;
+                    occluder->positions[k] = glm::vec3(position[0], position[1], position[2]);
+                }
+                const std::span<const uint32_t> occluder_indices = m_occluder_indices.subspan(record.first_occluder_index, record.occluder_index_count);
+                occluder->indices.assign(occluder_indices.begin(), occluder_indices.end());
+            }
+            sub_meshes.push_back(SubMesh(record.vertex_offset, record.index_offset, record.index_count, sub_mesh_bounds, std::move(occluder), record.uv_extent));
+        }
+        return sub_meshes;
+    }
+
+    void JMeshFile::write_vertices(Vertex *destination) const
+    {
+        ZoneScoped;
+        if (!quantized)
+        {
+            std::memcpy(destination, m_vertices.data(), m_vertices.size());
+            return;
+        }
+        const glm::vec3 scale = (bounds.max - bounds.min) / 65535.0f;
+        for (uint32_t i = 0; i < m_vertex_count; ++i)
+        {
+            QuantizedVertex vertex;
+            std::memcpy(&vertex, m_vertices.data() + i * sizeof(QuantizedVertex), sizeof(vertex));
+            const glm::vec3 position = bounds.min + glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) * scale;
+            const glm::vec3 normal = decode_octahedron(glm::vec2(vertex.normal[0], vertex.normal[1]) / 32767.0f);
+            destination[i] = Vertex(position, normal, glm::unpackHalf2x16(vertex.tex_coord));
+        }
+    }
+}
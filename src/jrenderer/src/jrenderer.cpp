@@ -5,7 +5,15 @@ namespace jre
     JRenderer::JRenderer(Window &window) : m_window(window),
                                            m_graphics(&window),
                                            m_imgui_drawer(std::make_shared<imgui::ImguiDrawer>(m_window, m_graphics)),
-                                           m_scene_drawer(std::make_shared<SceneDrawer>(m_graphics))
+                                           m_scene_drawer(std::make_shared<SceneDrawer>(m_graphics)),
+                                           m_texture_streamer(std::make_shared<TextureStreamer>(m_graphics, *m_scene_drawer)),
+                                           m_virtual_textures(m_graphics.sparse_residency() ? std::make_shared<VirtualTextureSystem>(m_graphics, *m_scene_drawer) : nullptr),
+                                           m_model_loader(std::make_shared<AsyncModelLoader>(m_graphics, *m_scene_drawer, m_texture_streamer.get(), m_virtual_textures.get())),
+                                           m_vertex_pretransformer(std::make_shared<VertexPretransformer>(m_graphics, *m_scene_drawer)),
+                                           m_visibility_buffer(m_graphics.geometry_shader() ? std::make_shared<VisibilityBufferDrawer>(m_graphics, *m_scene_drawer) : nullptr),
+                                           m_screen_space_outline(std::make_shared<ScreenSpaceOutlineDrawer>(m_graphics, *m_scene_drawer)),
+                                           m_hiz_culler(std::make_shared<HiZOcclusionCuller>(m_graphics, m_scene_drawer->scene)),
+                                           m_software_culler(std::make_shared<SoftwareOcclusionCuller>())
     {
         m_window.message_handlers.push_back(std::bind(&imgui::ImguiDrawer::WindowProc, m_imgui_drawer.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
         m_graphics.resize_funcs.push_back(std::bind(&imgui::ImguiDrawer::on_resize, m_imgui_drawer.get(), std::placeholders::_1, std::placeholders::_2));
@@ -13,6 +21,24 @@ namespace jre
         input_manager.input_manager().SetDisplaySize(m_window.width(), m_window.height());
         add_tickers();
         add_renderers();
+        m_graphics.post_render_pass_recorders.push_back(m_hiz_culler);
+        m_graphics.pre_render_pass_recorders.push_back(m_model_loader); // 最先录制，这一帧换进场景的网格、材质和纹理后面都能用
+        m_graphics.pre_render_pass_recorders.push_back(m_texture_streamer); // 在 model loader 之后，刚换进来的材质这一帧就能估计
+        if (m_virtual_textures)
+        {
+            m_graphics.pre_render_pass_recorders.push_back(m_virtual_textures); // 在所有采样它的 pass 之前拷走反馈、拷进 tile
+        }
+        m_graphics.pre_render_pass_recorders.push_back(m_scene_drawer->material_parameters); // 在所有 pass 之前，它们读到的都是这一帧的参数
+        m_graphics.pre_render_pass_recorders.push_back(m_vertex_pretransformer); // 要在可见性缓冲之前，它的 ID pass 也读预变换的顶点
+        if (m_visibility_buffer)
+        {
+            m_visibility_buffer->visible = false;
+            m_graphics.pre_render_pass_recorders.push_back(m_visibility_buffer);
+            m_scene_drawer->visibility_buffer = m_visibility_buffer;
+        }
+        m_graphics.pre_render_pass_recorders.push_back(m_screen_space_outline);
+        m_scene_drawer->screen_space_outline = m_screen_space_outline;
+        set_occlusion_culling(m_occlusion_culling_mode);
     }
 
     void JRenderer::set_msaa(const vk::SampleCountFlagBits &msaa)
@@ -21,6 +47,32 @@ namespace jre
         add_renderers();
         m_scene_drawer->on_set_msaa(m_graphics);
         m_imgui_drawer->on_set_msaa(m_graphics);
+        if (m_visibility_buffer)
+        {
+            m_visibility_buffer->on_set_msaa(m_graphics);
+        }
+        m_screen_space_outline->on_set_msaa(m_graphics);
+        m_hiz_culler->on_resize(m_graphics);
+    }
+
+    void JRenderer::set_occlusion_culling(OcclusionCullingMode mode)
+    {
+        m_occlusion_culling_mode = mode;
+        // 关掉时不录制 Hi-Z pass，重新打开时旧的回读已经过时了
+        m_hiz_culler->visible = mode == OcclusionCullingMode::HiZ;
+        m_hiz_culler->reset();
+        switch (mode)
+        {
+        case OcclusionCullingMode::HiZ:
+            m_scene_drawer->occlusion_culler = m_hiz_culler;
+            break;
+        case OcclusionCullingMode::Software:
+            m_scene_drawer->occlusion_culler = m_software_culler;
+            break;
+        default:
+            m_scene_drawer->occlusion_culler = nullptr;
+            break;
+        }
     }
 
     void JRenderer::new_frame(TickContext context)
@@ -50,6 +102,12 @@ namespace jre
     {
         input_manager.input_manager().SetDisplaySize(width, height);
         m_scene_drawer->scene.render_viewports[0].viewport = vk::Viewport{0.f, 0.f, static_cast<float>(width), static_cast<float>(height), 0.f, 1.f};
+        if (m_visibility_buffer)
+        {
+            m_visibility_buffer->on_resize(m_graphics);
+        }
+        m_screen_space_outline->on_resize(m_graphics);
+        m_hiz_culler->on_resize(m_graphics);
     }
 
     void JRenderer::add_tickers()
@@ -0,0 +1,331 @@
+#include "jrenderer/asset/ktx2_file.h"
+#include "jrenderer/asset/asset_archive.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr std::array<unsigned char, 12> ktx2_identifier = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+#pragma pack(push, 4) // sgd 的两个 uint64 紧接在 13 个 uint32 后面，不对齐到 8
+        struct Ktx2Header
+        {
+            uint32_t vk_format;
+            uint32_t type_size;
+            uint32_t pixel_width;
+            uint32_t pixel_height;
+            uint32_t pixel_depth;
+            uint32_t layer_count;
+            uint32_t face_count;
+            uint32_t level_count;
+            uint32_t supercompression_scheme;
+            uint32_t dfd_byte_offset;
+            uint32_t dfd_byte_length;
+            uint32_t kvd_byte_offset;
+            uint32_t kvd_byte_length;
+            uint64_t sgd_byte_offset;
+            uint64_t sgd_byte_length;
+        };
+#pragma pack(pop)
+        static_assert(sizeof(Ktx2Header) == 68);
+
+        struct Ktx2LevelIndex
+        {
+            uint64_t byte_offset;
+            uint64_t byte_length;
+            uint64_t uncompressed_byte_length;
+        };
+
+        // Khronos Data Format 里用到的几个值
+        constexpr uint32_t khr_df_model_rgbsda = 1;
+        constexpr uint32_t khr_df_model_bc4 = 131;
+        constexpr uint32_t khr_df_model_bc5 = 132;
+        constexpr uint32_t khr_df_model_bc7 = 134;
+        constexpr uint32_t khr_df_primaries_bt709 = 1;
+        constexpr uint32_t khr_df_transfer_linear = 1;
+        constexpr uint32_t khr_df_transfer_srgb = 2;
+
+        struct DfdSample
+        {
+            uint32_t bit_offset;
+            uint32_t bit_length;
+            uint32_t channel;
+            uint32_t upper;
+        };
+
+        // basic descriptor block，格式不支持就抛异常
+        std::vector<uint32_t> make_dfd(vk::Format format, bool srgb)
+        {
+            uint32_t color_model = 0;
+            uint32_t block_dimension = 0; // 每维 (值 - 1)，4x4 是 3
+            uint32_t bytes_plane0 = 0;
+            std::vector<DfdSample> samples;
+            switch (format)
+            {
+            case vk::Format::eR8G8B8A8Unorm:
+                color_model = khr_df_model_rgbsda;
+                bytes_plane0 = 4;
+                samples = {{0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255}, {24, 8, 15, 255}};
+                break;
+            case vk::Format::eBc4UnormBlock:
+                color_model = khr_df_model_bc4;
+                block_dimension = 3 | (3 << 8);
+                bytes_plane0 = 8;
+                samples = {{0, 64, 0, 0xFFFFFFFF}};
+                break;
+            case vk::Format::eBc5UnormBlock:
+                color_model = khr_df_model_bc5;
+                block_dimension = 3 | (3 << 8);
+                bytes_plane0 = 16;
+                samples = {{0, 64, 0, 0xFFFFFFFF}, {64, 64, 1, 0xFFFFFFFF}};
+                break;
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                color_model = khr_df_model_bc7;
+                block_dimension = 3 | (3 << 8);
+                bytes_plane0 = 16;
+                samples = {{0, 128, 0, 0xFFFFFFFF}};
+                break;
+            default:
+                throw std::runtime_error("Ktx2File: unsupported format " + vk::to_string(format));
+            }
+
+            const uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+            std::vector<uint32_t> dfd = {4 + block_size,
+                                         0, // vendorId = KHRONOS, descriptorType = BASICFORMAT
+                                         2 | (block_size << 16),
+                                         color_model | (khr_df_primaries_bt709 << 8) | ((srgb ? khr_df_transfer_srgb : khr_df_transfer_linear) << 16),
+                                         block_dimension,
+                                         bytes_plane0,
+                                         0};
+            for (const DfdSample &sample : samples)
+            {
+                dfd.push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+                dfd.push_back(0); // samplePosition
+                dfd.push_back(0); // sampleLower
+                dfd.push_back(sample.upper);
+            }
+            return dfd;
+        }
+
+        uint64_t align_up(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        constexpr uint32_t max_dimension = 16384; // 再大 level_size 的 uint32 会溢出
+
+        // make_dfd 写得出的格式，读的时候也只认这些
+        bool is_supported_format(vk::Format format)
+        {
+            switch (format)
+            {
+            case vk::Format::eR8G8B8A8Unorm:
+            case vk::Format::eBc4UnormBlock:
+            case vk::Format::eBc5UnormBlock:
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        template <typename T>
+        void write_bytes(std::vector<std::byte> &out, const T &value)
+        {
+            const std::byte *bytes = reinterpret_cast<const std::byte *>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+    }
+
+    Ktx2File::Ktx2File(const std::filesystem::path &path)
+    {
+        parse(read_asset(path).data(), path.string());
+    }
+
+    Ktx2File::Ktx2File(std::span<const std::byte> bytes)
+    {
+        parse(bytes, "<memory>");
+    }
+
+    void Ktx2File::parse(std::span<const std::byte> bytes, const std::string &name)
+    {
+        auto read = [&](uint64_t offset, void *destination, uint64_t size)
+        {
+            if (offset > bytes.size() || size > bytes.size() - offset)
+            {
+                throw std::runtime_error("Ktx2File: truncated file " + name);
+            }
+            std::memcpy(destination, bytes.data() + offset, size);
+        };
+
+        std::array<unsigned char, 12> identifier;
+        Ktx2Header header;
+        if (bytes.size() < identifier.size() + sizeof(header))
+        {
+            throw std::runtime_error("Ktx2File: not a KTX2 file " + name);
+        }
+        read(0, identifier.data(), identifier.size());
+        read(identifier.size(), &header, sizeof(header));
+        if (identifier != ktx2_identifier)
+        {
+            throw std::runtime_error("Ktx2File: not a KTX2 file " + name);
+        }
+        if (header.supercompression_scheme != 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1 || header.pixel_height == 0)
+        {
+            throw std::runtime_error("Ktx2File: only uncompressed single layer 2D textures are supported " + name);
+        }
+        // 头里的值在分配之前都要检查，坏文件不能让 level_index 和 data 分配出离谱的大小
+        if (header.pixel_width == 0 || header.pixel_width > max_dimension || header.pixel_height > max_dimension)
+        {
+            throw std::runtime_error("Ktx2File: invalid size " + name);
+        }
+        if (!is_supported_format(static_cast<vk::Format>(header.vk_format)))
+        {
+            throw std::runtime_error("Ktx2File: unsupported format " + vk::to_string(static_cast<vk::Format>(header.vk_format)) + " " + name);
+        }
+        if (header.level_count > get_mipmap_levels(header.pixel_width, header.pixel_height))
+        {
+            throw std::runtime_error("Ktx2File: too many levels " + name);
+        }
+        format = static_cast<vk::Format>(header.vk_format);
+        width = header.pixel_width;
+        height = header.pixel_height;
+        mip_levels = std::max(header.level_count, 1u); // 0 表示让加载的人自己生成，这里没有
+
+        std::vector<Ktx2LevelIndex> level_index(mip_levels);
+        read(identifier.size() + sizeof(header), level_index.data(), level_index.size() * sizeof(Ktx2LevelIndex));
+
+        if (header.dfd_byte_length >= 4 + 12)
+        {
+            std::array<unsigned char, 4> color_model_word;
+            read(header.dfd_byte_offset + 4 + 8, color_model_word.data(), color_model_word.size());
+            srgb = color_model_word[2] == khr_df_transfer_srgb;
+        }
+
+        uint64_t total_size = 0;
+        for (uint32_t level = 0; level < mip_levels; ++level)
+        {
+            total_size += level_size(level);
+        }
+        if (total_size > bytes.size())
+        {
+            throw std::runtime_error("Ktx2File: truncated file " + name);
+        }
+        data.resize(total_size);
+        size_t offset = 0;
+        for (uint32_t level = 0; level < mip_levels; ++level)
+        {
+            if (level_index[level].byte_length != level_size(level))
+            {
+                throw std::runtime_error("Ktx2File: unexpected level size " + name);
+            }
+            read(level_index[level].byte_offset, data.data() + offset, level_index[level].byte_length);
+            offset += level_index[level].byte_length;
+        }
+    }
+
+    uint32_t Ktx2File::level_size(uint32_t level) const
+    {
+        const uint32_t level_width = std::max(width >> level, 1u);
+        const uint32_t level_height = std::max(height >> level, 1u);
+        if (get_block_bytes(format) != 0)
+        {
+            return get_compressed_level_size(format, level_width, level_height);
+        }
+        return level_width * level_height * 4; // 非压缩的只有 eR8G8B8A8Unorm
+    }
+
+    std::vector<std::byte> Ktx2File::encode() const
+    {
+        const std::vector<uint32_t> dfd = make_dfd(format, srgb);
+        const std::string writer = "JRenderer";
+        const std::string writer_key = "KTXwriter";
+        const uint32_t kvd_entry_length = static_cast<uint32_t>(writer_key.size() + 1 + writer.size() + 1);
+
+        Ktx2Header header{};
+        header.vk_format = static_cast<uint32_t>(format);
+        header.type_size = 1;
+        header.pixel_width = width;
+        header.pixel_height = height;
+        header.face_count = 1;
+        header.level_count = mip_levels;
+        header.dfd_byte_offset = static_cast<uint32_t>(ktx2_identifier.size() + sizeof(Ktx2Header) + mip_levels * sizeof(Ktx2LevelIndex));
+        header.dfd_byte_length = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+        header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+        header.kvd_byte_length = static_cast<uint32_t>(align_up(sizeof(uint32_t) + kvd_entry_length, 4));
+
+        // level 从小到大放，每级对齐到 lcm(块大小, 4)，块大小 4、8、16 都是 4 的倍数
+        const uint64_t alignment = std::max<uint64_t>(get_block_bytes(format), 4);
+        std::vector<Ktx2LevelIndex> level_index(mip_levels);
+        std::vector<size_t> source_offsets(mip_levels);
+        uint64_t file_offset = header.kvd_byte_offset + header.kvd_byte_length;
+        size_t source_offset = 0;
+        for (uint32_t level = 0; level < mip_levels; ++level)
+        {
+            source_offsets[level] = source_offset;
+            source_offset += level_size(level);
+        }
+        if (source_offset != data.size())
+        {
+            throw std::runtime_error("Ktx2File: data size does not match the mip chain");
+        }
+        for (uint32_t level = mip_levels; level-- > 0;)
+        {
+            file_offset = align_up(file_offset, alignment);
+            level_index[level] = {file_offset, level_size(level), level_size(level)};
+            file_offset += level_size(level);
+        }
+
+        std::vector<std::byte> bytes;
+        bytes.reserve(file_offset);
+        write_bytes(bytes, ktx2_identifier);
+        write_bytes(bytes, header);
+        for (const Ktx2LevelIndex &index : level_index)
+        {
+            write_bytes(bytes, index);
+        }
+        for (uint32_t word : dfd)
+        {
+            write_bytes(bytes, word);
+        }
+        write_bytes(bytes, kvd_entry_length);
+        const std::span<const std::byte> writer_key_bytes = std::as_bytes(std::span(writer_key));
+        const std::span<const std::byte> writer_bytes = std::as_bytes(std::span(writer));
+        bytes.insert(bytes.end(), writer_key_bytes.begin(), writer_key_bytes.end());
+        bytes.push_back(std::byte{0});
+        bytes.insert(bytes.end(), writer_bytes.begin(), writer_bytes.end());
+        bytes.push_back(std::byte{0});
+        for (uint32_t level = mip_levels; level-- > 0;)
+        {
+            bytes.resize(level_index[level].byte_offset, std::byte{0});
+            const std::byte *level_data = reinterpret_cast<const std::byte *>(data.data() + source_offsets[level]);
+            bytes.insert(bytes.end(), level_data, level_data + level_size(level));
+        }
+        return bytes;
+    }
+
+    void Ktx2File::save(const std::filesystem::path &path) const
+    {
+        const std::vector<std::byte> bytes = encode();
+
+        // 先写临时文件再改名，中途失败不会留下半个文件被当成缓存读
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+            if (!stream)
+            {
+                throw std::runtime_error("Ktx2File: failed to write " + temp_path.string());
+            }
+        }
+        std::filesystem::rename(temp_path, path);
+    }
+}
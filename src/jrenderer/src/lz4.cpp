@@ -0,0 +1,154 @@
+#include "jrenderer/utils/lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr size_t min_match = 4;
+        constexpr size_t last_literals = 5; // 最后 5 个字节一定是字面量
+        constexpr size_t match_start_limit = 12; // 最后一个匹配要在结尾 12 个字节之前开始
+        constexpr uint32_t hash_bits = 12;
+        constexpr size_t max_offset = 65535;
+
+        uint32_t read_u32(const std::byte *p)
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        void write_length(std::vector<std::byte> &out, size_t length)
+        {
+            for (; length >= 255; length -= 255)
+            {
+                out.push_back(std::byte{255});
+            }
+            out.push_back(static_cast<std::byte>(length));
+        }
+
+        // match_length 为 0 表示最后一段，只有字面量
+        void write_sequence(std::vector<std::byte> &out, std::span<const std::byte> literals, size_t offset, size_t match_length)
+        {
+            const size_t match_code = match_length == 0 ? 0 : match_length - min_match;
+            out.push_back(static_cast<std::byte>((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(match_code, 15)));
+            if (literals.size() >= 15)
+            {
+                write_length(out, literals.size() - 15);
+            }
+            out.insert(out.end(), literals.begin(), literals.end());
+            if (match_length == 0)
+            {
+                return;
+            }
+            out.push_back(static_cast<std::byte>(offset & 0xFF));
+            out.push_back(static_cast<std::byte>(offset >> 8));
+            if (match_code >= 15)
+            {
+                write_length(out, match_code - 15);
+            }
+        }
+
+        size_t read_length(const std::byte *&in, const std::byte *in_end, size_t length)
+        {
+            if (length != 15)
+            {
+                return length;
+            }
+            std::byte extra;
+            do
+            {
+                if (in == in_end)
+                {
+                    throw std::runtime_error("lz4_decompress: truncated input");
+                }
+                extra = *in++;
+                length += std::to_integer<size_t>(extra);
+            } while (extra == std::byte{255});
+            return length;
+        }
+    }
+
+    std::vector<std::byte> lz4_compress(std::span<const std::byte> source)
+    {
+        std::vector<std::byte> out;
+        out.reserve(source.size() / 2 + 16);
+        const size_t size = source.size();
+        size_t anchor = 0;
+        if (size > match_start_limit)
+        {
+            std::vector<int64_t> table(size_t(1) << hash_bits, -1);
+            const size_t match_end_limit = size - last_literals;
+            for (size_t i = 0; i < size - match_start_limit;)
+            {
+                const uint32_t sequence = read_u32(source.data() + i);
+                const uint32_t hash = (sequence * 2654435761u) >> (32 - hash_bits);
+                const int64_t reference = table[hash];
+                table[hash] = static_cast<int64_t>(i);
+                if (reference < 0 || i - reference > max_offset || read_u32(source.data() + reference) != sequence)
+                {
+                    ++i;
+                    continue;
+                }
+                size_t length = min_match;
+                while (i + length < match_end_limit && source[reference + length] == source[i + length])
+                {
+                    ++length;
+                }
+                write_sequence(out, source.subspan(anchor, i - anchor), i - reference, length);
+                i += length;
+                anchor = i;
+            }
+        }
+        write_sequence(out, source.subspan(anchor), 0, 0);
+        return out;
+    }
+
+    void lz4_decompress(std::span<const std::byte> source, std::span<std::byte> destination)
+    {
+        const std::byte *in = source.data();
+        const std::byte *const in_end = in + source.size();
+        std::byte *out = destination.data();
+        std::byte *const out_end = out + destination.size();
+        while (in < in_end)
+        {
+            const uint8_t token = std::to_integer<uint8_t>(*in++);
+            const size_t literal_length = read_length(in, in_end, token >> 4);
+            if (static_cast<size_t>(in_end - in) < literal_length || static_cast<size_t>(out_end - out) < literal_length)
+            {
+                throw std::runtime_error("lz4_decompress: literals out of range");
+            }
+            std::memcpy(out, in, literal_length);
+            in += literal_length;
+            out += literal_length;
+            if (in == in_end)
+            {
+                break; // 最后一段没有匹配
+            }
+            if (in_end - in < 2)
+            {
+                throw std::runtime_error("lz4_decompress: truncated input");
+            }
+            const size_t offset = std::to_integer<size_t>(in[0]) | std::to_integer<size_t>(in[1]) << 8;
+            in += 2;
+            const size_t match_length = read_length(in, in_end, token & 15) + min_match;
+            if (offset == 0 || offset > static_cast<size_t>(out - destination.data()) || static_cast<size_t>(out_end - out) < match_length)
+            {
+                throw std::runtime_error("lz4_decompress: match out of range");
+            }
+            // 可能和自己重叠 (offset 比长度小)，一个一个拷
+            const std::byte *match = out - offset;
+            for (size_t k = 0; k < match_length; ++k)
+            {
+                out[k] = match[k];
+            }
+            out += match_length;
+        }
+        if (out != out_end)
+        {
+            throw std::runtime_error("lz4_decompress: size mismatch");
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include "jrenderer/utils/mapped_file.h"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace jre
+{
+    MappedFile::MappedFile(const std::filesystem::path &path)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("MappedFile: failed to open " + path.string());
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+        {
+            CloseHandle(file);
+            throw std::runtime_error("MappedFile: failed to get size of " + path.string());
+        }
+        m_size = static_cast<size_t>(file_size.QuadPart);
+        if (m_size == 0)
+        {
+            CloseHandle(file);
+            return;
+        }
+        // view 拿着 mapping 和文件的引用，两个句柄可以马上关
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            throw std::runtime_error("MappedFile: failed to map " + path.string());
+        }
+        m_data = static_cast<const std::byte *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (m_data == nullptr)
+        {
+            throw std::runtime_error("MappedFile: failed to map " + path.string());
+        }
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            throw std::runtime_error("MappedFile: failed to open " + path.string());
+        }
+        struct stat file_stat;
+        if (fstat(file, &file_stat) != 0)
+        {
+            ::close(file);
+            throw std::runtime_error("MappedFile: failed to get size of " + path.string());
+        }
+        m_size = static_cast<size_t>(file_stat.st_size);
+        if (m_size == 0)
+        {
+            ::close(file);
+            return;
+        }
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error("MappedFile: failed to map " + path.string());
+        }
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const std::byte *>(data);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0))
+    {
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    void MappedFile::close()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(const_cast<std::byte *>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
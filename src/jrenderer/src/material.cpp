@@ -12,19 +12,15 @@ namespace jre
             {
                 return vk::shared::create_shader_from_spv_file(device, path);
             }
-
-            auto [it, inserted] = shader_cache->try_emplace(path);
-            if (inserted)
-            {
-                it->second = vk::shared::create_shader_from_spv_file(device, path);
-            }
-            return it->second;
+            return shader_cache->get_or_create(path);
         };
         Material material;
-        std::tie(material.descriptor_pool, material.descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
-            device,
-            descriptor_set_count,
-            bindings);
+        if (!bindings.empty())
+        {
+            assert(descriptor_set_layouts && descriptor_allocator);
+            material.descriptor_set_layout = descriptor_set_layouts->get(bindings);
+            material.descriptor_allocator = descriptor_allocator;
+        }
 
         size_t hash_of_pipeline = render_pipeline_resources.hasher(
             PipelineHashInfo{
@@ -44,13 +40,25 @@ namespace jre
         {
             it->second->vertex_shader = get_or_create_shader(vertex_shader_info.path);
             it->second->fragment_shader = get_or_create_shader(fragment_shader_info.path);
-            pipeline_layout_builder.descriptor_set_layouts.push_back(
-                material.descriptor_set_layout.get());
+            if (material.descriptor_set_layout)
+            {
+                pipeline_layout_builder.descriptor_set_layouts.push_back(
+                    material.descriptor_set_layout.get());
+            }
             it->second->pipeline_layout = pipeline_layout_builder.build();
             it->second->pipeline_builder.pipeline_layout = it->second->pipeline_layout.get();
             it->second->pipeline_builder
                 .add_vertex_shader(it->second->vertex_shader.get(), vertex_shader_info.constants, vertex_shader_info.entry)
                 .add_fragment_shader(it->second->fragment_shader.get(), fragment_shader_info.constants, fragment_shader_info.entry);
+            it->second->vertex_constants = vertex_shader_info.constants;
+            it->second->fragment_constants = fragment_shader_info.constants;
+            it->second->depth_prepass = depth_prepass;
+            it->second->material_descriptor_set_layout = material.descriptor_set_layout;
+            if (!visibility_shader_info.path.empty())
+            {
+                it->second->visibility_shader = get_or_create_shader(visibility_shader_info.path);
+                it->second->visibility_constants = visibility_shader_info.constants;
+            }
             it->second->recreate_pipeline();
         }
         material.render_pipeline = it->second;
@@ -59,7 +67,10 @@ namespace jre
 
     MaterialInstance Material::create_instance(uint32_t frame_count)
     {
-        return MaterialInstance(*this, vk::shared::allocate_descriptor_sets(descriptor_pool,
-                                                                            std::vector<vk::DescriptorSetLayout>(frame_count, descriptor_set_layout.get())));
+        if (!descriptor_allocator)
+        {
+            return MaterialInstance(*this, {});
+        }
+        return MaterialInstance(*this, descriptor_allocator->allocate(std::vector<vk::DescriptorSetLayout>(frame_count, descriptor_set_layout.get())));
     }
 }
\ No newline at end of file
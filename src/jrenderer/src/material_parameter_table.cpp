@@ -0,0 +1,82 @@
+#include "jrenderer/material_parameter_table.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+
+namespace jre
+{
+    MaterialParameterTable::MaterialParameterTable(vk::SharedDevice device, vk::PhysicalDevice physical_device, uint32_t max_records)
+        : m_records(static_cast<size_t>(max_records) * record_size),
+          m_dirty(max_records, false),
+          m_uploaded(max_records, false)
+    {
+        m_buffer = BufferBuilder<void>(device,
+                                       physical_device,
+                                       vk::BufferCreateInfo()
+                                           .setSize(m_records.size())
+                                           .setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst),
+                                       vk::MemoryPropertyFlagBits::eDeviceLocal)
+                       .build();
+    }
+
+    void MaterialParameterTable::set(uint32_t material_id, std::span<const std::byte> record)
+    {
+        assert(record.size() <= record_size && material_id < m_dirty.size());
+        std::byte *dst = m_records.data() + static_cast<size_t>(material_id) * record_size;
+        if (m_uploaded[material_id] && std::memcmp(dst, record.data(), record.size()) == 0)
+        {
+            return;
+        }
+        std::memcpy(dst, record.data(), record.size());
+        if (!m_dirty[material_id])
+        {
+            m_dirty[material_id] = true;
+            m_dirty_ids.push_back(material_id);
+        }
+    }
+
+    void MaterialParameterTable::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        uploaded_count = static_cast<uint32_t>(m_dirty_ids.size());
+        if (m_dirty_ids.empty())
+        {
+            return;
+        }
+        ZoneScoped;
+
+        // 之前还在飞的帧读完了才能写
+        const vk::PipelineStageFlags shader_stages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+        command_buffer.pipelineBarrier(shader_stages,
+                                       vk::PipelineStageFlagBits::eTransfer,
+                                       {}, nullptr, nullptr, nullptr);
+
+        // 相邻的脏记录合成一次，vkCmdUpdateBuffer 一次最多 65536 字节
+        constexpr uint32_t max_records_per_update = 65536 / record_size;
+        std::ranges::sort(m_dirty_ids);
+        for (size_t begin = 0; begin < m_dirty_ids.size();)
+        {
+            size_t end = begin + 1;
+            while (end < m_dirty_ids.size() &&
+                   m_dirty_ids[end] == m_dirty_ids[end - 1] + 1 &&
+                   end - begin < max_records_per_update)
+            {
+                ++end;
+            }
+            const vk::DeviceSize offset = static_cast<vk::DeviceSize>(m_dirty_ids[begin]) * record_size;
+            const vk::DeviceSize size = static_cast<vk::DeviceSize>(end - begin) * record_size;
+            command_buffer.updateBuffer(m_buffer.vk_buffer(), offset, size, m_records.data() + offset);
+            begin = end;
+        }
+        for (uint32_t material_id : m_dirty_ids)
+        {
+            m_dirty[material_id] = false;
+            m_uploaded[material_id] = true;
+        }
+        m_dirty_ids.clear();
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                       shader_stages,
+                                       {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead),
+                                       nullptr, nullptr);
+    }
+}
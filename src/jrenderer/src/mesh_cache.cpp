@@ -0,0 +1,12 @@
+#include "jrenderer/mesh_cache.h"
+
+namespace jre
+{
+    void MeshCreator::retire(const std::shared_ptr<Mesh> &mesh) const
+    {
+        if (retired)
+        {
+            retired->retire(mesh);
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include "jrenderer/asset/mesh_cooker.h"
+#include "jrenderer/asset/derived_data_cache.h"
+#include "jrenderer/asset/obj_file.h"
+#include "jrenderer/asset/pmx_file.h"
+#include "tracy/Tracy.hpp"
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace jre
+{
+    namespace
+    {
+        // 烘焙的算法或者 .jmesh 的格式变了就加
+        constexpr uint32_t mesh_cooker_version = 2;
+
+        std::string to_utf8(const std::wstring &text)
+        {
+            const std::u8string utf8 = std::filesystem::path(text).u8string();
+            return std::string(reinterpret_cast<const char *>(utf8.data()), utf8.size());
+        }
+
+        CookedMeshData cook_pmx(const std::filesystem::path &source)
+        {
+            const PmxReader reader(source);
+            CookedMeshData data;
+            data.vertices.resize(reader.vertex_count());
+            reader.write_vertices(data.vertices.data());
+            data.indices = reader.indices;
+            data.sub_meshes = PmxMeshBuilder<Vertex, uint32_t>::build_sub_meshes(reader);
+            for (const PmxReader::Material &material : reader.materials)
+            {
+                const bool has_diffuse = material.diffuse_texture_index >= 0 && material.diffuse_texture_index < static_cast<int32_t>(reader.textures.size());
+                data.materials.push_back({to_utf8(material.name), has_diffuse ? to_utf8(reader.textures[material.diffuse_texture_index]) : std::string()});
+            }
+            return data;
+        }
+
+        struct ObjIndexHash
+        {
+            size_t operator()(const tinyobj::index_t &index) const
+            {
+                size_t hash = std::hash<int>()(index.vertex_index);
+                hash = hash * 31 + std::hash<int>()(index.normal_index);
+                return hash * 31 + std::hash<int>()(index.texcoord_index);
+            }
+        };
+
+        struct ObjIndexEqual
+        {
+            bool operator()(const tinyobj::index_t &a, const tinyobj::index_t &b) const
+            {
+                return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index && a.texcoord_index == b.texcoord_index;
+            }
+        };
+
+        // 位置、法线、UV 都相同的角合成一个顶点，三角形按材质分到 sub mesh 里
+        CookedMeshData cook_obj(const std::filesystem::path &source)
+        {
+            const ObjFile obj(source.string());
+            const tinyobj::attrib_t &attrib = obj.attrib();
+            CookedMeshData data;
+            std::unordered_map<tinyobj::index_t, uint32_t, ObjIndexHash, ObjIndexEqual> vertex_indices;
+            std::map<int, std::vector<uint32_t>> material_indices; // -1 是没有材质的
+            for (const tinyobj::shape_t &shape : obj.shapes())
+            {
+                size_t corner = 0;
+                for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); ++face)
+                {
+                    const size_t face_vertex_count = shape.mesh.num_face_vertices[face];
+                    std::vector<uint32_t> &indices = material_indices[shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[face]];
+                    for (size_t k = 0; k < face_vertex_count; ++k)
+                    {
+                        const tinyobj::index_t &index = shape.mesh.indices[corner + k];
+                        auto [it, inserted] = vertex_indices.try_emplace(index, static_cast<uint32_t>(data.vertices.size()));
+                        if (inserted)
+                        {
+                            Vertex vertex;
+                            vertex.pos = glm::vec3(attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2]);
+                            if (index.normal_index >= 0)
+                            {
+                                vertex.normal = glm::vec3(attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2]);
+                            }
+                            if (index.texcoord_index >= 0)
+                            {
+                                // OBJ 的 v 朝上
+                                vertex.tex_coord = glm::vec2(attrib.texcoords[2 * index.texcoord_index + 0], 1.0f - attrib.texcoords[2 * index.texcoord_index + 1]);
+                            }
+                            data.vertices.push_back(vertex);
+                        }
+                        indices.push_back(it->second);
+                    }
+                    corner += face_vertex_count;
+                }
+            }
+
+            std::vector<glm::vec3> positions = data.vertices |
+                                               std::views::transform([](const Vertex &vertex)
+                                                                     { return glm::vec3(vertex.pos); }) |
+                                               std::ranges::to<std::vector>();
+            for (const auto &[material_id, indices] : material_indices)
+            {
+                const uint32_t index_offset = static_cast<uint32_t>(data.indices.size());
+                data.indices.insert(data.indices.end(), indices.begin(), indices.end());
+                BoundingBox bounds;
+                glm::vec2 uv_min(std::numeric_limits<float>::max());
+                glm::vec2 uv_max(std::numeric_limits<float>::lowest());
+                for (uint32_t index : indices)
+                {
+                    bounds.expand(positions[index]);
+                    uv_min = glm::min(uv_min, glm::vec2(data.vertices[index].tex_coord));
+                    uv_max = glm::max(uv_max, glm::vec2(data.vertices[index].tex_coord));
+                }
+                const float uv_extent = indices.empty() ? 1.0f : std::max(uv_max.x - uv_min.x, uv_max.y - uv_min.y);
+                data.sub_meshes.push_back(SubMesh(0, index_offset, static_cast<uint32_t>(indices.size()), bounds, simplify_occluder(positions, indices, bounds), uv_extent));
+                if (material_id >= 0 && material_id < static_cast<int>(obj.materials().size()))
+                {
+                    data.materials.push_back({obj.materials()[material_id].name, obj.materials()[material_id].diffuse_texname});
+                }
+                else
+                {
+                    data.materials.push_back({});
+                }
+            }
+            return data;
+        }
+    }
+
+    std::filesystem::path get_cooked_mesh_path(const std::filesystem::path &source)
+    {
+        std::filesystem::path path = source;
+        path.replace_extension(".jmesh");
+        return path;
+    }
+
+    CookedMeshData cook_mesh(const std::filesystem::path &source)
+    {
+        ZoneScoped;
+        const std::filesystem::path extension = source.extension();
+        if (extension == ".pmx" || extension == ".PMX")
+        {
+            return cook_pmx(source);
+        }
+        if (extension == ".obj" || extension == ".OBJ")
+        {
+            return cook_obj(source);
+        }
+        throw std::runtime_error("cook_mesh: unsupported model " + source.string());
+    }
+
+    std::shared_ptr<const JMeshFile> load_cooked_mesh(const std::filesystem::path &source, bool quantize)
+    {
+        // 打包文件里的是发布时烘好的，直接用
+        if (std::optional<AssetBlob> archived = find_archived_asset(get_cooked_mesh_path(source)))
+        {
+            return std::make_shared<const JMeshFile>(std::move(*archived));
+        }
+        // Vertex 的布局也算进去，改了顶点格式不会读到旧的
+        DerivedDataKey key("mesh", mesh_cooker_version);
+        key.add_value(quantize).add_value(sizeof(Vertex)).add_source(source);
+        // OBJ 的材质在同名的 .mtl 里
+        std::filesystem::path material_library = source;
+        material_library.replace_extension(".mtl");
+        if (std::filesystem::exists(material_library) || contains_archived_asset(material_library))
+        {
+            key.add_source(material_library);
+        }
+
+        const DerivedDataCache &cache = default_derived_data_cache();
+        if (std::optional<AssetBlob> cached = cache.find(key.value()))
+        {
+            try
+            {
+                return std::make_shared<const JMeshFile>(std::move(*cached));
+            }
+            catch (const std::exception &)
+            {
+                // 坏了，重新烘焙覆盖掉
+            }
+        }
+        std::vector<std::byte> bytes = JMeshFile::encode(cook_mesh(source), quantize);
+        try
+        {
+            cache.put(key.value(), bytes);
+        }
+        catch (const std::exception &)
+        {
+            // 只是下次还要再烘焙
+        }
+        return std::make_shared<const JMeshFile>(std::move(bytes));
+    }
+}
@@ -0,0 +1,127 @@
+#include "jrenderer/mip_generator.h"
+#include "jrenderer/graphics.h"
+#include "jrenderer/pipeline.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include <ranges>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr uint32_t tile_size = 32; // 一个 workgroup 在 mip 1 上负责的边长
+        constexpr vk::Format mip_format = vk::Format::eR8G8B8A8Unorm;
+    }
+
+    MipGenerator::MipGenerator(Graphics &graphics)
+        : m_device(graphics.logical_device())
+    {
+        for (size_t i = 0; i <= graphics.cpu_frames().size(); ++i)
+        {
+            m_frames.push_back({DescriptorAllocator(m_device,
+                                                    {},
+                                                    16,
+                                                    {{vk::DescriptorType::eStorageImage, static_cast<float>(max_levels)},
+                                                     {vk::DescriptorType::eStorageBuffer, 1.0f}})});
+        }
+        m_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/mip_generate.comp.spv");
+
+        vk::ShaderStageFlags compute = vk::ShaderStageFlagBits::eCompute;
+        m_descriptor_set_layout = graphics.descriptor_set_layouts().get({vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageImage, max_levels, compute},
+                                                                         vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1, compute}});
+        m_update_template = DescriptorUpdateTemplate<Descriptors>(
+            m_device,
+            m_descriptor_set_layout.get(),
+            {DescriptorUpdateTemplate<Descriptors>::entry(0, vk::DescriptorType::eStorageImage, offsetof(Descriptors, mips), max_levels, sizeof(vk::DescriptorImageInfo)),
+             DescriptorUpdateTemplate<Descriptors>::entry(1, vk::DescriptorType::eStorageBuffer, offsetof(Descriptors, counters))});
+        m_pipeline_layout = vk::shared::create_pipeline_layout(m_device,
+                                                               m_descriptor_set_layout.get(),
+                                                               vk::PushConstantRange{compute, 0, sizeof(PushConstants)});
+        m_pipeline = ComputePipelineBuilder(m_device, m_pipeline_layout.get())
+                         .set_shader(m_shader.get())
+                         .build();
+
+        m_counter_buffer = BufferBuilder<void>(m_device,
+                                               graphics.physical_device(),
+                                               vk::BufferCreateInfo()
+                                                   .setSize(sizeof(uint32_t) * max_batch_images * m_frames.size())
+                                                   .setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst),
+                                               vk::MemoryPropertyFlagBits::eDeviceLocal)
+                               .build();
+    }
+
+    void MipGenerator::record(vk::CommandBuffer command_buffer, uint32_t frame, vk::Image image, vk::Extent2D extent, uint32_t mip_levels, bool srgb)
+    {
+        assert(mip_levels > 1 && mip_levels <= max_levels);
+        const uint32_t slot = frame_slot(frame);
+        FrameState &state = m_frames[slot];
+        if (state.pending_count >= max_batch_images)
+        {
+            throw std::runtime_error("too many images in one mip generation batch");
+        }
+        // 每份用计数器缓冲里自己的一段，在飞的几帧不会互相清零
+        const uint32_t counter_index = slot * max_batch_images + state.pending_count++;
+
+        // 没用到的数组位置填最后一级，着色器不会写
+        Descriptors descriptors;
+        const size_t first_view = state.views.size();
+        for (uint32_t level : std::views::iota(0u, mip_levels))
+        {
+            SharedImageViewBuilder view_builder(m_device, image);
+            view_builder.image_view_create_info.setViewType(vk::ImageViewType::e2D)
+                .setFormat(mip_format)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+            state.views.push_back(view_builder.build());
+        }
+        for (uint32_t level : std::views::iota(0u, max_levels))
+        {
+            descriptors.mips[level] = vk::DescriptorImageInfo({}, state.views[first_view + std::min(level, mip_levels - 1)].get(), vk::ImageLayout::eGeneral);
+        }
+        descriptors.counters = vk::DescriptorBufferInfo(m_counter_buffer.vk_buffer(), 0, VK_WHOLE_SIZE);
+        vk::DescriptorSet descriptor_set = state.descriptors.allocate_transient(m_descriptor_set_layout.get());
+        m_update_template.update(descriptor_set, descriptors);
+
+        command_buffer.fillBuffer(m_counter_buffer.vk_buffer(), counter_index * sizeof(uint32_t), sizeof(uint32_t), 0);
+        std::array image_barriers = {
+            vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+                                   vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral,
+                                   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                   image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)),
+            vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                                   vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+                                   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                   image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 1, VK_REMAINING_MIP_LEVELS, 0, 1))};
+        vk::BufferMemoryBarrier counter_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                                                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                m_counter_buffer.vk_buffer(), counter_index * sizeof(uint32_t), sizeof(uint32_t));
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr, counter_barrier, image_barriers);
+
+        const vk::Extent2D mip1_extent{std::max(extent.width >> 1, 1u), std::max(extent.height >> 1, 1u)};
+        const vk::Extent2D group_count{(mip1_extent.width + tile_size - 1) / tile_size, (mip1_extent.height + tile_size - 1) / tile_size};
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline_layout.get(), 0, descriptor_set, nullptr);
+        command_buffer.pushConstants<PushConstants>(m_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0,
+                                                    PushConstants{glm::ivec2(extent.width, extent.height),
+                                                                  mip_levels,
+                                                                  srgb ? 1u : 0u,
+                                                                  counter_index,
+                                                                  group_count.width * group_count.height});
+        command_buffer.dispatch(group_count.width, group_count.height, 1);
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr, nullptr,
+                                       vk::ImageMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+                                                              vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                              image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mip_levels, 0, 1)));
+    }
+
+    void MipGenerator::reset(uint32_t frame)
+    {
+        FrameState &state = m_frames[frame_slot(frame)];
+        state.descriptors.reset();
+        state.views.clear();
+        state.pending_count = 0;
+    }
+}
@@ -2,233 +2,399 @@
 
 #include "jrenderer/asset/model_lingsha.h"
 #include "jrenderer/asset/pmx_file.h"
+#include "jrenderer/asset/mesh_cooker.h"
 #include "jrenderer/asset/star_rail_material.h"
+#include <algorithm>
 #include <ranges>
 #include <unordered_set>
 
 namespace jre
 {
-    Model load_lingsha(SceneDrawer &scene_drawer,
-                       uint32_t frame_count,
-                       vk::SharedDevice device,
-                       vk::PhysicalDevice physical_device,
-                       vk::SharedQueue transfer_queue,
-                       vk::SharedCommandBuffer command_buffer)
+    namespace
     {
-        Model model = scene_drawer.factory.create();
-        PmxFile pmx_file("res/model/HonkaiStarRail/lingsha/lingsha.pmx");
-        PmxMeshBuilder<jre::Vertex, uint32_t> builder(device,
-                                                      physical_device,
-                                                      command_buffer.get(),
-                                                      transfer_queue.get(),
-                                                      pmx_file);
-        std::shared_ptr<Mesh> mesh = builder.build_shared();
-        std::unordered_set<int> removed_indices = {1, 10, 13};
-        std::vector<uint32_t> filtered_sub_mesh_indexes = std::views::iota(0u, static_cast<uint32_t>(mesh->sub_meshes.size())) |
-                                                          std::views::filter([](int i)
-                                                                             { return i != 1 && i != 10 && i != 13; }) |
-                                                          std::ranges::to<std::vector>(); // 过滤掉重复的网格，不然会闪
-        std::array model_parts = {
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Face,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Hair,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Body,
-            ModelPart::Face,
-            ModelPart::Face};
-
-        std::ranges::sort(filtered_sub_mesh_indexes, [&model_parts](uint32_t a, uint32_t b)
-                          { return model_parts[a] < model_parts[b]; }); // 按部位排序，相同的部位相同的材质，减少bind pipeline的次数
-
-        mesh->sub_meshes = filtered_sub_mesh_indexes |
-                           std::views::transform([&mesh](uint32_t sub_mesh_index)
-                                                 { return mesh->sub_meshes[sub_mesh_index]; }) |
-                           std::ranges::to<std::vector>();
-        model.mesh = mesh;
-
-        std::unordered_map<std::string, vk::SharedShaderModule> shader_cache;
-        StarRailMaterialBuilder material_builder(
-            scene_drawer.render_pipelines,
-            scene_drawer.pipeline_layout_builder,
-            scene_drawer.pipeline_builder,
-            device,
-            physical_device,
-            command_buffer.get(),
-            transfer_queue.get());
-        material_builder.builder.shader_cache = &shader_cache;
-        material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(ModelPart::Body));
-        material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(ModelPart::Body));
-        Material body_material = material_builder.build();
-        material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(ModelPart::Hair));
-        material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(ModelPart::Hair));
-        Material hair_material = material_builder.build();
-        material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(ModelPart::Face));
-        material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(ModelPart::Face));
-        Material face_material = material_builder.build();
-
-        StarRailOutlineMaterialBuilder outline_material_builder(
-            scene_drawer.render_pipelines,
-            scene_drawer.pipeline_layout_builder,
-            scene_drawer.pipeline_builder,
-            device,
-            physical_device,
-            command_buffer.get(),
-            transfer_queue.get());
-        outline_material_builder.builder.shader_cache = &shader_cache;
-        outline_material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(ModelPart::Body));
-        outline_material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(ModelPart::Body));
-        Material body_outline_material = outline_material_builder.build();
-        outline_material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(ModelPart::Face));
-        outline_material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(ModelPart::Face));
-        Material face_outline_material = outline_material_builder.build();
+        const std::filesystem::path lingsha_directory = "res/model/HonkaiStarRail/lingsha";
+        const std::filesystem::path lingsha_source = lingsha_directory / "lingsha.pmx";
 
-        std::unordered_map<std::string, Texture> texture_cache;
-        StarRailMaterialInstanceBuilder body_material_instance_builder{
-            device,
-            physical_device,
-            command_buffer.get(),
-            transfer_queue.get(),
-            frame_count,
-            body_material,
-            &texture_cache,
-            {},
-            {},
-            {},
-            {}};
-        body_material_instance_builder.filename_light_map = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_LightMap_L.png";
-        body_material_instance_builder.filename_cool_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_Cool_Ramp.png";
-        body_material_instance_builder.filename_warm_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_Warm_Ramp.png";
-        StarRailMaterialInstanceBuilder hair_material_instance_builder{
-            device,
-            physical_device,
-            command_buffer.get(),
-            transfer_queue.get(),
-            frame_count,
-            hair_material,
-            &texture_cache,
-            {},
-            {},
-            {},
-            {}};
-        hair_material_instance_builder.filename_light_map = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Hair_LightMap.png";
-        hair_material_instance_builder.filename_cool_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Hair_Cool_Ramp.png";
-        hair_material_instance_builder.filename_warm_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Hair_Warm_Ramp.png";
-        StarRailMaterialInstanceBuilder face_material_instance_builder{
-            device,
-            physical_device,
-            command_buffer.get(),
-            transfer_queue.get(),
-            frame_count,
-            face_material,
-            &texture_cache,
-            {},
-            {},
-            {},
-            {}};
-        face_material_instance_builder.filename_light_map = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_LightMap_L.png";
-        face_material_instance_builder.filename_cool_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_Cool_Ramp.png";
-        face_material_instance_builder.filename_warm_ramp = "res/model/HonkaiStarRail/lingsha/Avatar_Lingsha_00_Body_Warm_Ramp.png";
-        auto get_material = [&](ModelPart part) -> StarRailMaterialInstanceBuilder &
+        // 读文件、整理出来的数据，不碰 Vulkan，可以在工作线程上做
+        struct LingshaData
         {
-            switch (part)
+            std::string mesh_key;                       // SceneDrawer::mesh_cache 的 key，源文件规范化后的路径
+            std::shared_ptr<const JMeshFile> mesh;      // 建 mesh 的时候从映射的文件直接拷进 staging
+            std::vector<SubMesh> sub_meshes;            // 已经过滤、排好序
+            std::vector<ModelPart> parts;               // 和过滤后的 sub mesh 一一对应
+            std::vector<std::string> diffuse_filenames; // 同上
+        };
+
+        LingshaData prepare_lingsha(const std::filesystem::path &source)
+        {
+            LingshaData data;
+            data.mesh_key = std::filesystem::weakly_canonical(source).generic_string();
+            data.mesh = load_cooked_mesh(source);
+            std::vector<SubMesh> sub_meshes = data.mesh->sub_meshes();
+            std::vector<uint32_t> filtered_sub_mesh_indexes = std::views::iota(0u, static_cast<uint32_t>(sub_meshes.size())) |
+                                                              std::views::filter([](int i)
+                                                                                 { return i != 1 && i != 10 && i != 13; }) |
+                                                              std::ranges::to<std::vector>(); // 过滤掉重复的网格，不然会闪
+            std::array model_parts = {
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Face,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Hair,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Body,
+                ModelPart::Face,
+                ModelPart::Face};
+
+            std::ranges::sort(filtered_sub_mesh_indexes, [&model_parts](uint32_t a, uint32_t b)
+                              { return model_parts[a] < model_parts[b]; }); // 按部位排序，相同的部位相同的材质，减少bind pipeline的次数
+
+            for (uint32_t i : filtered_sub_mesh_indexes)
             {
-            case ModelPart::Body:
-                return body_material_instance_builder;
-            case ModelPart::Hair:
-                return hair_material_instance_builder;
-            case ModelPart::Face:
-                return face_material_instance_builder;
-            default:
-                throw std::runtime_error("Unknown part");
+                const std::string &diffuse_filename = data.mesh->materials[i].diffuse_texture;
+                data.parts.push_back(model_parts[i]);
+                data.diffuse_filenames.push_back((lingsha_directory / std::u8string(diffuse_filename.begin(), diffuse_filename.end())).string());
             }
-        };
+            data.sub_meshes = filtered_sub_mesh_indexes |
+                              std::views::transform([&sub_meshes](uint32_t sub_mesh_index)
+                                                    { return sub_meshes[sub_mesh_index]; }) |
+                              std::ranges::to<std::vector>();
+            return data;
+        }
 
-        StarRailOutlineMaterialInstanceBuilder body_outline_material_instance_builder{device,
-                                                                                      physical_device,
-                                                                                      command_buffer.get(),
-                                                                                      transfer_queue.get(),
-                                                                                      frame_count,
-                                                                                      body_outline_material,
-                                                                                      &texture_cache,
-                                                                                      {}};
-        StarRailOutlineMaterialInstanceBuilder face_outline_material_instance_builder{device,
-                                                                                      physical_device,
-                                                                                      command_buffer.get(),
-                                                                                      transfer_queue.get(),
-                                                                                      frame_count,
-                                                                                      face_outline_material,
-                                                                                      &texture_cache,
-                                                                                      {}};
-        auto get_outline_material = [&](ModelPart part) -> StarRailOutlineMaterialInstanceBuilder &
+        // 灵砂的管线：body、hair、face 三种着色，body、face 两种描边 (hair 的描边和 body 共用)。
+        // 只往 render_pipelines 里放、读 scene_drawer 建好之后不变的设置，给一个单独的 RenderPipelineResources 就能在工作线程上编
+        struct LingshaPipelines
         {
-            switch (part)
+            std::array<Material, static_cast<size_t>(ModelPart::PartNum)> shading;
+            std::array<Material, static_cast<size_t>(ModelPart::PartNum)> outline;
+
+            LingshaPipelines(SceneDrawer &scene_drawer, RenderPipelineResources &render_pipelines, vk::SharedDevice device)
             {
-            case ModelPart::Body:
-            case ModelPart::Hair:
-                return body_outline_material_instance_builder;
-            case ModelPart::Face:
-                return face_outline_material_instance_builder;
-            default:
-                throw std::runtime_error("Unknown part");
+                StarRailMaterialBuilder material_builder(
+                    render_pipelines,
+                    scene_drawer.pipeline_layout_builder,
+                    scene_drawer.pipeline_builder,
+                    device,
+                    {},
+                    {},
+                    {});
+                material_builder.builder.shader_cache = scene_drawer.shader_modules;
+                material_builder.builder.vertex_shader_info.path = scene_drawer.view_vertex_shader_path("res/shaders/star_rail");
+                material_builder.builder.fragment_shader_info.path = scene_drawer.material_fragment_shader_path("res/shaders/star_rail");
+                StarRailOutlineMaterialBuilder outline_material_builder(
+                    render_pipelines,
+                    scene_drawer.pipeline_layout_builder,
+                    scene_drawer.pipeline_builder,
+                    device,
+                    {},
+                    {},
+                    {});
+                outline_material_builder.builder.shader_cache = scene_drawer.shader_modules;
+                outline_material_builder.builder.vertex_shader_info.path = scene_drawer.view_vertex_shader_path("res/shaders/backface_outline");
+                outline_material_builder.builder.fragment_shader_info.path = scene_drawer.material_fragment_shader_path("res/shaders/backface_outline");
+
+                for (ModelPart part : {ModelPart::Body, ModelPart::Hair, ModelPart::Face})
+                {
+                    material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(part));
+                    material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(part));
+                    shading[static_cast<size_t>(part)] = material_builder.build();
+                }
+                for (ModelPart part : {ModelPart::Body, ModelPart::Face})
+                {
+                    outline_material_builder.builder.vertex_shader_info.constants.set_constant(0, bytes(part));
+                    outline_material_builder.builder.fragment_shader_info.constants.set_constant(0, bytes(part));
+                    outline[static_cast<size_t>(part)] = outline_material_builder.build();
+                }
+                outline[static_cast<size_t>(ModelPart::Hair)] = outline[static_cast<size_t>(ModelPart::Body)];
             }
         };
 
-        auto build_base_instance = [&](ModelPart part, const std::wstring &diffuse_filename)
+        // 灵砂的材质：body、hair、face 三种着色，描边 hair 和 body 共用
+        class LingshaMaterials
         {
-            StarRailMaterialInstanceBuilder &material_instance_builder = get_material(part);
-            material_instance_builder.filename_diffuse = std::filesystem::path("res/model/HonkaiStarRail/lingsha").append(diffuse_filename).string();
-            return std::static_pointer_cast<IMaterialInstance>(material_instance_builder.build_shared());
+        public:
+            LingshaMaterials(SceneDrawer &scene_drawer,
+                             uint32_t frame_count,
+                             vk::SharedDevice device,
+                             vk::PhysicalDevice physical_device,
+                             vk::CommandBuffer command_buffer,
+                             vk::Queue transfer_queue)
+            {
+                LingshaPipelines pipelines(scene_drawer, scene_drawer.render_pipelines, device);
+                for (ModelPart part : {ModelPart::Body, ModelPart::Hair, ModelPart::Face})
+                {
+                    StarRailMaterialInstanceBuilder &instance_builder = m_instance_builders[static_cast<size_t>(part)];
+                    instance_builder = {device,
+                                        physical_device,
+                                        command_buffer,
+                                        transfer_queue,
+                                        frame_count,
+                                        pipelines.shading[static_cast<size_t>(part)],
+                                        nullptr,
+                                        {},
+                                        {},
+                                        {},
+                                        {},
+                                        &scene_drawer.bindless_textures,
+                                        scene_drawer.material_parameters.get(),
+                                        scene_drawer.sampler_cache,
+                                        nullptr,
+                                        scene_drawer.compressed_textures,
+                                        nullptr};
+                    std::string prefix = (lingsha_directory / (part == ModelPart::Hair ? "Avatar_Lingsha_00_Hair_" : "Avatar_Lingsha_00_Body_")).string();
+                    instance_builder.filename_light_map = prefix + (part == ModelPart::Hair ? "LightMap.png" : "LightMap_L.png");
+                    instance_builder.filename_cool_ramp = prefix + "Cool_Ramp.png";
+                    instance_builder.filename_warm_ramp = prefix + "Warm_Ramp.png";
+                }
+
+                for (ModelPart part : {ModelPart::Body, ModelPart::Face})
+                {
+                    m_outline_instance_builders[static_cast<size_t>(part)] = {device,
+                                                                              physical_device,
+                                                                              command_buffer,
+                                                                              transfer_queue,
+                                                                              frame_count,
+                                                                              pipelines.outline[static_cast<size_t>(part)],
+                                                                              nullptr,
+                                                                              {},
+                                                                              &scene_drawer.bindless_textures,
+                                                                              scene_drawer.material_parameters.get(),
+                                                                              scene_drawer.sampler_cache,
+                                                                              nullptr,
+                                                                              scene_drawer.compressed_textures,
+                                                                              nullptr};
+                }
+                m_outline_instance_builders[static_cast<size_t>(ModelPart::Hair)] = m_outline_instance_builders[static_cast<size_t>(ModelPart::Body)];
+            }
+
+            // 纹理从哪里来，见 StarRailMaterialInstanceBuilder 的同名字段
+            void set_texture_sources(std::unordered_map<std::string, Texture> *texture_cache, TextureUploadBatch *upload_batch, TextureLoader *texture_loader)
+            {
+                for (StarRailMaterialInstanceBuilder &builder : m_instance_builders)
+                {
+                    builder.texture_cache = texture_cache;
+                    builder.upload_batch = upload_batch;
+                    builder.texture_loader = texture_loader;
+                }
+                for (StarRailOutlineMaterialInstanceBuilder &builder : m_outline_instance_builders)
+                {
+                    builder.texture_cache = texture_cache;
+                    builder.upload_batch = upload_batch;
+                    builder.texture_loader = texture_loader;
+                }
+            }
+
+            std::vector<TextureRequest> texture_requests(const LingshaData &data)
+            {
+                std::vector<TextureRequest> requests;
+                for (auto [part, diffuse_filename] : std::views::zip(data.parts, data.diffuse_filenames))
+                {
+                    StarRailMaterialInstanceBuilder &instance_builder = m_instance_builders[static_cast<size_t>(part)];
+                    instance_builder.filename_diffuse = diffuse_filename;
+                    std::ranges::move(instance_builder.texture_requests(), std::back_inserter(requests));
+                    StarRailOutlineMaterialInstanceBuilder &outline_instance_builder = m_outline_instance_builders[static_cast<size_t>(part)];
+                    outline_instance_builder.filename_diffuse = diffuse_filename;
+                    std::ranges::move(outline_instance_builder.texture_requests(), std::back_inserter(requests));
+                }
+                return requests;
+            }
+
+            // 先是每个 sub mesh 的着色材质，再是每个 sub mesh 的描边材质，diffuse 相同的共用一个实例
+            std::vector<std::shared_ptr<IMaterialInstance>> build(const LingshaData &data)
+            {
+                std::vector<std::shared_ptr<IMaterialInstance>> materials;
+                std::unordered_map<std::string, std::shared_ptr<IMaterialInstance>> base_materials_cache;
+                for (auto [part, diffuse_filename] : std::views::zip(data.parts, data.diffuse_filenames))
+                {
+                    std::shared_ptr<IMaterialInstance> &material = base_materials_cache[diffuse_filename];
+                    if (!material)
+                    {
+                        StarRailMaterialInstanceBuilder &instance_builder = m_instance_builders[static_cast<size_t>(part)];
+                        instance_builder.filename_diffuse = diffuse_filename;
+                        material = instance_builder.build_shared();
+                    }
+                    materials.push_back(material);
+                }
+                std::unordered_map<std::string, std::shared_ptr<IMaterialInstance>> outline_materials_cache;
+                for (auto [part, diffuse_filename] : std::views::zip(data.parts, data.diffuse_filenames))
+                {
+                    std::shared_ptr<IMaterialInstance> &material = outline_materials_cache[diffuse_filename];
+                    if (!material)
+                    {
+                        StarRailOutlineMaterialInstanceBuilder &instance_builder = m_outline_instance_builders[static_cast<size_t>(part)];
+                        instance_builder.filename_diffuse = diffuse_filename;
+                        material = instance_builder.build_shared();
+                    }
+                    materials.push_back(material);
+                }
+                return materials;
+            }
+
+        private:
+            std::array<StarRailMaterialInstanceBuilder, static_cast<size_t>(ModelPart::PartNum)> m_instance_builders;
+            std::array<StarRailOutlineMaterialInstanceBuilder, static_cast<size_t>(ModelPart::PartNum)> m_outline_instance_builders;
         };
 
-        auto build_outline_instance = [&](ModelPart part, const std::wstring &diffuse_filename)
+        class LingshaModelSource : public IAsyncModelSource
         {
-            StarRailOutlineMaterialInstanceBuilder &material_instance_builder = get_outline_material(part);
-            material_instance_builder.filename_diffuse = std::filesystem::path("res/model/HonkaiStarRail/lingsha").append(diffuse_filename).string();
-            return std::static_pointer_cast<IMaterialInstance>(material_instance_builder.build_shared());
+        public:
+            // 在渲染线程上构造：记下现在已有的 pipeline，工作线程上只编缺的
+            LingshaModelSource(SceneDrawer &scene_drawer, uint32_t frame_count) : m_scene_drawer(scene_drawer),
+                                                                                  m_frame_count(frame_count),
+                                                                                  m_device(scene_drawer.pipeline_builder.device),
+                                                                                  m_pipeline_generation(scene_drawer.render_pipelines.generation())
+            {
+                m_render_pipelines.pipelines = scene_drawer.render_pipelines.pipelines;
+            }
+
+            void prepare() override
+            {
+                m_data = prepare_lingsha(lingsha_source);
+                LingshaPipelines pipelines(m_scene_drawer, m_render_pipelines, m_device);
+            }
+
+            AsyncModelParts create(AsyncModelContext &context) override
+            {
+                AsyncModelParts parts;
+                if (std::optional<std::shared_ptr<Mesh>> cached = m_scene_drawer.mesh_cache->find(m_data.mesh_key))
+                {
+                    parts.mesh = std::move(*cached);
+                }
+                else
+                {
+                    PmxMeshBuilder<Vertex, uint32_t> mesh_builder(context.device, context.physical_device, context.command_buffer, {}, m_data.mesh, std::move(m_data.sub_meshes));
+                    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(mesh_builder.record(context.command_buffer, context.staging_buffers));
+                    m_scene_drawer.mesh_cache->insert(m_data.mesh_key, mesh);
+                    parts.mesh = std::move(mesh);
+                }
+                m_data.mesh.reset(); // 已经拷进 staging 了，解除映射
+
+                // prepare 编好的放进场景，LingshaMaterials 就都能找到。之后 msaa 之类变过的话是照旧设置编的，丢掉在这里重编
+                if (m_scene_drawer.render_pipelines.generation() == m_pipeline_generation)
+                {
+                    for (auto &[key, render_pipeline] : m_render_pipelines.pipelines)
+                    {
+                        m_scene_drawer.render_pipelines.pipelines.try_emplace(key, render_pipeline);
+                    }
+                }
+                m_render_pipelines.pipelines.clear();
+
+                // 纹理都先用占位的，builder 从 texture_cache 里拿，不会自己去加载。
+                // 真正的纹理由 streamer 持有、AsyncModelLoader 换进来，不走 SceneDrawer::texture_cache
+                LingshaMaterials materials(m_scene_drawer, m_frame_count, context.device, context.physical_device, context.command_buffer, {});
+                std::unordered_map<std::string, Texture> texture_cache;
+                for (const TextureRequest &request : materials.texture_requests(m_data))
+                {
+                    if (!texture_cache.contains(request.filename))
+                    {
+                        texture_cache.emplace(request.filename, context.request_texture(request));
+                    }
+                }
+                materials.set_texture_sources(&texture_cache, nullptr, nullptr);
+                parts.materials = materials.build(m_data);
+                return parts;
+            }
+
+        private:
+            SceneDrawer &m_scene_drawer;
+            uint32_t m_frame_count;
+            vk::SharedDevice m_device;
+            uint32_t m_pipeline_generation;
+            RenderPipelineResources m_render_pipelines; // 工作线程上编 pipeline 用，create 的时候并进场景的
+            LingshaData m_data;
         };
+    }
 
-        auto get_material_instance = [&pmx_file, &get_material, &model_parts](uint32_t i, std::unordered_map<std::wstring, std::shared_ptr<IMaterialInstance>> &cache, std::function<std::shared_ptr<IMaterialInstance>(ModelPart, const std::wstring &)> build_material_instance)
+    Model load_lingsha(SceneDrawer &scene_drawer,
+                       uint32_t frame_count,
+                       vk::SharedDevice device,
+                       vk::PhysicalDevice physical_device,
+                       vk::SharedQueue transfer_queue,
+                       vk::SharedCommandBuffer command_buffer)
+    {
+        Model model = scene_drawer.factory.create();
+        LingshaData data = prepare_lingsha(lingsha_source);
+        if (std::optional<std::shared_ptr<Mesh>> cached = scene_drawer.mesh_cache->find(data.mesh_key))
+        {
+            model.mesh = std::move(*cached);
+        }
+        else
+        {
+            PmxMeshBuilder<Vertex, uint32_t> builder(device,
+                                                     physical_device,
+                                                     command_buffer.get(),
+                                                     transfer_queue.get(),
+                                                     data.mesh,
+                                                     std::move(data.sub_meshes));
+            std::shared_ptr<Mesh> mesh = builder.build_shared();
+            scene_drawer.mesh_cache->insert(data.mesh_key, mesh);
+            model.mesh = std::move(mesh);
+        }
+
+        std::unordered_map<std::string, Texture> texture_cache;
+        TextureUploadBatch upload_batch(device, command_buffer.get(), transfer_queue.get(), scene_drawer.mip_generator.get());
+        TextureLoader texture_loader(device, physical_device, command_buffer.get(), transfer_queue.get(), upload_batch);
+        texture_loader.sampler_cache = scene_drawer.sampler_cache;
+        texture_loader.bindless_table = &scene_drawer.bindless_textures;
+        texture_loader.compressed_textures = scene_drawer.compressed_textures;
+        LingshaMaterials materials(scene_drawer, frame_count, device, physical_device, command_buffer.get(), transfer_queue.get());
+        materials.set_texture_sources(&texture_cache, &upload_batch, &texture_loader);
+
+        // 场景缓存里有的直接放进 texture_cache，builder 就不会再加载；
+        // 剩下的先都交给 texture_loader，后台并行解码，下面按顺序 build 的时候边等边上传
+        std::vector<std::pair<std::string, std::string>> loaded_keys; // 文件名, SceneDrawer::texture_cache 的 key
+        for (const TextureRequest &request : materials.texture_requests(data))
         {
-            std::wstring diffuse_filename = pmx_file.model().textures[pmx_file.model().materials[i].diffuse_texture_index];
-            if (cache.contains(diffuse_filename))
+            if (texture_cache.contains(request.filename))
             {
-                return cache[diffuse_filename];
+                continue;
             }
-            ModelPart part = model_parts[i];
-            auto material_instance = build_material_instance(part, diffuse_filename);
-            cache[diffuse_filename] = material_instance;
-            return std::static_pointer_cast<IMaterialInstance>(material_instance);
-        };
+            std::string key = texture_cache_key(request, scene_drawer.sampler_cache->get(request.sampler_create_info).get());
+            if (std::optional<std::shared_ptr<Texture>> cached = scene_drawer.texture_cache->find(key))
+            {
+                texture_cache.emplace(request.filename, **cached);
+                model.textures.push_back(std::move(*cached));
+            }
+            else if (std::ranges::find(loaded_keys, request.filename, &std::pair<std::string, std::string>::first) == loaded_keys.end())
+            {
+                texture_loader.load(request);
+                loaded_keys.emplace_back(request.filename, std::move(key));
+            }
+        }
+        model.materials = materials.build(data);
+        texture_loader.wait_all();
+        upload_batch.submit();
 
-        std::unordered_map<std::wstring, std::shared_ptr<IMaterialInstance>> base_materials_cache;
-        std::unordered_map<std::wstring, std::shared_ptr<IMaterialInstance>> outline_materials_cache;
-        model.materials = filtered_sub_mesh_indexes |
-                          std::views::transform(
-                              std::bind(get_material_instance, std::placeholders::_1, base_materials_cache, build_base_instance)) |
-                          std::ranges::to<std::vector>();
-        std::ranges::transform(filtered_sub_mesh_indexes,
-                               std::back_inserter(model.materials),
-                               std::bind(get_material_instance, std::placeholders::_1, outline_materials_cache, build_outline_instance));
+        for (auto &[filename, key] : loaded_keys)
+        {
+            std::shared_ptr<Texture> texture = std::make_shared<Texture>(texture_cache.at(filename));
+            scene_drawer.texture_cache->insert(key, SizedResource<std::shared_ptr<Texture>>{texture, device->getImageMemoryRequirements(texture->image.get()).size});
+            model.textures.push_back(std::move(texture));
+        }
 
         return std::move(model);
     }
-}
\ No newline at end of file
+
+    AsyncModelHandle load_lingsha_async(AsyncModelLoader &loader, SceneDrawer &scene_drawer, uint32_t frame_count)
+    {
+        return loader.load(std::make_shared<LingshaModelSource>(scene_drawer, frame_count));
+    }
+}
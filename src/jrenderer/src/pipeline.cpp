@@ -91,4 +91,88 @@ namespace jre
         }
         return vk::SharedPipeline{res_value.value, device};
     }
-}
\ No newline at end of file
+
+    vk::SharedPipeline ComputePipelineBuilder::build()
+    {
+        auto [data, entries] = convert_to<std::pair<jre::bytes, std::vector<vk::SpecializationMapEntry>>>(specialization);
+        vk::SpecializationInfo specialization_info(static_cast<uint32_t>(entries.size()), entries.data(), data.size(), data.data());
+        vk::ComputePipelineCreateInfo pipeline_info(
+            {},
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, shader, entry.c_str(), &specialization_info),
+            pipeline_layout);
+        auto res_value = device->createComputePipeline(cache, pipeline_info);
+        if (res_value.result != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        return vk::SharedPipeline{res_value.value, device};
+    }
+
+    SharedRenderPipeline RenderPipelineResources::get_or_create_specialized(const SharedRenderPipeline &base, const SpecializationConstants &constants)
+    {
+        size_t hash_of_constants = std::hash<std::map<uint32_t, bytes>>{}(constants.constants());
+        auto [it, inserted] = base->specialized_variants.try_emplace(hash_of_constants);
+        if (inserted)
+        {
+            // layout 和 shader module 共用，只换特化常量
+            it->second = std::make_shared<RenderPipeline>(*base);
+            RenderPipeline &variant = *it->second;
+            variant.specialized_variants.clear();
+            variant.vertex_constants.merge(constants);
+            variant.fragment_constants.merge(constants);
+            for (auto [stage, specialization] : std::views::zip(variant.pipeline_builder.stages, variant.pipeline_builder.specialization_constants))
+            {
+                specialization = convert_to<std::pair<jre::bytes, std::vector<vk::SpecializationMapEntry>>>(
+                    stage.stage == vk::ShaderStageFlagBits::eVertex ? variant.vertex_constants : variant.fragment_constants);
+            }
+            if (variant.visibility_shader)
+            {
+                variant.visibility_constants.merge(constants);
+            }
+            variant.recreate_pipeline();
+        }
+        return it->second;
+    }
+
+    void RenderPipelineResources::begin_frame(uint32_t frame)
+    {
+        if (m_retired_variants.size() <= frame)
+        {
+            m_retired_variants.resize(frame + 1);
+        }
+        std::vector<SharedRenderPipeline> &retired = m_retired_variants[frame];
+        retired.clear();
+        // 只剩 specialized_variants 自己拿着：最后一个实例解冻或者换了常量重新冻结了，在飞的帧可能还在用，先记着
+        for (auto &[key, render_pipeline] : pipelines)
+        {
+            std::erase_if(render_pipeline->specialized_variants, [&retired](auto &entry)
+                          {
+                              if (entry.second.use_count() > 1)
+                              {
+                                  return false;
+                              }
+                              retired.push_back(std::move(entry.second));
+                              return true; });
+        }
+    }
+
+    void RenderPipelineResources::recreate_pipelines(const std::function<bool(RenderPipeline &)> &update)
+    {
+        ++m_generation;
+        for (auto &[key, render_pipeline] : pipelines)
+        {
+            if (!update(*render_pipeline))
+            {
+                continue;
+            }
+            render_pipeline->recreate_pipeline();
+            std::erase_if(render_pipeline->specialized_variants, [](const auto &entry)
+                          { return entry.second.use_count() == 1; });
+            for (auto &[constants_hash, variant] : render_pipeline->specialized_variants)
+            {
+                update(*variant);
+                variant->recreate_pipeline();
+            }
+        }
+    }
+}
@@ -0,0 +1,330 @@
+#include "jrenderer/asset/pmx_reader.h"
+#include "jrenderer/asset/asset_archive.h"
+#include "tracy/Tracy.hpp"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JRE_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JRE_SIMD_SSE2
+#endif
+
+namespace jre
+{
+    namespace
+    {
+        enum class PmxEncoding : uint8_t
+        {
+            Utf16 = 0,
+            Utf8 = 1,
+        };
+
+        struct PmxGlobals
+        {
+            PmxEncoding encoding;
+            uint8_t additional_uv_count;
+            uint8_t vertex_index_size;
+            uint8_t texture_index_size;
+            uint8_t material_index_size;
+            uint8_t bone_index_size;
+            uint8_t morph_index_size;
+            uint8_t rigid_body_index_size;
+        };
+
+        // Windows 上 wchar_t 是 UTF-16，要拆成代理对
+        void append_code_point(std::wstring &text, uint32_t code_point)
+        {
+            if (sizeof(wchar_t) == sizeof(char16_t) && code_point >= 0x10000)
+            {
+                code_point -= 0x10000;
+                text.push_back(static_cast<wchar_t>(0xD800 + (code_point >> 10)));
+                text.push_back(static_cast<wchar_t>(0xDC00 + (code_point & 0x3FF)));
+            }
+            else
+            {
+                text.push_back(static_cast<wchar_t>(code_point));
+            }
+        }
+
+        // 在映射的内存上往前挪，越界就抛异常
+        class PmxCursor
+        {
+        public:
+            PmxCursor(std::span<const std::byte> data) : m_current(data.data()), m_end(data.data() + data.size()) {}
+
+            const std::byte *take(size_t size)
+            {
+                if (static_cast<size_t>(m_end - m_current) < size)
+                {
+                    throw std::runtime_error("PmxReader: truncated file");
+                }
+                const std::byte *data = m_current;
+                m_current += size;
+                return data;
+            }
+
+            void skip(size_t size) { take(size); }
+
+            template <typename T>
+            T read()
+            {
+                T value;
+                std::memcpy(&value, take(sizeof(T)), sizeof(T));
+                return value;
+            }
+
+            // 顶点索引 1、2 字节的是无符号的
+            uint32_t read_vertex_index(uint8_t size)
+            {
+                switch (size)
+                {
+                case 1:
+                    return read<uint8_t>();
+                case 2:
+                    return read<uint16_t>();
+                case 4:
+                    return read<uint32_t>();
+                default:
+                    throw std::runtime_error("PmxReader: invalid index size");
+                }
+            }
+
+            // 其他的索引都是有符号的，-1 表示没有
+            int32_t read_index(uint8_t size)
+            {
+                switch (size)
+                {
+                case 1:
+                    return read<int8_t>();
+                case 2:
+                    return read<int16_t>();
+                case 4:
+                    return read<int32_t>();
+                default:
+                    throw std::runtime_error("PmxReader: invalid index size");
+                }
+            }
+
+            uint32_t read_count()
+            {
+                const int32_t count = read<int32_t>();
+                if (count < 0)
+                {
+                    throw std::runtime_error("PmxReader: invalid count");
+                }
+                return static_cast<uint32_t>(count);
+            }
+
+            std::wstring read_text(PmxEncoding encoding)
+            {
+                const uint32_t size = read_count();
+                const std::byte *data = take(size);
+                std::wstring text;
+                text.reserve(encoding == PmxEncoding::Utf16 ? size / 2 : size);
+                if (encoding == PmxEncoding::Utf16)
+                {
+                    for (uint32_t i = 0; i + 1 < size; i += 2)
+                    {
+                        const uint32_t unit = std::to_integer<uint32_t>(data[i]) | std::to_integer<uint32_t>(data[i + 1]) << 8;
+                        if constexpr (sizeof(wchar_t) == sizeof(char16_t))
+                        {
+                            text.push_back(static_cast<wchar_t>(unit));
+                        }
+                        else if (unit >= 0xDC00 && unit < 0xE000 && !text.empty() && text.back() >= 0xD800 && text.back() < 0xDC00)
+                        {
+                            text.back() = static_cast<wchar_t>(0x10000 + ((text.back() - 0xD800) << 10) + (unit - 0xDC00));
+                        }
+                        else
+                        {
+                            text.push_back(static_cast<wchar_t>(unit));
+                        }
+                    }
+                    return text;
+                }
+                for (uint32_t i = 0; i < size;)
+                {
+                    const uint32_t lead = std::to_integer<uint32_t>(data[i]);
+                    const uint32_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+                    uint32_t code_point = length == 1 ? lead : lead & (0x3F >> (length - 1));
+                    for (uint32_t k = 1; k < length && i + k < size; ++k)
+                    {
+                        code_point = code_point << 6 | (std::to_integer<uint32_t>(data[i + k]) & 0x3F);
+                    }
+                    i += length;
+                    append_code_point(text, code_point);
+                }
+                return text;
+            }
+
+            void skip_text() { skip(read_count()); }
+
+        private:
+            const std::byte *m_current;
+            const std::byte *m_end;
+        };
+
+        PmxGlobals read_header(PmxCursor &cursor)
+        {
+            const std::byte *magic = cursor.take(4);
+            if (std::memcmp(magic, "PMX ", 4) != 0)
+            {
+                throw std::runtime_error("PmxReader: not a pmx file");
+            }
+            const float version = cursor.read<float>();
+            if (version != 2.0f && version != 2.1f)
+            {
+                throw std::runtime_error("PmxReader: unsupported version");
+            }
+            const uint8_t global_count = cursor.read<uint8_t>();
+            if (global_count < 8)
+            {
+                throw std::runtime_error("PmxReader: invalid globals");
+            }
+            PmxGlobals globals;
+            std::memcpy(&globals, cursor.take(sizeof(PmxGlobals)), sizeof(PmxGlobals));
+            cursor.skip(global_count - sizeof(PmxGlobals));
+            if (globals.encoding != PmxEncoding::Utf16 && globals.encoding != PmxEncoding::Utf8)
+            {
+                throw std::runtime_error("PmxReader: invalid text encoding");
+            }
+            return globals;
+        }
+    }
+
+    PmxReader::PmxReader(const std::filesystem::path &path)
+        : PmxReader(read_asset(path).data())
+    {
+    }
+
+    PmxReader::PmxReader(std::span<const std::byte> bytes)
+    {
+        ZoneScoped;
+        PmxCursor cursor(bytes);
+        const PmxGlobals globals = read_header(cursor);
+
+        // 模型名、英文名、注释、英文注释
+        for (int i = 0; i < 4; ++i)
+        {
+            cursor.skip_text();
+        }
+
+        // 顶点：位置、法线、UV 之后是附加 UV、蒙皮 (按类型长度不同)、描边倍率，都不要
+        const size_t bone_index_size = globals.bone_index_size;
+        const std::array<size_t, 5> skinning_sizes = {
+            bone_index_size,                                         // BDEF1
+            bone_index_size * 2 + sizeof(float),                     // BDEF2
+            bone_index_size * 4 + sizeof(float) * 4,                 // BDEF4
+            bone_index_size * 2 + sizeof(float) + sizeof(float) * 9, // SDEF: 权重之后 C、R0、R1
+            bone_index_size * 4 + sizeof(float) * 4,                 // QDEF
+        };
+        const size_t additional_uv_size = globals.additional_uv_count * sizeof(float) * 4;
+        const uint32_t vertex_count = cursor.read_count();
+        positions.resize(vertex_count);
+        normals.resize(vertex_count);
+        uvs.resize(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            const std::byte *vertex = cursor.take(sizeof(float) * 8);
+            // 不整个拷 glm::vec3，对齐的 vec3 有 4 个分量
+            std::memcpy(&positions[i].x, vertex, sizeof(float) * 3);
+            std::memcpy(&normals[i].x, vertex + sizeof(float) * 3, sizeof(float) * 3);
+            std::memcpy(&uvs[i].x, vertex + sizeof(float) * 6, sizeof(float) * 2);
+            cursor.skip(additional_uv_size);
+            const uint8_t skinning_type = cursor.read<uint8_t>();
+            if (skinning_type >= skinning_sizes.size())
+            {
+                throw std::runtime_error("PmxReader: invalid skinning type");
+            }
+            cursor.skip(skinning_sizes[skinning_type] + sizeof(float));
+        }
+
+        // 索引
+        const uint32_t index_count = cursor.read_count();
+        indices.resize(index_count);
+        if (globals.vertex_index_size == sizeof(uint32_t))
+        {
+            std::memcpy(indices.data(), cursor.take(index_count * sizeof(uint32_t)), index_count * sizeof(uint32_t));
+        }
+        else
+        {
+            for (uint32_t &index : indices)
+            {
+                index = cursor.read_vertex_index(globals.vertex_index_size);
+            }
+        }
+        for (uint32_t index : indices)
+        {
+            if (index >= vertex_count)
+            {
+                throw std::runtime_error("PmxReader: vertex index out of range");
+            }
+        }
+
+        // 纹理
+        const uint32_t texture_count = cursor.read_count();
+        textures.reserve(texture_count);
+        for (uint32_t i = 0; i < texture_count; ++i)
+        {
+            textures.push_back(cursor.read_text(globals.encoding));
+        }
+
+        // 材质，只留名字、漫反射纹理和索引数
+        const uint32_t material_count = cursor.read_count();
+        materials.reserve(material_count);
+        uint64_t material_index_count = 0;
+        for (uint32_t i = 0; i < material_count; ++i)
+        {
+            Material &material = materials.emplace_back();
+            material.name = cursor.read_text(globals.encoding);
+            cursor.skip_text(); // 英文名
+            // 漫反射 vec4、高光 vec3、高光系数、环境光 vec3、标志位、描边颜色 vec4、描边大小
+            cursor.skip(sizeof(float) * 4 + sizeof(float) * 3 + sizeof(float) + sizeof(float) * 3 + sizeof(uint8_t) + sizeof(float) * 4 + sizeof(float));
+            material.diffuse_texture_index = cursor.read_index(globals.texture_index_size);
+            cursor.read_index(globals.texture_index_size); // sphere 纹理
+            cursor.skip(sizeof(uint8_t));                  // sphere 模式
+            const uint8_t shared_toon = cursor.read<uint8_t>();
+            cursor.skip(shared_toon != 0 ? sizeof(uint8_t) : globals.texture_index_size);
+            cursor.skip_text(); // 备注
+            material.index_count = cursor.read_count();
+            material_index_count += material.index_count;
+        }
+        if (material_index_count > index_count)
+        {
+            throw std::runtime_error("PmxReader: material index count out of range");
+        }
+    }
+
+    void PmxReader::write_vertices(Vertex *destination) const
+    {
+        ZoneScoped;
+        // 按 pos、normal、tex_coord 的顺序写，前一个 16 字节的写多出来的那个分量落在填充或者下一个成员上，会被下一个写覆盖
+        static_assert(offsetof(Vertex, normal) >= offsetof(Vertex, pos) + sizeof(float) * 3 &&
+                      offsetof(Vertex, tex_coord) >= offsetof(Vertex, normal) + sizeof(float) * 3 &&
+                      offsetof(Vertex, pos) + sizeof(float) * 4 <= sizeof(Vertex));
+        const uint32_t count = vertex_count();
+        uint32_t i = 0;
+#if defined(JRE_SIMD_SSE2)
+        // 读 4 个分量，紧凑的 vec3 最后一个顶点会读出界，留给下面的标量
+        const uint32_t simd_count = sizeof(glm::vec3) == sizeof(float) * 4 ? count : (count > 0 ? count - 1 : 0);
+        const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        for (; i < simd_count; ++i)
+        {
+            std::byte *vertex = reinterpret_cast<std::byte *>(destination + i);
+            const __m128 position = _mm_and_ps(_mm_loadu_ps(&positions[i].x), xyz_mask);
+            const __m128 normal = _mm_and_ps(_mm_loadu_ps(&normals[i].x), xyz_mask);
+            const __m128 uv = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(&uvs[i].x)));
+            _mm_storeu_ps(reinterpret_cast<float *>(vertex + offsetof(Vertex, pos)), position);
+            _mm_storeu_ps(reinterpret_cast<float *>(vertex + offsetof(Vertex, normal)), normal);
+            _mm_storel_pi(reinterpret_cast<__m64 *>(vertex + offsetof(Vertex, tex_coord)), uv);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            destination[i] = Vertex(positions[i], normals[i], uvs[i]);
+        }
+    }
+}
@@ -1,4 +1,5 @@
 #include "jrenderer/asset/raii_stb_image.h"
+#include "jrenderer/asset/asset_archive.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 #undef STB_IMAGE_IMPLEMENTATION
@@ -7,8 +8,13 @@
 namespace jre
 {
     STBImage::STBImage(const std::string &file_name)
+        : STBImage(read_asset(file_name).data())
     {
-        m_data = stbi_load(file_name.c_str(), &m_width, &m_height, &m_channels, STBI_rgb_alpha);
+    }
+
+    STBImage::STBImage(std::span<const std::byte> bytes)
+    {
+        m_data = stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(bytes.data()), static_cast<int>(bytes.size()), &m_width, &m_height, &m_channels, STBI_rgb_alpha);
         m_channels = 4;
         if (!m_data)
         {
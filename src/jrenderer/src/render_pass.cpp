@@ -23,13 +23,13 @@ namespace jre
                               vk::ImageLayout::eColorAttachmentOptimal);
     }
 
-    vk::AttachmentReference RenderPassBuilder::add_depth_attachment(vk::Format format, vk::SampleCountFlagBits sample_count)
+    vk::AttachmentReference RenderPassBuilder::add_depth_attachment(vk::Format format, vk::SampleCountFlagBits sample_count, vk::AttachmentStoreOp store_op)
     {
         return add_attachment(vk::AttachmentDescription(vk::AttachmentDescriptionFlags{},
                                                         format,
                                                         sample_count,
                                                         vk::AttachmentLoadOp::eClear,
-                                                        vk::AttachmentStoreOp::eDontCare,
+                                                        store_op,
                                                         vk::AttachmentLoadOp::eDontCare,
                                                         vk::AttachmentStoreOp::eDontCare,
                                                         vk::ImageLayout::eUndefined,
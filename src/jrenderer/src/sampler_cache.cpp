@@ -0,0 +1,33 @@
+#include "jrenderer/sampler_cache.h"
+#include <glm/gtx/hash.hpp>
+
+namespace jre
+{
+    size_t SamplerCache::CreateInfoHash::operator()(const vk::SamplerCreateInfo &create_info) const
+    {
+        size_t hash{};
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.magFilter)));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.minFilter)));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.mipmapMode)));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.addressModeU)));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.addressModeV)));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.addressModeW)));
+        glm::detail::hash_combine(hash, std::hash<float>{}(create_info.mipLodBias));
+        glm::detail::hash_combine(hash, std::hash<float>{}(create_info.maxAnisotropy));
+        glm::detail::hash_combine(hash, std::hash<uint32_t>{}(static_cast<uint32_t>(create_info.compareOp)));
+        glm::detail::hash_combine(hash, std::hash<float>{}(create_info.minLod));
+        glm::detail::hash_combine(hash, std::hash<float>{}(create_info.maxLod));
+        return hash; // 剩下的字段交给 operator==
+    }
+
+    vk::SharedSampler SamplerCache::get(const vk::SamplerCreateInfo &create_info)
+    {
+        assert(!create_info.pNext);
+        auto [it, inserted] = m_samplers.try_emplace(create_info);
+        if (inserted)
+        {
+            it->second = vk::SharedSampler(m_device->createSampler(create_info), m_device);
+        }
+        return it->second;
+    }
+}
@@ -1,27 +1,48 @@
 #include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/drawer/visibility_buffer_drawer.h"
+#include "jrenderer/drawer/screen_space_outline_drawer.h"
 #include "jrenderer/graphics.h"
 #include "jrenderer/utils/diff_trigger.hpp"
 #include "jrenderer/mesh_drawer.h"
 #include "tracy/Tracy.hpp"
+#include <ranges>
 
 namespace jre
 {
 
     SceneDrawer::SceneDrawer(Graphics &graphics)
-        : factory(graphics.logical_device(),
-                  graphics.physical_device(),
-                  graphics.cpu_frames().size()),
+        : factory(static_cast<uint32_t>(graphics.cpu_frames().size())),
+          material_parameters(std::make_shared<MaterialParameterTable>(graphics.logical_device(), graphics.physical_device(), BindlessTextureTable::max_materials)),
+          bindless_textures(graphics.logical_device(), graphics.physical_device(), material_parameters->vk_buffer()),
+          sampler_cache(&graphics.sampler_cache()),
+          shader_modules(&graphics.shader_modules()),
+          mip_generator(graphics.physical_device_info().features.shaderStorageImageArrayDynamicIndexing ? std::make_shared<MipGenerator>(graphics) : nullptr),
+          compressed_textures(graphics.physical_device_info().features.textureCompressionBC),
+          render_view_limit(graphics.multi_viewport() ? max_render_views : 1),
+          virtual_texture_feedback(graphics.sparse_residency()), // JRenderer 在支持稀疏纹理时建 VirtualTextureSystem
           pipeline_layout_builder{graphics.logical_device(), {}, {}},
           pipeline_builder(graphics.logical_device(), VK_NULL_HANDLE, graphics.render_pass().get()),
           scene(graphics.logical_device(), graphics.physical_device(), graphics.cpu_frames().size())
     {
+        retired_meshes = std::make_shared<RetiredMeshes>(static_cast<uint32_t>(graphics.cpu_frames().size()));
+        mesh_cache = std::make_unique<MeshCache>(MeshCreator{retired_meshes}, 512ull << 20);
+        m_retired_textures = std::make_shared<RetiredTextures>(static_cast<uint32_t>(graphics.cpu_frames().size()));
+        m_retired_textures->add_release_listener([this](const std::shared_ptr<Texture> &texture)
+                                                 { bindless_textures.release_texture(texture->bindless_index); });
+        texture_cache = std::make_unique<TextureCache>(TextureCreator{m_retired_textures}, 1024ull << 20);
 
         pipeline_layout_builder
             .descriptor_set_layouts.push_back(
                 scene.descriptor_set_layout.get());
         pipeline_layout_builder
             .descriptor_set_layouts.push_back(
-                factory.transform_factory.descriptor_set_layout.get());
+                scene.object_descriptor_set_layout.get());
+        pipeline_layout_builder
+            .descriptor_set_layouts.push_back(
+                bindless_textures.descriptor_set_layout());
+        // 有自己 set 的材质由 MaterialBuilder 加在后面
+        pipeline_layout_builder
+            .push_constant_ranges.push_back(object_push_constant_range());
         pipeline_builder
             .add_vertex_input_binding(get_binding_description<Vertex>(0))
             .add_vertex_input_attributes(get_attribute_descriptions<Vertex>(0))
@@ -31,14 +52,59 @@ namespace jre
             .add_color_blend_attachment(PipelineBuilder::ColorBlendAttachment::alpha())
             .set_multisampling(graphics.settings().msaa)
             .set_rasterizer(vk::PolygonMode::eFill, 1.0f, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise);
+        // 视口数固定成 render_view_limit，没用到的视口填主视口，顶点着色器用 gl_ViewportIndex 选
+        pipeline_builder.viewports.resize(render_view_limit, pipeline_builder.viewports.front());
+        pipeline_builder.scissors.resize(render_view_limit, pipeline_builder.scissors.front());
 
         jre::RenderViewport &viewport = scene.render_viewports.emplace_back();
         viewport.viewport = vk::Viewport{0.0f, 0.0f, static_cast<float>(graphics.swapchain_extent().width), static_cast<float>(graphics.swapchain_extent().height), 0.0f, 1.0f};
+
+        depth_prepass_shader = vk::shared::create_shader_from_spv_file(graphics.logical_device(), view_vertex_shader_path("res/shaders/depth_prepass"));
+        depth_prepass_pipeline_layout = pipeline_layout_builder.build(); // 没有材质 set，只用 scene 和 object 两个 set
+        create_depth_prepass_pipeline(graphics);
+    }
+
+    std::string SceneDrawer::view_vertex_shader_path(std::string_view name) const
+    {
+        return std::string(name) + (render_view_limit > 1 ? ".vert.spv" : "_single_view.vert.spv");
+    }
+
+    std::string SceneDrawer::material_fragment_shader_path(std::string_view name) const
+    {
+        return std::string(name) + (virtual_texture_feedback ? ".frag.spv" : "_no_feedback.frag.spv");
+    }
+
+    void SceneDrawer::create_depth_prepass_pipeline(Graphics &graphics)
+    {
+        PipelineBuilder builder = pipeline_builder;
+        builder.pipeline_layout = depth_prepass_pipeline_layout.get();
+        builder.render_pass = graphics.render_pass().get();
+        builder.vertex_attribute_descriptions = {get_attribute_descriptions<Vertex>(0).front()}; // 只要位置
+        builder.color_blend_attachments = {vk::PipelineColorBlendAttachmentState{}};         // colorWriteMask 为空，不写颜色
+        builder.set_multisampling(graphics.settings().msaa)
+            .add_vertex_shader(depth_prepass_shader.get());
+        depth_prepass_pipeline = builder.build();
+    }
+
+    void SceneDrawer::set_depth_prepass_compare_op(Graphics &graphics, vk::CompareOp compare_op)
+    {
+        graphics.wait_idle();
+        render_pipelines.recreate_pipelines([compare_op](RenderPipeline &render_pipeline)
+                                            {
+                                                if (!render_pipeline.depth_prepass)
+                                                {
+                                                    return false;
+                                                }
+                                                render_pipeline.prepass_compare_op = compare_op;
+                                                return true;
+                                            });
     }
 
     void DiffSceneMaterialBinder::bind(const RenderMaterialData &render_material_data,
                                        vk::DescriptorSet scene_descriptor_set,
-                                       vk::DescriptorSet model_descriptor_set,
+                                       vk::DescriptorSet object_descriptor_set,
+                                       vk::DescriptorSet bindless_descriptor_set,
+                                       uint32_t vertex_base,
                                        vk::CommandBuffer command_buffer)
     {
         if (pipeline_diff.update(render_material_data.pipeline))
@@ -49,59 +115,177 @@ namespace jre
         {
             command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, render_material_data.pipeline_layout, static_cast<int>(UniformBufferSetIndex::PerRenderSet), scene_descriptor_set, nullptr);
         }
-        if (model_descriptor_set_diff.update(std::make_tuple(render_material_data.pipeline_layout, model_descriptor_set)))
+        if (object_descriptor_set_diff.update(std::make_tuple(render_material_data.pipeline_layout, object_descriptor_set)))
+        {
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, render_material_data.pipeline_layout, static_cast<int>(UniformBufferSetIndex::PerObject), object_descriptor_set, nullptr);
+        }
+        if (bindless_descriptor_set_diff.update(std::make_tuple(render_material_data.pipeline_layout, bindless_descriptor_set)))
         {
-            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, render_material_data.pipeline_layout, static_cast<int>(UniformBufferSetIndex::PerObject), model_descriptor_set, nullptr);
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, render_material_data.pipeline_layout, static_cast<int>(UniformBufferSetIndex::Bindless), bindless_descriptor_set, nullptr);
         }
-        if (material_descriptor_set_diff.update(std::make_tuple(render_material_data.pipeline_layout, render_material_data.descriptor_set)))
+        if (render_material_data.descriptor_set && material_descriptor_set_diff.update(std::make_tuple(render_material_data.pipeline_layout, render_material_data.descriptor_set)))
         {
             command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, render_material_data.pipeline_layout, static_cast<int>(UniformBufferSetIndex::PerMaterial), render_material_data.descriptor_set, nullptr);
         }
+        if (push_constants_diff.update(std::make_tuple(render_material_data.pipeline_layout, vertex_base, render_material_data.material_id)))
+        {
+            command_buffer.pushConstants<ObjectPushConstants>(render_material_data.pipeline_layout, object_push_constant_range().stageFlags, 0, ObjectPushConstants{vertex_base, render_material_data.material_id});
+        }
     }
 
     void SceneDrawer::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
     {
         ZoneScoped;
+        const uint32_t frame = graphics.current_cpu_frame();
+        retired_meshes->begin_frame(graphics.recording_cpu_frame()); // 这一帧的 fence 刚等过
+        m_retired_textures->begin_frame(graphics.recording_cpu_frame());
+        render_pipelines.begin_frame(graphics.recording_cpu_frame());
         DiffMeshBinder mesh_binder;
         DiffSceneMaterialBinder material_binder;
+        const bool visibility_mode = visibility_buffer && visibility_buffer->visible && scene.render_viewports.size() == 1;
+        culled_sub_mesh_count = visibility_mode ? visibility_buffer->culled_sub_mesh_count : 0;
+        if (occlusion_culler && !visibility_mode) // 可见性缓冲的 pass 已经 prepare 过了
+        {
+            occlusion_culler->prepare(scene, frame);
+        }
+        build_draw_list(frame, visibility_mode);
+        set_viewports(command_buffer);
 
-        for (auto &render_viewport : scene.render_viewports)
+        if (visibility_mode)
         {
-            command_buffer.setViewport(0, render_viewport.viewport);
-            command_buffer.setScissor(0, render_viewport.scissor.value_or(
-                                             vk::Rect2D{{static_cast<int32_t>(render_viewport.viewport.x),
-                                                         static_cast<int32_t>(render_viewport.viewport.y)},
-                                                        {static_cast<uint32_t>(render_viewport.viewport.width),
-                                                         static_cast<uint32_t>(render_viewport.viewport.height)}}));
-
-            for (Model &model : scene.models)
+            visibility_buffer->draw_composite(command_buffer);
+        }
+        else if (depth_prepass)
+        {
+            draw_depth_prepass(graphics, command_buffer, mesh_binder);
+        }
+
+        for (const SceneDraw &draw : m_draws)
+        {
+            const RenderMeshData &mesh_data = m_draw_meshes[draw.model_index];
+            const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[draw.sub_mesh_index];
+            mesh_binder.bind(mesh_data, command_buffer);
+
+            RenderMaterialData render_material_data = draw.material_data;
+            if (depth_prepass && !visibility_mode && render_material_data.prepassed_pipeline)
             {
-                const RenderMeshData mesh_data = model.mesh->get_render_data();
-                mesh_binder.bind(mesh_data, command_buffer);
+                render_material_data.pipeline = render_material_data.prepassed_pipeline;
+            }
+            material_binder.bind(render_material_data, scene.descriptor_sets[frame].get(), scene.object_descriptor_sets[frame].get(), bindless_textures.descriptor_set(), scene.vertex_bases[draw.model_index], command_buffer);
 
-                auto cur_sub_mesh = mesh_data.sub_meshes.begin();
-                auto cyclic_next = [](auto &it, auto &container) mutable
-                { return std::next(it) == container.end() ? it = container.begin() : ++it; };
+            command_buffer.drawIndexed(sub_mesh.index_count, draw.view_count, sub_mesh.index_offset, sub_mesh.vertex_offset, draw.first_view);
+        }
+
+        if (screen_space_outline)
+        {
+            screen_space_outline->draw_composite(command_buffer);
+        }
+    }
 
-                for (auto &material : model.materials)
+    void SceneDrawer::build_draw_list(uint32_t frame, bool visibility_mode)
+    {
+        ZoneScoped;
+        const UniformScene &ubo_scene = scene.scene_buffers[frame];
+        const uint32_t view_count = static_cast<uint32_t>(std::min<size_t>(scene.render_viewports.size(), render_view_limit));
+        m_draw_meshes.clear();
+        m_draws.clear();
+        for (auto [model_index, model] : scene.models | std::views::enumerate)
+        {
+            const RenderMeshData &mesh_data = m_draw_meshes.emplace_back(model.mesh->get_render_data());
+            const glm::mat4 model_matrix = model.transform.model(frame);
+            for (auto [material_index, material] : model.materials | std::views::enumerate)
+            {
+                const uint32_t sub_mesh_index = static_cast<uint32_t>(material_index % mesh_data.sub_meshes.size());
+                const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[sub_mesh_index];
+                const RenderMaterialData render_material_data = material->get_render_data(frame);
+                if (screen_space_outline && screen_space_outline->handles(static_cast<uint32_t>(model_index), static_cast<uint32_t>(material_index), render_material_data))
                 {
-                    RenderMaterialData render_material_data = material->get_render_data(graphics.current_cpu_frame());
-                    material_binder.bind(render_material_data, scene.descriptor_sets[graphics.current_cpu_frame()].get(), model.transform.descriptor_sets[graphics.current_cpu_frame()].get(), command_buffer);
+                    continue;
+                }
+                const bool handled_by_visibility_buffer = visibility_mode && visibility_buffer->handles(static_cast<uint32_t>(model_index), static_cast<uint32_t>(material_index), mesh_data, render_material_data);
 
-                    command_buffer.drawIndexed(cur_sub_mesh->index_count, 1, cur_sub_mesh->index_offset, cur_sub_mesh->vertex_offset, 0);
-                    cyclic_next(cur_sub_mesh, mesh_data.sub_meshes);
+                // 每个视口先做视锥剔除，主视口再过遮挡剔除；draw 覆盖第一个到最后一个可见的视口
+                uint32_t first_view = view_count;
+                uint32_t last_view = 0;
+                for (uint32_t view_index = 0; view_index < view_count; ++view_index)
+                {
+                    if (view_index == 0 && handled_by_visibility_buffer)
+                    {
+                        continue;
+                    }
+                    std::optional<ScreenRect> rect = project_bounds(sub_mesh.bounds, ubo_scene.cameras[view_index].view_proj * model_matrix);
+                    if ((rect && !rect->overlaps_viewport()) ||
+                        (view_index == 0 && occlusion_culler && !occlusion_culler->is_visible(sub_mesh.bounds, model_matrix)))
+                    {
+                        continue;
+                    }
+                    first_view = std::min(first_view, view_index);
+                    last_view = view_index + 1;
                 }
+
+                if (first_view >= last_view)
+                {
+                    culled_sub_mesh_count += handled_by_visibility_buffer ? 0 : 1; // 可见性缓冲自己统计
+                    continue;
+                }
+                m_draws.push_back({static_cast<uint32_t>(model_index), sub_mesh_index, render_material_data, first_view, last_view - first_view});
             }
         }
+        draw_count = static_cast<uint32_t>(m_draws.size());
     }
 
-    void SceneDrawer::on_set_msaa(Graphics &graphics)
+    void SceneDrawer::set_viewports(vk::CommandBuffer command_buffer)
     {
-        for (auto &[key, render_pipeline] : render_pipelines.pipelines)
+        std::array<vk::Viewport, max_render_views> viewports;
+        std::array<vk::Rect2D, max_render_views> scissors;
+        for (uint32_t view_index = 0; view_index < render_view_limit; ++view_index)
         {
-            render_pipeline->pipeline_builder.render_pass = graphics.render_pass().get();
-            render_pipeline->pipeline_builder.set_multisampling(graphics.settings().msaa);
-            render_pipeline->recreate_pipeline();
+            const RenderViewport &render_viewport = scene.render_viewports[view_index < scene.render_viewports.size() ? view_index : 0];
+            viewports[view_index] = render_viewport.viewport;
+            scissors[view_index] = render_viewport.scissor.value_or(
+                vk::Rect2D{{static_cast<int32_t>(render_viewport.viewport.x),
+                            static_cast<int32_t>(render_viewport.viewport.y)},
+                           {static_cast<uint32_t>(render_viewport.viewport.width),
+                            static_cast<uint32_t>(render_viewport.viewport.height)}});
         }
+        command_buffer.setViewport(0, vk::ArrayProxy<const vk::Viewport>(render_view_limit, viewports.data()));
+        command_buffer.setScissor(0, vk::ArrayProxy<const vk::Rect2D>(render_view_limit, scissors.data()));
+    }
+
+    void SceneDrawer::draw_depth_prepass(Graphics &graphics, vk::CommandBuffer command_buffer, DiffMeshBinder &mesh_binder)
+    {
+        ZoneScoped;
+        const uint32_t frame = graphics.current_cpu_frame();
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, depth_prepass_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, depth_prepass_pipeline_layout.get(), static_cast<int>(UniformBufferSetIndex::PerRenderSet),
+                                          {scene.descriptor_sets[frame].get(), scene.object_descriptor_sets[frame].get()}, nullptr);
+        DiffTrigger<uint32_t> vertex_base_diff{~0u}; // 第一个 draw 一定要推
+        for (const SceneDraw &draw : m_draws)
+        {
+            if (!draw.material_data.prepassed_pipeline)
+            {
+                continue;
+            }
+            const RenderMeshData &mesh_data = m_draw_meshes[draw.model_index];
+            const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[draw.sub_mesh_index];
+            mesh_binder.bind(mesh_data, command_buffer);
+            const uint32_t vertex_base = scene.vertex_bases[draw.model_index];
+            if (vertex_base_diff.update(vertex_base))
+            {
+                command_buffer.pushConstants<ObjectPushConstants>(depth_prepass_pipeline_layout.get(), object_push_constant_range().stageFlags, 0, ObjectPushConstants{vertex_base, 0});
+            }
+            command_buffer.drawIndexed(sub_mesh.index_count, draw.view_count, sub_mesh.index_offset, sub_mesh.vertex_offset, draw.first_view);
+        }
+    }
+
+    void SceneDrawer::on_set_msaa(Graphics &graphics)
+    {
+        render_pipelines.recreate_pipelines([&graphics](RenderPipeline &render_pipeline)
+                                            {
+                                                render_pipeline.pipeline_builder.render_pass = graphics.render_pass().get();
+                                                render_pipeline.pipeline_builder.set_multisampling(graphics.settings().msaa);
+                                                return true;
+                                            });
+        create_depth_prepass_pipeline(graphics);
     }
 }
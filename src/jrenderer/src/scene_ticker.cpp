@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "tracy/Tracy.hpp"
+#include <ranges>
 
 namespace jre
 {
@@ -12,23 +13,14 @@ namespace jre
         Scene &scene = context.scene;
         UniformScene ubo_scene = scene.scene_buffers[context.cur_frame];
         ubo_scene.main_light = convert_to<UniformLight>(scene.main_light);
-        auto &main_view = scene.render_viewports[0];
-        camera_view_matrix(&main_view.camera, glm::value_ptr(ubo_scene.camera_trans.view));
-        ubo_scene.camera_trans.proj = main_view.projection;
-        ubo_scene.camera_trans.view_proj = ubo_scene.camera_trans.proj * ubo_scene.camera_trans.view;
-        scene.scene_buffers[context.cur_frame] = ubo_scene;
-
-        for (auto &model : scene.models)
+        assert(scene.render_viewports.size() <= max_render_views);
+        for (auto [view_index, render_viewport] : scene.render_viewports | std::views::take(max_render_views) | std::views::enumerate)
         {
-            UniformPerObject ubo_obj = model.transform.ubo(context.cur_frame);
-            ubo_obj.mvp.model_view = ubo_scene.camera_trans.view * ubo_obj.mvp.model;
-            ubo_obj.mvp.model_view_proj = ubo_scene.camera_trans.proj * ubo_obj.mvp.model_view;
-            model.transform.set_ubo(ubo_obj, context.cur_frame);
-
-            for (auto &material_instance : model.materials)
-            {
-                material_instance->update_descriptor_set_data(context.cur_frame);
-            }
+            UniformCamera &camera_trans = ubo_scene.cameras[view_index];
+            camera_view_matrix(&render_viewport.camera, glm::value_ptr(camera_trans.view));
+            camera_trans.proj = render_viewport.projection;
+            camera_trans.view_proj = camera_trans.proj * camera_trans.view;
         }
+        scene.scene_buffers[context.cur_frame] = ubo_scene;
     }
 }
\ No newline at end of file
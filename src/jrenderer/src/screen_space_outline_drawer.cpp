@@ -0,0 +1,320 @@
+#include "jrenderer/drawer/screen_space_outline_drawer.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/graphics.h"
+#include "jrenderer/render_pass.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/descriptor_update.hpp"
+#include "tracy/Tracy.hpp"
+#include <vulkan_utils/utils.hpp>
+#include <ranges>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr vk::Format id_format = vk::Format::eR16Uint;
+        constexpr vk::Format normal_format = vk::Format::eR16G16B16A16Sfloat;
+        constexpr vk::Format outline_format = vk::Format::eR8G8B8A8Unorm;
+
+        vk::ImageMemoryBarrier outline_barrier(vk::Image image, vk::AccessFlags src_access, vk::AccessFlags dst_access, vk::ImageLayout old_layout)
+        {
+            return vk::ImageMemoryBarrier(src_access, dst_access,
+                                          old_layout, vk::ImageLayout::eGeneral,
+                                          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                          image,
+                                          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        }
+    }
+
+    ScreenSpaceOutlineDrawer::ScreenSpaceOutlineDrawer(Graphics &graphics, SceneDrawer &scene_drawer)
+        : m_scene_drawer(scene_drawer), m_device(graphics.logical_device())
+    {
+        m_gbuffer_vertex_shader = vk::shared::create_shader_from_spv_file(m_device, scene_drawer.view_vertex_shader_path("res/shaders/outline_gbuffer"));
+        m_gbuffer_fragment_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/outline_gbuffer.frag.spv");
+        m_edge_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/outline_edge.comp.spv");
+        m_composite_vertex_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/visibility_composite.vert.spv");
+        m_composite_fragment_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/outline_composite.frag.spv");
+        m_sampler = graphics.sampler_cache().get(vk::SamplerCreateInfo{}
+                                                     .setMagFilter(vk::Filter::eNearest)
+                                                     .setMinFilter(vk::Filter::eNearest)
+                                                     .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+                                                     .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+                                                     .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+                                                     .setAddressModeW(vk::SamplerAddressMode::eClampToEdge));
+
+        // G-buffer pass：ID、法线、深度都留给 compute 采样
+        RenderPassBuilder render_pass_builder(m_device);
+        auto color_attachment = [&](vk::Format format)
+        {
+            return render_pass_builder.add_attachment(
+                vk::AttachmentDescription({}, format, vk::SampleCountFlagBits::e1,
+                                          vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+                                          vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal),
+                vk::ImageLayout::eColorAttachmentOptimal);
+        };
+        std::array<vk::AttachmentReference, 2> color_attachments = {color_attachment(id_format), color_attachment(normal_format)};
+        vk::AttachmentReference depth_attachment = render_pass_builder.add_attachment(
+            vk::AttachmentDescription({}, vk::su::pickDepthFormat(graphics.physical_device()), vk::SampleCountFlagBits::e1,
+                                      vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                      vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+                                      vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal),
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        render_pass_builder
+            .add_subpass(vk::SubpassDescription()
+                             .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+                             .setColorAttachments(color_attachments)
+                             .setPDepthStencilAttachment(&depth_attachment))
+            .add_dependency(vk::SubpassDependency()
+                                .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+                                .setDstSubpass(0)
+                                .setSrcStageMask(vk::PipelineStageFlagBits::eComputeShader) // 上一帧的找边还在读
+                                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests)
+                                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite))
+            .add_dependency(vk::SubpassDependency()
+                                .setSrcSubpass(0)
+                                .setDstSubpass(VK_SUBPASS_EXTERNAL)
+                                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+                                .setDstStageMask(vk::PipelineStageFlagBits::eComputeShader)
+                                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                                .setDstAccessMask(vk::AccessFlagBits::eShaderRead));
+        m_render_pass = render_pass_builder.make_shared();
+
+        vk::DescriptorSetLayout scene_layout = scene_drawer.scene.descriptor_set_layout.get();
+        m_gbuffer_pipeline_layout = vk::shared::create_pipeline_layout(m_device,
+                                                                       {scene_layout, scene_drawer.scene.object_descriptor_set_layout.get()},
+                                                                       object_push_constant_range());
+        PipelineBuilder gbuffer_builder = scene_drawer.pipeline_builder;
+        gbuffer_builder.pipeline_layout = m_gbuffer_pipeline_layout.get();
+        gbuffer_builder.render_pass = m_render_pass.get();
+        gbuffer_builder.color_blend_attachments = {PipelineBuilder::ColorBlendAttachment::overwrite(), PipelineBuilder::ColorBlendAttachment::overwrite()};
+        gbuffer_builder.viewports.resize(1); // 只画主视口
+        gbuffer_builder.scissors.resize(1);
+        gbuffer_builder.set_multisampling(vk::SampleCountFlagBits::e1)
+            .clear_shaders()
+            .add_vertex_shader(m_gbuffer_vertex_shader.get())
+            .add_fragment_shader(m_gbuffer_fragment_shader.get());
+        m_gbuffer_pipeline = gbuffer_builder.build();
+
+        vk::ShaderStageFlags compute = vk::ShaderStageFlagBits::eCompute;
+        std::tie(m_descriptor_pool, m_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            m_device,
+            static_cast<uint32_t>(graphics.cpu_frames().size()),
+            {{{0, vk::DescriptorType::eCombinedImageSampler, 1, compute},
+              {1, vk::DescriptorType::eCombinedImageSampler, 1, compute},
+              {2, vk::DescriptorType::eCombinedImageSampler, 1, compute},
+              {3, vk::DescriptorType::eStorageBuffer, 1, compute},
+              {4, vk::DescriptorType::eStorageImage, 1, compute}}});
+        m_descriptor_sets = vk::shared::allocate_descriptor_sets(m_descriptor_pool,
+                                                                 std::vector<vk::DescriptorSetLayout>(graphics.cpu_frames().size(), m_descriptor_set_layout.get()));
+        m_edge_pipeline_layout = vk::shared::create_pipeline_layout(m_device,
+                                                                    {scene_layout, m_descriptor_set_layout.get()},
+                                                                    vk::PushConstantRange{compute, 0, sizeof(PushConstants)});
+        m_edge_pipeline = ComputePipelineBuilder(m_device, m_edge_pipeline_layout.get())
+                              .set_shader(m_edge_shader.get())
+                              .build();
+
+        std::tie(m_composite_descriptor_pool, m_composite_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            m_device,
+            1,
+            {{{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}}});
+        m_composite_descriptor_set = vk::shared::allocate_one_descriptor_set(m_composite_descriptor_pool, m_composite_descriptor_set_layout.get());
+        m_composite_pipeline_layout = vk::shared::create_pipeline_layout(m_device, m_composite_descriptor_set_layout.get(), {});
+        create_composite_pipeline(graphics);
+
+        for (auto _ : std::views::iota(0u, graphics.cpu_frames().size()))
+        {
+            m_params_buffers.push_back(HostArrayBufferBuilder<OutlineParams>(m_device, graphics.physical_device(), sizeof(OutlineParams) * max_outline_materials)
+                                           .set_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+                                           .build());
+        }
+        create_resources(graphics);
+    }
+
+    void ScreenSpaceOutlineDrawer::create_composite_pipeline(Graphics &graphics)
+    {
+        PipelineBuilder builder = m_scene_drawer.pipeline_builder;
+        builder.pipeline_layout = m_composite_pipeline_layout.get();
+        builder.render_pass = graphics.render_pass().get();
+        builder.vertex_binding_descriptions.clear();
+        builder.vertex_attribute_descriptions.clear();
+        builder.color_blend_attachments = {PipelineBuilder::ColorBlendAttachment::alpha()}; // a 是描边颜色的比例
+        builder.enable_depth(false)                                                          // 被挡住的在 G-buffer 里就没有边了
+            .set_multisampling(graphics.settings().msaa)
+            .clear_shaders()
+            .add_vertex_shader(m_composite_vertex_shader.get())
+            .add_fragment_shader(m_composite_fragment_shader.get());
+        m_composite_pipeline = builder.build();
+    }
+
+    void ScreenSpaceOutlineDrawer::create_resources(Graphics &graphics)
+    {
+        m_extent = graphics.swapchain_extent();
+
+        auto color_image = [&](vk::Format format, vk::ImageUsageFlags usage)
+        {
+            DeviceImageBuilder builder(m_device, graphics.physical_device());
+            builder.set_image_create_info(vk::ImageCreateInfo{
+                {},
+                vk::ImageType::e2D,
+                format,
+                vk::Extent3D{m_extent.width, m_extent.height, 1},
+                1,
+                1,
+                vk::SampleCountFlagBits::e1,
+                vk::ImageTiling::eOptimal,
+                usage,
+                vk::SharingMode::eExclusive});
+            builder.image_view_create_info.setViewType(vk::ImageViewType::e2D)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+            builder.memory_properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            return builder.build();
+        };
+        m_id_image = color_image(id_format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+        m_normal_image = color_image(normal_format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+        m_outline_image = color_image(outline_format, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+        m_depth_image = DepthStencilAttachment2DBuilder(m_device, graphics.physical_device())
+                            .set_extent(m_extent)
+                            .set_usage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled)
+                            .build();
+
+        std::array<vk::ImageView, 3> attachments = {m_id_image.image_view.get(), m_normal_image.image_view.get(), m_depth_image.image_view.get()};
+        m_framebuffer = vk::SharedFramebuffer(m_device->createFramebuffer(vk::FramebufferCreateInfo({}, m_render_pass.get(), attachments, m_extent.width, m_extent.height, 1)),
+                                              m_device);
+
+        for (auto [descriptor_set, params_buffer] : std::views::zip(m_descriptor_sets, m_params_buffers))
+        {
+            DescripterSetUpdater(descriptor_set)
+                .write_combined_image_sampler(m_sampler.get(), m_id_image.image_view.get())
+                .write_combined_image_sampler(m_sampler.get(), m_normal_image.image_view.get())
+                .write_combined_image_sampler(m_sampler.get(), m_depth_image.image_view.get())
+                .write_storage_buffer(vk::DescriptorBufferInfo{params_buffer.vk_buffer(), 0, VK_WHOLE_SIZE})
+                .write_storage_image(m_outline_image.image_view.get())
+                .update();
+        }
+        DescripterSetUpdater(m_composite_descriptor_set)
+            .write_combined_image_sampler(vk::DescriptorImageInfo{m_sampler.get(), m_outline_image.image_view.get(), vk::ImageLayout::eGeneral})
+            .update();
+    }
+
+    bool ScreenSpaceOutlineDrawer::handles(uint32_t model_index, uint32_t material_index, const RenderMaterialData &material_data) const
+    {
+        return supports(material_data) && !m_overflowed.contains({model_index, material_index});
+    }
+
+    bool ScreenSpaceOutlineDrawer::supports(const RenderMaterialData &material_data) const
+    {
+        return material_data.outline &&
+               material_data.outline->mode == OutlineMode::ScreenSpace &&
+               m_scene_drawer.scene.render_viewports.size() == 1;
+    }
+
+    void ScreenSpaceOutlineDrawer::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        const uint32_t frame = graphics.current_cpu_frame();
+        Scene &scene = m_scene_drawer.scene;
+        HostArrayBuffer<OutlineParams> &params_buffer = m_params_buffers[frame];
+        m_has_outline = false;
+        m_overflowed.clear();
+        outline_material_count = 0;
+        draw_count = 0;
+
+        // 屏幕空间描边的材质各分一个 ID，同一个 model 里对应同一个 sub mesh 的表面写这个 ID
+        std::vector<RenderMeshData> mesh_datas;
+        std::vector<std::vector<uint32_t>> sub_mesh_outline_ids;
+        for (auto [model_index, model] : scene.models | std::views::enumerate)
+        {
+            const RenderMeshData &mesh_data = mesh_datas.emplace_back(model.mesh->get_render_data());
+            std::vector<uint32_t> &outline_ids = sub_mesh_outline_ids.emplace_back(mesh_data.sub_meshes.size(), 0u);
+            for (auto [material_index, material] : model.materials | std::views::enumerate)
+            {
+                const RenderMaterialData material_data = material->get_render_data(frame);
+                if (!supports(material_data))
+                {
+                    continue;
+                }
+                if (outline_material_count + 1 >= max_outline_materials)
+                {
+                    // ID 表满了，SceneDrawer 照常画它的背面外扩
+                    m_overflowed.insert({static_cast<uint32_t>(model_index), static_cast<uint32_t>(material_index)});
+                    continue;
+                }
+                params_buffer[++outline_material_count] = {material_data.outline->color, glm::vec4(material_data.outline->width)};
+                outline_ids[material_index % mesh_data.sub_meshes.size()] = outline_material_count;
+            }
+        }
+        if (outline_material_count == 0)
+        {
+            return;
+        }
+
+        std::array<vk::ClearValue, 3> clear_values = {vk::ClearColorValue(std::array<uint32_t, 4>{0, 0, 0, 0}),
+                                                      vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f}),
+                                                      vk::ClearDepthStencilValue(1.0f, 0)};
+        command_buffer.beginRenderPass(vk::RenderPassBeginInfo(m_render_pass.get(), m_framebuffer.get(), {{0, 0}, m_extent}, clear_values), vk::SubpassContents::eInline);
+        command_buffer.setViewport(0, vk::Viewport{0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f});
+        command_buffer.setScissor(0, vk::Rect2D{{0, 0}, m_extent});
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_gbuffer_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_gbuffer_pipeline_layout.get(), static_cast<int>(UniformBufferSetIndex::PerRenderSet),
+                                          {scene.descriptor_sets[frame].get(), scene.object_descriptor_sets[frame].get()}, nullptr);
+        const glm::mat4 view_proj = scene.scene_buffers[frame].cameras[0].view_proj;
+        DiffMeshBinder mesh_binder;
+        for (auto [model, mesh_data, outline_ids, vertex_base] : std::views::zip(scene.models, mesh_datas, sub_mesh_outline_ids, scene.vertex_bases))
+        {
+            const glm::mat4 model_matrix = model.transform.model(frame);
+            bool model_bound = false;
+            for (auto [material_index, material] : model.materials | std::views::enumerate)
+            {
+                if (material->get_render_data(frame).outline) // 描边的外壳不是表面
+                {
+                    continue;
+                }
+                const uint32_t sub_mesh_index = static_cast<uint32_t>(material_index % mesh_data.sub_meshes.size());
+                const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[sub_mesh_index];
+                std::optional<ScreenRect> rect = project_bounds(sub_mesh.bounds, view_proj * model_matrix);
+                if (rect && !rect->overlaps_viewport())
+                {
+                    continue;
+                }
+                if (!model_bound)
+                {
+                    mesh_binder.bind(mesh_data, command_buffer);
+                    model_bound = true;
+                }
+                command_buffer.pushConstants<ObjectPushConstants>(m_gbuffer_pipeline_layout.get(), object_push_constant_range().stageFlags, 0, ObjectPushConstants{vertex_base, outline_ids[sub_mesh_index]});
+                command_buffer.drawIndexed(sub_mesh.index_count, 1, sub_mesh.index_offset, sub_mesh.vertex_offset, 0);
+                ++draw_count;
+            }
+        }
+        command_buffer.endRenderPass();
+
+        // 找边：每个像素一个线程
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr, nullptr,
+                                       outline_barrier(m_outline_image.image.get(), {}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined)); // 上一帧的 composite 读完了再写
+        PushConstants push_constants{{m_extent.width, m_extent.height}, depth_threshold, normal_threshold};
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_edge_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_edge_pipeline_layout.get(), 0,
+                                          {scene.descriptor_sets[frame].get(), m_descriptor_sets[frame].get()}, nullptr);
+        command_buffer.pushConstants<PushConstants>(m_edge_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+        command_buffer.dispatch((m_extent.width + group_size - 1) / group_size, (m_extent.height + group_size - 1) / group_size, 1);
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+                                       {}, nullptr, nullptr,
+                                       outline_barrier(m_outline_image.image.get(), vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral));
+        m_has_outline = true;
+    }
+
+    void ScreenSpaceOutlineDrawer::draw_composite(vk::CommandBuffer command_buffer)
+    {
+        if (!m_has_outline)
+        {
+            return;
+        }
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_composite_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_composite_pipeline_layout.get(), 0, m_composite_descriptor_set.get(), nullptr);
+        command_buffer.draw(3, 1, 0, 0);
+    }
+}
@@ -0,0 +1,12 @@
+#include "jrenderer/shader_module_cache.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/asset/asset_archive.h"
+
+namespace jre
+{
+    SizedResource<vk::SharedShaderModule> ShaderModuleCreator::operator()(const std::string &path) const
+    {
+        const AssetBlob content = read_asset(path);
+        return {vk::shared::create_shader_from_spv(device, content.data()), content.size()};
+    }
+}
@@ -0,0 +1,355 @@
+#include "jrenderer/culling/software_occlusion_culler.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "tracy/Tracy.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <array>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JRE_SIMD_SSE2
+#endif
+
+namespace jre
+{
+    namespace
+    {
+        // 光栅化用到的几个 SIMD 操作，按编译目标选宽度。MSVC 要 /arch:AVX2 才会走 AVX2
+        namespace simd
+        {
+#if defined(__AVX2__)
+            constexpr int width = 8;
+            using f32 = __m256;
+            inline f32 set1(float v) { return _mm256_set1_ps(v); }
+            inline f32 ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+            inline f32 load(const float *p) { return _mm256_loadu_ps(p); }
+            inline void store(float *p, f32 v) { _mm256_storeu_ps(p, v); }
+            inline f32 add(f32 a, f32 b) { return _mm256_add_ps(a, b); }
+            inline f32 mul(f32 a, f32 b) { return _mm256_mul_ps(a, b); }
+            inline f32 min(f32 a, f32 b) { return _mm256_min_ps(a, b); }
+            inline f32 cmpge(f32 a, f32 b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+            inline f32 cmple(f32 a, f32 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+            inline f32 mask_and(f32 a, f32 b) { return _mm256_and_ps(a, b); }
+            inline f32 select(f32 mask, f32 if_false, f32 if_true) { return _mm256_blendv_ps(if_false, if_true, mask); }
+            inline bool any(f32 mask) { return _mm256_movemask_ps(mask) != 0; }
+#elif defined(JRE_SIMD_SSE2)
+            constexpr int width = 4;
+            using f32 = __m128;
+            inline f32 set1(float v) { return _mm_set1_ps(v); }
+            inline f32 ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+            inline f32 load(const float *p) { return _mm_loadu_ps(p); }
+            inline void store(float *p, f32 v) { _mm_storeu_ps(p, v); }
+            inline f32 add(f32 a, f32 b) { return _mm_add_ps(a, b); }
+            inline f32 mul(f32 a, f32 b) { return _mm_mul_ps(a, b); }
+            inline f32 min(f32 a, f32 b) { return _mm_min_ps(a, b); }
+            inline f32 cmpge(f32 a, f32 b) { return _mm_cmpge_ps(a, b); }
+            inline f32 cmple(f32 a, f32 b) { return _mm_cmple_ps(a, b); }
+            inline f32 mask_and(f32 a, f32 b) { return _mm_and_ps(a, b); }
+            inline f32 select(f32 mask, f32 if_false, f32 if_true) { return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false)); }
+            inline bool any(f32 mask) { return _mm_movemask_ps(mask) != 0; }
+#else
+            constexpr int width = 1;
+            using f32 = float;
+            inline f32 set1(float v) { return v; }
+            inline f32 ramp() { return 0.0f; }
+            inline f32 load(const float *p) { return *p; }
+            inline void store(float *p, f32 v) { *p = v; }
+            inline f32 add(f32 a, f32 b) { return a + b; }
+            inline f32 mul(f32 a, f32 b) { return a * b; }
+            inline f32 min(f32 a, f32 b) { return std::min(a, b); }
+            // 标量版本 mask 用 0 / 1 表示
+            inline f32 cmpge(f32 a, f32 b) { return a >= b ? 1.0f : 0.0f; }
+            inline f32 cmple(f32 a, f32 b) { return a <= b ? 1.0f : 0.0f; }
+            inline f32 mask_and(f32 a, f32 b) { return a * b; }
+            inline f32 select(f32 mask, f32 if_false, f32 if_true) { return mask != 0.0f ? if_true : if_false; }
+            inline bool any(f32 mask) { return mask != 0.0f; }
+#endif
+        }
+
+        uint32_t round_up(uint32_t value, uint32_t multiple) { return (std::max(value, 1u) + multiple - 1) / multiple * multiple; }
+    }
+
+    std::shared_ptr<OccluderMesh> simplify_occluder(std::span<const glm::vec3> positions,
+                                                    std::span<const uint32_t> indices,
+                                                    const BoundingBox &bounds,
+                                                    uint32_t max_triangles)
+    {
+        auto occluder = std::make_shared<OccluderMesh>();
+        if (bounds.empty() || indices.size() < 3 || max_triangles == 0)
+        {
+            return occluder;
+        }
+
+        struct Candidate
+        {
+            float area; // 两倍面积，只用来比大小
+            size_t first_index;
+        };
+        std::vector<Candidate> candidates;
+        std::unordered_set<uint64_t> triangles; // 正反面、重复的三角形只留一个
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const glm::vec3 &a = positions[indices[i]];
+            const float area = glm::length(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a));
+            if (!(area > 0.0f))
+            {
+                continue;
+            }
+            std::array<uint64_t, 3> sorted = {indices[i], indices[i + 1], indices[i + 2]};
+            std::ranges::sort(sorted);
+            if (triangles.insert(sorted[0] | sorted[1] << 21 | sorted[2] << 42).second)
+            {
+                candidates.push_back({area, i});
+            }
+        }
+        if (candidates.size() > max_triangles)
+        {
+            std::ranges::nth_element(candidates, candidates.begin() + max_triangles, std::ranges::greater(), &Candidate::area);
+            candidates.resize(max_triangles);
+        }
+        std::ranges::sort(candidates, {}, &Candidate::first_index);
+
+        std::unordered_map<uint32_t, uint32_t> remap; // 原来的顶点 -> 遮挡体的顶点
+        for (const Candidate &candidate : candidates)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const uint32_t index = indices[candidate.first_index + k];
+                auto [it, inserted] = remap.try_emplace(index, static_cast<uint32_t>(occluder->positions.size()));
+                if (inserted)
+                {
+                    occluder->positions.push_back(positions[index]);
+                }
+                occluder->indices.push_back(it->second);
+            }
+        }
+        return occluder;
+    }
+
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height, uint32_t thread_count)
+        : m_workers(thread_count)
+    {
+        set_resolution(width, height);
+    }
+
+    void SoftwareOcclusionCuller::set_resolution(uint32_t width, uint32_t height)
+    {
+        m_width = round_up(width, tile_width);
+        m_height = round_up(height, tile_height);
+        m_tiles_x = m_width / tile_width;
+        m_tiles_y = m_height / tile_height;
+        m_tile_bins.assign(m_tiles_x * m_tiles_y, {});
+        m_depth.assign(m_width * m_height, 1.0f);
+        m_valid = false;
+    }
+
+    void SoftwareOcclusionCuller::clear()
+    {
+        m_triangles.clear();
+        for (auto &bin : m_tile_bins)
+        {
+            bin.clear();
+        }
+    }
+
+    void SoftwareOcclusionCuller::add_occluder(const OccluderMesh &occluder, const glm::mat4 &model_view_proj)
+    {
+        ZoneScoped;
+        std::vector<glm::vec4> clip_positions(occluder.positions.size());
+        std::ranges::transform(occluder.positions, clip_positions.begin(), [&](const glm::vec3 &position)
+                               { return model_view_proj * glm::vec4(position, 1.0f); });
+
+        glm::vec2 screen_scale(static_cast<float>(m_width), static_cast<float>(m_height));
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+        {
+            glm::vec3 v[3];
+            bool clipped = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec4 &clip = clip_positions[occluder.indices[i + k]];
+                // 跨过近平面的三角形直接丢掉，少一个遮挡体只会少剔除
+                if (clip.w <= std::numeric_limits<float>::epsilon() || clip.z < 0.0f)
+                {
+                    clipped = true;
+                    break;
+                }
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                v[k] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * screen_scale, ndc.z);
+            }
+            if (clipped)
+            {
+                continue;
+            }
+
+            float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+            if (std::abs(area) < 1e-6f)
+            {
+                continue;
+            }
+            if (area < 0.0f)
+            {
+                std::swap(v[1], v[2]);
+                area = -area;
+            }
+
+            TriangleSetup setup;
+            setup.min_x = std::max(0, static_cast<int>(std::floor(std::min({v[0].x, v[1].x, v[2].x}))));
+            setup.min_y = std::max(0, static_cast<int>(std::floor(std::min({v[0].y, v[1].y, v[2].y}))));
+            setup.max_x = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::ceil(std::max({v[0].x, v[1].x, v[2].x}))));
+            setup.max_y = std::min(static_cast<int>(m_height) - 1, static_cast<int>(std::ceil(std::max({v[0].y, v[1].y, v[2].y}))));
+            if (setup.min_x > setup.max_x || setup.min_y > setup.max_y)
+            {
+                continue;
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec3 &from = v[k];
+                const glm::vec3 &to = v[(k + 1) % 3];
+                float a = from.y - to.y;
+                float b = to.x - from.x;
+                // 在像素中心求值。只取完全覆盖的像素的话相邻三角形的公共边上会漏一条缝，
+                // 所以按中心覆盖来写，测试的时候把包围盒矩形往外扩一个像素来保守
+                setup.edge_a[k] = a;
+                setup.edge_b[k] = b;
+                setup.edge_c[k] = -(a * from.x + b * from.y) + 0.5f * (a + b);
+            }
+
+            setup.z_a = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+            setup.z_b = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+            // 同理深度取像素范围内最远的，再用三角形最远的顶点封顶
+            setup.z_c = v[0].z - setup.z_a * v[0].x - setup.z_b * v[0].y +
+                        0.5f * (setup.z_a + setup.z_b) + 0.5f * (std::abs(setup.z_a) + std::abs(setup.z_b));
+            setup.z_max = std::max({v[0].z, v[1].z, v[2].z});
+
+            uint32_t triangle_index = static_cast<uint32_t>(m_triangles.size());
+            m_triangles.push_back(setup);
+            for (uint32_t ty = setup.min_y / tile_height; ty <= setup.max_y / tile_height; ++ty)
+            {
+                for (uint32_t tx = setup.min_x / tile_width; tx <= setup.max_x / tile_width; ++tx)
+                {
+                    m_tile_bins[ty * m_tiles_x + tx].push_back(triangle_index);
+                }
+            }
+        }
+    }
+
+    void SoftwareOcclusionCuller::rasterize()
+    {
+        ZoneScoped;
+        m_workers.run(m_tiles_x * m_tiles_y, [this](uint32_t tile_index, uint32_t)
+                      { rasterize_tile(tile_index); });
+    }
+
+    void SoftwareOcclusionCuller::rasterize_tile(uint32_t tile_index)
+    {
+        const int tile_x = static_cast<int>(tile_index % m_tiles_x * tile_width);
+        const int tile_y = static_cast<int>(tile_index / m_tiles_x * tile_height);
+        for (int y = tile_y; y < tile_y + static_cast<int>(tile_height); ++y)
+        {
+            std::fill_n(m_depth.begin() + y * m_width + tile_x, tile_width, 1.0f);
+        }
+
+        const simd::f32 ramp = simd::ramp();
+        const simd::f32 zero = simd::set1(0.0f);
+        for (uint32_t triangle_index : m_tile_bins[tile_index])
+        {
+            const TriangleSetup &setup = m_triangles[triangle_index];
+            // tile 宽度是 SIMD 宽度的整数倍，起点往左对齐后一整组都在 tile 里，
+            // 多出来的像素落在三角形包围盒外，边函数不会通过
+            const int min_x = std::max(setup.min_x, tile_x) / simd::width * simd::width;
+            const int max_x = std::min(setup.max_x, tile_x + static_cast<int>(tile_width) - 1);
+            const int min_y = std::max(setup.min_y, tile_y);
+            const int max_y = std::min(setup.max_y, tile_y + static_cast<int>(tile_height) - 1);
+
+            const simd::f32 edge_a[3] = {simd::set1(setup.edge_a[0]), simd::set1(setup.edge_a[1]), simd::set1(setup.edge_a[2])};
+            const simd::f32 z_a = simd::set1(setup.z_a);
+            const simd::f32 z_max = simd::set1(setup.z_max);
+            for (int y = min_y; y <= max_y; ++y)
+            {
+                const float fy = static_cast<float>(y);
+                const simd::f32 row_edge[3] = {simd::set1(setup.edge_b[0] * fy + setup.edge_c[0]),
+                                               simd::set1(setup.edge_b[1] * fy + setup.edge_c[1]),
+                                               simd::set1(setup.edge_b[2] * fy + setup.edge_c[2])};
+                const simd::f32 row_z = simd::set1(setup.z_b * fy + setup.z_c);
+                float *row = m_depth.data() + y * m_width;
+                for (int x = min_x; x <= max_x; x += simd::width)
+                {
+                    const simd::f32 xs = simd::add(simd::set1(static_cast<float>(x)), ramp);
+                    simd::f32 mask = simd::cmpge(simd::add(simd::mul(edge_a[0], xs), row_edge[0]), zero);
+                    mask = simd::mask_and(mask, simd::cmpge(simd::add(simd::mul(edge_a[1], xs), row_edge[1]), zero));
+                    mask = simd::mask_and(mask, simd::cmpge(simd::add(simd::mul(edge_a[2], xs), row_edge[2]), zero));
+                    if (!simd::any(mask))
+                    {
+                        continue;
+                    }
+                    const simd::f32 z = simd::min(simd::add(simd::mul(z_a, xs), row_z), z_max);
+                    const simd::f32 depth = simd::load(row + x);
+                    simd::store(row + x, simd::select(mask, depth, simd::min(depth, z)));
+                }
+            }
+        }
+    }
+
+    void SoftwareOcclusionCuller::prepare(Scene &scene, uint32_t frame)
+    {
+        ZoneScoped;
+        clear();
+        m_view_proj = scene.scene_buffers[frame].cameras[0].view_proj;
+        for (Model &model : scene.models)
+        {
+            const glm::mat4 model_view_proj = m_view_proj * model.transform.model(frame);
+            for (const RenderSubMeshData &sub_mesh : model.mesh->get_render_data().sub_meshes)
+            {
+                if (sub_mesh.occluder)
+                {
+                    add_occluder(*sub_mesh.occluder, model_view_proj);
+                }
+            }
+        }
+        rasterize();
+        m_valid = true;
+    }
+
+    bool SoftwareOcclusionCuller::is_visible(const BoundingBox &bounds, const glm::mat4 &model) const
+    {
+        if (!m_valid || bounds.empty())
+        {
+            return true;
+        }
+        std::optional<ScreenRect> rect = project_bounds(bounds, m_view_proj * model);
+        if (!rect || !rect->overlaps_viewport())
+        {
+            return true;
+        }
+
+        const int min_x = std::clamp(static_cast<int>(std::floor(rect->min.x * m_width)) - 1, 0, static_cast<int>(m_width) - 1);
+        const int max_x = std::clamp(static_cast<int>(std::floor(rect->max.x * m_width)) + 1, 0, static_cast<int>(m_width) - 1);
+        const int min_y = std::clamp(static_cast<int>(std::floor(rect->min.y * m_height)) - 1, 0, static_cast<int>(m_height) - 1);
+        const int max_y = std::clamp(static_cast<int>(std::floor(rect->max.y * m_height)) + 1, 0, static_cast<int>(m_height) - 1);
+
+        // 矩形里只要有一个像素的遮挡深度不比包围盒最近点近，就算可见
+        const simd::f32 ramp = simd::ramp();
+        const simd::f32 nearest = simd::set1(rect->nearest_depth);
+        const simd::f32 range_min = simd::set1(static_cast<float>(min_x));
+        const simd::f32 range_max = simd::set1(static_cast<float>(max_x));
+        for (int y = min_y; y <= max_y; ++y)
+        {
+            const float *row = m_depth.data() + y * m_width;
+            for (int x = min_x / simd::width * simd::width; x <= max_x; x += simd::width)
+            {
+                const simd::f32 xs = simd::add(simd::set1(static_cast<float>(x)), ramp);
+                simd::f32 mask = simd::mask_and(simd::cmpge(xs, range_min), simd::cmple(xs, range_max));
+                mask = simd::mask_and(mask, simd::cmpge(simd::load(row + x), nearest));
+                if (simd::any(mask))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
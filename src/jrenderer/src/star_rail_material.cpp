@@ -1,9 +1,32 @@
 #include "jrenderer/asset/star_rail_material.h"
 #include "jrenderer/asset/raii_stb_image.h"
+#include "jrenderer/asset/texture_cooker.h"
 #include "jrenderer/descriptor_update.hpp"
 
 namespace jre
 {
+    static StarRailMaterialParameters make_star_rail_parameters(const UniformPropertiesStarRail &props, const UniformStarRailDebug &debug)
+    {
+        StarRailMaterialParameters parameters{};
+        parameters.props = props;
+        parameters.debug_control = debug.debug_control;
+        parameters.show_material_region = debug.show_material_region ? 1u : 0u;
+        return parameters;
+    }
+
+    SpecializationConstants make_frozen_constants(const UniformPropertiesStarRail &props)
+    {
+        SpecializationConstants constants;
+        constants.set_constant(static_cast<uint32_t>(StarRailConstantId::ParametersFrozen), vk::Bool32{vk::True});
+        for (uint32_t region = 0; region < MATERIAL_REGION_COUNT; ++region)
+        {
+            constants.set_constant(static_cast<uint32_t>(StarRailConstantId::SpecularShininess) + region, props.specular_shininess[region]);
+            constants.set_constant(static_cast<uint32_t>(StarRailConstantId::SpecularRoughness) + region, props.specular_roughness[region]);
+        }
+        constants.set_constant(static_cast<uint32_t>(StarRailConstantId::OutlineWidth), props.outline.width);
+        return constants;
+    }
+
     StarRailMaterialBuilder::StarRailMaterialBuilder(RenderPipelineResources &render_pipeline_resources,
                                                      PipelineLayoutBuilder pipeline_layout_builder,
                                                      PipelineBuilder pipeline_builder,
@@ -18,50 +41,106 @@ namespace jre
                                                                                          command_buffer,
                                                                                          transfer_queue)
     {
-        builder.bindings = {{{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment},
-                             {1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment},
-                             {2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment},
-                             {3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment},
-                             {4, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment},
-                             {5, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}}};
+        // 参数和纹理都在 set_bindless 里按材质 ID 取，没有材质自己的 set
         builder.vertex_shader_info.path = "res/shaders/star_rail.vert.spv";
         builder.fragment_shader_info.path = "res/shaders/star_rail.frag.spv";
+        builder.visibility_shader_info.path = "res/shaders/star_rail_visibility.comp.spv";
+        builder.depth_prepass = true; // 片元着色器很重，不透明，适合先画深度
     }
 
     Material StarRailMaterialBuilder::build()
     {
+        builder.visibility_shader_info.constants = builder.fragment_shader_info.constants; // 和片元着色器同一套 k_model_part
         return builder.build();
     }
 
-    StarRailMaterialInstance StarRailMaterialInstanceBuilder::build()
+    // 两种 instance builder 共用，结果要放进它们的 texture_cache
+    template <typename InstanceBuilder>
+    static Texture build_star_rail_texture(InstanceBuilder &builder, const std::string &filename, const vk::SamplerCreateInfo &sampler_create_info, TextureRole role)
     {
-        StarRailMaterialInstance instance(material.create_instance(frame_count));
-        instance.uniform_buffer_debug = UniformBufferBuilder<UniformStarRailDebug>(
-                                            device, physical_device, frame_count)
-                                            .build();
-        instance.uniform_buffer_props = UniformBufferBuilder<UniformPropertiesStarRail>(
-                                            device, physical_device, frame_count)
-                                            .build();
-
-        auto build_texture = [this](const std::string &filename, const vk::SamplerCreateInfo &sampler_create_info)
+        Texture texture;
+        if (builder.texture_loader)
         {
-            if (texture_cache && texture_cache->contains(filename))
-            {
-                return texture_cache->at(filename);
-            }
-            STBImage stb_data(filename);
-            TextureData texture_data{stb_data.width(), stb_data.height(), stb_data.channels(), (unsigned char *)(stb_data.data())};
-            TextureBuilder texture_builder(device, physical_device, command_buffer, transfer_queue, texture_data);
-            texture_builder.set_sampler(sampler_create_info);
-            return texture_cache ? texture_cache->emplace(filename, texture_builder.build()).first->second : texture_builder.build();
+            texture = builder.texture_loader->wait(builder.texture_loader->load(filename, role, sampler_create_info));
+            return builder.texture_cache ? builder.texture_cache->emplace(filename, texture).first->second : texture;
+        }
+        auto build = [&](const TextureData &texture_data)
+        {
+            TextureBuilder texture_builder(builder.device, builder.physical_device, builder.command_buffer, builder.transfer_queue, texture_data);
+            texture_builder.set_sampler(sampler_create_info)
+                .set_sampler_cache(builder.sampler_cache)
+                .set_srgb(role == TextureRole::Color)
+                .set_bindless_table(builder.bindless_textures);
+            texture = builder.upload_batch ? texture_builder.build(*builder.upload_batch) : texture_builder.build();
         };
+        if (builder.compressed_textures)
+        {
+            Ktx2File cooked = load_cooked_texture(filename, role);
+            build(cooked.texture_data());
+        }
+        else
+        {
+            STBImage stb_data(filename);
+            build(TextureData{stb_data.width(), stb_data.height(), stb_data.channels(), (unsigned char *)(stb_data.data())});
+        }
+        return builder.texture_cache ? builder.texture_cache->emplace(filename, texture).first->second : texture;
+    }
+
+    // 两种 instance builder 共用
+    template <typename InstanceBuilder>
+    static void prefetch_star_rail_textures(InstanceBuilder &builder)
+    {
+        if (!builder.texture_loader)
+        {
+            return;
+        }
+        for (const TextureRequest &request : builder.texture_requests())
+        {
+            builder.texture_loader->load(request);
+        }
+    }
+
+    template <typename InstanceBuilder>
+    static Texture get_star_rail_texture(InstanceBuilder &builder, const TextureRequest &request)
+    {
+        if (builder.texture_cache && builder.texture_cache->contains(request.filename))
+        {
+            return builder.texture_cache->at(request.filename);
+        }
+        return build_star_rail_texture(builder, request.filename, request.sampler_create_info, request.role);
+    }
+
+    std::vector<TextureRequest> StarRailMaterialInstanceBuilder::texture_requests() const
+    {
         vk::SamplerCreateInfo sampler_create_info = make_sampler_create_info(vk::SamplerAddressMode::eRepeat);
         vk::SamplerCreateInfo ramp_sampler_create_info = make_sampler_create_info(vk::SamplerAddressMode::eClampToEdge);
-        instance.diffuse = build_texture(filename_diffuse, sampler_create_info);
-        instance.light_map = build_texture(filename_light_map, sampler_create_info);
-        instance.cool_ramp = build_texture(filename_cool_ramp, ramp_sampler_create_info);
-        instance.warm_ramp = build_texture(filename_warm_ramp, ramp_sampler_create_info);
-        instance.update_descriptor_set();
+        return {{filename_diffuse, TextureRole::Color, sampler_create_info},
+                {filename_light_map, TextureRole::Data, sampler_create_info}, // 各通道是数据，不是颜色
+                {filename_cool_ramp, TextureRole::Color, ramp_sampler_create_info},
+                {filename_warm_ramp, TextureRole::Color, ramp_sampler_create_info}};
+    }
+
+    void StarRailMaterialInstanceBuilder::prefetch_textures()
+    {
+        prefetch_star_rail_textures(*this);
+    }
+
+    StarRailMaterialInstance StarRailMaterialInstanceBuilder::build()
+    {
+        StarRailMaterialInstance instance(material.create_instance(frame_count));
+
+        std::vector<TextureRequest> requests = texture_requests();
+        instance.diffuse = get_star_rail_texture(*this, requests[0]);
+        instance.light_map = get_star_rail_texture(*this, requests[1]);
+        instance.cool_ramp = get_star_rail_texture(*this, requests[2]);
+        instance.warm_ramp = get_star_rail_texture(*this, requests[3]);
+        instance.material_id = bindless_textures->register_material(std::array{instance.diffuse.bindless_index,
+                                                                               instance.light_map.bindless_index,
+                                                                               instance.cool_ramp.bindless_index,
+                                                                               instance.warm_ramp.bindless_index});
+        instance.material_parameters = material_parameters;
+        instance.bindless_textures = bindless_textures;
+        instance.mark_dirty();
         return instance;
     }
 
@@ -70,25 +149,33 @@ namespace jre
         return std::make_shared<StarRailMaterialInstance>(std::move(build()));
     }
 
-    void StarRailMaterialInstance::update_descriptor_set_data(uint32_t cur_frame)
+    void StarRailMaterialInstance::mark_dirty()
+    {
+        material_parameters->set(material_id, make_star_rail_parameters(buffer_data_props, buffer_data_debug));
+    }
+
+    void StarRailMaterialInstance::freeze(RenderPipelineResources &render_pipeline_resources)
     {
-        uniform_buffer_debug[cur_frame] = buffer_data_debug;
-        uniform_buffer_props[cur_frame] = buffer_data_props;
+        frozen_pipeline = render_pipeline_resources.get_or_create_specialized(material.render_pipeline, make_frozen_constants(buffer_data_props));
     }
 
-    void StarRailMaterialInstance::update_descriptor_set()
+    void StarRailMaterialInstance::replace_texture(const Texture &placeholder, const Texture &texture)
     {
-        for (auto const [index, descriptor_set] : std::views::enumerate(descriptor_sets))
+        bool replaced = false;
+        for (Texture *slot : {&diffuse, &light_map, &cool_ramp, &warm_ramp})
+        {
+            if (slot->image_view == placeholder.image_view)
+            {
+                *slot = texture;
+                replaced = true;
+            }
+        }
+        if (replaced)
         {
-            DescripterSetUpdater updater(descriptor_set);
-            updater
-                .write_uniform_buffer(uniform_buffer_debug)
-                .write_uniform_buffer(uniform_buffer_props)
-                .write_combined_image_sampler(diffuse.sampler.get(), diffuse.image_view.get())
-                .write_combined_image_sampler(light_map.sampler.get(), light_map.image_view.get())
-                .write_combined_image_sampler(cool_ramp.sampler.get(), cool_ramp.image_view.get())
-                .write_combined_image_sampler(warm_ramp.sampler.get(), warm_ramp.image_view.get())
-                .update();
+            bindless_textures->update_material(material_id, std::array{diffuse.bindless_index,
+                                                                       light_map.bindless_index,
+                                                                       cool_ramp.bindless_index,
+                                                                       warm_ramp.bindless_index});
         }
     }
 
@@ -106,60 +193,50 @@ namespace jre
                                                                                                        command_buffer,
                                                                                                        transfer_queue)
     {
-        builder.bindings = {{{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment},
-                             {1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment},
-                             {2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}}};
         builder.vertex_shader_info.path = "res/shaders/backface_outline.vert.spv";
         builder.fragment_shader_info.path = "res/shaders/backface_outline.frag.spv";
         builder.pipeline_builder.set_rasterizer(
             vk::PipelineRasterizationStateCreateInfo{{}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eFront, vk::FrontFace::eCounterClockwise, true, 10000.0f, 0.0f, 0.0f, 1.0f});
     }
 
-    void StarRailOutlineMaterialInstance::update_descriptor_set_data(uint32_t cur_frame)
+    void StarRailOutlineMaterialInstance::mark_dirty()
     {
-        uniform_buffer_debug[cur_frame] = buffer_data_debug;
-        uniform_buffer_props[cur_frame] = buffer_data_props;
+        material_parameters->set(material_id, make_star_rail_parameters(buffer_data_props, buffer_data_debug));
     }
 
-    void StarRailOutlineMaterialInstance::update_descriptor_set()
+    void StarRailOutlineMaterialInstance::freeze(RenderPipelineResources &render_pipeline_resources)
     {
-        for (auto const [index, descriptor_set] : std::views::enumerate(descriptor_sets))
+        frozen_pipeline = render_pipeline_resources.get_or_create_specialized(material.render_pipeline, make_frozen_constants(buffer_data_props));
+    }
+
+    void StarRailOutlineMaterialInstance::replace_texture(const Texture &placeholder, const Texture &texture)
+    {
+        if (diffuse.image_view == placeholder.image_view)
         {
-            DescripterSetUpdater updater(descriptor_set);
-            updater
-                .write_uniform_buffer(uniform_buffer_debug)
-                .write_uniform_buffer(uniform_buffer_props)
-                .write_combined_image_sampler(diffuse.sampler.get(), diffuse.image_view.get())
-                .update();
+            diffuse = texture;
+            bindless_textures->update_material(material_id, std::array{diffuse.bindless_index});
         }
     }
 
+    std::vector<TextureRequest> StarRailOutlineMaterialInstanceBuilder::texture_requests() const
+    {
+        return {{filename_diffuse, TextureRole::Color, make_sampler_create_info(vk::SamplerAddressMode::eRepeat)}};
+    }
+
+    void StarRailOutlineMaterialInstanceBuilder::prefetch_textures()
+    {
+        prefetch_star_rail_textures(*this);
+    }
+
     StarRailOutlineMaterialInstance StarRailOutlineMaterialInstanceBuilder::build()
     {
         StarRailOutlineMaterialInstance instance(material.create_instance(frame_count));
-        instance.uniform_buffer_debug = UniformBufferBuilder<UniformStarRailDebug>(
-                                            device, physical_device, frame_count)
-                                            .build();
-        instance.uniform_buffer_props = UniformBufferBuilder<UniformPropertiesStarRail>(
-                                            device, physical_device, frame_count)
-                                            .build();
-
-        vk::SamplerCreateInfo sampler_create_info = make_sampler_create_info(vk::SamplerAddressMode::eRepeat);
-        auto build_texture = [this](const std::string &filename, const vk::SamplerCreateInfo &sampler_create_info)
-        {
-            if (texture_cache && texture_cache->contains(filename))
-            {
-                return texture_cache->at(filename);
-            }
-            STBImage stb_data(filename);
-            TextureData texture_data{stb_data.width(), stb_data.height(), stb_data.channels(), (unsigned char *)(stb_data.data())};
-            TextureBuilder texture_builder(device, physical_device, command_buffer, transfer_queue, texture_data);
-            texture_builder.set_sampler(sampler_create_info);
-            return texture_cache ? texture_cache->emplace(filename, texture_builder.build()).first->second : texture_builder.build();
-        };
 
-        instance.diffuse = build_texture(filename_diffuse, sampler_create_info);
-        instance.update_descriptor_set();
+        instance.diffuse = get_star_rail_texture(*this, texture_requests()[0]);
+        instance.material_id = bindless_textures->register_material(std::array{instance.diffuse.bindless_index});
+        instance.material_parameters = material_parameters;
+        instance.bindless_textures = bindless_textures;
+        instance.mark_dirty();
         return instance;
     }
 }
\ No newline at end of file
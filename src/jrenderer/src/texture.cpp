@@ -1,8 +1,10 @@
 #include "jrenderer/texture.h"
+#include <cassert>
 
 namespace jre
 {
-    static void generate_image_mipmaps(vk::CommandBuffer command_buffer, vk::Queue transfer_queue, vk::Image image, uint32_t width, uint32_t height, uint32_t mipmap_levels)
+    // 逐级 blit，没有 MipGenerator 时用
+    static void generate_image_mipmaps(vk::CommandBuffer command_buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipmap_levels)
     {
         // if (!(physical_device.getFormatProperties(m_format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
         // {
@@ -27,9 +29,6 @@ namespace jre
         //     color = readTexture(uv, minFilter);
         // }
 
-        CommandBufferRecorder recorder(command_buffer);
-        recorder.begin();
-
         vk::ImageMemoryBarrier barrier{};
         barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
         barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
@@ -87,10 +86,68 @@ namespace jre
         barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
         barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion, {}, {}, barrier);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, {}, {}, barrier);
+    }
+
+    TextureUploadBatch::TextureUploadBatch(vk::SharedDevice device, vk::CommandBuffer command_buffer, vk::Queue queue, MipGenerator *mip_generator)
+        : m_device(device),
+          m_command_buffer(command_buffer),
+          m_queue(queue),
+          m_mip_generator(mip_generator),
+          m_fence(device->createFence({}), device)
+    {
+    }
 
-        recorder.end();
-        recorder.submit_wait_idle(transfer_queue);
+    vk::CommandBuffer TextureUploadBatch::command_buffer()
+    {
+        if (!m_recording)
+        {
+            m_command_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+            m_recording = true;
+        }
+        return m_command_buffer;
+    }
+
+    void TextureUploadBatch::keep_alive(DynamicBuffer &&staging_buffer)
+    {
+        m_staging_buffers.push_back(std::move(staging_buffer));
+        ++m_texture_count;
+    }
+
+    void TextureUploadBatch::submit()
+    {
+        assert(!m_external); // 外部的 command buffer 由它的主人提交
+        if (!m_recording)
+        {
+            return;
+        }
+        m_command_buffer.end();
+        m_queue.submit(vk::SubmitInfo({}, {}, m_command_buffer), m_fence.get());
+        vk::detail::resultCheck(m_device->waitForFences(m_fence.get(), true, std::numeric_limits<uint64_t>::max()), "TextureUploadBatch::submit");
+        m_device->resetFences(m_fence.get());
+        m_recording = false;
+        m_staging_buffers.clear();
+        m_texture_count = 0;
+        if (m_mip_generator)
+        {
+            m_mip_generator->reset(MipGenerator::synchronous);
+        }
+    }
+
+    void TextureUploadBatch::record_into(vk::CommandBuffer recording_command_buffer, uint32_t frame)
+    {
+        assert(!m_recording || m_external);
+        m_command_buffer = recording_command_buffer;
+        m_mip_frame = frame;
+        m_recording = true;
+        m_external = true;
+    }
+
+    std::vector<DynamicBuffer> TextureUploadBatch::take_staging_buffers()
+    {
+        // MipGenerator 的这一份还在等 command buffer 执行，由调用方在那一帧的 fence 之后 reset
+        m_texture_count = 0;
+        return std::exchange(m_staging_buffers, {});
     }
 
     TextureBuilder::TextureBuilder(vk::SharedDevice device,
@@ -107,7 +164,7 @@ namespace jre
             vk::ImageCreateInfo{
                 {},
                 vk::ImageType::e2D,
-                vk::Format::eR8G8B8A8Unorm,
+                data.format,
                 vk::Extent3D(data.width, data.height, 1),
                 1,
                 1,
@@ -122,63 +179,91 @@ namespace jre
     }
 
     DeviceImage TextureBuilder::build()
+    {
+        TextureUploadBatch batch(image_builder.device, command_buffer, transfer_queue);
+        DeviceImage image_data = build(batch);
+        batch.submit();
+        return image_data;
+    }
+
+    DeviceImage TextureBuilder::build(TextureUploadBatch &batch)
     {
         assert(sampler_create_info.has_value());
-        if (generate_mipmaps)
+        vk::ImageCreateInfo &image_create_info = image_builder.image_create_info;
+        MipGenerator *mip_generator = batch.mip_generator();
+        // 1x1 没有下一级可生成，当普通纹理传
+        const bool generate = generate_mipmaps && !data.has_mips() &&
+                              get_mipmap_levels(image_create_info.extent.width, image_create_info.extent.height) > 1;
+        if (data.has_mips())
         {
-            image_builder.image_create_info.mipLevels = get_mipmap_levels(image_builder.image_create_info.extent.width, image_builder.image_create_info.extent.height);
-            image_builder.image_create_info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
-            image_view_create_info.subresourceRange.levelCount = image_builder.image_create_info.mipLevels;
-            sampler_create_info.value().setMaxLod(static_cast<float>(image_builder.image_create_info.mipLevels));
+            image_create_info.mipLevels = data.mip_levels;
+            image_view_create_info.subresourceRange.levelCount = data.mip_levels;
+            sampler_create_info.value().setMaxLod(VK_LOD_CLAMP_NONE);
+        }
+        else if (generate)
+        {
+            image_create_info.mipLevels = get_mipmap_levels(image_create_info.extent.width, image_create_info.extent.height);
+            if (image_create_info.mipLevels > MipGenerator::max_levels)
+            {
+                mip_generator = nullptr;
+            }
+            image_create_info.usage |= mip_generator ? vk::ImageUsageFlagBits::eStorage : vk::ImageUsageFlagBits::eTransferSrc;
+            image_view_create_info.subresourceRange.levelCount = image_create_info.mipLevels;
+            sampler_create_info.value().setMaxLod(VK_LOD_CLAMP_NONE); // 由 image view 的 levelCount 限制，不按纹理的 mip 数，这样不同大小的纹理能共用 sampler
         }
         DeviceImage image_data = DeviceImageBuilder::build();
         DynamicBuffer staging_buffer = HostVisibleDynamicBufferBuilder(image_builder.device, physical_device, data.size())
                                            .set_usage(vk::BufferUsageFlagBits::eTransferSrc)
                                            .build(data.data, data.size());
 
-        // 如果是mipmaps，会将所有的level都转成eTransferDstOptimal。因为barrier的baselevel是0，levelCount是最高
-        // 如果都转成VK_IMAGE_LAYOUT_GENERAL的话，就直接blit就行了，但是会慢，所以选择转src和dst
-        transition_image_layout(command_buffer,
-                                transfer_queue,
-                                image_data.image.get(),
-                                image_builder.image_create_info.initialLayout,
-                                vk::ImageLayout::eTransferDstOptimal,
-                                vk::ImageSubresourceRange(
-                                    vk::ImageAspectFlagBits::eColor,
-                                    0,
-                                    generate_mipmaps ? image_builder.image_create_info.mipLevels : 1,
-                                    0,
-                                    1));
-
-        copy_buffer_to_image(command_buffer,
-                             transfer_queue,
-                             staging_buffer.buffer().get(),
-                             image_data.image.get(),
-                             vk::ImageLayout::eTransferDstOptimal,
-                             image_builder.image_create_info.extent);
-
-        if (generate_mipmaps)
+        vk::CommandBuffer command_buffer = batch.command_buffer();
+        // 所有 level 都先转成 eTransferDstOptimal，mip 0 拷贝，其余的等着被写
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, nullptr, nullptr,
+                                       vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite,
+                                                              vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                                                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                              image_data.image.get(),
+                                                              vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, image_create_info.mipLevels, 0, 1)));
+        // 带 mip 链的每级都有，一级一个 region；没有的只有 mip 0
+        std::vector<vk::BufferImageCopy> regions;
+        vk::DeviceSize buffer_offset = 0;
+        for (uint32_t level = 0; level < data.mip_levels; ++level)
+        {
+            const uint32_t level_width = std::max(data.width >> level, 1u);
+            const uint32_t level_height = std::max(data.height >> level, 1u);
+            regions.emplace_back(buffer_offset, 0, 0,
+                                 vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+                                 vk::Offset3D{0, 0, 0},
+                                 vk::Extent3D{level_width, level_height, 1});
+            buffer_offset += data.level_size(level);
+        }
+        command_buffer.copyBufferToImage(staging_buffer.vk_buffer(),
+                                         image_data.image.get(),
+                                         vk::ImageLayout::eTransferDstOptimal,
+                                         regions);
+        batch.keep_alive(std::move(staging_buffer));
+
+        const vk::Extent2D extent{image_create_info.extent.width, image_create_info.extent.height};
+        if (generate && mip_generator)
         {
-            generate_image_mipmaps(command_buffer,
-                                   transfer_queue,
-                                   image_data.image.get(),
-                                   image_builder.image_create_info.extent.width,
-                                   image_builder.image_create_info.extent.height,
-                                   image_builder.image_create_info.mipLevels);
+            mip_generator->record(command_buffer, batch.mip_frame(), image_data.image.get(), extent, image_create_info.mipLevels, srgb);
+        }
+        else if (generate)
+        {
+            generate_image_mipmaps(command_buffer, image_data.image.get(), extent.width, extent.height, image_create_info.mipLevels);
         }
         else
         {
-            transition_image_layout(command_buffer,
-                                    transfer_queue,
-                                    image_data.image.get(),
-                                    vk::ImageLayout::eTransferDstOptimal,
-                                    vk::ImageLayout::eShaderReadOnlyOptimal,
-                                    vk::ImageSubresourceRange(
-                                        vk::ImageAspectFlagBits::eColor,
-                                        0,
-                                        1,
-                                        0,
-                                        1));
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, nullptr, nullptr,
+                                           vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+                                                                  vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                                                  VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                                  image_data.image.get(),
+                                                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, image_create_info.mipLevels, 0, 1)));
+        }
+        if (bindless_table)
+        {
+            image_data.bindless_index = bindless_table->register_texture(image_data);
         }
         return image_data;
     }
@@ -0,0 +1,17 @@
+#include "jrenderer/texture_cache.h"
+
+namespace jre
+{
+    void TextureCreator::retire(const std::shared_ptr<Texture> &texture) const
+    {
+        if (retired)
+        {
+            retired->retire(texture);
+        }
+    }
+
+    std::string texture_cache_key(const TextureRequest &request, vk::Sampler sampler)
+    {
+        return request.filename + '|' + std::to_string(static_cast<int>(request.role)) + '|' + std::to_string(std::hash<vk::Sampler>{}(sampler));
+    }
+}
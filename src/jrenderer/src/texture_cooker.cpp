@@ -0,0 +1,578 @@
+#include "jrenderer/asset/texture_cooker.h"
+#include "jrenderer/asset/raii_stb_image.h"
+#include "jrenderer/asset/derived_data_cache.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <tracy/Tracy.hpp>
+
+namespace jre
+{
+    namespace
+    {
+        using Texel = std::array<float, 4>;
+        using Block = std::array<Texel, 16>; // 4x4，按行，值在 [0, 255]
+
+        struct MipImage
+        {
+            uint32_t width;
+            uint32_t height;
+            std::vector<Texel> texels; // [0, 1]，Color 的 rgb 在线性空间
+        };
+
+        float srgb_to_linear(float c)
+        {
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float linear_to_srgb(float c)
+        {
+            return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        }
+
+        // 和 mip_generate.comp 一样的 2x2 平均，奇数边上的取边上的
+        MipImage downsample(const MipImage &src)
+        {
+            MipImage dst{std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), {}};
+            dst.texels.resize(dst.width * dst.height);
+            for (uint32_t y = 0; y < dst.height; ++y)
+            {
+                for (uint32_t x = 0; x < dst.width; ++x)
+                {
+                    const uint32_t x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                    const uint32_t y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+                    Texel &out = dst.texels[y * dst.width + x];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        out[c] = (src.texels[y0 * src.width + x0][c] + src.texels[y0 * src.width + x1][c] +
+                                  src.texels[y1 * src.width + x0][c] + src.texels[y1 * src.width + x1][c]) *
+                                 0.25f;
+                    }
+                }
+            }
+            return dst;
+        }
+
+        // 超出图片的按边上的取，不足 4x4 的 mip 也能编
+        Block fetch_block(const MipImage &image, uint32_t block_x, uint32_t block_y, bool srgb)
+        {
+            Block block;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t x = std::min(block_x * 4 + i % 4, image.width - 1);
+                const uint32_t y = std::min(block_y * 4 + i / 4, image.height - 1);
+                const Texel &texel = image.texels[y * image.width + x];
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float value = srgb && c < 3 ? linear_to_srgb(texel[c]) : texel[c];
+                    block[i][c] = std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+                }
+            }
+            return block;
+        }
+
+        // 最低位先写
+        struct BitWriter
+        {
+            std::array<uint64_t, 2> words = {};
+            uint32_t position = 0;
+
+            void write(uint64_t value, uint32_t bits)
+            {
+                for (uint32_t i = 0; i < bits; ++i, ++position)
+                {
+                    words[position / 64] |= ((value >> i) & 1ull) << (position % 64);
+                }
+            }
+        };
+
+        // BC4：两个端点 + 16 个 3 bit 下标。r0 > r1 时中间插 6 个值
+        uint64_t encode_bc4_block(const Block &block, int channel)
+        {
+            float lo = 255.0f, hi = 0.0f;
+            for (const Texel &texel : block)
+            {
+                lo = std::min(lo, texel[channel]);
+                hi = std::max(hi, texel[channel]);
+            }
+            const uint32_t r0 = static_cast<uint32_t>(hi), r1 = static_cast<uint32_t>(lo);
+            BitWriter writer;
+            writer.write(r0, 8);
+            writer.write(r1, 8);
+            if (r0 == r1)
+            {
+                writer.write(0, 48); // 全是 r0
+                return writer.words[0];
+            }
+            std::array<float, 8> palette = {static_cast<float>(r0), static_cast<float>(r1)};
+            for (uint32_t i = 1; i < 7; ++i)
+            {
+                palette[i + 1] = std::floor(((7 - i) * r0 + i * r1) / 7.0f);
+            }
+            for (const Texel &texel : block)
+            {
+                uint32_t best = 0;
+                for (uint32_t i = 1; i < 8; ++i)
+                {
+                    if (std::abs(palette[i] - texel[channel]) < std::abs(palette[best] - texel[channel]))
+                    {
+                        best = i;
+                    }
+                }
+                writer.write(best, 3);
+            }
+            return writer.words[0];
+        }
+
+        // BC7 只用 mode 6：一个子集，RGBA 各 7 bit 端点 + 每个端点一个 p bit，16 级插值，适合不分区的平滑纹理
+        constexpr std::array<uint32_t, 16> bc7_weights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        struct Bc7Endpoints
+        {
+            std::array<uint32_t, 4> quantized[2]; // 7 bit
+            uint32_t p_bits[2];
+
+            uint32_t value(int endpoint, int channel) const { return (quantized[endpoint][channel] << 1) | p_bits[endpoint]; }
+        };
+
+        // 两个 p bit 都试一下，按通道权重挑误差小的
+        void quantize_bc7_endpoint(const Texel &endpoint, const Texel &channel_weights, Bc7Endpoints &out, int index)
+        {
+            float best_error = std::numeric_limits<float>::max();
+            for (uint32_t p = 0; p < 2; ++p)
+            {
+                std::array<uint32_t, 4> quantized;
+                float error = 0.0f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    quantized[c] = static_cast<uint32_t>(std::clamp(std::round((endpoint[c] - p) / 2.0f), 0.0f, 127.0f));
+                    const float diff = static_cast<float>((quantized[c] << 1) | p) - endpoint[c];
+                    error += channel_weights[c] * diff * diff;
+                }
+                if (error < best_error)
+                {
+                    best_error = error;
+                    out.quantized[index] = quantized;
+                    out.p_bits[index] = p;
+                }
+            }
+        }
+
+        float find_bc7_indices(const Block &block, const Bc7Endpoints &endpoints, const Texel &channel_weights, std::array<uint32_t, 16> &indices)
+        {
+            std::array<Texel, 16> palette;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    palette[i][c] = static_cast<float>(((64 - bc7_weights4[i]) * endpoints.value(0, c) + bc7_weights4[i] * endpoints.value(1, c) + 32) >> 6);
+                }
+            }
+            float total_error = 0.0f;
+            for (uint32_t t = 0; t < 16; ++t)
+            {
+                float best_error = std::numeric_limits<float>::max();
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    float error = 0.0f;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const float diff = palette[i][c] - block[t][c];
+                        error += channel_weights[c] * diff * diff;
+                    }
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        indices[t] = i;
+                    }
+                }
+                total_error += best_error;
+            }
+            return total_error;
+        }
+
+        std::array<uint64_t, 2> encode_bc7_block(const Block &block, const Texel &channel_weights)
+        {
+            // 主轴：协方差矩阵幂迭代，端点取投影的两头
+            Texel mean = {};
+            for (const Texel &texel : block)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    mean[c] += texel[c] / 16.0f;
+                }
+            }
+            std::array<std::array<float, 4>, 4> covariance = {};
+            Texel axis = {};
+            for (const Texel &texel : block)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                    }
+                    axis[i] = std::max(axis[i], std::abs(texel[i] - mean[i]));
+                }
+            }
+            for (int iteration = 0; iteration < 8; ++iteration)
+            {
+                Texel next = {};
+                float length = 0.0f;
+                for (int i = 0; i < 4; ++i)
+                {
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        next[i] += covariance[i][j] * axis[j];
+                    }
+                    length = std::max(length, std::abs(next[i]));
+                }
+                if (length == 0.0f)
+                {
+                    break;
+                }
+                for (int i = 0; i < 4; ++i)
+                {
+                    axis[i] = next[i] / length;
+                }
+            }
+            float t_min = 0.0f, t_max = 0.0f;
+            const float axis_length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+            if (axis_length2 > 0.0f)
+            {
+                t_min = std::numeric_limits<float>::max();
+                t_max = std::numeric_limits<float>::lowest();
+                for (const Texel &texel : block)
+                {
+                    float t = 0.0f;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        t += (texel[c] - mean[c]) * axis[c];
+                    }
+                    t /= axis_length2;
+                    t_min = std::min(t_min, t);
+                    t_max = std::max(t_max, t);
+                }
+            }
+            Texel e0, e1;
+            for (int c = 0; c < 4; ++c)
+            {
+                e0[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+                e1[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+            }
+
+            Bc7Endpoints endpoints;
+            quantize_bc7_endpoint(e0, channel_weights, endpoints, 0);
+            quantize_bc7_endpoint(e1, channel_weights, endpoints, 1);
+            std::array<uint32_t, 16> indices;
+            float error = find_bc7_indices(block, endpoints, channel_weights, indices);
+
+            // 按选出来的下标最小二乘重新拟合一次端点，更好就用它
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            Texel ax = {}, bx = {};
+            for (uint32_t t = 0; t < 16; ++t)
+            {
+                const float w = bc7_weights4[indices[t]] / 64.0f;
+                aa += (1.0f - w) * (1.0f - w);
+                ab += (1.0f - w) * w;
+                bb += w * w;
+                for (int c = 0; c < 4; ++c)
+                {
+                    ax[c] += (1.0f - w) * block[t][c];
+                    bx[c] += w * block[t][c];
+                }
+            }
+            const float determinant = aa * bb - ab * ab;
+            if (error > 0.0f && std::abs(determinant) > 1e-6f)
+            {
+                Texel r0, r1;
+                for (int c = 0; c < 4; ++c)
+                {
+                    r0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+                    r1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+                }
+                Bc7Endpoints refined;
+                quantize_bc7_endpoint(r0, channel_weights, refined, 0);
+                quantize_bc7_endpoint(r1, channel_weights, refined, 1);
+                std::array<uint32_t, 16> refined_indices;
+                const float refined_error = find_bc7_indices(block, refined, channel_weights, refined_indices);
+                if (refined_error < error)
+                {
+                    endpoints = refined;
+                    indices = refined_indices;
+                }
+            }
+
+            // 第一个下标的最高位是隐含的 0，不是的话端点对调
+            if (indices[0] & 8u)
+            {
+                std::swap(endpoints.quantized[0], endpoints.quantized[1]);
+                std::swap(endpoints.p_bits[0], endpoints.p_bits[1]);
+                for (uint32_t &index : indices)
+                {
+                    index = 15u - index;
+                }
+            }
+
+            BitWriter writer;
+            writer.write(1u << 6, 7); // mode 6
+            for (int c = 0; c < 4; ++c)
+            {
+                writer.write(endpoints.quantized[0][c], 7);
+                writer.write(endpoints.quantized[1][c], 7);
+            }
+            writer.write(endpoints.p_bits[0], 1);
+            writer.write(endpoints.p_bits[1], 1);
+            writer.write(indices[0], 3);
+            for (uint32_t t = 1; t < 16; ++t)
+            {
+                writer.write(indices[t], 4);
+            }
+            return writer.words;
+        }
+
+        void encode_level(const MipImage &image, TextureRole role, unsigned char *out, WorkerPool *workers)
+        {
+            const uint32_t blocks_x = (image.width + 3) / 4;
+            const uint32_t blocks_y = (image.height + 3) / 4;
+            const vk::Format format = get_cooked_format(role);
+            const uint32_t block_bytes = get_block_bytes(format);
+            // Data 的 alpha 是材质区域 ID (floor(8 * a))，差一点就会跳到别的区域，p bit 优先保它
+            const Texel channel_weights = role == TextureRole::Data ? Texel{1.0f, 1.0f, 1.0f, 16.0f} : Texel{1.0f, 1.0f, 1.0f, 1.0f};
+            auto encode_row = [&](uint32_t block_y, uint32_t)
+            {
+                for (uint32_t block_x = 0; block_x < blocks_x; ++block_x)
+                {
+                    const Block block = fetch_block(image, block_x, block_y, role == TextureRole::Color);
+                    unsigned char *dst = out + (block_y * blocks_x + block_x) * block_bytes;
+                    switch (role)
+                    {
+                    case TextureRole::Color:
+                    case TextureRole::Data:
+                    {
+                        const std::array<uint64_t, 2> words = encode_bc7_block(block, channel_weights);
+                        std::memcpy(dst, words.data(), 16);
+                        break;
+                    }
+                    case TextureRole::TwoChannel:
+                    {
+                        const std::array<uint64_t, 2> words = {encode_bc4_block(block, 0), encode_bc4_block(block, 1)};
+                        std::memcpy(dst, words.data(), 16);
+                        break;
+                    }
+                    case TextureRole::SingleChannel:
+                    {
+                        const uint64_t word = encode_bc4_block(block, 0);
+                        std::memcpy(dst, &word, 8);
+                        break;
+                    }
+                    }
+                }
+            };
+            if (workers)
+            {
+                workers->run(blocks_y, encode_row);
+            }
+            else
+            {
+                for (uint32_t block_y = 0; block_y < blocks_y; ++block_y)
+                {
+                    encode_row(block_y, 0);
+                }
+            }
+        }
+
+        const char *get_role_name(TextureRole role)
+        {
+            switch (role)
+            {
+            case TextureRole::Color:
+                return "color";
+            case TextureRole::Data:
+                return "data";
+            case TextureRole::TwoChannel:
+                return "rg";
+            case TextureRole::SingleChannel:
+                return "r";
+            }
+            return "unknown";
+        }
+    }
+
+    vk::Format get_cooked_format(TextureRole role)
+    {
+        switch (role)
+        {
+        case TextureRole::TwoChannel:
+            return vk::Format::eBc5UnormBlock;
+        case TextureRole::SingleChannel:
+            return vk::Format::eBc4UnormBlock;
+        default:
+            return vk::Format::eBc7UnormBlock; // 颜色也用 Unorm，shader 里和原来的 eR8G8B8A8Unorm 一样读
+        }
+    }
+
+    std::filesystem::path get_cooked_texture_path(const std::filesystem::path &source, TextureRole role)
+    {
+        std::filesystem::path path = source;
+        path.replace_extension(std::string(".") + get_role_name(role) + ".ktx2");
+        return path;
+    }
+
+    namespace
+    {
+        MipImage decode_image(const std::string &source, bool srgb)
+        {
+            STBImage stb_image(source);
+            MipImage image{stb_image.width(), stb_image.height(), {}};
+            image.texels.resize(image.width * image.height);
+            const unsigned char *pixels = static_cast<const unsigned char *>(stb_image.data());
+            for (size_t i = 0; i < image.texels.size(); ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float value = pixels[i * 4 + c] / 255.0f;
+                    image.texels[i][c] = srgb && c < 3 ? srgb_to_linear(value) : value;
+                }
+            }
+            return image;
+        }
+
+        void store_rgba8_level(const MipImage &image, bool srgb, unsigned char *out)
+        {
+            for (size_t i = 0; i < image.texels.size(); ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float value = srgb && c < 3 ? linear_to_srgb(image.texels[i][c]) : image.texels[i][c];
+                    out[i * 4 + c] = static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+
+    Ktx2File build_mip_chain(const std::string &source, TextureRole role)
+    {
+        ZoneScoped;
+        const bool srgb = role == TextureRole::Color;
+        MipImage image = decode_image(source, srgb);
+
+        Ktx2File file;
+        file.format = vk::Format::eR8G8B8A8Unorm;
+        file.width = image.width;
+        file.height = image.height;
+        file.mip_levels = get_mipmap_levels(image.width, image.height);
+        file.srgb = srgb;
+        size_t total_size = 0;
+        for (uint32_t level = 0; level < file.mip_levels; ++level)
+        {
+            total_size += file.level_size(level);
+        }
+        file.data.resize(total_size);
+
+        size_t offset = 0;
+        for (uint32_t level = 0; level < file.mip_levels; ++level)
+        {
+            if (level > 0)
+            {
+                image = downsample(image);
+            }
+            store_rgba8_level(image, srgb, file.data.data() + offset);
+            offset += file.level_size(level);
+        }
+        return file;
+    }
+
+    Ktx2File cook_texture(const std::string &source, TextureRole role, WorkerPool *workers)
+    {
+        ZoneScoped;
+        const bool srgb = role == TextureRole::Color;
+        MipImage image = decode_image(source, srgb);
+
+        Ktx2File file;
+        file.format = get_cooked_format(role);
+        file.width = image.width;
+        file.height = image.height;
+        file.mip_levels = get_mipmap_levels(image.width, image.height);
+        file.srgb = srgb;
+        uint32_t total_size = 0;
+        for (uint32_t level = 0; level < file.mip_levels; ++level)
+        {
+            total_size += file.level_size(level);
+        }
+        file.data.resize(total_size);
+
+        size_t offset = 0;
+        for (uint32_t level = 0; level < file.mip_levels; ++level)
+        {
+            if (level > 0)
+            {
+                image = downsample(image);
+            }
+            encode_level(image, role, file.data.data() + offset, workers);
+            offset += file.level_size(level);
+        }
+        return file;
+    }
+
+    namespace
+    {
+        // 烘焙、生成 mip 的算法或者 KTX2 的写法变了就加，旧的缓存自然就用不上了
+        constexpr uint32_t texture_cooker_version = 1;
+
+        // 按源图片的内容、用途到 derived data cache 里找，没有再烘焙。不同文件名的同一张图只烘焙一次
+        Ktx2File load_derived_texture(const std::string &source, TextureRole role, std::string_view cooker, const std::function<Ktx2File()> &cook)
+        {
+            const uint64_t key = DerivedDataKey(cooker, texture_cooker_version).add_value(role).add_source(source).value();
+            const DerivedDataCache &cache = default_derived_data_cache();
+            if (std::optional<AssetBlob> cached = cache.find(key))
+            {
+                try
+                {
+                    return Ktx2File(cached->data());
+                }
+                catch (const std::exception &)
+                {
+                    // 坏了，重新烘焙覆盖掉
+                }
+            }
+            Ktx2File file = cook();
+            try
+            {
+                cache.put(key, file.encode());
+            }
+            catch (const std::exception &)
+            {
+                // 只是下次还要再烘焙
+            }
+            return file;
+        }
+    }
+
+    Ktx2File load_cooked_texture(const std::string &source, TextureRole role, WorkerPool *workers)
+    {
+        // 打包文件里的是发布时烘好的，直接用
+        if (std::optional<AssetBlob> archived = find_archived_asset(get_cooked_texture_path(source, role)))
+        {
+            try
+            {
+                return Ktx2File(archived->data());
+            }
+            catch (const std::exception &)
+            {
+                // 包里的坏了，当没有，从源文件烘焙
+            }
+        }
+        return load_derived_texture(source, role, "texture", [&]
+                                    { return cook_texture(source, role, workers); });
+    }
+
+    Ktx2File load_mip_chain(const std::string &source, TextureRole role)
+    {
+        return load_derived_texture(source, role, "mip_chain", [&]
+                                    { return build_mip_chain(source, role); });
+    }
+}
@@ -0,0 +1,255 @@
+#include "jrenderer/texture_loader.h"
+#include "jrenderer/async_helper.hpp"
+#include "jrenderer/asset/derived_data_cache.h"
+#include "jrenderer/texture_streamer.h"
+#include "jrenderer/virtual_texture.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace jre
+{
+    namespace
+    {
+        void forward_result(const std::shared_future<Texture> &from, std::promise<Texture> &to)
+        {
+            try
+            {
+                to.set_value(from.get());
+            }
+            catch (...)
+            {
+                to.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    TextureLoader::TextureLoader(vk::SharedDevice device,
+                                 vk::PhysicalDevice physical_device,
+                                 vk::CommandBuffer command_buffer,
+                                 vk::Queue transfer_queue,
+                                 TextureUploadBatch &batch,
+                                 uint32_t thread_count,
+                                 uint32_t queue_capacity)
+        : m_device(device),
+          m_physical_device(physical_device),
+          m_command_buffer(command_buffer),
+          m_transfer_queue(transfer_queue),
+          m_batch(batch),
+          m_decoded(std::max(1u, queue_capacity))
+    {
+        for (uint32_t i = 0; i < std::max(1u, thread_count); ++i)
+        {
+            m_threads.emplace_back([this]
+                                   { decode_loop(); });
+        }
+    }
+
+    TextureLoader::~TextureLoader()
+    {
+        m_jobs.close();
+        m_decoded.close();
+    }
+
+    std::shared_future<Texture> TextureLoader::load(const std::string &filename, TextureRole role, const vk::SamplerCreateInfo &sampler_create_info)
+    {
+        auto [it, inserted] = m_request_indices.try_emplace(filename, static_cast<uint32_t>(m_requests.size()));
+        if (!inserted)
+        {
+            return m_requests[it->second].future;
+        }
+        Request &request = m_requests.emplace_back(sampler_create_info, role);
+        request.future = request.promise.get_future().share();
+        m_jobs.push(DecodeJob{it->second, filename, role, sampler_create_info, compressed_textures, streamer != nullptr, virtual_textures != nullptr});
+        return request.future;
+    }
+
+    Texture TextureLoader::wait(const std::shared_future<Texture> &texture)
+    {
+        ZoneScoped;
+        while (!is_ready(texture))
+        {
+            upload_one();
+        }
+        return texture.get();
+    }
+
+    void TextureLoader::wait_all()
+    {
+        ZoneScoped;
+        while (m_uploaded_count < m_requests.size())
+        {
+            upload_one();
+        }
+    }
+
+    size_t TextureLoader::ready_count() const
+    {
+        return count_ready(m_requests | std::views::transform(&Request::future));
+    }
+
+    void TextureLoader::decode_loop()
+    {
+        while (std::optional<DecodeJob> job = m_jobs.pop())
+        {
+            ZoneScopedN("TextureLoader::decode");
+            DecodedTexture decoded{job->index};
+            try
+            {
+                // 内容、用途、sampler 都一样的只有第一个解码，后来的交给 upload 等它的结果
+                const std::pair<uint64_t, TextureRole> content_key(hash_asset_content(job->filename), job->role);
+                {
+                    std::lock_guard lock(m_content_mutex);
+                    std::vector<ContentRequest> &content_requests = m_content_indices[content_key];
+                    auto it = std::ranges::find(content_requests, job->sampler_create_info, &ContentRequest::sampler_create_info);
+                    if (it != content_requests.end())
+                    {
+                        decoded.alias_of = it->index;
+                    }
+                    else
+                    {
+                        content_requests.push_back({job->sampler_create_info, job->index});
+                    }
+                }
+                if (!decoded.alias_of)
+                {
+                    decode(*job, decoded);
+                }
+            }
+            catch (...)
+            {
+                decoded.error = std::current_exception();
+            }
+            if (!m_decoded.push(std::move(decoded)))
+            {
+                return;
+            }
+        }
+    }
+
+    void TextureLoader::decode(const DecodeJob &job, DecodedTexture &decoded) const
+    {
+        // 切好的 tile 文件直接打开，不用解码整张
+        if (job.virtual_texture)
+        {
+            const vk::Format format = job.compressed ? get_cooked_format(job.role) : vk::Format::eR8G8B8A8Unorm;
+            decoded.virtual_file = virtual_textures->open(job.filename, job.role, format);
+        }
+        if (!decoded.virtual_file)
+        {
+            if (job.compressed)
+            {
+                decoded.cooked = load_cooked_texture(job.filename, job.role);
+            }
+            else if (job.streamed || job.virtual_texture)
+            {
+                decoded.cooked = load_mip_chain(job.filename, job.role);
+            }
+            else
+            {
+                decoded.image.emplace(job.filename);
+            }
+        }
+        // 不够大或者 GPU 不支持这个格式的稀疏 image 就还用整条 mip 链
+        if (job.virtual_texture && decoded.cooked)
+        {
+            decoded.virtual_file = virtual_textures->cook(job.filename, job.role, *decoded.cooked);
+            if (decoded.virtual_file)
+            {
+                decoded.cooked.reset();
+            }
+        }
+    }
+
+    uint32_t TextureLoader::upload_ready(uint32_t max_count)
+    {
+        uint32_t count = 0;
+        while (count < max_count && m_uploaded_count < m_requests.size())
+        {
+            std::optional<DecodedTexture> decoded = m_decoded.try_pop();
+            if (!decoded)
+            {
+                break;
+            }
+            upload(*decoded);
+            ++count;
+        }
+        return count;
+    }
+
+    void TextureLoader::upload_one()
+    {
+        std::optional<DecodedTexture> decoded = m_decoded.pop();
+        assert(decoded.has_value()); // 还有没录的请求，队列就不会关
+        upload(*decoded);
+    }
+
+    void TextureLoader::upload(DecodedTexture &decoded)
+    {
+        Request &request = m_requests[decoded.index];
+        ++m_uploaded_count;
+        if (decoded.alias_of)
+        {
+            // 第一个请求还没录的话挂在它后面，录完一起给
+            Request &original = m_requests[*decoded.alias_of];
+            if (is_ready(original.future))
+            {
+                forward_result(original.future, request.promise);
+            }
+            else
+            {
+                original.aliases.push_back(decoded.index);
+            }
+            return;
+        }
+        upload_texture(request, decoded);
+        for (uint32_t alias : request.aliases)
+        {
+            forward_result(request.future, m_requests[alias].promise);
+        }
+        request.aliases.clear();
+    }
+
+    void TextureLoader::upload_texture(Request &request, DecodedTexture &decoded)
+    {
+        if (decoded.error)
+        {
+            request.promise.set_exception(decoded.error);
+            return;
+        }
+        ZoneScopedN("TextureLoader::upload");
+        if (decoded.virtual_file || (streamer && decoded.cooked))
+        {
+            try
+            {
+                request.promise.set_value(decoded.virtual_file ? virtual_textures->add(std::move(decoded.virtual_file), request.sampler_create_info, m_batch)
+                                                               : streamer->add(std::move(*decoded.cooked), request.sampler_create_info, m_batch));
+            }
+            catch (...)
+            {
+                request.promise.set_exception(std::current_exception());
+            }
+            return;
+        }
+        const TextureData texture_data = decoded.cooked ? decoded.cooked->texture_data()
+                                                        : TextureData{decoded.image->width(), decoded.image->height(), decoded.image->channels(),
+                                                                      static_cast<const unsigned char *>(decoded.image->data())};
+        TextureBuilder texture_builder(m_device, m_physical_device, m_command_buffer, m_transfer_queue, texture_data);
+        texture_builder.set_sampler(request.sampler_create_info)
+            .set_sampler_cache(sampler_cache)
+            .set_srgb(request.role == TextureRole::Color)
+            .set_bindless_table(bindless_table);
+        try
+        {
+            request.promise.set_value(texture_builder.build(m_batch));
+        }
+        catch (...)
+        {
+            request.promise.set_exception(std::current_exception());
+        }
+        if (textures_per_submit > 0 && m_batch.texture_count() >= textures_per_submit)
+        {
+            m_batch.submit(); // 等 GPU 的时候工作线程接着解码
+        }
+    }
+}
@@ -0,0 +1,246 @@
+#include "jrenderer/texture_streamer.h"
+#include "jrenderer/graphics.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+#include <limits>
+#include <ranges>
+
+namespace jre
+{
+    TextureStreamer::TextureStreamer(Graphics &graphics, SceneDrawer &scene_drawer)
+        : m_device(graphics.logical_device()),
+          m_physical_device(graphics.physical_device()),
+          m_scene_drawer(scene_drawer),
+          m_batch(graphics.logical_device(), {}, {}),
+          m_frames(graphics.cpu_frames().size())
+    {
+    }
+
+    Texture TextureStreamer::add(Ktx2File &&source, const vk::SamplerCreateInfo &sampler_create_info, TextureUploadBatch &batch)
+    {
+        ZoneScoped;
+        const uint32_t index = static_cast<uint32_t>(m_textures.size());
+        StreamedTexture texture{std::move(source), sampler_create_info};
+        while (texture.base_level + 1 < texture.source.mip_levels &&
+               std::max(texture.source.width, texture.source.height) >> texture.base_level > initial_resident_size)
+        {
+            ++texture.base_level;
+        }
+        texture.resident_level = texture.wanted_level = texture.target_level = texture.base_level;
+        texture.issued = build_texture(texture, texture.base_level, batch);
+        texture.texture = texture.issued;
+        m_texture_indices[texture.issued.image_view.get()] = index;
+        m_resident_bytes += get_resident_size(texture, texture.base_level);
+        return m_textures.emplace_back(std::move(texture)).issued;
+    }
+
+    Texture TextureStreamer::resolve(const Texture &texture) const
+    {
+        auto it = m_texture_indices.find(texture.image_view.get());
+        return it == m_texture_indices.end() ? texture : m_textures[it->second].texture;
+    }
+
+    vk::DeviceSize TextureStreamer::get_resident_size(const StreamedTexture &texture, uint32_t level) const
+    {
+        vk::DeviceSize size = 0;
+        for (uint32_t i = level; i < texture.source.mip_levels; ++i)
+        {
+            size += texture.source.level_size(i);
+        }
+        return size;
+    }
+
+    Texture TextureStreamer::build_texture(const StreamedTexture &texture, uint32_t level, TextureUploadBatch &batch)
+    {
+        const Ktx2File &source = texture.source;
+        size_t offset = 0;
+        for (uint32_t i = 0; i < level; ++i)
+        {
+            offset += source.level_size(i);
+        }
+        // source 从 level 开始的那一段 mip 链
+        const TextureData data{std::max(source.width >> level, 1u),
+                               std::max(source.height >> level, 1u),
+                               4,
+                               source.data.data() + offset,
+                               source.format,
+                               source.mip_levels - level};
+        TextureBuilder texture_builder(m_device, m_physical_device, {}, {}, data);
+        texture_builder.set_generate_mipmaps(false)
+            .set_bindless_table(&m_scene_drawer.bindless_textures)
+            .set_sampler(texture.sampler_create_info)
+            .set_sampler_cache(m_scene_drawer.sampler_cache);
+        return texture_builder.build(batch);
+    }
+
+    void TextureStreamer::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        // 这个 cpu frame 的 fence 刚等过：上次录的上传都执行完了，上次换下来的也没有帧在用了
+        FrameUploads &frame = m_frames[graphics.recording_cpu_frame()];
+        frame.staging_buffers.clear();
+        for (const Texture &texture : frame.retired)
+        {
+            m_scene_drawer.bindless_textures.release_texture(texture.bindless_index);
+        }
+        frame.retired.clear();
+        for (const Transition &transition : frame.transitions)
+        {
+            complete_transition(transition, frame);
+            m_textures[transition.index].transitioning = false;
+            --m_transition_count;
+        }
+        frame.transitions.clear();
+
+        if (m_textures.empty())
+        {
+            return;
+        }
+        estimate_levels(graphics);
+        fit_budget();
+        m_batch.record_into(command_buffer, graphics.recording_cpu_frame());
+        record_transitions(command_buffer, frame);
+    }
+
+    void TextureStreamer::complete_transition(const Transition &transition, FrameUploads &frame)
+    {
+        StreamedTexture &texture = m_textures[transition.index];
+        for (Model &model : m_scene_drawer.scene.models)
+        {
+            for (const std::shared_ptr<IMaterialInstance> &material : model.materials)
+            {
+                material->replace_texture(texture.texture, transition.texture);
+            }
+        }
+        m_resident_bytes -= get_resident_size(texture, texture.resident_level);
+        if (texture.texture.image_view.get() != texture.issued.image_view.get())
+        {
+            m_texture_indices.erase(texture.texture.image_view.get());
+            frame.retired.push_back(std::move(texture.texture));
+        }
+        texture.texture = transition.texture;
+        texture.resident_level = transition.level;
+        m_texture_indices[texture.texture.image_view.get()] = transition.index;
+        m_resident_bytes += get_resident_size(texture, texture.resident_level);
+    }
+
+    void TextureStreamer::estimate_levels(Graphics &graphics)
+    {
+        ZoneScoped;
+        for (StreamedTexture &texture : m_textures)
+        {
+            texture.wanted_level = texture.base_level; // 这一帧没看到的降回常驻的几级
+        }
+        Scene &scene = m_scene_drawer.scene;
+        const uint32_t frame = graphics.current_cpu_frame();
+        const glm::mat4 view_proj = scene.scene_buffers[frame].cameras[0].view_proj;
+        const vk::Viewport &viewport = scene.render_viewports[0].viewport;
+        for (Model &model : scene.models)
+        {
+            const RenderMeshData mesh_data = model.mesh->get_render_data();
+            if (mesh_data.sub_meshes.empty())
+            {
+                continue;
+            }
+            const glm::mat4 model_view_proj = view_proj * model.transform.model(frame);
+            for (auto [material_index, material] : model.materials | std::views::enumerate)
+            {
+                const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[material_index % mesh_data.sub_meshes.size()];
+                std::optional<ScreenRect> rect = project_bounds(sub_mesh.bounds, model_view_proj);
+                if (rect && !rect->overlaps_viewport())
+                {
+                    continue;
+                }
+                // 跨过相机平面的就在眼前，要最清楚的。不裁到视口里，贴得很近的网格纹素密度还是按整个投影算
+                const float screen_size = rect ? std::max((rect->max.x - rect->min.x) * viewport.width, (rect->max.y - rect->min.y) * viewport.height)
+                                               : std::numeric_limits<float>::max();
+                for (const Texture &used : material->get_textures())
+                {
+                    auto it = m_texture_indices.find(used.image_view.get());
+                    if (it == m_texture_indices.end())
+                    {
+                        continue;
+                    }
+                    StreamedTexture &texture = m_textures[it->second];
+                    // 屏幕上一个像素对应几个纹素，mip 每降一级减半
+                    const float texels = static_cast<float>(std::max(texture.source.width, texture.source.height)) * sub_mesh.uv_extent;
+                    const float level = std::floor(std::log2(std::max(texels / std::max(screen_size, 1.0f), 1.0f)) + mip_bias);
+                    const uint32_t wanted_level = static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(texture.base_level)));
+                    texture.wanted_level = std::min(texture.wanted_level, wanted_level);
+                }
+            }
+        }
+    }
+
+    void TextureStreamer::fit_budget()
+    {
+        vk::DeviceSize total = 0;
+        for (StreamedTexture &texture : m_textures)
+        {
+            texture.target_level = texture.wanted_level;
+            total += get_resident_size(texture, texture.target_level);
+        }
+        // 超了就把占得最多的降一级，直到放得下或者都只剩常驻的几级
+        while (total > budget_bytes)
+        {
+            StreamedTexture *largest = nullptr;
+            vk::DeviceSize largest_size = 0;
+            for (StreamedTexture &texture : m_textures)
+            {
+                const vk::DeviceSize size = get_resident_size(texture, texture.target_level);
+                if (texture.target_level < texture.base_level && size > largest_size)
+                {
+                    largest = &texture;
+                    largest_size = size;
+                }
+            }
+            if (!largest)
+            {
+                break;
+            }
+            ++largest->target_level;
+            total -= largest_size - get_resident_size(*largest, largest->target_level);
+        }
+    }
+
+    void TextureStreamer::record_transitions(vk::CommandBuffer command_buffer, FrameUploads &frame)
+    {
+        ZoneScoped;
+        std::vector<uint32_t> candidates;
+        for (auto [index, texture] : m_textures | std::views::enumerate)
+        {
+            if (!texture.transitioning && texture.target_level != texture.resident_level)
+            {
+                candidates.push_back(static_cast<uint32_t>(index));
+            }
+        }
+        // 先降的，腾出预算；再按差的级数从多到少升
+        std::ranges::sort(candidates, std::ranges::greater{}, [this](uint32_t index)
+                          {
+                              const StreamedTexture &texture = m_textures[index];
+                              return texture.target_level > texture.resident_level ? std::numeric_limits<int>::max()
+                                                                                   : static_cast<int>(texture.resident_level - texture.target_level); });
+
+        vk::DeviceSize uploaded_bytes = 0;
+        for (uint32_t index : candidates)
+        {
+            StreamedTexture &texture = m_textures[index];
+            if (texture.target_level == texture.base_level)
+            {
+                // 换回 issued，它早就上传好了，马上换
+                complete_transition(Transition{index, texture.issued, texture.base_level}, frame);
+                continue;
+            }
+            const vk::DeviceSize size = get_resident_size(texture, texture.target_level);
+            if (uploaded_bytes > 0 && uploaded_bytes + size > upload_bytes_per_frame)
+            {
+                continue;
+            }
+            uploaded_bytes += size;
+            frame.transitions.push_back(Transition{index, build_texture(texture, texture.target_level, m_batch), texture.target_level});
+            texture.transitioning = true;
+            ++m_transition_count;
+        }
+        std::ranges::move(m_batch.take_staging_buffers(), std::back_inserter(frame.staging_buffers));
+    }
+}
@@ -0,0 +1,116 @@
+#include "jrenderer/drawer/vertex_pretransformer.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/graphics.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/descriptor_update.hpp"
+#include "tracy/Tracy.hpp"
+#include <bit>
+#include <ranges>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr vk::DeviceSize initial_capacity = 4 * 1024 * 1024;
+    }
+
+    VertexPretransformer::VertexPretransformer(Graphics &graphics, SceneDrawer &scene_drawer)
+        : m_scene_drawer(scene_drawer),
+          m_device(graphics.logical_device()),
+          m_physical_device(graphics.physical_device())
+    {
+        m_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/vertex_pretransform.comp.spv");
+
+        vk::ShaderStageFlags compute = vk::ShaderStageFlagBits::eCompute;
+        m_source_descriptor_set_layout = graphics.descriptor_set_layouts().get(vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageBuffer, 1, compute});
+        m_source_update_template = DescriptorUpdateTemplate<vk::DescriptorBufferInfo>(
+            m_device,
+            m_source_descriptor_set_layout.get(),
+            DescriptorUpdateTemplate<vk::DescriptorBufferInfo>::entry(0, vk::DescriptorType::eStorageBuffer, 0));
+        m_pipeline_layout = vk::shared::create_pipeline_layout(m_device,
+                                                               {scene_drawer.scene.object_descriptor_set_layout.get(), m_source_descriptor_set_layout.get()}, // 写的就是顶点着色器读的 object set
+                                                               vk::PushConstantRange{compute, 0, sizeof(PushConstants)});
+        m_pipeline = ComputePipelineBuilder(m_device, m_pipeline_layout.get())
+                         .set_shader(m_shader.get())
+                         .build();
+        reserve(graphics, initial_capacity);
+    }
+
+    void VertexPretransformer::reserve(Graphics &graphics, vk::DeviceSize size)
+    {
+        graphics.wait_idle();
+        m_capacity = size;
+        m_vertex_buffers.clear();
+        for (vk::SharedDescriptorSet &descriptor_set : m_scene_drawer.scene.object_descriptor_sets)
+        {
+            DynamicBuffer &vertex_buffer = m_vertex_buffers.emplace_back(BufferBuilder<void>(m_device,
+                                                                                             m_physical_device,
+                                                                                             vk::BufferCreateInfo()
+                                                                                                 .setSize(m_capacity)
+                                                                                                 .setUsage(vk::BufferUsageFlagBits::eStorageBuffer),
+                                                                                             vk::MemoryPropertyFlagBits::eDeviceLocal)
+                                                                              .build());
+            DescripterSetUpdater(descriptor_set)
+                .write_storage_buffer(vk::DescriptorBufferInfo{vertex_buffer.vk_buffer(), 0, VK_WHOLE_SIZE})
+                .update();
+        }
+    }
+
+    void VertexPretransformer::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        const uint32_t frame = graphics.current_cpu_frame();
+        Scene &scene = m_scene_drawer.scene;
+
+        // 每个 model 一段，顶点着色器按 push constant 里的 vertex_base 找到自己那段，model 增删不用动任何 set
+        std::vector<RenderMeshData> mesh_datas;
+        scene.vertex_bases.clear();
+        uint32_t total_vertex_count = 0;
+        for (Model &model : scene.models)
+        {
+            const RenderMeshData &mesh_data = mesh_datas.emplace_back(model.mesh->get_render_data());
+            assert(mesh_data.vertexes.size() == 1);
+            scene.vertex_bases.push_back(total_vertex_count);
+            total_vertex_count += mesh_data.vertex_count;
+        }
+        const vk::DeviceSize size = std::max(total_vertex_count, 1u) * sizeof(PretransformedVertex);
+        if (size > m_capacity)
+        {
+            reserve(graphics, std::bit_ceil(size));
+        }
+
+        // 上一次用这块 buffer 的顶点着色器读完了才能写
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader,
+                                       vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr, nullptr, nullptr);
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline_layout.get(), 0, scene.object_descriptor_sets[frame].get(), nullptr);
+        vertex_count = 0;
+        for (auto [model, mesh_data, vertex_base] : std::views::zip(scene.models, mesh_datas, scene.vertex_bases))
+        {
+            if (mesh_data.vertex_count == 0)
+            {
+                continue;
+            }
+            // 每帧临时分配，不按 buffer 缓存，mesh 换了也不会留下失效的 set
+            vk::DescriptorSet source_descriptor_set = graphics.transient_descriptor_allocator().allocate_transient(m_source_descriptor_set_layout.get());
+            m_source_update_template.update(source_descriptor_set, vk::DescriptorBufferInfo{mesh_data.vertexes.front(), 0, VK_WHOLE_SIZE});
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline_layout.get(), 1, source_descriptor_set, nullptr);
+            PushConstants push_constants{model.transform.model(frame),
+                                         vertex_base,
+                                         mesh_data.vertex_count,
+                                         sizeof(Vertex) / sizeof(float),
+                                         offsetof(Vertex, pos) / sizeof(float),
+                                         offsetof(Vertex, normal) / sizeof(float)};
+            command_buffer.pushConstants<PushConstants>(m_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+            command_buffer.dispatch((mesh_data.vertex_count + group_size - 1) / group_size, 1, 1);
+            vertex_count += mesh_data.vertex_count;
+        }
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::PipelineStageFlagBits::eVertexShader,
+                                       {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead),
+                                       nullptr, nullptr);
+    }
+}
@@ -0,0 +1,555 @@
+#include "jrenderer/virtual_texture.h"
+#include "jrenderer/graphics.h"
+#include "tracy/Tracy.hpp"
+#include <vulkan_utils/utils.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <map>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr vk::ImageUsageFlags sparse_image_usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+        constexpr vk::PipelineStageFlags shader_stages = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+
+        std::filesystem::path get_virtual_texture_path(const std::string &source, TextureRole role)
+        {
+            return get_cooked_texture_path(source, role).replace_extension(".jvt");
+        }
+
+        vk::ImageMemoryBarrier image_barrier(vk::Image image, uint32_t level_count,
+                                             vk::AccessFlags src_access, vk::AccessFlags dst_access,
+                                             vk::ImageLayout old_layout, vk::ImageLayout new_layout)
+        {
+            return vk::ImageMemoryBarrier(src_access, dst_access,
+                                          old_layout, new_layout,
+                                          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                          image,
+                                          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, level_count, 0, 1));
+        }
+    }
+
+    VirtualTextureSystem::VirtualTextureSystem(Graphics &graphics, SceneDrawer &scene_drawer)
+        : m_device(graphics.logical_device()),
+          m_physical_device(graphics.physical_device()),
+          m_sparse_queue(graphics.graphics_queue().get()),
+          m_scene_drawer(scene_drawer),
+          m_frames(graphics.cpu_frames().size()),
+          m_loaded_tiles(64)
+    {
+        m_feedback_buffer = BufferBuilder<void>(m_device,
+                                                m_physical_device,
+                                                vk::BufferCreateInfo()
+                                                    .setSize(max_tiles / 8)
+                                                    .setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst),
+                                                vk::MemoryPropertyFlagBits::eDeviceLocal)
+                                .build();
+        m_residency_buffer = HostVisibleDynamicBufferBuilder(m_device, m_physical_device, max_tiles / 8)
+                                 .set_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+                                 .build();
+        std::memset(m_residency_buffer.mapped_memory(), 0, max_tiles / 8);
+        for (FrameWork &frame : m_frames)
+        {
+            frame.feedback_readback = HostVisibleDynamicBufferBuilder(m_device, m_physical_device, max_tiles / 8)
+                                          .set_usage(vk::BufferUsageFlagBits::eTransferDst)
+                                          .build();
+            frame.bind_fence = vk::SharedFence(m_device->createFence({}), m_device);
+        }
+        scene_drawer.bindless_textures.set_virtual_texture_buffers(m_feedback_buffer.vk_buffer(), m_residency_buffer.vk_buffer());
+
+        // 读 tile 是小块的随机读，一个线程够了
+        m_threads.emplace_back([this]
+                               { load_loop(); });
+    }
+
+    VirtualTextureSystem::~VirtualTextureSystem()
+    {
+        m_tile_requests.close();
+        m_loaded_tiles.close();
+    }
+
+    std::optional<VirtualTextureSystem::TileLayout> VirtualTextureSystem::get_tile_layout(vk::Format format, uint32_t width, uint32_t height, uint32_t mip_levels) const
+    {
+        const std::vector<vk::SparseImageFormatProperties> properties = m_physical_device.getSparseImageFormatProperties(format,
+                                                                                                                         vk::ImageType::e2D,
+                                                                                                                         vk::SampleCountFlagBits::e1,
+                                                                                                                         sparse_image_usage,
+                                                                                                                         vk::ImageTiling::eOptimal);
+        auto it = std::ranges::find_if(properties, [](const vk::SparseImageFormatProperties &property)
+                                       { return static_cast<bool>(property.aspectMask & vk::ImageAspectFlagBits::eColor); });
+        if (it == properties.end())
+        {
+            return std::nullopt;
+        }
+        const vk::Extent2D granularity{it->imageGranularity.width, it->imageGranularity.height};
+        // 比一个 tile 小的级 (对齐要求的话，不是整 tile 的级) 起都进 mip tail
+        uint32_t mip_tail_start = 0;
+        for (; mip_tail_start < mip_levels; ++mip_tail_start)
+        {
+            const uint32_t level_width = std::max(width >> mip_tail_start, 1u);
+            const uint32_t level_height = std::max(height >> mip_tail_start, 1u);
+            if (level_width < granularity.width || level_height < granularity.height)
+            {
+                break;
+            }
+            if ((it->flags & vk::SparseImageFormatFlagBits::eAlignedMipSize) &&
+                (level_width % granularity.width != 0 || level_height % granularity.height != 0))
+            {
+                break;
+            }
+        }
+        return TileLayout{granularity, mip_tail_start};
+    }
+
+    std::shared_ptr<VirtualTextureFile> VirtualTextureSystem::open(const std::string &filename, TextureRole role, vk::Format format) const
+    {
+        const std::filesystem::path path = get_virtual_texture_path(filename, role);
+        std::error_code error;
+        const auto source_time = std::filesystem::last_write_time(filename, error);
+        if (error)
+        {
+            return nullptr;
+        }
+        const auto cooked_time = std::filesystem::last_write_time(path, error);
+        if (error || cooked_time < source_time)
+        {
+            return nullptr;
+        }
+        try
+        {
+            auto file = std::make_shared<VirtualTextureFile>(path);
+            if (file->format != format || std::max(file->width, file->height) < min_texture_size)
+            {
+                return nullptr;
+            }
+            // 换了 GPU 的话 tile 的形状可能不一样，重新切
+            const std::optional<TileLayout> layout = get_tile_layout(file->format, file->width, file->height, file->mip_levels);
+            if (!layout || layout->tile_extent != file->tile_extent || layout->mip_tail_start != file->mip_tail_start)
+            {
+                return nullptr;
+            }
+            return file;
+        }
+        catch (const std::exception &)
+        {
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<VirtualTextureFile> VirtualTextureSystem::cook(const std::string &filename, TextureRole role, const Ktx2File &chain) const
+    {
+        ZoneScoped;
+        if (std::max(chain.width, chain.height) < min_texture_size)
+        {
+            return nullptr;
+        }
+        const std::optional<TileLayout> layout = get_tile_layout(chain.format, chain.width, chain.height, chain.mip_levels);
+        if (!layout || layout->mip_tail_start == 0)
+        {
+            return nullptr;
+        }
+        try
+        {
+            const std::filesystem::path path = get_virtual_texture_path(filename, role);
+            VirtualTextureFile::save(chain, layout->tile_extent, layout->mip_tail_start, path);
+            return std::make_shared<VirtualTextureFile>(path);
+        }
+        catch (const std::exception &)
+        {
+            // 写不了 (只读目录之类) 就不做成虚拟的
+            return nullptr;
+        }
+    }
+
+    Texture VirtualTextureSystem::add(std::shared_ptr<VirtualTextureFile> file, const vk::SamplerCreateInfo &sampler_create_info, TextureUploadBatch &batch)
+    {
+        ZoneScoped;
+        const uint32_t first_tile = static_cast<uint32_t>(m_tiles.size());
+        if (first_tile + file->tile_count() > max_tiles)
+        {
+            throw std::runtime_error("virtual texture tiles are full");
+        }
+
+        vk::SharedImage image(m_device->createImage(vk::ImageCreateInfo(vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency,
+                                                                        vk::ImageType::e2D,
+                                                                        file->format,
+                                                                        vk::Extent3D{file->width, file->height, 1},
+                                                                        file->mip_levels,
+                                                                        1,
+                                                                        vk::SampleCountFlagBits::e1,
+                                                                        vk::ImageTiling::eOptimal,
+                                                                        sparse_image_usage)),
+                              m_device);
+        const vk::MemoryRequirements memory_requirements = m_device->getImageMemoryRequirements(image.get());
+        const std::vector<vk::SparseImageMemoryRequirements> sparse_requirements = m_device->getImageSparseMemoryRequirements(image.get());
+        auto sparse_it = std::ranges::find_if(sparse_requirements, [](const vk::SparseImageMemoryRequirements &requirements)
+                                              { return static_cast<bool>(requirements.formatProperties.aspectMask & vk::ImageAspectFlagBits::eColor); });
+        if (sparse_it == sparse_requirements.end() ||
+            sparse_it->imageMipTailFirstLod != file->mip_tail_start ||
+            sparse_it->formatProperties.imageGranularity.width != file->tile_extent.width ||
+            sparse_it->formatProperties.imageGranularity.height != file->tile_extent.height)
+        {
+            throw std::runtime_error("VirtualTextureSystem: sparse image layout does not match the tile file");
+        }
+        // 所有虚拟纹理共用一个页池，页的大小和内存类型要一致
+        if (m_page_size == 0)
+        {
+            m_page_size = memory_requirements.alignment;
+            m_page_memory_type_bits = memory_requirements.memoryTypeBits;
+        }
+        else if (memory_requirements.alignment != m_page_size || !(memory_requirements.memoryTypeBits & m_page_memory_type_bits))
+        {
+            throw std::runtime_error("VirtualTextureSystem: sparse page size does not match the page pool");
+        }
+        m_page_memory_type_bits &= memory_requirements.memoryTypeBits;
+
+        Texture texture;
+        texture.image = image;
+        if (file->mip_tail_start < file->mip_levels)
+        {
+            // mip tail 一直驻留，单独一块显存，绑定完再往下录
+            texture.memory = vk::SharedDeviceMemory(vk::su::allocateDeviceMemory(m_device.get(),
+                                                                                 m_physical_device.getMemoryProperties(),
+                                                                                 vk::MemoryRequirements(sparse_it->imageMipTailSize, memory_requirements.alignment, memory_requirements.memoryTypeBits),
+                                                                                 vk::MemoryPropertyFlagBits::eDeviceLocal),
+                                                    m_device);
+            const vk::SparseMemoryBind tail_bind(sparse_it->imageMipTailOffset, sparse_it->imageMipTailSize, texture.memory.get(), 0);
+            const vk::SparseImageOpaqueMemoryBindInfo opaque_bind(image.get(), tail_bind);
+            vk::SharedFence fence(m_device->createFence({}), m_device);
+            m_sparse_queue.bindSparse(vk::BindSparseInfo().setImageOpaqueBinds(opaque_bind), fence.get());
+            vk::detail::resultCheck(m_device->waitForFences(fence.get(), true, std::numeric_limits<uint64_t>::max()), "VirtualTextureSystem::add");
+        }
+        texture.image_view = vk::SharedImageView(m_device->createImageView(vk::ImageViewCreateInfo({},
+                                                                                                   image.get(),
+                                                                                                   vk::ImageViewType::e2D,
+                                                                                                   file->format,
+                                                                                                   {},
+                                                                                                   vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, file->mip_levels, 0, 1))),
+                                                 m_device);
+        texture.sampler = m_scene_drawer.sampler_cache->get(vk::SamplerCreateInfo(sampler_create_info).setMaxLod(VK_LOD_CLAMP_NONE));
+
+        // 整张转成 eShaderReadOnlyOptimal，没绑定的 tile 也跟着转，之后只拷贝进来
+        vk::CommandBuffer command_buffer = batch.command_buffer();
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+                                       image_barrier(image.get(), file->mip_levels, {}, vk::AccessFlagBits::eTransferWrite,
+                                                     vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal));
+        if (file->mip_tail_start < file->mip_levels)
+        {
+            DynamicBuffer staging_buffer = HostVisibleDynamicBufferBuilder(m_device, m_physical_device, file->mip_tail.size())
+                                               .set_usage(vk::BufferUsageFlagBits::eTransferSrc)
+                                               .build(file->mip_tail.data(), file->mip_tail.size());
+            std::vector<vk::BufferImageCopy> regions;
+            vk::DeviceSize buffer_offset = 0;
+            for (uint32_t level = file->mip_tail_start; level < file->mip_levels; ++level)
+            {
+                const vk::Extent2D level_extent = file->level_extent(level);
+                regions.emplace_back(buffer_offset, 0, 0,
+                                     vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+                                     vk::Offset3D{0, 0, 0},
+                                     vk::Extent3D{level_extent.width, level_extent.height, 1});
+                buffer_offset += get_block_bytes(file->format) != 0 ? get_compressed_level_size(file->format, level_extent.width, level_extent.height)
+                                                                    : level_extent.width * level_extent.height * 4;
+            }
+            command_buffer.copyBufferToImage(staging_buffer.vk_buffer(), image.get(), vk::ImageLayout::eTransferDstOptimal, regions);
+            batch.keep_alive(std::move(staging_buffer));
+        }
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, shader_stages, {}, nullptr, nullptr,
+                                       image_barrier(image.get(), file->mip_levels, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+                                                     vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal));
+
+        BindlessTextureTable &bindless_textures = m_scene_drawer.bindless_textures;
+        texture.bindless_index = bindless_textures.register_texture(texture);
+        const uint32_t texture_index = static_cast<uint32_t>(m_textures.size());
+        for (uint32_t level = 0; level < file->mip_tail_start; ++level)
+        {
+            const vk::Extent2D level_tiles = file->level_tiles(level);
+            for (uint32_t y = 0; y < level_tiles.height; ++y)
+            {
+                for (uint32_t x = 0; x < level_tiles.width; ++x)
+                {
+                    m_tiles.push_back(Tile{texture_index, level, x, y});
+                }
+            }
+        }
+        bindless_textures.set_virtual_texture(texture.bindless_index,
+                                              glm::uvec4(first_tile,
+                                                         file->width | file->height << 16,
+                                                         file->tile_extent.width | file->tile_extent.height << 16,
+                                                         file->mip_levels | file->mip_tail_start << 8));
+        m_textures.push_back(VirtualTexture{std::move(file), texture, first_tile});
+        return texture;
+    }
+
+    void VirtualTextureSystem::load_loop()
+    {
+        while (std::optional<TileRequest> request = m_tile_requests.pop())
+        {
+            ZoneScopedN("VirtualTextureSystem::load");
+            LoadedTile loaded{request->tile};
+            try
+            {
+                loaded.data = request->file->read_tile(request->file_tile);
+            }
+            catch (...)
+            {
+                loaded.error = std::current_exception();
+            }
+            if (!m_loaded_tiles.push(std::move(loaded)))
+            {
+                return;
+            }
+        }
+    }
+
+    void VirtualTextureSystem::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        ++m_frame_number;
+        // 这个 cpu frame 的 fence 刚等过：上次录的 tile 拷贝执行完了，可以让着色器用了
+        FrameWork &frame = m_frames[graphics.recording_cpu_frame()];
+        for (const UploadingTile &uploading : frame.copied)
+        {
+            set_resident(uploading.tile, true);
+        }
+        frame.copied.clear();
+
+        if (m_textures.empty())
+        {
+            return;
+        }
+        read_feedback(frame);
+        record_feedback_copy(command_buffer, frame);
+        record_tile_copies(command_buffer, frame);
+        bind_loaded_tiles(frame);
+    }
+
+    void VirtualTextureSystem::read_feedback(FrameWork &frame)
+    {
+        ZoneScoped;
+        const uint32_t *words = static_cast<const uint32_t *>(frame.feedback_readback.mapped_memory());
+        for (uint32_t word = 0; word < frame.feedback_words; ++word)
+        {
+            for (uint32_t bits = words[word]; bits != 0; bits &= bits - 1)
+            {
+                const uint32_t tile_index = word * 32 + std::countr_zero(bits);
+                Tile &tile = m_tiles[tile_index];
+                tile.last_used_frame = m_frame_number;
+                if (tile.state == TileState::NonResident)
+                {
+                    tile.state = TileState::Loading;
+                    ++m_loading_count;
+                    const VirtualTexture &texture = m_textures[tile.texture];
+                    m_tile_requests.push(TileRequest{texture.file, tile_index - texture.first_tile, tile_index});
+                }
+            }
+        }
+    }
+
+    void VirtualTextureSystem::record_feedback_copy(vk::CommandBuffer command_buffer, FrameWork &frame)
+    {
+        // 上一帧的着色器写完了才拷走、清零。第一次清零之前的内容是乱的，不拷
+        command_buffer.pipelineBarrier(shader_stages, vk::PipelineStageFlagBits::eTransfer, {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite),
+                                       nullptr, nullptr);
+        const uint32_t word_count = static_cast<uint32_t>(m_tiles.size() + 31) / 32;
+        frame.feedback_words = m_feedback_cleared ? word_count : 0;
+        if (frame.feedback_words > 0)
+        {
+            command_buffer.copyBuffer(m_feedback_buffer.vk_buffer(), frame.feedback_readback.vk_buffer(), vk::BufferCopy(0, 0, sizeof(uint32_t) * word_count));
+        }
+        command_buffer.fillBuffer(m_feedback_buffer.vk_buffer(), 0, VK_WHOLE_SIZE, 0);
+        m_feedback_cleared = true;
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, shader_stages | vk::PipelineStageFlagBits::eHost, {},
+                                       vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eHostRead),
+                                       nullptr, nullptr);
+    }
+
+    void VirtualTextureSystem::record_tile_copies(vk::CommandBuffer command_buffer, FrameWork &frame)
+    {
+        ZoneScoped;
+        // 上次录制时提交的绑定，拷贝之前要完成
+        if (frame.bind_pending)
+        {
+            vk::detail::resultCheck(m_device->waitForFences(frame.bind_fence.get(), true, std::numeric_limits<uint64_t>::max()), "VirtualTextureSystem::record_tile_copies");
+            m_device->resetFences(frame.bind_fence.get());
+            frame.bind_pending = false;
+        }
+        if (frame.bound.empty())
+        {
+            return;
+        }
+
+        std::map<uint32_t, std::vector<const UploadingTile *>> texture_tiles;
+        for (const UploadingTile &uploading : frame.bound)
+        {
+            texture_tiles[m_tiles[uploading.tile].texture].push_back(&uploading);
+        }
+        std::vector<vk::ImageMemoryBarrier> barriers;
+        for (const auto &[texture_index, tiles] : texture_tiles)
+        {
+            const VirtualTexture &texture = m_textures[texture_index];
+            barriers.push_back(image_barrier(texture.texture.image.get(), texture.file->mip_levels, {}, vk::AccessFlagBits::eTransferWrite,
+                                             vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferDstOptimal));
+        }
+        command_buffer.pipelineBarrier(shader_stages, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
+        for (const auto &[texture_index, tiles] : texture_tiles)
+        {
+            const vk::Image image = m_textures[texture_index].texture.image.get();
+            for (const UploadingTile *uploading : tiles)
+            {
+                const Tile &tile = m_tiles[uploading->tile];
+                const vk::SparseImageMemoryBind bind = get_tile_bind(tile, {}, 0);
+                command_buffer.copyBufferToImage(uploading->staging_buffer.vk_buffer(), image, vk::ImageLayout::eTransferDstOptimal,
+                                                 vk::BufferImageCopy(0, 0, 0,
+                                                                     vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, tile.level, 0, 1),
+                                                                     bind.offset,
+                                                                     bind.extent));
+            }
+        }
+        for (vk::ImageMemoryBarrier &barrier : barriers)
+        {
+            barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+                .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, shader_stages, {}, nullptr, nullptr, barriers);
+        frame.copied = std::move(frame.bound);
+        frame.bound.clear();
+    }
+
+    void VirtualTextureSystem::bind_loaded_tiles(FrameWork &frame)
+    {
+        ZoneScoped;
+        // 上一轮清掉驻留位的已经没有帧在读了，页先还回去给这次用
+        std::vector<uint32_t> evicted_tiles;
+        for (auto [tile, page] : frame.evicted)
+        {
+            evicted_tiles.push_back(tile);
+            m_free_pages.push_back(page);
+        }
+        frame.evicted.clear();
+
+        std::map<uint32_t, std::vector<vk::SparseImageMemoryBind>> image_binds;
+        for (uint32_t i = 0; i < tiles_per_frame; ++i)
+        {
+            std::optional<LoadedTile> loaded = m_loaded_tiles.try_pop();
+            if (!loaded)
+            {
+                break;
+            }
+            --m_loading_count;
+            Tile &tile = m_tiles[loaded->tile];
+            if (loaded->error)
+            {
+                // 读不出来的留在 Loading 不再请求，着色器一直用更糊的级
+                continue;
+            }
+            const std::optional<uint32_t> page = allocate_page(frame);
+            if (!page)
+            {
+                // 页都在用，下次反馈还要的话再读
+                tile.state = TileState::NonResident;
+                continue;
+            }
+            tile.page = *page;
+            tile.state = TileState::Uploading;
+            image_binds[tile.texture].push_back(get_tile_bind(tile, m_page_blocks[*page / pages_per_block].get(), *page % pages_per_block * m_page_size));
+            frame.bound.push_back(UploadingTile{loaded->tile,
+                                                HostVisibleDynamicBufferBuilder(m_device, m_physical_device, loaded->data.size())
+                                                    .set_usage(vk::BufferUsageFlagBits::eTransferSrc)
+                                                    .build(loaded->data.data(), loaded->data.size())});
+        }
+        // 换出去之后又读回来、已经绑了新页的不解绑
+        for (uint32_t tile_index : evicted_tiles)
+        {
+            const Tile &tile = m_tiles[tile_index];
+            if (tile.state == TileState::NonResident || tile.state == TileState::Loading)
+            {
+                image_binds[tile.texture].push_back(get_tile_bind(tile, {}, 0));
+            }
+        }
+        if (image_binds.empty())
+        {
+            return;
+        }
+
+        std::vector<vk::SparseImageMemoryBindInfo> bind_infos;
+        for (const auto &[texture_index, binds] : image_binds)
+        {
+            bind_infos.emplace_back(m_textures[texture_index].texture.image.get(), binds);
+        }
+        // 下次这个 cpu frame 录制时等它，再录拷贝
+        m_sparse_queue.bindSparse(vk::BindSparseInfo().setImageBinds(bind_infos), frame.bind_fence.get());
+        frame.bind_pending = true;
+    }
+
+    std::optional<uint32_t> VirtualTextureSystem::allocate_page(FrameWork &frame)
+    {
+        if (!m_free_pages.empty())
+        {
+            const uint32_t page = m_free_pages.back();
+            m_free_pages.pop_back();
+            return page;
+        }
+        if (m_page_count < max_pages)
+        {
+            if (m_page_count % pages_per_block == 0)
+            {
+                m_page_blocks.emplace_back(vk::su::allocateDeviceMemory(m_device.get(),
+                                                                        m_physical_device.getMemoryProperties(),
+                                                                        vk::MemoryRequirements(m_page_size * pages_per_block, m_page_size, m_page_memory_type_bits),
+                                                                        vk::MemoryPropertyFlagBits::eDeviceLocal),
+                                           m_device);
+            }
+            return m_page_count++;
+        }
+        // 满了：换出最久没被采样的，它的页等这个 cpu frame 下一轮才能用，这次还是分不到
+        auto victim = std::ranges::min_element(m_resident_tiles, {}, [this](uint32_t tile)
+                                               { return m_tiles[tile].last_used_frame; });
+        if (victim != m_resident_tiles.end() && m_frame_number - m_tiles[*victim].last_used_frame > keep_frames)
+        {
+            const uint32_t tile_index = *victim;
+            Tile &tile = m_tiles[tile_index];
+            frame.evicted.emplace_back(tile_index, tile.page);
+            tile.page = ~0u;
+            set_resident(tile_index, false);
+        }
+        return std::nullopt;
+    }
+
+    vk::SparseImageMemoryBind VirtualTextureSystem::get_tile_bind(const Tile &tile, vk::DeviceMemory memory, vk::DeviceSize memory_offset) const
+    {
+        const VirtualTextureFile &file = *m_textures[tile.texture].file;
+        const vk::Extent2D level_extent = file.level_extent(tile.level);
+        const uint32_t x = tile.x * file.tile_extent.width;
+        const uint32_t y = tile.y * file.tile_extent.height;
+        // 边上的 tile 到图像边为止
+        return vk::SparseImageMemoryBind(vk::ImageSubresource(vk::ImageAspectFlagBits::eColor, tile.level, 0),
+                                         vk::Offset3D{static_cast<int32_t>(x), static_cast<int32_t>(y), 0},
+                                         vk::Extent3D{std::min(file.tile_extent.width, level_extent.width - x), std::min(file.tile_extent.height, level_extent.height - y), 1},
+                                         memory,
+                                         memory_offset);
+    }
+
+    void VirtualTextureSystem::set_resident(uint32_t tile_index, bool resident)
+    {
+        uint32_t *words = static_cast<uint32_t *>(m_residency_buffer.mapped_memory());
+        Tile &tile = m_tiles[tile_index];
+        if (resident)
+        {
+            words[tile_index / 32] |= 1u << tile_index % 32;
+            tile.state = TileState::Resident;
+            m_resident_tiles.push_back(tile_index);
+        }
+        else
+        {
+            words[tile_index / 32] &= ~(1u << tile_index % 32);
+            tile.state = TileState::NonResident;
+            std::erase(m_resident_tiles, tile_index);
+        }
+    }
+}
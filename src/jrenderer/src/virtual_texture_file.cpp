@@ -0,0 +1,192 @@
+#include "jrenderer/asset/virtual_texture_file.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr std::array<char, 4> jvt_magic = {'J', 'V', 'T', '1'};
+
+        struct JvtHeader
+        {
+            std::array<char, 4> magic;
+            uint32_t vk_format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mip_levels;
+            uint32_t tile_width;
+            uint32_t tile_height;
+            uint32_t mip_tail_start;
+            uint32_t srgb;
+            uint32_t tile_count;
+        };
+        static_assert(sizeof(JvtHeader) == 40);
+
+        // 块压缩的按 4x4 块算，非压缩的只有 eR8G8B8A8Unorm，一个像素算一块
+        struct BlockLayout
+        {
+            uint32_t size;
+            uint32_t bytes;
+        };
+
+        BlockLayout get_block_layout(vk::Format format)
+        {
+            const uint32_t block_bytes = get_block_bytes(format);
+            return block_bytes != 0 ? BlockLayout{4, block_bytes} : BlockLayout{1, 4};
+        }
+
+        vk::Extent2D get_level_tiles(vk::Extent2D level_extent, vk::Extent2D tile_extent)
+        {
+            return {(level_extent.width + tile_extent.width - 1) / tile_extent.width, (level_extent.height + tile_extent.height - 1) / tile_extent.height};
+        }
+    }
+
+    void VirtualTextureFile::save(const Ktx2File &chain, vk::Extent2D tile_extent, uint32_t mip_tail_start, const std::filesystem::path &path)
+    {
+        const BlockLayout block = get_block_layout(chain.format);
+        if (tile_extent.width % block.size != 0 || tile_extent.height % block.size != 0 || mip_tail_start > chain.mip_levels)
+        {
+            throw std::runtime_error("VirtualTextureFile: tile extent does not fit the format");
+        }
+        std::vector<size_t> level_offsets(chain.mip_levels + 1, 0);
+        for (uint32_t level = 0; level < chain.mip_levels; ++level)
+        {
+            level_offsets[level + 1] = level_offsets[level] + chain.level_size(level);
+        }
+
+        std::vector<unsigned char> tiles;
+        std::vector<uint64_t> tile_offsets;
+        for (uint32_t level = 0; level < mip_tail_start; ++level)
+        {
+            const vk::Extent2D level_extent{std::max(chain.width >> level, 1u), std::max(chain.height >> level, 1u)};
+            const vk::Extent2D level_tiles = get_level_tiles(level_extent, tile_extent);
+            const uint32_t row_pitch = (level_extent.width + block.size - 1) / block.size * block.bytes;
+            const unsigned char *level_data = chain.data.data() + level_offsets[level];
+            for (uint32_t tile_y = 0; tile_y < level_tiles.height; ++tile_y)
+            {
+                for (uint32_t tile_x = 0; tile_x < level_tiles.width; ++tile_x)
+                {
+                    tile_offsets.push_back(tiles.size());
+                    // 边上的块只存图像里的部分
+                    const uint32_t x = tile_x * tile_extent.width;
+                    const uint32_t y = tile_y * tile_extent.height;
+                    const uint32_t block_columns = (std::min(tile_extent.width, level_extent.width - x) + block.size - 1) / block.size;
+                    const uint32_t block_rows = (std::min(tile_extent.height, level_extent.height - y) + block.size - 1) / block.size;
+                    for (uint32_t row = 0; row < block_rows; ++row)
+                    {
+                        const unsigned char *source = level_data + (y / block.size + row) * row_pitch + x / block.size * block.bytes;
+                        tiles.insert(tiles.end(), source, source + block_columns * block.bytes);
+                    }
+                }
+            }
+        }
+
+        const JvtHeader header{jvt_magic,
+                               static_cast<uint32_t>(chain.format),
+                               chain.width,
+                               chain.height,
+                               chain.mip_levels,
+                               tile_extent.width,
+                               tile_extent.height,
+                               mip_tail_start,
+                               chain.srgb,
+                               static_cast<uint32_t>(tile_offsets.size())};
+        const uint64_t tiles_offset = sizeof(JvtHeader) + (tile_offsets.size() + 1) * sizeof(uint64_t);
+        for (uint64_t &offset : tile_offsets)
+        {
+            offset += tiles_offset;
+        }
+        tile_offsets.push_back(tiles_offset + tiles.size());
+
+        // 和 Ktx2File::save 一样先写临时文件再改名
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            stream.write(reinterpret_cast<const char *>(tile_offsets.data()), tile_offsets.size() * sizeof(uint64_t));
+            stream.write(reinterpret_cast<const char *>(tiles.data()), tiles.size());
+            stream.write(reinterpret_cast<const char *>(chain.data.data() + level_offsets[mip_tail_start]), level_offsets[chain.mip_levels] - level_offsets[mip_tail_start]);
+            if (!stream)
+            {
+                throw std::runtime_error("VirtualTextureFile: failed to write " + temp_path.string());
+            }
+        }
+        std::filesystem::rename(temp_path, path);
+    }
+
+    VirtualTextureFile::VirtualTextureFile(const std::filesystem::path &path)
+        : m_stream(path, std::ios::binary)
+    {
+        if (!m_stream)
+        {
+            throw std::runtime_error("VirtualTextureFile: failed to open " + path.string());
+        }
+        JvtHeader header;
+        m_stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!m_stream || header.magic != jvt_magic || header.tile_width == 0 || header.tile_height == 0 || header.mip_tail_start > header.mip_levels)
+        {
+            throw std::runtime_error("VirtualTextureFile: not a virtual texture file " + path.string());
+        }
+        format = static_cast<vk::Format>(header.vk_format);
+        width = header.width;
+        height = header.height;
+        mip_levels = header.mip_levels;
+        tile_extent = vk::Extent2D{header.tile_width, header.tile_height};
+        mip_tail_start = header.mip_tail_start;
+        srgb = header.srgb != 0;
+        if (header.tile_count != level_first_tile(mip_tail_start))
+        {
+            throw std::runtime_error("VirtualTextureFile: unexpected tile count " + path.string());
+        }
+
+        m_tile_offsets.resize(header.tile_count + 1);
+        m_stream.read(reinterpret_cast<char *>(m_tile_offsets.data()), m_tile_offsets.size() * sizeof(uint64_t));
+        size_t tail_size = 0;
+        for (uint32_t level = mip_tail_start; level < mip_levels; ++level)
+        {
+            const vk::Extent2D extent = level_extent(level);
+            tail_size += get_block_bytes(format) != 0 ? get_compressed_level_size(format, extent.width, extent.height) : extent.width * extent.height * 4;
+        }
+        mip_tail.resize(tail_size);
+        m_stream.seekg(m_tile_offsets.back());
+        m_stream.read(reinterpret_cast<char *>(mip_tail.data()), mip_tail.size());
+        if (!m_stream)
+        {
+            throw std::runtime_error("VirtualTextureFile: truncated file " + path.string());
+        }
+    }
+
+    vk::Extent2D VirtualTextureFile::level_tiles(uint32_t level) const
+    {
+        return level < mip_tail_start ? get_level_tiles(level_extent(level), tile_extent) : vk::Extent2D{0, 0};
+    }
+
+    uint32_t VirtualTextureFile::level_first_tile(uint32_t level) const
+    {
+        uint32_t first_tile = 0;
+        for (uint32_t i = 0; i < level; ++i)
+        {
+            const vk::Extent2D tiles = level_tiles(i);
+            first_tile += tiles.width * tiles.height;
+        }
+        return first_tile;
+    }
+
+    std::vector<unsigned char> VirtualTextureFile::read_tile(uint32_t tile) const
+    {
+        std::vector<unsigned char> data(m_tile_offsets[tile + 1] - m_tile_offsets[tile]);
+        std::lock_guard lock(m_mutex);
+        m_stream.seekg(m_tile_offsets[tile]);
+        m_stream.read(reinterpret_cast<char *>(data.data()), data.size());
+        if (!m_stream)
+        {
+            m_stream.clear();
+            throw std::runtime_error("VirtualTextureFile: failed to read tile");
+        }
+        return data;
+    }
+}
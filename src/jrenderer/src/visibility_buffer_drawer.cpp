@@ -0,0 +1,423 @@
+#include "jrenderer/drawer/visibility_buffer_drawer.h"
+#include "jrenderer/drawer/scene_drawer.h"
+#include "jrenderer/graphics.h"
+#include "jrenderer/render_pass.h"
+#include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/descriptor_update.hpp"
+#include "tracy/Tracy.hpp"
+#include <vulkan_utils/utils.hpp>
+#include <ranges>
+
+namespace jre
+{
+    namespace
+    {
+        constexpr vk::Format id_format = vk::Format::eR32G32Uint;
+        constexpr vk::Format shaded_format = vk::Format::eR16G16B16A16Sfloat;
+        constexpr uint32_t invalid_id = 0xffffffffu;
+
+        vk::ImageMemoryBarrier shaded_barrier(vk::Image image, vk::AccessFlags src_access, vk::AccessFlags dst_access, vk::ImageLayout old_layout)
+        {
+            return vk::ImageMemoryBarrier(src_access, dst_access,
+                                          old_layout, vk::ImageLayout::eGeneral,
+                                          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                          image,
+                                          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        }
+
+        vk::BufferMemoryBarrier buffer_barrier(const DynamicBuffer &buffer, vk::AccessFlags src_access, vk::AccessFlags dst_access)
+        {
+            return vk::BufferMemoryBarrier(src_access, dst_access,
+                                           VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                           buffer.vk_buffer(), 0, VK_WHOLE_SIZE);
+        }
+    }
+
+    VisibilityBufferDrawer::VisibilityBufferDrawer(Graphics &graphics, SceneDrawer &scene_drawer)
+        : m_scene_drawer(scene_drawer), m_device(graphics.logical_device())
+    {
+        m_id_vertex_shader = vk::shared::create_shader_from_spv_file(m_device, scene_drawer.view_vertex_shader_path("res/shaders/depth_prepass"));
+        m_id_fragment_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/visibility.frag.spv");
+        m_classify_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/visibility_classify.comp.spv");
+        m_composite_vertex_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/visibility_composite.vert.spv");
+        m_composite_fragment_shader = vk::shared::create_shader_from_spv_file(m_device, "res/shaders/visibility_composite.frag.spv");
+        m_sampler = graphics.sampler_cache().get(vk::SamplerCreateInfo{}
+                                                     .setMagFilter(vk::Filter::eNearest)
+                                                     .setMinFilter(vk::Filter::eNearest)
+                                                     .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+                                                     .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+                                                     .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+                                                     .setAddressModeW(vk::SamplerAddressMode::eClampToEdge));
+
+        // ID pass：ID 用 eGeneral 留给 compute 读，深度留给 composite 采样
+        RenderPassBuilder render_pass_builder(m_device);
+        vk::AttachmentReference id_attachment = render_pass_builder.add_attachment(
+            vk::AttachmentDescription({}, id_format, vk::SampleCountFlagBits::e1,
+                                      vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                      vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+                                      vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral),
+            vk::ImageLayout::eColorAttachmentOptimal);
+        vk::AttachmentReference depth_attachment = render_pass_builder.add_attachment(
+            vk::AttachmentDescription({}, vk::su::pickDepthFormat(graphics.physical_device()), vk::SampleCountFlagBits::e1,
+                                      vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                      vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+                                      vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal),
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        render_pass_builder
+            .add_subpass(vk::SubpassDescription()
+                             .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+                             .setColorAttachments(id_attachment)
+                             .setPDepthStencilAttachment(&depth_attachment))
+            .add_dependency(vk::SubpassDependency()
+                                .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+                                .setDstSubpass(0)
+                                .setSrcStageMask(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader) // 上一帧的着色和 composite 还在读
+                                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests)
+                                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite))
+            .add_dependency(vk::SubpassDependency()
+                                .setSrcSubpass(0)
+                                .setDstSubpass(VK_SUBPASS_EXTERNAL)
+                                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+                                .setDstStageMask(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader)
+                                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                                .setDstAccessMask(vk::AccessFlagBits::eShaderRead));
+        m_render_pass = render_pass_builder.make_shared();
+
+        vk::DescriptorSetLayout scene_layout = scene_drawer.scene.descriptor_set_layout.get();
+        m_id_pipeline_layout = vk::shared::create_pipeline_layout(m_device,
+                                                                  {scene_layout, scene_drawer.scene.object_descriptor_set_layout.get()},
+                                                                  object_push_constant_range());
+        PipelineBuilder id_builder = scene_drawer.pipeline_builder;
+        id_builder.pipeline_layout = m_id_pipeline_layout.get();
+        id_builder.render_pass = m_render_pass.get();
+        id_builder.vertex_attribute_descriptions = {get_attribute_descriptions<Vertex>(0).front()}; // 只要位置
+        id_builder.color_blend_attachments = {PipelineBuilder::ColorBlendAttachment::overwrite()};   // 整数格式不能混合
+        id_builder.viewports.resize(1);                                                              // 只画主视口
+        id_builder.scissors.resize(1);
+        id_builder.set_multisampling(vk::SampleCountFlagBits::e1)
+            .clear_shaders()
+            .add_vertex_shader(m_id_vertex_shader.get())
+            .add_fragment_shader(m_id_fragment_shader.get());
+        m_id_pipeline = id_builder.build();
+
+        vk::ShaderStageFlags compute = vk::ShaderStageFlagBits::eCompute;
+        std::tie(m_descriptor_pool, m_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            m_device,
+            static_cast<uint32_t>(graphics.cpu_frames().size()),
+            {{{0, vk::DescriptorType::eStorageImage, 1, compute},
+              {1, vk::DescriptorType::eStorageBuffer, 1, compute},
+              {2, vk::DescriptorType::eStorageBuffer, 1, compute},
+              {3, vk::DescriptorType::eStorageBuffer, 1, compute},
+              {4, vk::DescriptorType::eStorageImage, 1, compute}}});
+        m_descriptor_sets = vk::shared::allocate_descriptor_sets(m_descriptor_pool,
+                                                                 std::vector<vk::DescriptorSetLayout>(graphics.cpu_frames().size(), m_descriptor_set_layout.get()));
+        vk::PushConstantRange push_constant_range{vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants)};
+        m_classify_pipeline_layout = vk::shared::create_pipeline_layout(m_device, {scene_layout, m_descriptor_set_layout.get()}, push_constant_range);
+        m_classify_pipeline = ComputePipelineBuilder(m_device, m_classify_pipeline_layout.get())
+                                  .set_shader(m_classify_shader.get())
+                                  .build();
+
+        m_descriptor_allocator = &graphics.descriptor_allocator();
+        m_geometry_descriptor_set_layout = graphics.descriptor_set_layouts().get({vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageBuffer, 1, compute},
+                                                                                  vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1, compute}});
+        m_geometry_update_template = DescriptorUpdateTemplate<GeometryDescriptors>(
+            m_device,
+            m_geometry_descriptor_set_layout.get(),
+            {DescriptorUpdateTemplate<GeometryDescriptors>::entry(0, vk::DescriptorType::eStorageBuffer, offsetof(GeometryDescriptors, vertexes)),
+             DescriptorUpdateTemplate<GeometryDescriptors>::entry(1, vk::DescriptorType::eStorageBuffer, offsetof(GeometryDescriptors, indices))});
+        // 换出去的 mesh 放掉之后缓冲句柄可能分给新的 mesh，按句柄存的 set 跟着删掉
+        scene_drawer.retired_meshes->add_release_listener([this](const std::shared_ptr<Mesh> &mesh)
+                                                          { m_geometry_descriptor_sets.erase(std::make_tuple(mesh->vertex_buffer.buffer().get(), mesh->index_buffer.buffer().get())); });
+
+        std::tie(m_composite_descriptor_pool, m_composite_descriptor_set_layout) = vk::shared::make_descriptor_pool_with_layout(
+            m_device,
+            1,
+            {{{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment},
+              {1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment},
+              {2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}}});
+        m_composite_descriptor_set = vk::shared::allocate_one_descriptor_set(m_composite_descriptor_pool, m_composite_descriptor_set_layout.get());
+        m_composite_pipeline_layout = vk::shared::create_pipeline_layout(m_device, m_composite_descriptor_set_layout.get(), {});
+        create_composite_pipeline(graphics);
+
+        for (auto _ : std::views::iota(0u, graphics.cpu_frames().size()))
+        {
+            m_draw_buffers.push_back(HostArrayBufferBuilder<DrawRecord>(m_device, graphics.physical_device(), sizeof(DrawRecord) * max_draws)
+                                         .set_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+                                         .build());
+        }
+        m_bin_args_reset.assign(max_bins, vk::DispatchIndirectCommand{0, 1, 1});
+        m_bin_args = BufferBuilder<void>(m_device,
+                                         graphics.physical_device(),
+                                         vk::BufferCreateInfo()
+                                             .setSize(sizeof(vk::DispatchIndirectCommand) * max_bins)
+                                             .setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst),
+                                         vk::MemoryPropertyFlagBits::eDeviceLocal)
+                     .build();
+        create_resources(graphics);
+    }
+
+    void VisibilityBufferDrawer::create_composite_pipeline(Graphics &graphics)
+    {
+        PipelineBuilder builder = m_scene_drawer.pipeline_builder;
+        builder.pipeline_layout = m_composite_pipeline_layout.get();
+        builder.render_pass = graphics.render_pass().get();
+        builder.vertex_binding_descriptions.clear();
+        builder.vertex_attribute_descriptions.clear();
+        builder.color_blend_attachments = {PipelineBuilder::ColorBlendAttachment::overwrite()};
+        builder.depth_stencil.setDepthCompareOp(vk::CompareOp::eAlways); // 深度来自 ID pass，原样写进主 pass 的深度
+        builder.set_multisampling(graphics.settings().msaa)
+            .clear_shaders()
+            .add_vertex_shader(m_composite_vertex_shader.get())
+            .add_fragment_shader(m_composite_fragment_shader.get());
+        m_composite_pipeline = builder.build();
+    }
+
+    void VisibilityBufferDrawer::create_resources(Graphics &graphics)
+    {
+        m_extent = graphics.swapchain_extent();
+        m_tile_count_x = (m_extent.width + tile_size - 1) / tile_size;
+        m_tile_count_y = (m_extent.height + tile_size - 1) / tile_size;
+
+        auto color_image = [&](vk::Format format, vk::ImageUsageFlags usage)
+        {
+            DeviceImageBuilder builder(m_device, graphics.physical_device());
+            builder.set_image_create_info(vk::ImageCreateInfo{
+                {},
+                vk::ImageType::e2D,
+                format,
+                vk::Extent3D{m_extent.width, m_extent.height, 1},
+                1,
+                1,
+                vk::SampleCountFlagBits::e1,
+                vk::ImageTiling::eOptimal,
+                usage,
+                vk::SharingMode::eExclusive});
+            builder.image_view_create_info.setViewType(vk::ImageViewType::e2D)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+            builder.memory_properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            return builder.build();
+        };
+        m_id_image = color_image(id_format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+        m_shaded_image = color_image(shaded_format, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+        m_depth_image = DepthStencilAttachment2DBuilder(m_device, graphics.physical_device())
+                            .set_extent(m_extent)
+                            .set_usage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled)
+                            .build();
+
+        std::array<vk::ImageView, 2> attachments = {m_id_image.image_view.get(), m_depth_image.image_view.get()};
+        m_framebuffer = vk::SharedFramebuffer(m_device->createFramebuffer(vk::FramebufferCreateInfo({}, m_render_pass.get(), attachments, m_extent.width, m_extent.height, 1)),
+                                              m_device);
+
+        m_bin_tiles = BufferBuilder<void>(m_device,
+                                          graphics.physical_device(),
+                                          vk::BufferCreateInfo()
+                                              .setSize(sizeof(uint32_t) * max_bins * m_tile_count_x * m_tile_count_y)
+                                              .setUsage(vk::BufferUsageFlagBits::eStorageBuffer),
+                                          vk::MemoryPropertyFlagBits::eDeviceLocal)
+                      .build();
+
+        for (auto [descriptor_set, draw_buffer] : std::views::zip(m_descriptor_sets, m_draw_buffers))
+        {
+            DescripterSetUpdater(descriptor_set)
+                .write_storage_image(m_id_image.image_view.get())
+                .write_storage_buffer(vk::DescriptorBufferInfo{draw_buffer.vk_buffer(), 0, VK_WHOLE_SIZE})
+                .write_storage_buffer(vk::DescriptorBufferInfo{m_bin_args.vk_buffer(), 0, VK_WHOLE_SIZE})
+                .write_storage_buffer(vk::DescriptorBufferInfo{m_bin_tiles.vk_buffer(), 0, VK_WHOLE_SIZE})
+                .write_storage_image(m_shaded_image.image_view.get())
+                .update();
+        }
+        DescripterSetUpdater(m_composite_descriptor_set)
+            .write_combined_image_sampler(vk::DescriptorImageInfo{m_sampler.get(), m_id_image.image_view.get(), vk::ImageLayout::eGeneral})
+            .write_combined_image_sampler(vk::DescriptorImageInfo{m_sampler.get(), m_shaded_image.image_view.get(), vk::ImageLayout::eGeneral})
+            .write_combined_image_sampler(vk::DescriptorImageInfo{m_sampler.get(), m_depth_image.image_view.get(), vk::ImageLayout::eShaderReadOnlyOptimal})
+            .update();
+    }
+
+    bool VisibilityBufferDrawer::handles(uint32_t model_index, uint32_t material_index, const RenderMeshData &mesh_data, const RenderMaterialData &material_data) const
+    {
+        return supports(mesh_data, material_data) && !m_overflowed.contains({model_index, material_index});
+    }
+
+    bool VisibilityBufferDrawer::supports(const RenderMeshData &mesh_data, const RenderMaterialData &material_data) const
+    {
+        return material_data.render_pipeline &&
+               material_data.render_pipeline->visibility_shader &&
+               !material_data.render_pipeline->material_descriptor_set_layout && // 着色 pipeline 没有 set_material
+               mesh_data.vertexes.size() == 1 &&
+               mesh_data.index_type == vk::IndexType::eUint32;
+    }
+
+    vk::DescriptorSet VisibilityBufferDrawer::get_geometry_descriptor_set(const RenderMeshData &mesh_data)
+    {
+        auto [it, inserted] = m_geometry_descriptor_sets.try_emplace(std::make_tuple(mesh_data.vertexes.front(), mesh_data.index_buffer));
+        if (inserted)
+        {
+            it->second = m_descriptor_allocator->allocate(m_geometry_descriptor_set_layout.get());
+            m_geometry_update_template.update(it->second.get(),
+                                              GeometryDescriptors{vk::DescriptorBufferInfo{mesh_data.vertexes.front(), 0, VK_WHOLE_SIZE},
+                                                                  vk::DescriptorBufferInfo{mesh_data.index_buffer, 0, VK_WHOLE_SIZE}});
+        }
+        return it->second.get();
+    }
+
+    const VisibilityBufferDrawer::ShadingPipeline &VisibilityBufferDrawer::get_shading_pipeline(RenderPipeline *render_pipeline)
+    {
+        auto [it, inserted] = m_shading_pipelines.try_emplace(std::make_tuple(render_pipeline->visibility_shader.get(), render_pipeline->visibility_constants.constants()));
+        if (inserted)
+        {
+            it->second.pipeline_layout = vk::shared::create_pipeline_layout(
+                m_device,
+                {m_scene_drawer.scene.descriptor_set_layout.get(),
+                 m_descriptor_set_layout.get(),
+                 m_scene_drawer.bindless_textures.descriptor_set_layout(),
+                 m_geometry_descriptor_set_layout.get()},
+                vk::PushConstantRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants)});
+            it->second.pipeline = ComputePipelineBuilder(m_device, it->second.pipeline_layout.get())
+                                      .set_shader(render_pipeline->visibility_shader.get(), render_pipeline->visibility_constants)
+                                      .build();
+        }
+        return it->second;
+    }
+
+    uint32_t VisibilityBufferDrawer::get_bin(const RenderMeshData &mesh_data, const RenderMaterialData &material_data)
+    {
+        auto [it, inserted] = m_bin_indices.try_emplace(std::make_tuple(material_data.render_pipeline, mesh_data.vertexes.front()),
+                                                        static_cast<uint32_t>(m_bins.size()));
+        if (inserted)
+        {
+            m_bins.push_back({material_data.render_pipeline, get_geometry_descriptor_set(mesh_data)});
+        }
+        return it->second;
+    }
+
+    void VisibilityBufferDrawer::on_draw(Graphics &graphics, vk::CommandBuffer command_buffer)
+    {
+        ZoneScoped;
+        const uint32_t frame = graphics.current_cpu_frame();
+        Scene &scene = m_scene_drawer.scene;
+        if (scene.render_viewports.size() != 1) // 多视口时全部前向画
+        {
+            draw_count = bin_count = culled_sub_mesh_count = 0;
+            return;
+        }
+        IOcclusionCuller *culler = m_scene_drawer.occlusion_culler.get();
+        if (culler)
+        {
+            culler->prepare(scene, frame);
+        }
+        vk::DescriptorSet scene_descriptor_set = scene.descriptor_sets[frame].get();
+        HostArrayBuffer<DrawRecord> &draw_buffer = m_draw_buffers[frame];
+        m_bins.clear();
+        m_bin_indices.clear();
+        m_overflowed.clear();
+        draw_count = 0;
+        culled_sub_mesh_count = 0;
+
+        // 上一帧的 indirect dispatch 读完了才能重置
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::PipelineStageFlagBits::eTransfer,
+                                       {}, nullptr,
+                                       buffer_barrier(m_bin_args, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite),
+                                       nullptr);
+        command_buffer.updateBuffer<vk::DispatchIndirectCommand>(m_bin_args.vk_buffer(), 0, m_bin_args_reset);
+
+        std::array<vk::ClearValue, 2> clear_values = {vk::ClearColorValue(std::array<uint32_t, 4>{invalid_id, invalid_id, 0, 0}),
+                                                      vk::ClearDepthStencilValue(1.0f, 0)};
+        command_buffer.beginRenderPass(vk::RenderPassBeginInfo(m_render_pass.get(), m_framebuffer.get(), {{0, 0}, m_extent}, clear_values), vk::SubpassContents::eInline);
+        command_buffer.setViewport(0, vk::Viewport{0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f});
+        command_buffer.setScissor(0, vk::Rect2D{{0, 0}, m_extent});
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_id_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_id_pipeline_layout.get(), static_cast<int>(UniformBufferSetIndex::PerRenderSet),
+                                          {scene_descriptor_set, scene.object_descriptor_sets[frame].get()}, nullptr);
+        DiffMeshBinder mesh_binder;
+        for (auto [model_index, model, vertex_base] : std::views::zip(std::views::iota(0u), scene.models, scene.vertex_bases))
+        {
+            const RenderMeshData mesh_data = model.mesh->get_render_data();
+            const glm::mat4 model_matrix = model.transform.model(frame);
+            bool model_bound = false;
+            for (auto [material_index, material] : model.materials | std::views::enumerate)
+            {
+                const RenderSubMeshData &sub_mesh = mesh_data.sub_meshes[material_index % mesh_data.sub_meshes.size()];
+                const RenderMaterialData material_data = material->get_render_data(frame);
+                if (!supports(mesh_data, material_data))
+                {
+                    continue;
+                }
+                if (culler && !culler->is_visible(sub_mesh.bounds, model_matrix))
+                {
+                    ++culled_sub_mesh_count;
+                    continue;
+                }
+                // draw 或者 bin 满了，剩下的交给前向画
+                if (draw_count >= max_draws || (m_bins.size() >= max_bins && !m_bin_indices.contains({material_data.render_pipeline, mesh_data.vertexes.front()})))
+                {
+                    m_overflowed.insert({static_cast<uint32_t>(model_index), static_cast<uint32_t>(material_index)});
+                    continue;
+                }
+                if (!model_bound)
+                {
+                    mesh_binder.bind(mesh_data, command_buffer);
+                    model_bound = true;
+                }
+                draw_buffer[draw_count] = {model_matrix, get_bin(mesh_data, material_data), sub_mesh.vertex_offset, sub_mesh.index_offset, material_data.material_id};
+                command_buffer.pushConstants<ObjectPushConstants>(m_id_pipeline_layout.get(), object_push_constant_range().stageFlags, 0, ObjectPushConstants{vertex_base, draw_count});
+                command_buffer.drawIndexed(sub_mesh.index_count, 1, sub_mesh.index_offset, sub_mesh.vertex_offset, 0);
+                ++draw_count;
+            }
+        }
+        command_buffer.endRenderPass();
+        bin_count = static_cast<uint32_t>(m_bins.size());
+
+        // 分类：每个 tile 一个 workgroup
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::PipelineStageFlagBits::eComputeShader,
+                                       {}, nullptr,
+                                       buffer_barrier(m_bin_args, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite),
+                                       shaded_barrier(m_shaded_image.image.get(), {}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined)); // 上一帧的 composite 读完了再写
+        PushConstants push_constants{{m_extent.width, m_extent.height},
+                                     m_tile_count_x,
+                                     m_tile_count_x * m_tile_count_y,
+                                     0,
+                                     sizeof(Vertex) / sizeof(float),
+                                     offsetof(Vertex, pos) / sizeof(float),
+                                     offsetof(Vertex, normal) / sizeof(float),
+                                     offsetof(Vertex, tex_coord) / sizeof(float)};
+        vk::DescriptorSet descriptor_set = m_descriptor_sets[frame].get();
+        if (draw_count > 0)
+        {
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_classify_pipeline.get());
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_classify_pipeline_layout.get(), 1, descriptor_set, nullptr);
+            command_buffer.pushConstants<PushConstants>(m_classify_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+            command_buffer.dispatch(m_tile_count_x, m_tile_count_y, 1);
+
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                           vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+                                           {},
+                                           vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead),
+                                           nullptr, nullptr);
+        }
+
+        // 着色：每个 bin 只在自己的 tile 上跑，材质 pipeline 和网格 set 一个 bin 换一次
+        for (auto [bin_index, bin] : m_bins | std::views::enumerate)
+        {
+            const ShadingPipeline &shading_pipeline = get_shading_pipeline(bin.render_pipeline);
+            push_constants.bin = static_cast<uint32_t>(bin_index);
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, shading_pipeline.pipeline.get());
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, shading_pipeline.pipeline_layout.get(), 0,
+                                              {scene_descriptor_set, descriptor_set, m_scene_drawer.bindless_textures.descriptor_set(), bin.geometry_descriptor_set}, nullptr);
+            command_buffer.pushConstants<PushConstants>(shading_pipeline.pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+            command_buffer.dispatchIndirect(m_bin_args.vk_buffer(), sizeof(vk::DispatchIndirectCommand) * bin_index);
+        }
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+                                       {}, nullptr, nullptr,
+                                       shaded_barrier(m_shaded_image.image.get(), vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral));
+    }
+
+    void VisibilityBufferDrawer::draw_composite(vk::CommandBuffer command_buffer)
+    {
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_composite_pipeline.get());
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_composite_pipeline_layout.get(), 0, m_composite_descriptor_set.get(), nullptr);
+        command_buffer.draw(3, 1, 0, 0);
+    }
+}
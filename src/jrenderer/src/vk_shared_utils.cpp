@@ -1,4 +1,5 @@
 #include "jrenderer/utils/vk_shared_utils.h"
+#include "jrenderer/asset/asset_archive.h"
 
 #include <vector>
 #include <vulkan/vulkan_shared.hpp>
@@ -35,13 +36,13 @@ namespace vk
                 {
                     if (pool_size_iter->type == binding.descriptorType)
                     {
-                        pool_size_iter->descriptorCount++;
+                        pool_size_iter->descriptorCount += binding.descriptorCount; // 数组 binding 占 descriptorCount 个
                         break;
                     }
                 }
                 if (pool_size_iter == pool_sizes.end())
                 {
-                    pool_sizes.push_back({binding.descriptorType, 1});
+                    pool_sizes.push_back({binding.descriptorType, binding.descriptorCount});
                 }
             }
             return pool_sizes;
@@ -53,6 +54,10 @@ namespace vk
             vk::ArrayProxy<vk::DescriptorSetLayoutBinding> bindings)
         {
             std::vector<vk::DescriptorPoolSize> pool_sizes = count_pool_sizes(bindings);
+            for (auto &pool_size : pool_sizes)
+            {
+                pool_size.descriptorCount *= max_sets; // pool size 是整个pool的总量，不是每个set的
+            }
             return {vk::SharedDescriptorPool(
                         device->createDescriptorPool(
                             vk::DescriptorPoolCreateInfo(
@@ -81,28 +86,18 @@ namespace vk
         }
         std::vector<char> load_spv_shader_file(const std::string &file_path)
         {
-            std::ifstream file(file_path, std::ios::ate | std::ios::binary);
-            if (!file.is_open())
-            {
-                throw std::runtime_error("failed to open file!");
-            }
-
-            // std::ios::ate, Start reading at the end of the file
-            // The advantage of starting to read at the end of the file is that we can use the read position to determine the size of the file and allocate a buffer:
-            // https://cplusplus.com/reference/istream/istream/tellg/
-            // Returns the position of the current character in the input stream.
-            size_t file_size = (size_t)file.tellg();
-            std::vector<char> buffer(file_size);
-
-            file.seekg(0, file.beg);
-            file.read(buffer.data(), file_size);
-            file.close();
-
-            return buffer;
+            const jre::AssetBlob blob = jre::read_asset(file_path);
+            const char *begin = reinterpret_cast<const char *>(blob.data().data());
+            return std::vector<char>(begin, begin + blob.size());
         }
 
         vk::SharedShaderModule create_shader_from_spv(vk::SharedDevice device, const std::vector<char> &content)
         {
+            return create_shader_from_spv(device, std::as_bytes(std::span(content)));
+        }
+        vk::SharedShaderModule create_shader_from_spv(vk::SharedDevice device, std::span<const std::byte> content)
+        {
+            // 打包文件里的条目至少 4 字节对齐，散文件是整个映射的，都能直接当 pCode 用
             vk::ShaderModuleCreateInfo create_info{};
             create_info.codeSize = content.size();
             create_info.pCode = reinterpret_cast<const uint32_t *>(content.data());
@@ -110,7 +105,7 @@ namespace vk
         }
         vk::SharedShaderModule create_shader_from_spv_file(vk::SharedDevice device, const std::string &file_path)
         {
-            return create_shader_from_spv(device, load_spv_shader_file(file_path));
+            return create_shader_from_spv(device, jre::read_asset(file_path).data());
         }
 
         vk::SharedPipelineLayout create_pipeline_layout(vk::SharedDevice device,
@@ -0,0 +1,81 @@
+// 资源打包：把文件和目录 (递归) 打成一个 .jpak，条目名是相对工作目录的路径，要在运行程序的目录下打。
+// 运行时挂上之后着色器、贴图、模型和烘焙好的 .ktx2/.jmesh 都从包里读，不再一个个打开散文件
+// usage: AssetPacker [--lz4] [--alignment N] <output.jpak> <path>...
+#include "jrenderer/asset/asset_archive.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    jre::AssetArchive::Builder builder;
+    int arg = 1;
+    for (; arg < argc; ++arg)
+    {
+        const std::string option = argv[arg];
+        if (option == "--lz4")
+        {
+            builder.compress = true;
+        }
+        else if (option == "--alignment" && arg + 1 < argc)
+        {
+            builder.alignment = std::stoul(argv[++arg]);
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (argc - arg < 2)
+    {
+        fmt::print("usage: AssetPacker [--lz4] [--alignment N] <output.jpak> <path>...\n");
+        return 1;
+    }
+    const std::filesystem::path output = argv[arg++];
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t file_count = 0;
+    uintmax_t source_size = 0;
+    auto add_file = [&](const std::filesystem::path &path)
+    {
+        // .tmp 是烘焙写到一半的
+        if (path.extension() == ".tmp" || std::filesystem::weakly_canonical(path) == std::filesystem::weakly_canonical(output))
+        {
+            return;
+        }
+        builder.add_file(path, path);
+        source_size += std::filesystem::file_size(path);
+        ++file_count;
+    };
+    try
+    {
+        for (; arg < argc; ++arg)
+        {
+            const std::filesystem::path path = argv[arg];
+            if (std::filesystem::is_directory(path))
+            {
+                for (const auto &entry : std::filesystem::recursive_directory_iterator(path))
+                {
+                    if (entry.is_regular_file())
+                    {
+                        add_file(entry.path());
+                    }
+                }
+            }
+            else
+            {
+                add_file(path);
+            }
+        }
+        builder.save(output);
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print("{}: {}\n", output.string(), e.what());
+        return 1;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fmt::print("{}: {} files, {} KB -> {} KB, {:.1f} ms\n",
+               output.string(), file_count, source_size / 1024, std::filesystem::file_size(output) / 1024, ms);
+    return 0;
+}
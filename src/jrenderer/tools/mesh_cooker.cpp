@@ -0,0 +1,39 @@
+// 离线网格烘焙：PMX/OBJ 转成 .jmesh，写到 get_cooked_mesh_path，用 AssetPacker 打包之后运行时映射、直接拷进 staging
+// usage: MeshCooker [--quantize] <model>...
+#include "jrenderer/asset/mesh_cooker.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    const bool quantize = argc > 1 && std::string(argv[1]) == "--quantize";
+    const int first_model = quantize ? 2 : 1;
+    if (argc <= first_model)
+    {
+        fmt::print("usage: MeshCooker [--quantize] <model>...\n");
+        return 1;
+    }
+    int failed = 0;
+    for (int i = first_model; i < argc; ++i)
+    {
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            const jre::CookedMeshData data = jre::cook_mesh(argv[i]);
+            const std::vector<std::byte> bytes = jre::JMeshFile::encode(data, quantize);
+            const std::filesystem::path cooked_path = jre::get_cooked_mesh_path(argv[i]);
+            jre::JMeshFile::save(bytes, cooked_path);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            fmt::print("{} -> {}: {} vertices, {} indices, {} sub meshes, {} KB, {:.1f} ms\n",
+                       argv[i], cooked_path.string(), data.vertices.size(), data.indices.size(), data.sub_meshes.size(),
+                       bytes.size() / 1024, ms);
+        }
+        catch (const std::exception &e)
+        {
+            fmt::print("{}: {}\n", argv[i], e.what());
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// 离线纹理烘焙：按用途把 png/jpg 编成块压缩的 KTX2，写到 get_cooked_texture_path，用 AssetPacker 打包之后运行时直接读
+// usage: TextureCooker <color|data|rg|r> <image>...
+#include "jrenderer/asset/texture_cooker.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    const std::map<std::string, jre::TextureRole> roles = {{"color", jre::TextureRole::Color},
+                                                           {"data", jre::TextureRole::Data},
+                                                           {"rg", jre::TextureRole::TwoChannel},
+                                                           {"r", jre::TextureRole::SingleChannel}};
+    if (argc < 3 || !roles.contains(argv[1]))
+    {
+        fmt::print("usage: TextureCooker <color|data|rg|r> <image>...\n");
+        return 1;
+    }
+    const jre::TextureRole role = roles.at(argv[1]);
+    jre::WorkerPool workers;
+    int failed = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            jre::Ktx2File file = jre::cook_texture(argv[i], role, &workers);
+            const std::filesystem::path cooked_path = jre::get_cooked_texture_path(argv[i], role);
+            file.save(cooked_path);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const size_t rgba8_size = static_cast<size_t>(file.width) * file.height * 4 * 4 / 3; // 带 mip 的 RGBA8 约多 1/3
+            fmt::print("{} -> {}: {}x{} {} mips, {} KB (RGBA8 {} KB), {:.1f} ms\n",
+                       argv[i], cooked_path.string(), file.width, file.height, file.mip_levels,
+                       file.data.size() / 1024, rgba8_size / 1024, ms);
+        }
+        catch (const std::exception &e)
+        {
+            fmt::print("{}: {}\n", argv[i], e.what());
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
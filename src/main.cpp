@@ -1,10 +1,16 @@
 #include "app.h"
+#include "jrenderer/asset/asset_archive.h"
 
 int WinMain(HINSTANCE hinst,
             HINSTANCE hprev,
             LPSTR cmdline,
             int show)
 {
+    // 发布时 res 打成 res.jpak (AssetPacker)，有的话先挂上，渲染器构造时读的 shader 也从包里来
+    if (std::filesystem::exists("res.jpak"))
+    {
+        jre::mount_asset_archive(std::make_shared<const jre::AssetArchive>("res.jpak"));
+    }
     App app(hinst, hprev, cmdline, show);
     return app.main_loop();
 }